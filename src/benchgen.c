@@ -0,0 +1,851 @@
+/************************************************************************/
+/**
+
+   \file       benchgen.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Generate synthetic structures and loop databases for
+               benchmarking
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Writes the input data for test/bench.sh.
+
+   With -p, writes a PDB file of synthetic protein chains. The backbone
+   is built from ideal bond lengths and angles with phi/psi taken from
+   helix, strand and coil segments, so the chains have the local
+   geometry of real proteins and pass the backbone checks in
+   buildloopdb. Loops with their stems, with the backbone angles of
+   loops in test/pdb1yqv.ent that pass the default distance table, are
+   mixed in so that a build with the default table finds records. Each residue
+   has N, CA, C, O and (except glycine) CB.
+   Residue numbers run to 9999 and then restart with an insertion code
+   so that chains of up to 50k residues can be written.
+
+   With -d, writes a loop database in the format written by
+   buildloopdb. Loop lengths follow an exponential distribution and
+   each distance is drawn from a normal distribution with the mean and
+   standard deviation in distances.h, keeping only values within the
+   default distance table, as for the records of a real build. The
+   database is marked as shard 1 of 1 so that mergeloopdb -q can
+   write a sidecar for it.
+
+   Both use their own random number generator so the same seed gives
+   the same files on every platform.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "bioplib/SysDefs.h"
+#include "loopdb.h"
+#include "distances.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXBUFF        160
+#define DEF_SEED       12345
+#define DEF_MEANLEN    12.0     /* Mean loop length in a database       */
+#define DEF_MAXLEN     100      /* Longest loop in a database           */
+#define DEF_PERENTRY   50       /* Mean records for each PDB code       */
+#define MAXRESNUM      9999     /* Largest PDB residue number           */
+#define MAXCHAINS      26
+
+#define BOND_NCA       1.458    /* Ideal backbone geometry              */
+#define BOND_CAC       1.525
+#define BOND_CN        1.329
+#define BOND_CO        1.231
+#define ANGLE_NCAC     111.2
+#define ANGLE_CACN     116.2
+#define ANGLE_CNCA     121.7
+#define ANGLE_CACO     120.5
+#define OMEGA          180.0
+
+#define SS_HELIX       0
+#define SS_STRAND      1
+#define SS_COIL        2
+#define SS_LOOP        3
+
+#define MAXTEMPLATE    15       /* Most residues in a loop template     */
+#define NTEMPLATE      3
+#define LOOP_FRACTION  0.15     /* Fraction of segments that are loops  */
+#define LOOP_SD        2.0      /* Scatter on template phi/psi          */
+
+#ifndef PI
+#define PI             (4.0 * atan(1.0))
+#endif
+#define DEG2RAD(x)     ((x) * PI / 180.0)
+
+typedef struct
+{
+   REAL n[3],
+        ca[3],
+        c[3],
+        o[3],
+        cb[3];
+   char resnam[4],
+        chain;
+}  SYNRES;
+
+/* A loop with its stems. The angles for each residue are those of the
+   peptide bond before it, N-CA-C and phi/psi
+*/
+typedef struct
+{
+   int  nRes;
+   REAL omega[MAXTEMPLATE],
+        cacn[MAXTEMPLATE],
+        cnca[MAXTEMPLATE],
+        ncac[MAXTEMPLATE],
+        phi[MAXTEMPLATE],
+        psi[MAXTEMPLATE];
+}  LOOPTEMPLATE;
+
+/************************************************************************/
+/* Globals
+*/
+static unsigned long sRandState = DEF_SEED;
+
+/************************************************************************/
+/* Prototypes
+*/
+int  main(int argc, char **argv);
+BOOL ParseCmdLine(int argc, char **argv, char *outfile, int *nRes,
+                  int *nChains, long *nRecords, REAL *meanLen,
+                  int *maxLen, unsigned long *seed);
+void Usage(void);
+void SeedRandom(unsigned long seed);
+REAL RandUniform(void);
+REAL RandNormal(REAL mean, REAL sd);
+void PlaceAtom(REAL *a, REAL *b, REAL *c, REAL bond, REAL angle,
+               REAL torsion, REAL *d);
+void BuildChain(SYNRES *res, int nRes, char chain);
+BOOL WriteSyntheticPDB(FILE *out, int nRes, int nChains);
+void WriteSyntheticDB(FILE *out, long nRecords, REAL meanLen,
+                      int maxLen, unsigned long seed);
+
+
+/************************************************************************/
+/*>int main(int argc, char **argv)
+   -------------------------------
+*//**
+   Main program
+
+-  18.10.26 Original   By: ACRM
+*/
+int main(int argc, char **argv)
+{
+   char          outfile[MAXBUFF];
+   int           nRes     = 0,
+                 nChains  = 1,
+                 maxLen   = DEF_MAXLEN;
+   long          nRecords = 0;
+   REAL          meanLen  = DEF_MEANLEN;
+   unsigned long seed     = DEF_SEED;
+   FILE          *out     = stdout;
+
+   if(!ParseCmdLine(argc, argv, outfile, &nRes, &nChains, &nRecords,
+                    &meanLen, &maxLen, &seed))
+   {
+      Usage();
+      return(0);
+   }
+
+   if(outfile[0] && ((out = fopen(outfile, "w"))==NULL))
+   {
+      fprintf(stderr,"Error (benchgen): Unable to write %s\n", outfile);
+      return(1);
+   }
+
+   SeedRandom(seed);
+   if(nRes)
+   {
+      if(!WriteSyntheticPDB(out, nRes, nChains))
+      {
+         fprintf(stderr,"Error (benchgen): No memory for %d residues\n",
+                 nRes);
+         return(1);
+      }
+   }
+   else
+   {
+      WriteSyntheticDB(out, nRecords, meanLen, maxLen, seed);
+   }
+
+   if(out != stdout)
+   {
+      if(fclose(out))
+      {
+         fprintf(stderr,"Error (benchgen): Failed writing %s\n",
+                 outfile);
+         return(1);
+      }
+   }
+   return(0);
+}
+
+
+/************************************************************************/
+/*>BOOL ParseCmdLine(int argc, char **argv, char *outfile, int *nRes,
+                     int *nChains, long *nRecords, REAL *meanLen,
+                     int *maxLen, unsigned long *seed)
+   -------------------------------------------------------------------
+*//**
+   \param[in]   argc       Argument count
+   \param[in]   **argv     Argument array
+   \param[out]  *outfile   Output file (or blank for stdout)
+   \param[out]  *nRes      Residues in each chain for -p (or 0)
+   \param[out]  *nChains   Number of chains for -p
+   \param[out]  *nRecords  Records for -d (or 0)
+   \param[out]  *meanLen   Mean loop length for -d
+   \param[out]  *maxLen    Maximum loop length for -d
+   \param[out]  *seed      Random number seed
+   \return                 Success
+
+   Parse the command line. Exactly one of -p and -d must be given.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL ParseCmdLine(int argc, char **argv, char *outfile, int *nRes,
+                  int *nChains, long *nRecords, REAL *meanLen,
+                  int *maxLen, unsigned long *seed)
+{
+   argc--;
+   argv++;
+
+   outfile[0] = '\0';
+
+   while(argc)
+   {
+      if(argv[0][0] == '-')
+      {
+         switch(argv[0][1])
+         {
+         case 'p':
+            argv++;
+            argc--;
+            if(!argc || !sscanf(argv[0], "%d", nRes) || (*nRes < 1))
+               return(FALSE);
+            break;
+         case 'c':
+            argv++;
+            argc--;
+            if(!argc || !sscanf(argv[0], "%d", nChains) ||
+               (*nChains < 1) || (*nChains > MAXCHAINS))
+               return(FALSE);
+            break;
+         case 'd':
+            argv++;
+            argc--;
+            if(!argc || !sscanf(argv[0], "%ld", nRecords) ||
+               (*nRecords < 1))
+               return(FALSE);
+            break;
+         case 'l':
+            argv++;
+            argc--;
+            if(!argc || !sscanf(argv[0], "%lf", meanLen) ||
+               (*meanLen <= 0.0))
+               return(FALSE);
+            break;
+         case 'x':
+            argv++;
+            argc--;
+            if(!argc || !sscanf(argv[0], "%d", maxLen) || (*maxLen < 1))
+               return(FALSE);
+            break;
+         case 'S':
+            argv++;
+            argc--;
+            if(!argc || !sscanf(argv[0], "%lu", seed))
+               return(FALSE);
+            break;
+         default:
+            return(FALSE);
+            break;
+         }
+      }
+      else
+      {
+         /* Check that there is only 1 argument left                    */
+         if(argc > 1)
+            return(FALSE);
+         strncpy(outfile, argv[0], MAXBUFF-1);
+         outfile[MAXBUFF-1] = '\0';
+      }
+      argc--;
+      argv++;
+   }
+
+   /* Need exactly one of -p and -d                                     */
+   if((*nRes == 0) == (*nRecords == 0))
+      return(FALSE);
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void Usage(void)
+   ----------------
+*//**
+   Prints a usage message
+
+-  18.10.26 Original   By: ACRM
+*/
+void Usage(void)
+{
+   fprintf(stderr,"\nbenchgen V1.0 (c) 2015-26 UCL, Dr. Andrew C.R. \
+Martin.\n");
+
+   fprintf(stderr,"\nUsage: benchgen [-S seed] -p nres [-c nchains] \
+[out.pdb]\n");
+   fprintf(stderr,"--or-- benchgen [-S seed] -d nrecords [-l meanlen]\
+[-x maxlen] [out.db]\n");
+   fprintf(stderr,"       -S - Seed for the random numbers [%d]\n",
+           DEF_SEED);
+   fprintf(stderr,"       -p - Write a PDB file with chains of this \
+many residues\n");
+   fprintf(stderr,"       -c - Number of chains [1]\n");
+   fprintf(stderr,"       -d - Write a loop database with this many \
+records\n");
+   fprintf(stderr,"       -l - Mean loop length in the database \
+[%.1f]\n", DEF_MEANLEN);
+   fprintf(stderr,"       -x - Maximum loop length in the database \
+[%d]\n", DEF_MAXLEN);
+
+   fprintf(stderr,"\nGenerates synthetic input for benchmarking \
+buildloopdb and scanloopdb.\n");
+   fprintf(stderr,"Structures have ideal backbone geometry with \
+helix, strand and coil\n");
+   fprintf(stderr,"segments and loops that pass the default distance \
+table. Database records\n");
+   fprintf(stderr,"have loop lengths from an exponential distribution \
+and distances\n");
+   fprintf(stderr,"drawn from those in distances.h. The same seed \
+always gives the same\n");
+   fprintf(stderr,"output.\n\n");
+}
+
+
+/************************************************************************/
+/*>void SeedRandom(unsigned long seed)
+   -----------------------------------
+*//**
+   \param[in]   seed    Seed for RandUniform()
+
+-  18.10.26 Original   By: ACRM
+*/
+void SeedRandom(unsigned long seed)
+{
+   sRandState = (seed & 0xFFFFFFFFUL) ? (seed & 0xFFFFFFFFUL) : DEF_SEED;
+}
+
+
+/************************************************************************/
+/*>REAL RandUniform(void)
+   ----------------------
+*//**
+   \return    Random number in [0,1)
+
+   32-bit xorshift generator. Used rather than rand() so that the
+   output is the same with every C library.
+
+-  18.10.26 Original   By: ACRM
+*/
+REAL RandUniform(void)
+{
+   sRandState ^= (sRandState << 13) & 0xFFFFFFFFUL;
+   sRandState ^= (sRandState >> 17);
+   sRandState ^= (sRandState << 5)  & 0xFFFFFFFFUL;
+   return((REAL)sRandState / 4294967296.0);
+}
+
+
+/************************************************************************/
+/*>REAL RandNormal(REAL mean, REAL sd)
+   -----------------------------------
+*//**
+   \param[in]   mean    Mean
+   \param[in]   sd      Standard deviation
+   \return              Normally distributed random number
+
+   Box-Muller transform
+
+-  18.10.26 Original   By: ACRM
+*/
+REAL RandNormal(REAL mean, REAL sd)
+{
+   REAL u1, u2;
+
+   do
+   {
+      u1 = RandUniform();
+   }  while(u1 <= 0.0);
+   u2 = RandUniform();
+
+   return(mean + sd * sqrt(-2.0 * log(u1)) * cos(2.0 * PI * u2));
+}
+
+
+/************************************************************************/
+/*>void PlaceAtom(REAL *a, REAL *b, REAL *c, REAL bond, REAL angle,
+                  REAL torsion, REAL *d)
+   ----------------------------------------------------------------
+*//**
+   \param[in]   *a        First reference atom
+   \param[in]   *b        Second reference atom
+   \param[in]   *c        Atom to which d is bonded
+   \param[in]   bond      c-d bond length
+   \param[in]   angle     b-c-d angle (degrees)
+   \param[in]   torsion   a-b-c-d torsion (degrees)
+   \param[out]  *d        The new atom
+
+   Places an atom from internal coordinates (the NeRF method)
+
+-  18.10.26 Original   By: ACRM
+*/
+void PlaceAtom(REAL *a, REAL *b, REAL *c, REAL bond, REAL angle,
+               REAL torsion, REAL *d)
+{
+   REAL bc[3], ab[3], n[3], m[3], d2[3], len;
+   int  i;
+
+   for(i=0; i<3; i++)
+   {
+      bc[i] = c[i] - b[i];
+      ab[i] = b[i] - a[i];
+   }
+   len = sqrt(bc[0]*bc[0] + bc[1]*bc[1] + bc[2]*bc[2]);
+   for(i=0; i<3; i++)
+      bc[i] /= len;
+
+   /* Normal to the a,b,c plane                                         */
+   n[0] = ab[1]*bc[2] - ab[2]*bc[1];
+   n[1] = ab[2]*bc[0] - ab[0]*bc[2];
+   n[2] = ab[0]*bc[1] - ab[1]*bc[0];
+   len  = sqrt(n[0]*n[0] + n[1]*n[1] + n[2]*n[2]);
+   for(i=0; i<3; i++)
+      n[i] /= len;
+
+   m[0] = n[1]*bc[2] - n[2]*bc[1];
+   m[1] = n[2]*bc[0] - n[0]*bc[2];
+   m[2] = n[0]*bc[1] - n[1]*bc[0];
+
+   d2[0] = -bond * cos(DEG2RAD(angle));
+   d2[1] =  bond * sin(DEG2RAD(angle)) * cos(DEG2RAD(torsion));
+   d2[2] =  bond * sin(DEG2RAD(angle)) * sin(DEG2RAD(torsion));
+
+   for(i=0; i<3; i++)
+      d[i] = c[i] + d2[0]*bc[i] + d2[1]*m[i] + d2[2]*n[i];
+}
+
+
+/************************************************************************/
+/*>void BuildChain(SYNRES *res, int nRes, char chain)
+   --------------------------------------------------
+*//**
+   \param[out]  *res     Residues to fill in
+   \param[in]   nRes     Number of residues
+   \param[in]   chain    Chain label
+
+   Builds a chain from ideal geometry. Segments of helix (8-20
+   residues), strand (4-10) and coil (3-12) are chosen at random and
+   phi/psi are scattered about the values for each. Some segments are
+   loops with their stems, built from the backbone angles of a loop
+   from test/pdb1yqv.ent that passes the default distance table (with
+   a little scatter on phi/psi).
+
+-  18.10.26 Original   By: ACRM
+*/
+void BuildChain(SYNRES *res, int nRes, char chain)
+{
+   static char *aa[] = {"ALA","ARG","ASN","ASP","CYS","GLN","GLU",
+                        "GLY","HIS","ILE","LEU","LYS","MET","PHE",
+                        "PRO","SER","THR","TRP","TYR","VAL"};
+   static REAL coilPhi[] = {-65.0, -90.0, 60.0, -120.0},
+               coilPsi[] = {145.0,   0.0, 45.0,  150.0};
+   /* Stems and loops found by buildloopdb -p in test/pdb1yqv.ent with
+      the default distance table (those furthest inside its ranges)
+   */
+   static LOOPTEMPLATE loops[NTEMPLATE] =
+   {
+      {13, /* H92-H105                                                */
+       {  172.0, -176.6,  177.0,  178.7, -179.3, -177.7,  178.4,  178.9,
+         -178.4,  179.8,  178.9,  177.7, -178.2},
+       {  116.8,  117.5,  115.2,  115.9,  117.3,  116.8,  117.1,  117.2,
+          116.6,  116.6,  115.3,  116.2,  117.3},
+       {  119.5,  120.3,  122.9,  121.5,  120.3,  120.9,  120.6,  121.1,
+          120.6,  120.1,  123.3,  120.9,  121.3},
+       {   98.2,  113.2,  106.7,  108.9,  111.8,  114.9,  111.4,  111.0,
+          115.1,  113.1,  109.5,  107.6,  114.2},
+       { -110.8, -163.9, -111.9, -154.5, -156.8,  -74.1,  -94.2, -159.0,
+         -150.0,  -71.7, -110.2,  -70.9,  -73.3},
+       {  155.9,  166.8,  154.0,   88.2, -178.9,  -12.0,  -42.8,  162.0,
+           32.6,  153.7,  151.8,  171.2,  -10.2}},
+      {12, /* L88-L100                                                */
+       {  175.7, -179.4,  175.3, -175.4, -179.6, -179.1,  179.0, -179.5,
+          177.3, -179.4,  176.6, -179.4},
+       {  117.4,  116.8,  116.6,  114.7,  116.8,  116.2,  116.2,  116.6,
+          115.6,  115.4,  116.5,  117.0},
+       {  119.0,  120.9,  120.7,  123.0,  120.6,  122.0,  122.6,  123.3,
+          121.7,  124.0,  119.9,  121.1},
+       {  104.7,  110.9,  100.0,  113.0,  114.5,  113.1,  105.9,  115.7,
+          108.7,  109.7,  107.4,  114.8},
+       {  -95.4, -155.5, -101.9, -104.9,  -91.8,  -58.4, -131.7,  -47.0,
+         -136.6, -114.2,  -77.3,  -75.9},
+       {  164.2,  136.9,  128.9,   52.4, -145.5,  -41.1,   82.1,  137.5,
+          153.3,  150.0,  174.7,   -5.2}},
+      {15, /* H48-H61                                                 */
+       { -178.3, -178.3, -177.6,  179.1,  177.9, -179.1,  179.4,  179.4,
+         -179.5, -179.3, -180.0,  176.8, -179.6,  176.5, -179.3},
+       {  116.8,  115.9,  116.6,  116.0,  116.2,  117.4,  116.2,  117.9,
+          115.1,  116.9,  116.0,  115.9,  116.6,  116.2,  117.4},
+       {  122.1,  120.3,  120.5,  120.5,  122.3,  122.7,  119.2,  120.7,
+          121.2,  121.4,  122.1,  122.7,  121.6,  120.8,  120.0},
+       {  114.5,  108.8,  112.2,  109.4,  102.8,  116.7,  114.1,  107.8,
+          112.2,  112.0,  110.1,  103.8,  111.6,  102.1,  112.7},
+       {  -94.4,  165.8, -158.1, -139.3, -111.0,  -52.8,   94.5,  -87.9,
+           85.7,  -70.6, -145.8, -132.8, -122.4,  -72.5,  -56.5},
+       {  -50.3, -166.6,  163.9,  146.3,   99.3,  138.3,  -40.7,  -26.8,
+           -0.2,  146.0,  153.1,  134.9,  146.7,  145.6,  -32.6}}
+   };
+   REAL phi, psi,
+        omega, angCACN, angCNCA, angNCAC,
+        prevPsi = 150.0,
+        a[3], b[3], c[3];
+   int  i, j,
+        ss       = SS_COIL,
+        segLeft  = 0,
+        coilType = 0,
+        loopType = 0,
+        loopPos  = 0;
+   REAL r;
+
+   for(i=0; i<nRes; i++)
+   {
+      /* Choose the next segment                                        */
+      if(segLeft == 0)
+      {
+         r = RandUniform();
+         if(r < LOOP_FRACTION)
+         {
+            ss       = SS_LOOP;
+            loopType = (int)(RandUniform() * NTEMPLATE);
+            loopPos  = 0;
+            segLeft  = loops[loopType].nRes;
+         }
+         else if(r < 0.4)
+         {
+            ss      = SS_HELIX;
+            segLeft = 8 + (int)(RandUniform() * 13);
+         }
+         else if(r < 0.65)
+         {
+            ss      = SS_STRAND;
+            segLeft = 4 + (int)(RandUniform() * 7);
+         }
+         else
+         {
+            ss      = SS_COIL;
+            segLeft = 3 + (int)(RandUniform() * 10);
+         }
+      }
+      segLeft--;
+
+      omega   = OMEGA;
+      angCACN = ANGLE_CACN;
+      angCNCA = ANGLE_CNCA;
+      angNCAC = ANGLE_NCAC;
+      switch(ss)
+      {
+      case SS_HELIX:
+         phi = RandNormal(-57.0, 7.0);
+         psi = RandNormal(-47.0, 7.0);
+         break;
+      case SS_STRAND:
+         phi = RandNormal(-120.0, 10.0);
+         psi = RandNormal(130.0, 10.0);
+         break;
+      case SS_LOOP:
+         omega   = loops[loopType].omega[loopPos];
+         angCACN = loops[loopType].cacn[loopPos];
+         angCNCA = loops[loopType].cnca[loopPos];
+         angNCAC = loops[loopType].ncac[loopPos];
+         phi     = RandNormal(loops[loopType].phi[loopPos], LOOP_SD);
+         psi     = RandNormal(loops[loopType].psi[loopPos], LOOP_SD);
+         loopPos++;
+         break;
+      default:
+         coilType = (int)(RandUniform() * 4);
+         phi = RandNormal(coilPhi[coilType], 20.0);
+         psi = RandNormal(coilPsi[coilType], 20.0);
+         break;
+      }
+
+      res[i].chain = chain;
+      strcpy(res[i].resnam, aa[(int)(RandUniform() * 20)]);
+
+      if(i == 0)
+      {
+         /* Start in a fixed frame                                      */
+         a[0] = 0.0;  a[1] = 1.0;  a[2] = 0.0;
+         b[0] = 0.0;  b[1] = 0.0;  b[2] = 0.0;
+         c[0] = 1.0;  c[1] = 0.0;  c[2] = 0.0;
+         for(j=0; j<3; j++)
+         {
+            res[i].n[j]  = 0.0;
+            res[i].ca[j] = 0.0;
+         }
+         res[i].ca[0] = BOND_NCA;
+         PlaceAtom(a, b, res[i].ca, BOND_CAC, ANGLE_NCAC, 180.0,
+                   res[i].c);
+      }
+      else
+      {
+         PlaceAtom(res[i-1].n, res[i-1].ca, res[i-1].c, BOND_CN,
+                   angCACN, prevPsi, res[i].n);
+         PlaceAtom(res[i-1].ca, res[i-1].c, res[i].n, BOND_NCA,
+                   angCNCA, omega, res[i].ca);
+         PlaceAtom(res[i-1].c, res[i].n, res[i].ca, BOND_CAC,
+                   angNCAC, phi, res[i].c);
+      }
+
+      /* O is in the peptide plane opposite the next N                  */
+      PlaceAtom(res[i].n, res[i].ca, res[i].c, BOND_CO, ANGLE_CACO,
+                psi + 180.0, res[i].o);
+
+      /* Ideal CB from N, CA and C                                      */
+      for(j=0; j<3; j++)
+      {
+         b[j] = res[i].ca[j] - res[i].n[j];
+         c[j] = res[i].c[j]  - res[i].ca[j];
+      }
+      a[0] = b[1]*c[2] - b[2]*c[1];
+      a[1] = b[2]*c[0] - b[0]*c[2];
+      a[2] = b[0]*c[1] - b[1]*c[0];
+      for(j=0; j<3; j++)
+         res[i].cb[j] = -0.58273431*a[j] + 0.56802827*b[j]
+                        - 0.54067466*c[j] + res[i].ca[j];
+
+      prevPsi = psi;
+   }
+}
+
+
+/************************************************************************/
+/*>BOOL WriteSyntheticPDB(FILE *out, int nRes, int nChains)
+   --------------------------------------------------------
+*//**
+   \param[in]   *out      Output file
+   \param[in]   nRes      Residues in each chain
+   \param[in]   nChains   Number of chains
+   \return                Success (FALSE if out of memory)
+
+   Builds the chains, moves them so that all coordinates are positive
+   (the PDB format only has room for 3 digits before the point for
+   negative values) and writes them.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL WriteSyntheticPDB(FILE *out, int nRes, int nChains)
+{
+   static char *atnam[] = {" N  ", " CA ", " C  ", " O  ", " CB "};
+   SYNRES *res;
+   REAL   min[3],
+          *xyz[5];
+   long   nTotal = (long)nRes * nChains,
+          i,
+          atnum  = 0;
+   int    chain,
+          j, k,
+          resnum;
+   char   insert;
+
+   if((res = (SYNRES *)malloc(nTotal * sizeof(SYNRES)))==NULL)
+      return(FALSE);
+
+   for(chain=0; chain<nChains; chain++)
+      BuildChain(res + (long)chain*nRes, nRes, (char)('A' + chain));
+
+   /* Each chain starts at the origin, so spread them out along z       */
+   for(i=0; i<nTotal; i++)
+   {
+      REAL dz = 20.0 * (REAL)(i / nRes);
+      res[i].n[2]  += dz;
+      res[i].ca[2] += dz;
+      res[i].c[2]  += dz;
+      res[i].o[2]  += dz;
+      res[i].cb[2] += dz;
+   }
+
+   for(j=0; j<3; j++)
+      min[j] = res[0].n[j];
+   for(i=0; i<nTotal; i++)
+   {
+      xyz[0] = res[i].n;  xyz[1] = res[i].ca; xyz[2] = res[i].c;
+      xyz[3] = res[i].o;  xyz[4] = res[i].cb;
+      for(k=0; k<5; k++)
+         for(j=0; j<3; j++)
+            if(xyz[k][j] < min[j])
+               min[j] = xyz[k][j];
+   }
+
+   fprintf(out, "HEADER    SYNTHETIC STRUCTURE FOR BENCHMARKING\n");
+   for(i=0; i<nTotal; i++)
+   {
+      int r = (int)(i % nRes);
+
+      resnum = (r % MAXRESNUM) + 1;
+      insert = (char)((r < MAXRESNUM) ? ' ' : ('A' + r/MAXRESNUM - 1));
+
+      xyz[0] = res[i].n;  xyz[1] = res[i].ca; xyz[2] = res[i].c;
+      xyz[3] = res[i].o;  xyz[4] = res[i].cb;
+      for(k=0; k<5; k++)
+      {
+         if((k == 4) && !strcmp(res[i].resnam, "GLY"))
+            break;
+         atnum = (atnum % 99999) + 1;
+         fprintf(out, "ATOM  %5ld %s %s %c%4d%c   %8.3f%8.3f%8.3f\
+  1.00 20.00           %c\n", atnum, atnam[k], res[i].resnam,
+                 res[i].chain, resnum, insert,
+                 xyz[k][0] - min[0] + 1.0, xyz[k][1] - min[1] + 1.0,
+                 xyz[k][2] - min[2] + 1.0, atnam[k][1]);
+      }
+      if(r == nRes-1)
+         fprintf(out, "TER\n");
+   }
+   fprintf(out, "END\n");
+
+   free(res);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void WriteSyntheticDB(FILE *out, long nRecords, REAL meanLen,
+                         int maxLen, unsigned long seed)
+   --------------------------------------------------------------
+*//**
+   \param[in]   *out       Output file
+   \param[in]   nRecords   Number of records
+   \param[in]   meanLen    Mean loop length
+   \param[in]   maxLen     Longest loop
+   \param[in]   seed       Seed (recorded in the header)
+
+   Writes a database of records with the default stem size. Runs of
+   records (on average DEF_PERENTRY) share a PDB code and the loops
+   run along a chain as in a real build. Each distance is drawn from
+   the distribution in distances.h and redrawn if it falls outside the
+   default distance table.
+
+-  18.10.26 Original   By: ACRM
+*/
+void WriteSyntheticDB(FILE *out, long nRecords, REAL meanLen,
+                      int maxLen, unsigned long seed)
+{
+   static char alnum[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+   char  pdbCode[8],
+         chain   = 'A';
+   long  i;
+   int   j, k,
+         len,
+         start   = 0,
+         left    = 0;
+   REAL  d,
+         lo, hi;
+
+   fprintf(out, "#PDBDIR: synthetic\n");
+   fprintf(out, "%s   %d\n", DB_STEMTAG, NSTEM);
+   fprintf(out, "#SHARD:  1/1\n");
+   fprintf(out, "#DATE:   Synthetic database, seed %lu\n\n", seed);
+
+   for(i=0; i<nRecords; i++)
+   {
+      /* Start a new entry                                              */
+      if(left == 0)
+      {
+         pdbCode[0] = (char)('1' + (int)(RandUniform() * 9));
+         for(j=1; j<4; j++)
+            pdbCode[j] = alnum[(int)(RandUniform() * 36)];
+         pdbCode[4] = '\0';
+         left  = 1 + (int)(-log(1.0 - RandUniform()) * DEF_PERENTRY);
+         chain = 'A';
+         start = 1 + (int)(RandUniform() * 20);
+      }
+      left--;
+
+      len = 1 + (int)(-log(1.0 - RandUniform()) * (meanLen - 1.0));
+      if(len > maxLen)
+         len = maxLen;
+
+      fprintf(out, "%s %c%d %c%d %d ", pdbCode, chain, start, chain,
+              start + len + 2*NSTEM - 1, len);
+
+      for(j=0; j<NSTEM; j++)
+      {
+         for(k=0; k<NSTEM; k++)
+         {
+            lo = means[j][k] - sdMult * sds[j][k];
+            hi = means[j][k] + sdMult * sds[j][k];
+            do
+            {
+               d = RandNormal(means[j][k], sds[j][k]);
+            }  while((d < lo) || (d > hi));
+            fprintf(out, "%.3f ", d);
+         }
+      }
+      fprintf(out, "\n");
+
+      /* Move along the chain, occasionally starting a new one          */
+      start += 1 + (int)(RandUniform() * 15);
+      if((start > 500) && (chain < 'Z'))
+      {
+         chain++;
+         start = 1 + (int)(RandUniform() * 20);
+      }
+   }
+}
@@ -0,0 +1,143 @@
+/************************************************************************/
+/**
+
+   \file       buildkernel.h
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Stem distance kernel for buildloopdb (one per stem size)
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+   Description:
+   ============
+   This is a template rather than an ordinary header. loopbuild.c
+   includes it once for each supported stem size with STEM_K defined
+   to that size, giving a CheckStems2(), CheckStems3(), ... each with
+   the loop bounds fixed at compile time so that the compiler can
+   unroll them. The common 3-residue case is thus as fast as the
+   original hard-wired code.
+
+   The including file must define DBOUTPUT.
+
+**************************************************************************
+
+   Usage:
+   ======
+   #define STEM_K 3
+   #include "buildkernel.h"
+   #undef STEM_K
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+#ifndef STEM_K
+#error "Define STEM_K before including buildkernel.h"
+#endif
+
+#ifndef STEM_KERNEL
+#define STEM_PASTE2(a, b) a##b
+#define STEM_PASTE(a, b)  STEM_PASTE2(a, b)
+#define STEM_KERNEL(name) STEM_PASTE(name, STEM_K)
+#endif
+
+/************************************************************************/
+/*>static int CheckStemsK(PDB **n, PDB **c, DBOUTPUT *dbOut, 
+                          int nWanted, REAL distMat[MAXSTEM][MAXSTEM])
+   --------------------------------------------------------------------
+*//**
+   \param[in]     **n        The STEM_K N-terminal stem residues
+   \param[in]     **c        The STEM_K C-terminal stem residues
+   \param[in,out] *dbOut     Outputs; those with wanted set are checked
+                             and it is cleared for those that reject
+                             the loop
+   \param[in]     nWanted    Number of outputs with wanted set
+   \param[out]    distMat    The distances (complete only if the return
+                             is non-zero)
+   \return                   Number of outputs that accept the loop
+
+   When the loop is rejected, dbOut->failCell is set to the distance
+   (i*STEM_K+j) that rejected it for the last output.
+
+   Calculates the stem distances in turn, checking each against the
+   tables of the outputs still interested and giving up as soon as none
+   are. With a single output this is just the original early-exit test.
+
+-  18.10.26 Original   By: ACRM
+*/
+static int STEM_KERNEL(CheckStems)(PDB **n, PDB **c, DBOUTPUT *dbOut,
+                                   int nWanted, 
+                                   REAL distMat[MAXSTEM][MAXSTEM])
+{
+   DBOUTPUT *o;
+   int      i, j;
+
+   if(dbOut->next == NULL)
+   {
+      for(i=0; i<STEM_K; i++)
+      {
+         for(j=0; j<STEM_K; j++)
+         {
+            distMat[i][j] = DIST(n[i], c[j]);
+            if((distMat[i][j] < dbOut->minTable[i][j]) ||
+               (distMat[i][j] > dbOut->maxTable[i][j]))
+            {
+               dbOut->wanted   = FALSE;
+               dbOut->failCell = i*STEM_K + j;
+               return(0);
+            }
+         }
+      }
+      return(1);
+   }
+
+   for(i=0; i<STEM_K; i++)
+   {
+      for(j=0; j<STEM_K; j++)
+      {
+         distMat[i][j] = DIST(n[i], c[j]);
+         for(o=dbOut; o!=NULL; NEXT(o))
+         {
+            if(o->wanted &&
+               ((distMat[i][j] < o->minTable[i][j]) ||
+                (distMat[i][j] > o->maxTable[i][j])))
+            {
+               o->wanted = FALSE;
+               if(--nWanted == 0)
+               {
+                  dbOut->failCell = i*STEM_K + j;
+                  return(0);
+               }
+            }
+         }
+      }
+   }
+   return(nWanted);
+}
@@ -3,11 +3,11 @@
 
    \file       buildloopdb.c
    
-   \version    V1.3
-   \date       12.12.17
+   \version    V1.20
+   \date       18.10.26
    \brief      Build a database of CDR-H3 like loops
    
-   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2017
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
    \author     Dr. Andrew C. R. Martin
    \par
                Institute of Structural & Molecular Biology,
@@ -41,7 +41,10 @@
    distances.h which is built automatically from a directory of PDB
    files. A table containing distance ranges may be used to override
    these defaults. Output is a file containing the PDB code, residue range
-   loop length (residues between the takeoff regions) and the 9 distances.
+   loop length (residues between the takeoff regions) and the nStem^2
+   distances between the residues of the two stems, where the stem size
+   nStem is MINSTEM to MAXSTEM residues (-s). The default stems of 3
+   residues give 9 distances.
 
 **************************************************************************
 
@@ -62,28 +65,65 @@
                     minimum length to 1 residue. Also fixed problem
                     with multi-chain PDBs where chains after the first
                     would be analyzed multiple times
+   V1.4   18.10.26  Added -q to write a quantized filter sidecar
+   V1.5   18.10.26  Added -c to write loop backbone coordinates
+   V1.6   18.10.26  Files are processed in sorted order. Added --shard
+                    to build one of several parts to be combined with
+                    mergeloopdb. Distance tables moved to disttable.c
+   V1.7   18.10.26  Added -M to write a manifest of the input files and
+                    -u to update a previous database, only processing
+                    new or changed files
+   V1.8   18.10.26  Added -k and --resume to checkpoint a build and
+                    resume it after an interruption
+   V1.9   18.10.26  Added -P to write a pack of CA traces and -R to
+                    rebuild from one. Chain breaks are found once per
+                    file rather than for every candidate loop
+   V1.10  18.10.26  Added -T to build databases for several loop types
+                    in one pass, sharing the distance calculations
+   V1.11  18.10.26  Added -s to set the number of residues in each stem.
+                    The stem size is written in the header and the
+                    distance check is specialized for each size
+   V1.12  18.10.26  Added --stats to write a report of where the time
+                    goes and why candidates are rejected
+   V1.13  18.10.26  Added --counters to read the hardware performance
+                    counters for each phase
+   V1.14  18.10.26  Added --reference to use the straightforward
+                    reference implementation of the analysis for
+                    differential testing
+   V1.15  18.10.26  Added -j. Large structures are split into tasks run
+                    by several threads
+   V1.16  18.10.26  Added --stream to read and analyse large structures
+                    one chain at a time
+   V1.17  18.10.26  Files that can't contain a loop are skipped by a
+                    quick pre-screen before they are parsed. Added
+                    --noprescreen
+   V1.18  18.10.26  Added --resolution, --rfactor, --xray, --nonmr and
+                    --exptl to filter entries by experimental method,
+                    resolution and R-factor and record these in the
+                    database
+   V1.19  18.10.26  Added --dedup, --dedupall and --deduptol to analyse
+                    repeated copies of a chain once, writing an alias
+                    file
+   V1.20  18.10.26  The build pipeline is now in loopbuild.c (part of
+                    libloopdb) behind a LOOPDBBUILD handle; this file
+                    parses the command line
 
 *************************************************************************/
+/************************************************************************/
 /* Includes
 */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
-#include <dirent.h>
-#include <time.h>
-#include <math.h>
 
 #include "bioplib/pdb.h"
 #include "bioplib/general.h"
 #include "bioplib/macros.h"
+#include "loopdb.h"
 
 /************************************************************************/
 /* Defines and macros
 */
-#define MAXBUFF                160
-#define MAX_CA_CA_DISTANCE_SQ   16.0  /* max CA-CA distance of 4.0A     */
-#define MAX_BOND_DISTANCE_SQ     4.0  /* max bond length of 2.0A        */
 
 /************************************************************************/
 /* Globals
@@ -93,26 +133,8 @@
 /* Prototypes
 */
 int  main(int argc, char **argv);
-BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
-                  int *minLength, int *maxLength, BOOL *isDirectory,
-                  char *distTable, BOOL *verbose, int *limit);
+BOOL ParseCmdLine(int argc, char **argv, LOOPDBBUILDOPTS *opts);
 void Usage(void);
-int  RunAnalysis(FILE *out, PDB *pdb, int minLength, int maxLength, 
-                 char *pdbCode, REAL minTable[3][3], REAL maxTable[3][3]);
-void PrintResults(FILE *out, char *pdbCode, int separation, PDB *p[3], 
-                  PDB *q[3], REAL distMat[3][3]);
-void ProcessFile(FILE *in, FILE *out, int minLength, int maxLength,
-                 char *pdbCode, REAL minTable[3][3], REAL maxTable[3][3],
-                 BOOL verbose);
-void ProcessAllFiles(FILE *out, char *dirName, int minLength, 
-                     int maxLength, REAL minTable[3][3], 
-                     REAL maxTable[3][3], BOOL verbose, int limit);
-void PrintHeader(FILE *out, char *dirName);
-void ReadDistanceTable(char *distTable, REAL minTable[3][3],
-                       REAL maxTable[3][3]);
-void SetUpMinMaxTables(REAL minTable[3][3], REAL maxTable[3][3]);
-BOOL ChainIsIntact(PDB *start, PDB *end);
-BOOL BackboneComplete(PDB *pdb);
 
 
 /************************************************************************/
@@ -121,281 +143,91 @@ BOOL BackboneComplete(PDB *pdb);
 *//**
 -  14.07.15 Original   By: ACRM
 -  12.12.17 Changed default minimum length to 1 residue
+-  18.10.26 Added quantized filter sidecar output
+-  18.10.26 Added loop coordinate output
+-  18.10.26 Added sharding
+-  18.10.26 Added manifest and update from a previous build
+-  18.10.26 Added checkpointing and resuming
+-  18.10.26 Added writing and running from a CA pack
+-  18.10.26 Added extra loop types with -T
+-  18.10.26 Added the stem size
+-  18.10.26 Added --stats
+-  18.10.26 Added --counters
+-  18.10.26 Added --reference
+-  18.10.26 Added -j
+-  18.10.26 Added --stream
+-  18.10.26 Added --dedup
+-  18.10.26 Writes the stem size when building from a single file
+-  18.10.26 The build is run by libloopdb (see loopbuild.c)
 */
 int main(int argc, char **argv)
 {
-   char infile[MAXBUFF],
-        outfile[MAXBUFF],
-        distTable[MAXBUFF];
-   FILE *in         = stdin,
-        *out        = stdout;
-   int  minLength   = 1,
-        maxLength   = 0,
-        retval      = 0,
-        limit       = 0;
-   BOOL isDirectory = FALSE,
-        verbose     = FALSE;
-   REAL minTable[3][3],
-        maxTable[3][3];
-
-   /* Default distance ranges for CDR-H3                                */
-   SetUpMinMaxTables(minTable, maxTable);
-
-   if(!ParseCmdLine(argc, argv, infile, outfile, &minLength, &maxLength,
-                    &isDirectory, distTable, &verbose, &limit))
+   LOOPDBBUILDOPTS opts;
+   LOOPDBBUILD     *build;
+   BOOL            ok;
+
+   if(!ParseCmdLine(argc, argv, &opts))
    {
       Usage();
       return(0);
    }
-   else
-   {
-      if(distTable[0])
-      {
-         ReadDistanceTable(distTable, minTable, maxTable);
-      }
-
-      if(isDirectory)
-      {
-         if(blOpenStdFiles(NULL, outfile, NULL, &out))
-         {
-            PrintHeader(out, infile);
-            ProcessAllFiles(out, infile, minLength, maxLength, 
-                            minTable, maxTable, verbose, limit);
-            FCLOSE(out);
-         }
-      }
-      else
-      {
-         if(blOpenStdFiles(infile, outfile, &in, &out))
-         {
-            char *pdbCode;
-            pdbCode = blFNam2PDB(infile);
-            ProcessFile(in, out, minLength, maxLength, pdbCode, 
-                        minTable, maxTable, verbose);
-            FCLOSE(in);
-            FCLOSE(out);
-         }
-         else
-         {
-            return(1);
-         }
-      }
-      
-   }
-         
-   return(retval);
-}
 
-/************************************************************************/
-/*>void PrintHeader(FILE *out, char *dirName)
-   ------------------------------------------
-   \param[in]   *out      Output file pointer
-   \param[in]   *dirName  Name of directory being processed
+   if((build = LoopDBBuildOpen(&opts))==NULL)
+      exit(1);
+   ok = LoopDBBuildRun(build);
+   if(!LoopDBBuildClose(build) || !ok)
+      exit(1);
 
-   Prints a short header for the database file
-*//**
--  14.07.15 Original   By: ACRM
-*/
-void PrintHeader(FILE *out, char *dirName)
-{
-   time_t tm;
-   
-   time(&tm);
-   fprintf(out,"#PDBDIR: %s\n",dirName);
-   fprintf(out,"#DATE:   %s\n",ctime(&tm));
+   return(0);
 }
 
-   
-/************************************************************************/
-/*>void ProcessAllFiles(FILE *out, char *dirName, int minLength, 
-                        int maxLength, REAL minTable[3][3], 
-                        REAL maxTable[3][3], int limit)
-   --------------------------------------------------------------
-*//**
-   \param[in]   *out       Output file pointer
-   \param[in]   *dirName   Directory being processed
-   \param[in]   minLength  Minimum loop length (0 = no limit)
-   \param[in]   maxLength  Maximum loop length (0 = no limit)
-   \param[in]   minTable   table of minimum distances
-   \param[in]   maxTable   table of maximum distances
-   \param[in]   limit      Max number of PDB files to process
-
-   Steps through all files in the specified directory and processes them
-   via calls to ProcessFile()
-
--  14.07.15 Original   By: ACRM
--  03.11.15 Now reads the file list first and then works through.
-            It seemed to be failing, maybe because the directory was
-            changing?
--  04.11.15 Added limit
-*/
-void ProcessAllFiles(FILE *out, char *dirName, int minLength, 
-                     int maxLength, REAL minTable[3][3], 
-                     REAL maxTable[3][3], BOOL verbose, int limit)
-{
-   DIR           *dp;
-   struct dirent *dent;
-   char          filename[MAXBUFF],
-                 *fname;
-   FILE          *in;
-   STRINGLIST    *fileList = NULL,
-                 *string;
-   int           count     = 0;
-   
-   
-   /* Get the list of PDB files                                         */
-   if((dp=opendir(dirName))!=NULL)
-   {
-      while((dent=readdir(dp))!=NULL)
-      {
-         if(dent->d_name[0] != '.')
-         {
-            if(limit && (++count > limit))
-               break;
-
-            sprintf(filename,"%s/%s",dirName,dent->d_name);
-            if((fileList = blStoreString(fileList, filename))==NULL)
-            {
-               fprintf(stderr,"Error (buildloopdb): No memory for file \
-list.\n");
-               exit(1);
-            }
-            
-            if(verbose)
-            {
-               fprintf(stderr,"Listing: %s\n", filename);
-            }
-         }
-      }
-      closedir(dp);
-   }
-   
-   /* now work through the file list processing each in turn            */
-   for(string=fileList; string!=NULL; NEXT(string))
-   {
-      fname = string->string;
-      
-      if((in=fopen(fname, "r"))!=NULL)
-      {
-         char *pdbCode;
-         pdbCode = blFNam2PDB(fname);
-         fprintf(stderr,"Processing: %s\n", fname);
-         ProcessFile(in, out, minLength, maxLength, pdbCode, 
-                     minTable, maxTable, verbose);
-         fclose(in);
-      }
-      else if(verbose)
-      {
-         fprintf(stderr,"Could not open file: %s\n", fname);
-      }
-      
-   }
-
-   blFreeStringList(fileList);
-}
 
 /************************************************************************/
-/*>void ProcessFile(FILE *in, FILE *out, int minLength, int maxLength, 
-                    char *pdbCode, REAL minTable[3][3], 
-                    REAL maxTable[3][3], BOOL verbose)
-   --------------------------------------------------------------------
+/*>BOOL ParseCmdLine(int argc, char **argv, LOOPDBBUILDOPTS *opts)
+   ---------------------------------------------------------------
 *//**
-   \param[in]   *in        Input file pointer (for PDB file)
-   \param[in]   *out       Output file pointer
-   \param[in]   minLength  Minimum loop length
-   \param[in]   maxLength  Maximum loop length
-   \param[in]   pdbCode    PDB code for this file
-   \param[in]   minTable   table of minimum distances
-   \param[in]   maxTable   table of maximum distances
-   \param[in]   verbose    Verbose mode
+   \param[in]   argc      Argument count
+   \param[in]   **argv    Argument array
+   \param[out]  *opts     Build options
+   \return                Success
 
-   Obtains the PDB data and calls RunAnalysis() to do the real work
-
--  14.07.15 Original   By: ACRM
--  03.11.15 RunAnalysis() now returns number of loops found
--  10.12.15 Added check that PDB backbone has no missing atoms
-*/
-void ProcessFile(FILE *in, FILE *out, int minLength, int maxLength, 
-                 char *pdbCode, REAL minTable[3][3], REAL maxTable[3][3],
-                 BOOL verbose)
-{
-   PDB *pdb;
-   int natoms;
-
-   if((pdb = blReadPDBAtoms(in, &natoms))!=NULL)
-   {
-      if(BackboneComplete(pdb))
-      {
-         /* Extract the CAs                                             */
-         if((pdb = blSelectCaPDB(pdb))!=NULL)
-         {
-            int nLoops;
-            
-            /* Run the analysis                                         */
-            nLoops = RunAnalysis(out, pdb, minLength, maxLength, pdbCode, 
-                                 minTable, maxTable);
-            if(verbose)
-               fprintf(stderr,"%d loops found\n", nLoops);
-            
-            FREELIST(pdb, PDB);
-         }
-         else if(verbose)
-         {
-            fprintf(stderr,"No CA atoms extracted\n");
-         }
-      }
-      else
-      {
-         FREELIST(pdb, PDB);
-      }
-   }
-   else if(verbose)
-   {
-      fprintf(stderr,"No atoms read from PDB file\n");
-   }
-}
-
-
-
-/************************************************************************/
-/*>BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
-                     int *minLength, int *maxLength, BOOL *isDirectory,
-                     char *distTable, BOOL *verbose, int *limit)
-   ---------------------------------------------------------------------
-*//**
-   \param[in]   argc              Argument count
-   \param[in]   **argv            Argument array
-   \param[out]  *infile           Input filename (or blank string)  
-   \param[out]  *outfile          Output filename (or blank string) 
-   \param[out]  *minLength        miniumum loop length to display   
-   \param[out]  *maxLength        maxiumum loop length to display   
-   \param[out]  *isDirectory      Input 'filename' is a directory   
-   \param[out]  *distTable        Distance table filename           
-   \param[out]  *verbose          Verbose mode                      
-   \param[out]  *limit            Max number of PDBs to process (0=all)
-   \return                        Success
-
-   Parse the command line
+   Parse the command line into the build options, starting from the
+   defaults given by LoopDBBuildDefaults(). The first argument is the
+   PDB directory (or the PDB file with -p) and the second, if given, is
+   the database to write. With -R, the only argument is the database
+   and the PDB directory is the one the CA pack was built from.
 
 -  14.07.15 Original    By: ACRM
 -  04.11.15 Added -v and -l
 -  12.12.17 Changed default minimum length to 1
+-  18.10.26 Added -q
+-  18.10.26 Added -c
+-  18.10.26 Added --shard
+-  18.10.26 Added -M and -u
+-  18.10.26 Added -k, -K and --resume
+-  18.10.26 Added -P and -R
+-  18.10.26 Added -T
+-  18.10.26 Added -s
+-  18.10.26 Added --stats
+-  18.10.26 Added --counters
+-  18.10.26 Added --reference
+-  18.10.26 Added -j
+-  18.10.26 Added --stream
+-  18.10.26 Added --noprescreen
+-  18.10.26 Added --exptl, --xray, --nonmr, --resolution and --rfactor
+-  18.10.26 Added --dedup, --dedupall and --deduptol
+-  18.10.26 Fills in a LOOPDBBUILDOPTS rather than separate outputs
+            for each option. Handles the argument of -R
 */
-BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
-                  int *minLength, int *maxLength, BOOL *isDirectory,
-                  char *distTable, BOOL *verbose, int *limit)
+BOOL ParseCmdLine(int argc, char **argv, LOOPDBBUILDOPTS *opts)
 {
-   BOOL gotArg = FALSE;
+   LOOPTYPE *lt;
+   BOOL     gotArg = FALSE;
    
    argc--;
    argv++;
    
-   infile[0]    = outfile[0] = '\0';
-   *minLength   = 1;
-   *maxLength   = 0;
-   *isDirectory = TRUE;
-   distTable[0] = '\0';
-   *limit       = 0;
+   LoopDBBuildDefaults(opts);
    
    while(argc)
    {
@@ -406,19 +238,33 @@ BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
          case 'm':
             argv++;
             argc--;
-            if(!argc || !sscanf(argv[0], "%d", minLength))
+            if(!argc || !sscanf(argv[0], "%d", &(opts->minLength)))
                return(FALSE);
             break;
          case 'x':
             argv++;
             argc--;
-            if(!argc || !sscanf(argv[0], "%d", maxLength))
+            if(!argc || !sscanf(argv[0], "%d", &(opts->maxLength)))
                return(FALSE);
             break;
          case 'l':
             argv++;
             argc--;
-            if(!argc || !sscanf(argv[0], "%d", limit))
+            if(!argc || !sscanf(argv[0], "%d", &(opts->limit)))
+               return(FALSE);
+            break;
+         case 's':
+            argv++;
+            argc--;
+            if(!argc || !sscanf(argv[0], "%d", &(opts->nStem)) ||
+               (opts->nStem < MINSTEM) || (opts->nStem > MAXSTEM))
+               return(FALSE);
+            break;
+         case 'j':
+            argv++;
+            argc--;
+            if(!argc || !sscanf(argv[0], "%d", &(opts->nThreads)) || 
+               (opts->nThreads < 0))
                return(FALSE);
             break;
          case 't':
@@ -426,13 +272,188 @@ BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
             argc--;
             if(!argc)
                return(FALSE);
-            strncpy(distTable, argv[0], MAXBUFF);
+            strncpy(opts->distTable, argv[0], LDB_MAXFILE-1);
+            break;
+         case 'q':
+            argv++;
+            argc--;
+            if(!argc)
+               return(FALSE);
+            strncpy(opts->qfFile, argv[0], LDB_MAXFILE-1);
+            break;
+         case 'c':
+            argv++;
+            argc--;
+            if(!argc)
+               return(FALSE);
+            strncpy(opts->coordsFile, argv[0], LDB_MAXFILE-1);
+            break;
+         case 'M':
+            argv++;
+            argc--;
+            if(!argc)
+               return(FALSE);
+            strncpy(opts->mfFile, argv[0], LDB_MAXFILE-1);
+            break;
+         case 'u':
+            argv++;
+            argc--;
+            if(!argc)
+               return(FALSE);
+            strncpy(opts->prevDb, argv[0], LDB_MAXFILE-1);
+            argv++;
+            argc--;
+            if(!argc)
+               return(FALSE);
+            strncpy(opts->prevMf, argv[0], LDB_MAXFILE-1);
+            break;
+         case 'k':
+            argv++;
+            argc--;
+            if(!argc)
+               return(FALSE);
+            strncpy(opts->ckFile, argv[0], LDB_MAXFILE-1);
+            break;
+         case 'K':
+            argv++;
+            argc--;
+            if(!argc || !sscanf(argv[0], "%d", &(opts->ckInterval)))
+               return(FALSE);
+            break;
+         case 'P':
+            argv++;
+            argc--;
+            if(!argc)
+               return(FALSE);
+            strncpy(opts->packFile, argv[0], LDB_MAXFILE-1);
+            break;
+         case 'R':
+            argv++;
+            argc--;
+            if(!argc)
+               return(FALSE);
+            strncpy(opts->packIn, argv[0], LDB_MAXFILE-1);
+            break;
+         case 'T':
+            if((argc < 5) || (opts->nLoopTypes >= MAXLOOPTYPES))
+               return(FALSE);
+            lt = &(opts->loopTypes[opts->nLoopTypes]);
+            strncpy(lt->distTable, argv[1], LDB_MAXFILE-1);
+            lt->distTable[LDB_MAXFILE-1] = '\0';
+            if(!sscanf(argv[2], "%d", &(lt->minLength)) ||
+               !sscanf(argv[3], "%d", &(lt->maxLength)))
+               return(FALSE);
+            strncpy(lt->outfile, argv[4], LDB_MAXFILE-1);
+            lt->outfile[LDB_MAXFILE-1] = '\0';
+            (opts->nLoopTypes)++;
+            argv += 4;
+            argc -= 4;
             break;
          case 'p':
-            *isDirectory = FALSE;
+            opts->isDirectory = FALSE;
             break;
          case 'v':
-            *verbose = TRUE;
+            opts->verbose = TRUE;
+            break;
+         case '-':
+            if(!strcmp(argv[0], "--shard"))
+            {
+               argv++;
+               argc--;
+               if(!argc || 
+                  (sscanf(argv[0], "%d/%d", &(opts->shard),
+                          &(opts->nShards)) != 2) ||
+                  (opts->nShards < 1) || (opts->shard < 1) ||
+                  (opts->shard > opts->nShards))
+                  return(FALSE);
+            }
+            else if(!strcmp(argv[0], "--resume"))
+            {
+               opts->resume = TRUE;
+            }
+            else if(!strcmp(argv[0], "--reference"))
+            {
+               opts->reference = TRUE;
+            }
+            else if(!strcmp(argv[0], "--stream"))
+            {
+               opts->stream = TRUE;
+            }
+            else if(!strcmp(argv[0], "--noprescreen"))
+            {
+               opts->noScreen = TRUE;
+            }
+            else if(!strcmp(argv[0], "--exptl"))
+            {
+               opts->exptl = TRUE;
+            }
+            else if(!strcmp(argv[0], "--xray"))
+            {
+               opts->filter.xray = TRUE;
+            }
+            else if(!strcmp(argv[0], "--nonmr"))
+            {
+               opts->filter.noNMR = TRUE;
+            }
+            else if(!strcmp(argv[0], "--resolution"))
+            {
+               argv++;
+               argc--;
+               if(!argc || 
+                  !sscanf(argv[0], "%lf",
+                          &(opts->filter.maxResolution)) ||
+                  (opts->filter.maxResolution <= 0.0))
+                  return(FALSE);
+            }
+            else if(!strcmp(argv[0], "--rfactor"))
+            {
+               argv++;
+               argc--;
+               if(!argc || 
+                  !sscanf(argv[0], "%lf", &(opts->filter.maxRFactor)) ||
+                  (opts->filter.maxRFactor <= 0.0))
+                  return(FALSE);
+            }
+            else if(!strcmp(argv[0], "--dedup"))
+            {
+               argv++;
+               argc--;
+               if(!argc)
+                  return(FALSE);
+               strncpy(opts->aliasFile, argv[0], LDB_MAXFILE-1);
+            }
+            else if(!strcmp(argv[0], "--dedupall"))
+            {
+               opts->dedupAll = TRUE;
+            }
+            else if(!strcmp(argv[0], "--deduptol"))
+            {
+               argv++;
+               argc--;
+               if(!argc || !sscanf(argv[0], "%lf", &(opts->dedupTol)) ||
+                  (opts->dedupTol < 0.0))
+                  return(FALSE);
+            }
+            else if(!strcmp(argv[0], "--stats"))
+            {
+               argv++;
+               argc--;
+               if(!argc)
+                  return(FALSE);
+               strncpy(opts->statsFile, argv[0], LDB_MAXFILE-1);
+            }
+            else if(!strcmp(argv[0], "--counters"))
+            {
+               argv++;
+               argc--;
+               if(!argc)
+                  return(FALSE);
+               strncpy(opts->countersFile, argv[0], LDB_MAXFILE-1);
+            }
+            else
+            {
+               return(FALSE);
+            }
             break;
          default:
             return(FALSE);
@@ -448,24 +469,35 @@ BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
          gotArg = TRUE;
          
          /* Copy the first to infile                                    */
-         strcpy(infile, argv[0]);
+         strncpy(opts->infile, argv[0], LDB_MAXFILE-1);
          
          /* If there's another, copy it to outfile                      */
          argc--;
          argv++;
          if(argc)
-            strcpy(outfile, argv[0]);
+            strncpy(opts->outfile, argv[0], LDB_MAXFILE-1);
             
-         return(TRUE);
+         break;
       }
 
       argc--;
       argv++;
    }
 
-   /* If it's a directory then we MUST have a directory name            */
-   if(*isDirectory && !gotArg)
+   /* If it's a directory then we MUST have a directory name unless it
+      comes from a CA pack
+   */
+   if(opts->isDirectory && !gotArg && !opts->packIn[0])
       return(FALSE);
+
+   /* With a CA pack, the only argument is the output file             */
+   if(opts->isDirectory && opts->packIn[0])
+   {
+      if(opts->outfile[0])
+         return(FALSE);
+      strcpy(opts->outfile, opts->infile);
+      opts->infile[0] = '\0';
+   }
    
    return(TRUE);
 }
@@ -480,18 +512,58 @@ BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
 -  14.07.15 Original   By: ACRM
 -  10.12.15 V1.2
 -  12.12.17 V1.3
+-  18.10.26 Describes the new options
+-  18.10.26 Describes the distances for any stem size
 */
 void Usage(void)
 {
-   fprintf(stderr,"\nbuildloopdb V1.3 (c) 2015-17 UCL, Dr. Andrew C.R. \
+   fprintf(stderr,"\nbuildloopdb V1.20 (c) 2015-26 UCL, Dr. Andrew C.R. \
 Martin.\n");
 
    fprintf(stderr,"\nUsage: buildloopdb [-v][-m minLength][-x maxLength]\
-[-t disttable]\n");
-   fprintf(stderr,"                   [-l limit] pdbdir [out.db]\n");
+[-s stem][-t disttable]\n");
+   fprintf(stderr,"                   [-l limit][-q sidecar][-c coords]\
+[--shard i/N]\n");
+   fprintf(stderr,"                   [-M manifest][-u old.db \
+old.manifest]\n");
+   fprintf(stderr,"                   [-k checkpoint [-K seconds]\
+[--resume]][-P capack]\n");
+   fprintf(stderr,"                   [-T disttable minLength maxLength \
+type.db ...]\n");
+   fprintf(stderr,"                   [--stats report][--counters file]\
+[--reference]\n");
+   fprintf(stderr,"                   [-j nthreads][--stream]\
+[--noprescreen][--exptl]\n");
+   fprintf(stderr,"                   [--xray][--nonmr][--resolution \
+max][--rfactor max]\n");
+   fprintf(stderr,"                   [--dedup aliases [--dedupall]\
+[--deduptol tol]]\n");
+   fprintf(stderr,"                   pdbdir [out.db]\n");
+   fprintf(stderr,"--or--\n");
+   fprintf(stderr,"       buildloopdb -R capack [-v][-m minLength]\
+[-x maxLength][-s stem]\n");
+   fprintf(stderr,"                   [-t disttable]\n");
+   fprintf(stderr,"                   [-l limit][-q sidecar][-c coords]\
+[--shard i/N]\n");
+   fprintf(stderr,"                   [-M manifest][-k checkpoint \
+[-K seconds][--resume]]\n");
+   fprintf(stderr,"                   [-T disttable minLength maxLength \
+type.db ...]\n");
+   fprintf(stderr,"                   [--stats report][--counters file]\
+[-j nthreads] [out.db]\n");
    fprintf(stderr,"--or--\n");
    fprintf(stderr,"       buildloopdb -p [-v][-m minLength][-x maxLength]\
-[-t disttable]\n");
+[-s stem][-t disttable]\n");
+   fprintf(stderr,"                   [-q sidecar][-c coords]\
+[-T disttable minLength maxLength\n");
+   fprintf(stderr,"                   type.db ...][--stats report]\
+[--counters file]\n");
+   fprintf(stderr,"                   [--reference][-j nthreads]\
+[--stream][--noprescreen]\n");
+   fprintf(stderr,"                   [--exptl][--xray][--nonmr]\
+[--resolution max]\n");
+   fprintf(stderr,"                   [--rfactor max][--dedup aliases \
+[--deduptol tol]]\n");
    fprintf(stderr,"                   [in.pdb [out.db]]\n");
    
 
@@ -499,8 +571,123 @@ Martin.\n");
    fprintf(stderr,"                   -m Set minimum loop length [1]\n");
    fprintf(stderr,"                   -x Set maximum loop length \
 [None]\n");
+   fprintf(stderr,"                   -s Residues in each takeoff stem \
+(%d-%d) [%d]\n", MINSTEM, MAXSTEM, NSTEM);
+   fprintf(stderr,"                      A distance table is needed if \
+this is not %d\n", NSTEM);
    fprintf(stderr,"                   -t Specify a distance table\n");
    fprintf(stderr,"                   -l Limit the number of PDB files\n");
+   fprintf(stderr,"                   -q Also write a quantized filter \
+sidecar for\n");
+   fprintf(stderr,"                      scanloopdb -q (out.db must be \
+a file)\n");
+   fprintf(stderr,"                   -c Also write the backbone \
+coordinates of each\n");
+   fprintf(stderr,"                      loop and its stems (out.db \
+must be a file)\n");
+   fprintf(stderr,"                   -M Also write a manifest of the \
+PDB files used\n");
+   fprintf(stderr,"                      (out.db must be a file)\n");
+   fprintf(stderr,"                   -u Update a database built with \
+-M, only processing\n");
+   fprintf(stderr,"                      PDB files that are new or \
+have changed\n");
+   fprintf(stderr,"                   -k Write a checkpoint \
+periodically so that an\n");
+   fprintf(stderr,"                      interrupted build can be \
+resumed (out.db must be\n");
+   fprintf(stderr,"                      a file)\n");
+   fprintf(stderr,"                   -K Seconds between checkpoints \
+[%d]\n", DEF_CKINTERVAL);
+   fprintf(stderr,"                   --resume Carry on an \
+interrupted build from its\n");
+   fprintf(stderr,"                      checkpoint. Give the same \
+options as before\n");
+   fprintf(stderr,"                   -P Also write a pack of the \
+CA atoms of each file\n");
+   fprintf(stderr,"                      (with their backbones if -c \
+is given)\n");
+   fprintf(stderr,"                   -R Rebuild from a CA pack \
+instead of reading the\n");
+   fprintf(stderr,"                      PDB files\n");
+   fprintf(stderr,"                   -T Also build a database for \
+another loop type in the\n");
+   fprintf(stderr,"                      same pass (distance table \
+'-' for the default;\n");
+   fprintf(stderr,"                      maxLength 0 for no limit). \
+May be repeated up to\n");
+   fprintf(stderr,"                      %d times. With -q or -c, each \
+database gets its\n", MAXLOOPTYPES);
+   fprintf(stderr,"                      own files with the same \
+extensions\n");
+   fprintf(stderr,"                   --shard Build part i of N \
+(from 1) for combining\n");
+   fprintf(stderr,"                      with mergeloopdb\n");
+   fprintf(stderr,"                   --stats Write a JSON report of \
+the time spent in each\n");
+   fprintf(stderr,"                      phase, rejected files and \
+candidates and the\n");
+   fprintf(stderr,"                      slowest files ('-' for \
+standard error)\n");
+   fprintf(stderr,"                   --counters Write a line of hardware \
+performance counters\n");
+   fprintf(stderr,"                      (cycles, instructions, cache \
+and branch misses) for\n");
+   fprintf(stderr,"                      each phase of each file; \
+totals go in the --stats report\n");
+   fprintf(stderr,"                   --reference Use the original, \
+unoptimized analysis\n");
+   fprintf(stderr,"                      to check faster versions \
+against (cannot be used\n");
+   fprintf(stderr,"                      with -q, -c, -P, -R, -u or \
+-k)\n");
+   fprintf(stderr,"                   -j Number of threads used to \
+analyse structures of at\n");
+   fprintf(stderr,"                      least %d residues, split by \
+chain and into runs of\n", BL_MINPARALLEL);
+   fprintf(stderr,"                      %d residues [one per \
+processor]\n", BL_TASKSIZE);
+   fprintf(stderr,"                   --stream Read and analyse each \
+file one chain at a time\n");
+   fprintf(stderr,"                      so that memory is bounded by \
+the largest chain\n");
+   fprintf(stderr,"                      (cannot be used with -P, -R \
+or --reference)\n");
+   fprintf(stderr,"                   --noprescreen Parse every file \
+rather than first\n");
+   fprintf(stderr,"                      skipping those with no \
+protein, only CA atoms or\n");
+   fprintf(stderr,"                      too few residues for a loop\n");
+   fprintf(stderr,"                   --exptl Write the experimental \
+method, resolution and\n");
+   fprintf(stderr,"                      R-factor of the entry at the \
+end of each record\n");
+   fprintf(stderr,"                      (as do the options below; \
+cannot be used with -R)\n");
+   fprintf(stderr,"                   --xray Only use X-ray \
+structures\n");
+   fprintf(stderr,"                   --nonmr Don't use NMR \
+structures\n");
+   fprintf(stderr,"                   --resolution Only use structures \
+with this resolution\n");
+   fprintf(stderr,"                      or better\n");
+   fprintf(stderr,"                   --rfactor Only use structures \
+with this R-factor or\n");
+   fprintf(stderr,"                      better\n");
+   fprintf(stderr,"                   --dedup Analyse a chain that \
+repeats an earlier chain\n");
+   fprintf(stderr,"                      of the entry (same residues \
+and CA-CA distances)\n");
+   fprintf(stderr,"                      only once, writing an alias \
+for it to this file\n");
+   fprintf(stderr,"                      (cannot be used with -u, \
+--resume, -P or -R)\n");
+   fprintf(stderr,"                   --dedupall Also treat chains \
+repeating a chain of an\n");
+   fprintf(stderr,"                      earlier entry as aliases\n");
+   fprintf(stderr,"                   --deduptol Max difference in a \
+CA-CA distance for\n");
+   fprintf(stderr,"                      an alias [%.2f]\n", DEF_DEDUPTOL);
    fprintf(stderr,"                   -v Verbose\n");
 
    fprintf(stderr,"\nReads a directory of PDB files and identifies \
@@ -514,12 +701,17 @@ directory of PDB\n");
    fprintf(stderr,"files. Output is a file containing the PDB code, \
 residue range\n");
    fprintf(stderr,"loop length (residues between the takeoff regions) \
-and the 9 distances.\n");
+and the nStem^2\n");
+   fprintf(stderr,"distances, where nStem is the stem size (%d-%d \
+residues, -s). The default\n", MINSTEM, MAXSTEM);
+   fprintf(stderr,"stems of 3 residues give 9 distances.\n");
    fprintf(stderr,"-t allows the default distance ranges to be \
 overridden; the distance file\n");
-   fprintf(stderr,"contains nine min/max distance pairs representing \
-n0-c0, n0-c1, n0-c2,\n");
-   fprintf(stderr,"n1-c0, n1-c1, n1-c2, n2-c0, n2-c1, n2-c2\n");
+   fprintf(stderr,"contains nStem^2 min/max distance pairs representing \
+n0-c0, n0-c1, ...\n");
+   fprintf(stderr,"n1-c0, n1-c1, ... in that order (n0-c0, n0-c1, \
+n0-c2, n1-c0, ... n2-c2\n");
+   fprintf(stderr,"for 3-residue stems)\n");
 
    fprintf(stderr,"\n-p is primarilly for testing - it builds a database \
 from a single PDB\n\n");
@@ -531,353 +723,3 @@ are not specified.\n");
 optional.\n\n");
 }
 
-/************************************************************************/
-/*>int RunAnalysis(FILE *out, PDB *pdb, int minLength, int maxLength, 
-                   char *pdbCode, REAL minTable[3][3], 
-                   REAL maxTable[3][3])
-   --------------------------------------------------------------------
-*//**
-   \param[in]   *out        Output file pointer
-   \param[in]   *pdb        Pointer to PDB linked list
-   \param[in]   minLength   Minimum loop length       
-   \param[in]   maxLength   Maximum loop length       
-   \param[in]   *pdbCode    PDB code for this file    
-   \param[in]   minTable    table of minimum distances
-   \param[in]   maxTable    table of maximum distances
-
-   Does the real work of analyzing a structure. Steps through N-ter and
-   C-ter triplets of residues to find those that match the requirements
-   of the minTable and maxTable distance matrices as well as any specified
-   loop length requirements.
-
--  14.07.15 Original   By: ACRM
--  03.11.15 Now returns number of loops found
--  04.11.15 Now calls blFindNextChain() rather than blFindNextChainPDB()
-            so the the first chain isn't terminated.
--  13.12.17 Added check on chain change when finding Nter and Cter
-            residues (fixed bug with 2nd and subsequent chains being
-            done multiple times).
-*/
-int RunAnalysis(FILE *out, PDB *pdb, int minLength, int maxLength, 
-                char *pdbCode, REAL minTable[3][3], REAL maxTable[3][3])
-{
-   PDB  *n[3], *c[3],
-        *chain,
-        *nextChain;
-   REAL distMat[3][3];
-   int  i, j, 
-        nloops = 0,
-        separation;
-   
-   for(chain=pdb; chain!=NULL; chain=nextChain)
-   {
-      nextChain = blFindNextChain(chain);
-      
-      /* Find an N-terminal residue                                     */
-      for(n[0]=chain; 
-          n[0]!=NULL && n[0]!=nextChain;
-          NEXT(n[0]))
-      {
-
-         /* And find the next two                                       */
-         n[1] = (n[0])?n[0]->next:NULL;
-         n[2] = (n[1])?n[1]->next:NULL;
-
-         /* If all three are valid                                      */
-         if((n[2] != NULL) && (n[2]->next != NULL))
-         {
-            separation = 0;
-            
-            /* Find a C-terminal residue                                */
-            for(c[0]=n[2]->next->next; 
-                c[0]!=NULL && c[0]!=nextChain;
-                NEXT(c[0]))
-            {
-               /* If the spacing between N and Cter is too long or not
-                  long enough, break out
-               */
-               separation++;
-               if(maxLength && (separation > maxLength))
-                  break;
-
-               if(separation >= minLength)
-               {
-                  /* And find the next two                              */
-                  c[1] = (c[0])?c[0]->next:NULL;
-                  c[2] = (c[1])?c[1]->next:NULL;
-
-                  /* If all three are valid                             */
-                  if((c[1] != NULL) && (c[2] != NULL))
-                  {
-                     BOOL badDistance = FALSE;
-                  
-                     if(ChainIsIntact((PDB*)(n[0]), c[2]->next))
-                     {
-                        /* Create the distance matrix                   */
-                        for(i=0; i<3; i++)
-                        {
-                           for(j=0; j<3; j++)
-                           {
-                              distMat[i][j] = DIST(n[i], c[j]);
-                              
-                              if((distMat[i][j] < minTable[i][j]) ||
-                                 (distMat[i][j] > maxTable[i][j]))
-                              {
-                                 badDistance = TRUE;
-                                 i=4; /* Break out of outer loop        */
-                                 break;
-                              }
-                           }
-                        }
-
-                        if(!badDistance)
-                        {
-                           nloops++;
-                           PrintResults(out, pdbCode, separation, n, c, 
-                                        distMat);
-                        }
-                        
-                     }
-                  }
-               }
-            }  
-         }
-      }
-   }
-   return(nloops);
-}
-
-
-/************************************************************************/
-/*>BOOL ChainIsIntact(PDB *start, PDB *end)
-   ----------------------------------------
-*//**
-   \param[in]    *start  Start of region
-   \param[in]    *end    End of region
-   \return               Is intact?
-
-   Checks whether a chain is intact (i.e. doesn't have any chain breaks)
-
--  16.07.15 Original   By: ACRM
-*/
-BOOL ChainIsIntact(PDB *start, PDB *end)
-{
-   PDB *p;
-   
-   for(p=start; p!=end; NEXT(p))
-   {
-      if((p!=NULL) && (p->next != NULL))
-      {
-         if(DISTSQ(p, p->next) > MAX_CA_CA_DISTANCE_SQ)
-         {
-            return(FALSE);
-         }
-      }
-   }
-   
-   return(TRUE);
-}
-
-
-/************************************************************************/
-/*>void PrintResults(FILE *out, char *pdbCode, int separation, 
-                     PDB *n[3], PDB *c[3], REAL distMat[3][3]) 
-   ------------------------------------------------------------
-*//**
-   \param[in]   *out          Output file pointer
-   \param[in]   *pdbCode      PDB code
-   \param[in]   separation    loop length
-   \param[in]   *n[]          N-ter three PDB pointers
-   \param[in]   *c[]          C-ter three PDB pointers
-   \param[in]   *distMat[][]  Distance matrix
-
-   Prints the results for a loop already determined to match criteria
-
--  14.07.15 Original   By: ACRM
-*/
-void PrintResults(FILE *out, char *pdbCode, int separation, 
-                  PDB *n[3], PDB *c[3], REAL distMat[3][3]) 
-{
-   char resid1[16],
-        resid2[16];
-   int  i, j;
-               
-   MAKERESID(resid1, n[0]);
-   MAKERESID(resid2, c[2]);
-   
-   fprintf(out, "%s %s %s %d ", (pdbCode!=NULL)?pdbCode:"",
-           resid1, resid2, separation);
-   for(i=0; i<3; i++)
-   {
-      for(j=0; j<3; j++)
-      {
-         fprintf(out, "%.3f ", distMat[i][j]);
-      }
-   }
-   fprintf(out, "\n");
-}
-
-
-/************************************************************************/
-/*>void ReadDistanceTable(char *distTable, REAL minTable[3][3], 
-                          REAL maxTable[3][3])
-   ------------------------------------------------------------
-*//**
-   \param[in]   *distTable    Distance table filename
-   \param[out]  minTable[][]  table of minimum distances
-   \param[out]  maxTable[][]  table of maximum distances
-
-   Reads a user-specified distance matrix table instead of using the
-   defaults coded in distances.h
-
--  14.07.15 Original   By: ACRM
-*/
-void ReadDistanceTable(char *distTable, REAL minTable[3][3],
-                       REAL maxTable[3][3])
-{
-   FILE *fp = NULL;
-   char buffer[MAXBUFF];
-   int  i = 0,
-        j = 0;
-   
-   if((fp=fopen(distTable, "r"))!=NULL)
-   {
-      while(fgets(buffer, MAXBUFF, fp))
-      {
-         char *chp;
-         TERMINATE(buffer);
-         if((chp = strchr(buffer, '#'))!=NULL)
-            *chp = '\0';
-         KILLTRAILSPACES(buffer);
-         if(strlen(buffer))
-         {
-            sscanf(buffer,"%lf %lf", 
-                   &(minTable[i][j]), &(maxTable[i][j]));
-            if((++j)==3)
-            {
-               j=0;
-               i++;
-            }
-         }
-      }
-      
-      fclose(fp);
-   }
-}
-
-
-/************************************************************************/
-/*>void SetUpMinMaxTables(REAL minTable[3][3], REAL maxTable[3][3])
-   ----------------------------------------------------------------
-*//**
-   \param[out]  minTable[][]  table of minimum distances
-   \param[out]  maxTable[][]  table of maximum distances
-
-   Initializes the minimum and maximum distance matrices based on
-   mean and standard deviation distances in distances.h
-
--  15.07.15 Original   By: ACRM
-*/
-void SetUpMinMaxTables(REAL minTable[3][3], REAL maxTable[3][3])
-{
-   int i, j;
-
-   #include "distances.h"
-
-   for(i=0; i<3; i++)
-   {
-      for(j=0; j<3; j++)
-      {
-         minTable[i][j] = means[i][j] - sdMult * sds[i][j];
-         maxTable[i][j] = means[i][j] + sdMult * sds[i][j];
-      }
-   }
-}
-
-
-/************************************************************************/
-/*>BOOL BackboneComplete(PDB *pdb)
-   -------------------------------
-*//**
-   \param[in]  *pdb   PDB linked list
-   \return            Is the backbone complete?
-
-   Checks whether the backbone is complete - thus rejecting CA-only files
-   like 3ixx
-
--  10.12.15 Original  By: ACRM
-*/
-BOOL BackboneComplete(PDB *pdb)
-{
-   PDB  *p, 
-        *start,
-        *nextRes,
-        *n     = NULL, 
-        *ca    = NULL,
-        *c     = NULL,
-        *o     = NULL,
-        *cPrev = NULL;
-   char chain[blMAXCHAINLABEL];
-
-   chain[0] = '\0';
-   
-   /* Step through the PDB file one residue at a time                   */
-   for(start=pdb; start!=NULL; start=nextRes)
-   {
-      nextRes = blFindNextResidue(start);
-      
-      /* If the chain has changed we reset everything                   */
-      if(!CHAINMATCH(start->chain, chain))
-      {
-         n = ca = c = o = cPrev = NULL;
-         strncpy(chain, start->chain, blMAXCHAINLABEL);
-      }
-      
-
-      /* Step through the residue finding the important atoms           */
-      cPrev = c;
-      for(p=start; p!=nextRes; NEXT(p))
-      {
-         if(!strncmp(p->atnam, "N   ", 4))
-            n=p;
-
-         if(!strncmp(p->atnam, "CA  ", 4))
-            ca=p;
-
-         if(!strncmp(p->atnam, "C   ", 4))
-            c=p;
-
-         if(!strncmp(p->atnam, "O   ", 4))
-            o=p;
-      }
-
-      /* Either all atoms must be found (protein) or none of the atoms
-         found (nucleic acid)
-      */
-      if((n==NULL) && (ca==NULL) && (c==NULL) && (o==NULL))     /* None */
-      {
-         continue;
-      }
-      else if((n!=NULL) && (ca!=NULL) && (c!=NULL) && (o!=NULL))/* All  */
-      {
-         /* Check the distances                                         */
-         if(cPrev!=NULL)
-         {
-            if(DISTSQ(cPrev,n) > MAX_BOND_DISTANCE_SQ)
-               return(FALSE);
-         }
-         if(DISTSQ(n,ca) > MAX_BOND_DISTANCE_SQ)
-            return(FALSE);
-         if(DISTSQ(ca,c) > MAX_BOND_DISTANCE_SQ)
-            return(FALSE);
-         if(DISTSQ(c,o)  > MAX_BOND_DISTANCE_SQ)
-            return(FALSE);
-      }
-      else
-      {
-         return(FALSE);
-      }
-   }
-   return(TRUE);
-}
-
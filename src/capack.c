@@ -0,0 +1,519 @@
+/************************************************************************/
+/**
+
+   \file       capack.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Pack file of CA traces for rebuilding without reading PDB
+               files
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Reading and checking the PDB files is by far the slowest part of
+   building a database, but it does not depend on the loop lengths or
+   distance table. The CA pack stores, for each PDB file, the CA atoms
+   that survived BackboneComplete() and blSelectCaPDB() so that a
+   database can be rebuilt with new parameters without reading the PDB
+   files again.
+
+   The file is laid out as:
+      CPHEADER
+      for each PDB file: CARES[nRes] then, if the pack has backbones,
+                         BBRES[nRes], padded to a multiple of 8 bytes
+      CPENTRY[nFiles]    sorted by path
+      the paths, NUL terminated
+
+   Each residue is flagged if the distance from its CA to the next one
+   in the file is too long for them to be joined, so the break need not
+   be found again.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "bioplib/pdb.h"
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define ENTRY_CHUNK  4096
+#define STRING_CHUNK 65536
+#define PAD8(x)      (((x) + 7) & ~7L)
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+static BOOL PadTo8(CPWRITER *cw);
+
+
+/************************************************************************/
+/*>CPWRITER *OpenCAPackWriter(char *filename, char *pdbDir,
+                              BOOL withBackbone)
+   -----------------------------------------------------------
+*//**
+   \param[in]   *filename     Pack file to create
+   \param[in]   *pdbDir       Directory of PDB files it is built from
+   \param[in]   withBackbone  Also store the backbone of each residue so
+                              that coordinate files can be written
+   \return                    Writer structure (NULL on failure)
+
+   Opens a CA pack for writing
+
+-  18.10.26 Original   By: ACRM
+*/
+CPWRITER *OpenCAPackWriter(char *filename, char *pdbDir,
+                           BOOL withBackbone)
+{
+   CPWRITER *cw;
+
+   if((cw = (CPWRITER *)malloc(sizeof(CPWRITER)))==NULL)
+      return(NULL);
+
+   if((cw->fp = fopen(filename, "wb"))==NULL)
+   {
+      free(cw);
+      return(NULL);
+   }
+
+   memset(&(cw->header), 0, sizeof(CPHEADER));
+   memcpy(cw->header.magic, CP_MAGIC, 8);
+   cw->header.version     = CP_VERSION;
+   cw->header.hasBackbone = withBackbone;
+   strncpy(cw->header.pdbDir, pdbDir, CP_MAXDIR-1);
+
+   cw->entries     = NULL;
+   cw->maxEntries  = 0;
+   cw->strings     = NULL;
+   cw->stringsSize = 0;
+   cw->maxStrings  = 0;
+   cw->dataOffset  = sizeof(CPHEADER);
+   cw->fileOffset  = cw->dataOffset;
+   cw->fileRes     = 0;
+
+   /* Space for the header; rewritten with the final counts on close    */
+   if(fwrite(&(cw->header), sizeof(CPHEADER), 1, cw->fp) != 1)
+   {
+      fclose(cw->fp);
+      free(cw);
+      return(NULL);
+   }
+
+   return(cw);
+}
+
+
+/************************************************************************/
+/*>BOOL WriteCAPackResidues(CPWRITER *cw, PDB *pdb, BBRES *backbone,
+                            char *breakAfter)
+   -----------------------------------------------------------------
+*//**
+   \param[in]   *cw         Pack writer
+   \param[in]   *pdb        CA atoms of a PDB file
+   \param[in]   *backbone   Backbone of each residue (NULL if the pack
+                            does not store backbones)
+   \param[in]   *breakAfter Flags for residues whose CA is too far from
+                            the next one
+   \return                  Success
+
+   Stores the CA trace of the current PDB file. Called at most once for
+   each file before EndCAPackFile().
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL WriteCAPackResidues(CPWRITER *cw, PDB *pdb, BBRES *backbone,
+                         char *breakAfter)
+{
+   PDB   *p;
+   CARES res;
+   long  nRes = 0;
+
+   for(p=pdb; p!=NULL; NEXT(p))
+   {
+      memset(&res, 0, sizeof(CARES));
+      res.x      = p->x;
+      res.y      = p->y;
+      res.z      = p->z;
+      res.resnum = p->resnum;
+      res.flags  = breakAfter[nRes]?CP_BREAK:0;
+      memcpy(res.chain,  p->chain,  8);
+      memcpy(res.insert, p->insert, 8);
+      memcpy(res.resnam, p->resnam, 8);
+      if(fwrite(&res, sizeof(CARES), 1, cw->fp) != 1)
+         return(FALSE);
+      nRes++;
+   }
+   cw->dataOffset += nRes * sizeof(CARES);
+
+   if(cw->header.hasBackbone)
+   {
+      if(fwrite(backbone, sizeof(BBRES), nRes, cw->fp) != (size_t)nRes)
+         return(FALSE);
+      cw->dataOffset += nRes * sizeof(BBRES);
+   }
+
+   cw->fileRes = nRes;
+   return(PadTo8(cw));
+}
+
+
+/************************************************************************/
+/*>BOOL EndCAPackFile(CPWRITER *cw, char *path, MFENTRY *details)
+   --------------------------------------------------------------
+*//**
+   \param[in]   *cw        Pack writer
+   \param[in]   *path      PDB file
+   \param[in]   *details   Size, modification time and hash of the file
+   \return                 Success
+
+   Adds an index entry for a PDB file with the residues stored since
+   the previous one. A file with no usable residues still gets an entry
+   so that it is known to have been read.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL EndCAPackFile(CPWRITER *cw, char *path, MFENTRY *details)
+{
+   CPENTRY *e;
+   long    len = strlen(path) + 1;
+
+   if(cw->header.nFiles >= cw->maxEntries)
+   {
+      CPENTRY *entries;
+      if((entries = (CPENTRY *)realloc(cw->entries,
+                                       (cw->maxEntries + ENTRY_CHUNK) *
+                                       sizeof(CPENTRY)))==NULL)
+         return(FALSE);
+      cw->entries     = entries;
+      cw->maxEntries += ENTRY_CHUNK;
+   }
+
+   if(cw->stringsSize + len > cw->maxStrings)
+   {
+      char *strings;
+      long newSize = cw->maxStrings + STRING_CHUNK + len;
+      if((strings = (char *)realloc(cw->strings, newSize))==NULL)
+         return(FALSE);
+      cw->strings    = strings;
+      cw->maxStrings = newSize;
+   }
+
+   e = cw->entries + cw->header.nFiles++;
+   e->size    = details->size;
+   e->mtime   = details->mtime;
+   e->hash    = details->hash;
+   e->offset  = cw->fileOffset;
+   e->nRes    = cw->fileRes;
+   e->path    = cw->stringsSize;
+   strcpy(cw->strings + cw->stringsSize, path);
+   cw->stringsSize       += len;
+   cw->header.nResidues  += cw->fileRes;
+
+   cw->fileOffset = cw->dataOffset;
+   cw->fileRes    = 0;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>BOOL CloseCAPackWriter(CPWRITER *cw)
+   ------------------------------------
+*//**
+   \param[in]   *cw        Pack writer
+   \return                 Success
+
+   Writes the index and paths and rewrites the header with the final
+   counts. Frees the writer. The files must have been added in sorted
+   order.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL CloseCAPackWriter(CPWRITER *cw)
+{
+   BOOL ok       = TRUE;
+   long nEntries = cw->header.nFiles;
+
+   cw->header.indexOffset   = cw->dataOffset;
+   cw->header.stringsOffset = cw->dataOffset + nEntries * sizeof(CPENTRY);
+   cw->header.stringsSize   = cw->stringsSize;
+
+   if(nEntries &&
+      (fwrite(cw->entries, sizeof(CPENTRY), nEntries, cw->fp) !=
+       (size_t)nEntries))
+      ok = FALSE;
+   if(ok && cw->stringsSize &&
+      (fwrite(cw->strings, 1, cw->stringsSize, cw->fp) !=
+       (size_t)cw->stringsSize))
+      ok = FALSE;
+
+   if(ok)
+   {
+      if(fseek(cw->fp, 0L, SEEK_SET) ||
+         (fwrite(&(cw->header), sizeof(CPHEADER), 1, cw->fp) != 1))
+         ok = FALSE;
+   }
+
+   if(fclose(cw->fp))
+      ok = FALSE;
+   if(cw->entries != NULL)
+      free(cw->entries);
+   if(cw->strings != NULL)
+      free(cw->strings);
+   free(cw);
+
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>static BOOL PadTo8(CPWRITER *cw)
+   --------------------------------
+*//**
+   \param[in]   *cw        Pack writer
+   \return                 Success
+
+   Pads the data so that the next file's residues are aligned for use
+   directly from a mapped file
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL PadTo8(CPWRITER *cw)
+{
+   char   pad[8];
+   size_t nPad = (size_t)(PAD8(cw->dataOffset) - cw->dataOffset);
+
+   if(nPad)
+   {
+      memset(pad, 0, 8);
+      if(fwrite(pad, 1, nPad, cw->fp) != nPad)
+         return(FALSE);
+      cw->dataOffset += nPad;
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>CAPACK *OpenCAPack(char *filename)
+   ----------------------------------
+*//**
+   \param[in]   *filename  Pack file
+   \return                 Mapped pack (NULL if it can't be opened or
+                           is incomplete)
+
+   Maps a CA pack into memory
+
+-  18.10.26 Original   By: ACRM
+*/
+CAPACK *OpenCAPack(char *filename)
+{
+   CAPACK      *cp;
+   FILE        *fp;
+   struct stat st;
+
+   if((fp = fopen(filename, "rb"))==NULL)
+      return(NULL);
+
+   if(fstat(fileno(fp), &st) || (st.st_size < (off_t)sizeof(CPHEADER)))
+   {
+      fclose(fp);
+      return(NULL);
+   }
+
+   if((cp = (CAPACK *)malloc(sizeof(CAPACK)))==NULL)
+   {
+      fclose(fp);
+      return(NULL);
+   }
+
+   cp->mapSize = (size_t)st.st_size;
+   cp->map     = mmap(NULL, cp->mapSize, PROT_READ, MAP_SHARED,
+                      fileno(fp), 0);
+   fclose(fp);
+   if(cp->map == MAP_FAILED)
+   {
+      free(cp);
+      return(NULL);
+   }
+
+   cp->header  = (CPHEADER *)cp->map;
+   if(strncmp(cp->header->magic, CP_MAGIC, 8)   ||
+      (cp->header->version != CP_VERSION)       ||
+      (cp->mapSize != (size_t)(cp->header->stringsOffset +
+                               cp->header->stringsSize)))
+   {
+      munmap(cp->map, cp->mapSize);
+      free(cp);
+      return(NULL);
+   }
+   cp->entries = (CPENTRY *)((char *)cp->map + cp->header->indexOffset);
+   cp->strings = (char *)cp->map + cp->header->stringsOffset;
+
+   return(cp);
+}
+
+
+/************************************************************************/
+/*>char *CAPackPath(CAPACK *cp, long file)
+   ---------------------------------------
+*//**
+   \param[in]   *cp        Mapped pack
+   \param[in]   file       File number
+   \return                 Path of the PDB file
+
+-  18.10.26 Original   By: ACRM
+*/
+char *CAPackPath(CAPACK *cp, long file)
+{
+   return(cp->strings + cp->entries[file].path);
+}
+
+
+/************************************************************************/
+/*>CARES *CAPackResidues(CAPACK *cp, long file, int *nRes,
+                         BBRES **backbone)
+   -------------------------------------------------------
+*//**
+   \param[in]   *cp        Mapped pack
+   \param[in]   file       File number
+   \param[out]  *nRes      Number of residues
+   \param[out]  **backbone Backbone of each residue (NULL if the pack
+                           does not store backbones)
+   \return                 The CA trace (points into the mapped file)
+
+-  18.10.26 Original   By: ACRM
+*/
+CARES *CAPackResidues(CAPACK *cp, long file, int *nRes, BBRES **backbone)
+{
+   CPENTRY *e   = cp->entries + file;
+   CARES   *res = (CARES *)((char *)cp->map + e->offset);
+
+   *nRes     = (int)e->nRes;
+   *backbone = cp->header->hasBackbone?(BBRES *)(res + e->nRes):NULL;
+   return(res);
+}
+
+
+/************************************************************************/
+/*>PDB *CAPackToPDB(CARES *res, int nRes)
+   --------------------------------------
+*//**
+   \param[in]   *res       CA trace from CAPackResidues()
+   \param[in]   nRes       Number of residues
+   \return                 Linked list of CA atoms (NULL if none or no
+                           memory)
+
+   Rebuilds the CA atoms of a PDB file from the pack
+
+-  18.10.26 Original   By: ACRM
+*/
+PDB *CAPackToPDB(CARES *res, int nRes)
+{
+   PDB *pdb = NULL,
+       *p   = NULL;
+   int i;
+
+   for(i=0; i<nRes; i++)
+   {
+      if(pdb == NULL)
+      {
+         INIT(pdb, PDB);
+         p = pdb;
+      }
+      else
+      {
+         ALLOCNEXT(p, PDB);
+      }
+      if(p == NULL)
+      {
+         FREELIST(pdb, PDB);
+         return(NULL);
+      }
+
+      CLEAR_PDB(p);
+      strcpy(p->record_type, "ATOM  ");
+      strcpy(p->atnam,       "CA  ");
+      strcpy(p->atnam_raw,   " CA ");
+      strcpy(p->resnam,      res[i].resnam);
+      strcpy(p->chain,       res[i].chain);
+      strcpy(p->insert,      res[i].insert);
+      p->atnum  = i+1;
+      p->resnum = res[i].resnum;
+      p->x      = res[i].x;
+      p->y      = res[i].y;
+      p->z      = res[i].z;
+      p->occ    = 1.0;
+      p->next   = NULL;
+   }
+   return(pdb);
+}
+
+
+/************************************************************************/
+/*>void CloseCAPack(CAPACK *cp)
+   ----------------------------
+*//**
+   \param[in]   *cp        Mapped pack
+
+   Unmaps a CA pack
+
+-  18.10.26 Original   By: ACRM
+*/
+void CloseCAPack(CAPACK *cp)
+{
+   if(cp != NULL)
+   {
+      munmap(cp->map, cp->mapSize);
+      free(cp);
+   }
+}
@@ -0,0 +1,644 @@
+/************************************************************************/
+/**
+
+   \file       chainread.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Reading a PDB or mmCIF file one chain at a time
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Lets buildloopdb --stream work through a very large structure
+   holding only one chain in memory. The coordinate records of each
+   chain in turn are copied to a temporary file which is read with
+   blReadPDBAtoms() so that the atoms are exactly those that reading
+   the whole file would give.
+
+   A chain is a run of ATOM/HETATM records with the same chain label
+   (column 22) in a PDB file or the same auth_asym_id and label_asym_id
+   in the atom_site loop of an mmCIF file, in which case the data_ line
+   and the loop header are copied in front of each chain. Only the
+   first model is read, as by blReadPDBAtoms(). Each mmCIF atom must be
+   on one line of no more than CR_MAXLINE characters.
+
+   PreScreenFile() uses the same reading of the records, without
+   building any atoms, to find files that can't contain a loop so that
+   buildloopdb need not parse them at all.
+
+**************************************************************************
+
+   Usage:
+   ======
+   cr = OpenChainReader(fp);
+   while(ReadNextChain(cr, &pdb, &natoms))
+   {
+      if(pdb != NULL)
+      {
+         ...
+         FREELIST(pdb, PDB);
+      }
+   }
+   if(cr->error) ...
+   CloseChainReader(cr);
+
+   if(PreScreenFile(fp, 2*nStem + minLength) == PS_USABLE) ...
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "bioplib/pdb.h"
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define CR_ATOMSITE   "_atom_site."
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+static BOOL StartChainReader(CHAINREADER *cr);
+static BOOL ReadCifHeader(CHAINREADER *cr);
+static BOOL NextAtomLine(CHAINREADER *cr);
+static BOOL CifField(char *line, int col, char *field);
+static BOOL AddHeaderLine(CHAINREADER *cr, char *line);
+static BOOL AtomName(CHAINREADER *cr, char *name);
+
+
+/************************************************************************/
+/*>CHAINREADER *OpenChainReader(FILE *in)
+   --------------------------------------
+*//**
+   \param[in]   *in     PDB or mmCIF file
+   \return              Chain reader (NULL if no memory)
+
+   Starts reading a file one chain at a time. The file should be
+   seekable if RewindChainReader() is to be used.
+
+-  18.10.26 Original   By: ACRM
+*/
+CHAINREADER *OpenChainReader(FILE *in)
+{
+   CHAINREADER *cr;
+
+   if((cr = (CHAINREADER *)calloc(1, sizeof(CHAINREADER)))==NULL)
+      return(NULL);
+   cr->in = in;
+   if(!StartChainReader(cr))
+   {
+      CloseChainReader(cr);
+      return(NULL);
+   }
+   return(cr);
+}
+
+
+/************************************************************************/
+/*>BOOL RewindChainReader(CHAINREADER *cr)
+   ---------------------------------------
+*//**
+   \param[in,out] *cr   Chain reader
+   \return              Success (FALSE if the file can't be rewound)
+
+   Goes back to the first chain
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL RewindChainReader(CHAINREADER *cr)
+{
+   if(fseek(cr->in, 0L, SEEK_SET))
+      return(FALSE);
+   return(StartChainReader(cr));
+}
+
+
+/************************************************************************/
+/*>void CloseChainReader(CHAINREADER *cr)
+   --------------------------------------
+*//**
+   \param[in]   *cr     Chain reader
+
+   Frees a chain reader. The file is not closed.
+
+-  18.10.26 Original   By: ACRM
+*/
+void CloseChainReader(CHAINREADER *cr)
+{
+   if(cr != NULL)
+   {
+      free(cr->header);
+      free(cr);
+   }
+}
+
+
+/************************************************************************/
+/*>BOOL ReadNextChain(CHAINREADER *cr, PDB **pdb, int *natoms)
+   -----------------------------------------------------------
+*//**
+   \param[in,out] *cr       Chain reader
+   \param[out]    **pdb     Atoms of the chain (NULL if it has no ATOM
+                            records)
+   \param[out]    *natoms   Number of atoms
+   \return                  Was a chain read? (FALSE at the end of the
+                            first model or on error, when cr->error is
+                            set)
+
+   Reads the next chain
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL ReadNextChain(CHAINREADER *cr, PDB **pdb, int *natoms)
+{
+   FILE *tmp;
+   char chain[CR_MAXLINE];
+
+   *pdb    = NULL;
+   *natoms = 0;
+   if(cr->error || !cr->pending)
+      return(FALSE);
+
+   if((tmp = tmpfile())==NULL)
+   {
+      cr->error = TRUE;
+      return(FALSE);
+   }
+   if(cr->header != NULL)
+      fputs(cr->header, tmp);
+
+   strcpy(chain, cr->chain);
+   do
+   {
+      fputs(cr->line, tmp);
+   }  while(NextAtomLine(cr) && !strcmp(cr->chain, chain));
+
+   if(cr->header != NULL)
+      fputs("#\n", tmp);
+
+   if(ferror(tmp))
+   {
+      cr->error = TRUE;
+      fclose(tmp);
+      return(FALSE);
+   }
+   rewind(tmp);
+   *pdb = blReadPDBAtoms(tmp, natoms);
+   fclose(tmp);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>int PreScreenFile(FILE *in, int minResidues)
+   --------------------------------------------
+*//**
+   \param[in]   *in           PDB or mmCIF file
+   \param[in]   minResidues   Fewest residues that can hold a loop
+   \return                    PS_USABLE or the reason the file can't
+                              give a loop
+
+   A quick look at the ATOM records of the first model, counting the
+   backbone atom names without building a PDB linked list. A file is
+   only rejected when reading it properly could not give a loop:
+   PS_NOPROTEIN if there is no CA atom at all (nucleic acid only),
+   PS_CAONLY if there are CA atoms but no N, C or O atoms at all, so
+   that BackboneComplete() must fail, and PS_SHORT if there are fewer
+   CA atoms in the whole model (counting alternate positions) than
+   minResidues. Anything else, including files with no ATOM records,
+   files that can't be read and files that aren't seekable, is left
+   for the normal reading. The scan stops as soon as the file is known
+   to be usable, so a normal file costs only its first few records.
+
+   The file is left where it started.
+
+-  18.10.26 Original   By: ACRM
+*/
+int PreScreenFile(FILE *in, int minResidues)
+{
+   CHAINREADER *cr;
+   char        name[CR_MAXLINE],
+               field[CR_MAXLINE];
+   long        start,
+               nAtoms = 0,
+               nCa    = 0,
+               nN     = 0,
+               nC     = 0,
+               nO     = 0;
+   int         result = PS_USABLE;
+
+   if((start = ftell(in)) < 0L)
+      return(PS_USABLE);
+   if((cr = OpenChainReader(in))==NULL)
+   {
+      fseek(in, start, SEEK_SET);
+      return(PS_USABLE);
+   }
+   if(cr->isCif && (cr->atomCol < 0))
+      cr->pending = FALSE;
+
+   for(; cr->pending; NextAtomLine(cr))
+   {
+      /* Only ATOM records are read by blReadPDBAtoms()                 */
+      if(cr->isCif)
+      {
+         if((cr->groupCol >= 0) &&
+            (!CifField(cr->line, cr->groupCol, field) ||
+             strcmp(field, "ATOM")))
+            continue;
+      }
+      else if(strncmp(cr->line, "ATOM  ", 6))
+      {
+         continue;
+      }
+
+      nAtoms++;
+      if(!AtomName(cr, name))
+         continue;
+      if(!strcmp(name, "CA"))
+         nCa++;
+      else if(!strcmp(name, "N"))
+         nN++;
+      else if(!strcmp(name, "C"))
+         nC++;
+      else if(!strcmp(name, "O"))
+         nO++;
+
+      if((nCa >= minResidues) && nN && nC && nO)
+         break;
+   }
+
+   if(!cr->error && nAtoms && !((nCa >= minResidues) && nN && nC && nO))
+   {
+      if(nCa == 0)
+         result = PS_NOPROTEIN;
+      else if(!nN || !nC || !nO)
+         result = PS_CAONLY;
+      else
+         result = PS_SHORT;
+   }
+
+   CloseChainReader(cr);
+   if(fseek(in, start, SEEK_SET))
+      return(PS_USABLE);
+   return(result);
+}
+
+
+/************************************************************************/
+/*>static BOOL AtomName(CHAINREADER *cr, char *name)
+   -------------------------------------------------
+*//**
+   \param[in]   *cr     Chain reader holding an atom record
+   \param[out]  *name   Atom name without spaces
+   \return              Was a name found?
+
+   Gets the atom name from columns 13-16 of a PDB record or from the
+   label_atom_id (or auth_atom_id) of an mmCIF record
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL AtomName(CHAINREADER *cr, char *name)
+{
+   char *chp;
+   int  i;
+
+   if(cr->isCif)
+      return((cr->atomCol >= 0) && CifField(cr->line, cr->atomCol, name));
+
+   if(strlen(cr->line) < 17)
+      return(FALSE);
+   for(chp=cr->line+12; (chp < cr->line+16) && (*chp == ' '); chp++)
+      ;
+   for(i=0; (chp < cr->line+16) && (*chp != ' '); chp++)
+      name[i++] = *chp;
+   name[i] = '\0';
+   return(i > 0);
+}
+
+
+/************************************************************************/
+/*>static BOOL StartChainReader(CHAINREADER *cr)
+   ---------------------------------------------
+*//**
+   \param[in,out] *cr   Chain reader positioned at the start of the file
+   \return              Success (FALSE if no memory)
+
+   Works out whether the file is PDB or mmCIF and reads up to the first
+   atom
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL StartChainReader(CHAINREADER *cr)
+{
+   int  c;
+
+   free(cr->header);
+   cr->header   = NULL;
+   cr->isCif    = FALSE;
+   cr->pending  = FALSE;
+   cr->error    = FALSE;
+   cr->model[0] = '\0';
+
+   /* An mmCIF file starts with a data_ line                            */
+   while(((c = getc(cr->in)) != EOF) && isspace(c))
+      ;
+   if(c == EOF)
+      return(TRUE);
+   ungetc(c, cr->in);
+
+   if(c == 'd')
+   {
+      if(fgets(cr->line, CR_MAXLINE-1, cr->in) == NULL)
+         return(TRUE);
+      if(!strncmp(cr->line, "data_", 5))
+      {
+         cr->isCif = TRUE;
+         if(strchr(cr->line, '\n') == NULL)
+            strcat(cr->line, "\n");
+         if(!AddHeaderLine(cr, cr->line))
+            return(FALSE);
+         if(!ReadCifHeader(cr))
+            return(!cr->error);
+      }
+   }
+
+   NextAtomLine(cr);
+   return(!cr->error);
+}
+
+
+/************************************************************************/
+/*>static BOOL ReadCifHeader(CHAINREADER *cr)
+   ------------------------------------------
+*//**
+   \param[in,out] *cr   Chain reader just after the data_ line
+   \return              Was an atom_site loop found? (FALSE on error
+                        with cr->error set)
+
+   Reads up to the first row of the atom_site loop, keeping its header
+   and noting the columns giving the chain and model
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL ReadCifHeader(CHAINREADER *cr)
+{
+   long offset = 0L;
+   BOOL inLoop = FALSE;
+   int  nCol   = 0;
+
+   cr->authCol  = cr->labelCol = cr->modelCol = (-1);
+   cr->groupCol = cr->atomCol  = (-1);
+
+   /* Find the loop_ line followed by _atom_site. items                 */
+   while(fgets(cr->line, CR_MAXLINE-1, cr->in) != NULL)
+   {
+      if(!strncmp(cr->line, "loop_", 5))
+      {
+         inLoop = TRUE;
+         continue;
+      }
+      if(inLoop && !strncmp(cr->line, CR_ATOMSITE, strlen(CR_ATOMSITE)))
+         break;
+      inLoop = FALSE;
+   }
+   if(feof(cr->in) || ferror(cr->in))
+      return(FALSE);
+
+   if(!AddHeaderLine(cr, "loop_\n"))
+      return(FALSE);
+
+   /* Keep the items and leave the file at the first row                */
+   do
+   {
+      if(strncmp(cr->line, CR_ATOMSITE, strlen(CR_ATOMSITE)))
+         break;
+      if(!strncmp(cr->line, "_atom_site.auth_asym_id", 23) &&
+         isspace(cr->line[23]))
+         cr->authCol = nCol;
+      else if(!strncmp(cr->line, "_atom_site.label_asym_id", 24) &&
+              isspace(cr->line[24]))
+         cr->labelCol = nCol;
+      else if(!strncmp(cr->line, "_atom_site.pdbx_PDB_model_num", 29) &&
+              isspace(cr->line[29]))
+         cr->modelCol = nCol;
+      else if(!strncmp(cr->line, "_atom_site.group_PDB", 20) &&
+              isspace(cr->line[20]))
+         cr->groupCol = nCol;
+      else if(!strncmp(cr->line, "_atom_site.label_atom_id", 24) &&
+              isspace(cr->line[24]))
+         cr->atomCol = nCol;
+      else if(!strncmp(cr->line, "_atom_site.auth_atom_id", 23) &&
+              isspace(cr->line[23]) && (cr->atomCol < 0))
+         cr->atomCol = nCol;
+      nCol++;
+      if(strchr(cr->line, '\n') == NULL)
+         strcat(cr->line, "\n");
+      if(!AddHeaderLine(cr, cr->line))
+         return(FALSE);
+      offset = ftell(cr->in);
+   }  while(fgets(cr->line, CR_MAXLINE-1, cr->in) != NULL);
+
+   if(fseek(cr->in, offset, SEEK_SET))
+   {
+      cr->error = TRUE;
+      return(FALSE);
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL NextAtomLine(CHAINREADER *cr)
+   -----------------------------------------
+*//**
+   \param[in,out] *cr   Chain reader
+   \return              Was an atom read? (Sets cr->pending)
+
+   Reads the next coordinate record of the first model into cr->line
+   and its chain into cr->chain
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL NextAtomLine(CHAINREADER *cr)
+{
+   char field[CR_MAXLINE];
+
+   cr->pending = FALSE;
+   while(fgets(cr->line, CR_MAXLINE-1, cr->in) != NULL)
+   {
+      if(strchr(cr->line, '\n') == NULL)
+         strcat(cr->line, "\n");
+
+      if(!cr->isCif)
+      {
+         /* PDB: only the first model                                   */
+         if(!strncmp(cr->line, "ENDMDL", 6))
+            return(FALSE);
+         if(strncmp(cr->line, "ATOM  ", 6) &&
+            strncmp(cr->line, "HETATM", 6))
+            continue;
+         cr->chain[0] = (strlen(cr->line) > 22) ? cr->line[21] : ' ';
+         cr->chain[1] = '\0';
+      }
+      else
+      {
+         /* mmCIF: the loop ends with a #, a new item or a new loop     */
+         if((cr->line[0] == '#') || (cr->line[0] == '_') ||
+            !strncmp(cr->line, "loop_", 5) ||
+            !strncmp(cr->line, "data_", 5))
+            return(FALSE);
+         if(!CifField(cr->line, 0, field))
+            continue;
+
+         if((cr->modelCol >= 0) && CifField(cr->line, cr->modelCol,
+                                            field))
+         {
+            if(cr->model[0] == '\0')
+               strcpy(cr->model, field);
+            else if(strcmp(cr->model, field))
+               return(FALSE);
+         }
+
+         cr->chain[0] = '\0';
+         if((cr->authCol >= 0) && CifField(cr->line, cr->authCol, field))
+            strcpy(cr->chain, field);
+         strcat(cr->chain, " ");
+         if((cr->labelCol >= 0) &&
+            CifField(cr->line, cr->labelCol, field))
+            strcat(cr->chain, field);
+      }
+      cr->pending = TRUE;
+      return(TRUE);
+   }
+   if(ferror(cr->in))
+      cr->error = TRUE;
+   return(FALSE);
+}
+
+
+/************************************************************************/
+/*>static BOOL CifField(char *line, int col, char *field)
+   ------------------------------------------------------
+*//**
+   \param[in]   *line    A row of an mmCIF loop
+   \param[in]   col      Column wanted (from 0)
+   \param[out]  *field   The value (without quotes)
+   \return               Was the column found?
+
+   Extracts a value from a row, allowing for quoted values
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL CifField(char *line, int col, char *field)
+{
+   char *chp = line,
+        *start,
+        quote;
+   int  i;
+
+   for(i=0; ; i++)
+   {
+      while(*chp && isspace(*chp))
+         chp++;
+      if(*chp == '\0')
+         return(FALSE);
+
+      if((*chp == '\'') || (*chp == '"'))
+      {
+         /* A quoted value ends at the quote followed by a space        */
+         quote = *chp++;
+         start = chp;
+         while(*chp && !((*chp == quote) &&
+                         ((chp[1] == '\0') || isspace(chp[1]))))
+            chp++;
+      }
+      else
+      {
+         start = chp;
+         while(*chp && !isspace(*chp))
+            chp++;
+      }
+
+      if(i == col)
+      {
+         strncpy(field, start, chp - start);
+         field[chp - start] = '\0';
+         return(TRUE);
+      }
+      if(*chp)
+         chp++;
+   }
+}
+
+
+/************************************************************************/
+/*>static BOOL AddHeaderLine(CHAINREADER *cr, char *line)
+   ------------------------------------------------------
+*//**
+   \param[in,out] *cr     Chain reader
+   \param[in]     *line   Line to add to the mmCIF header
+   \return                Success (FALSE if no memory, setting
+                          cr->error)
+
+   Adds a line to the header copied in front of each mmCIF chain
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL AddHeaderLine(CHAINREADER *cr, char *line)
+{
+   char *header;
+   int  len = (cr->header == NULL) ? 0 : strlen(cr->header);
+
+   if((header = (char *)realloc(cr->header, len + strlen(line) + 1))
+      ==NULL)
+   {
+      cr->error = TRUE;
+      return(FALSE);
+   }
+   strcpy(header + len, line);
+   cr->header = header;
+   return(TRUE);
+}
@@ -0,0 +1,226 @@
+/************************************************************************/
+/**
+
+   \file       checkpoint.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Checkpoints for resuming an interrupted database build
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   A checkpoint records how far a build through the sorted file list
+   has got: the index of the next file to process, the name of the last
+   one completed and the sizes of the output files once everything up
+   to that point had been flushed to disk. An interrupted build can
+   truncate its outputs to those sizes and carry on from the next file.
+
+   The checkpoint is a text file:
+      #LOOPDBCHECKPOINT 1
+      #PARAMS: minLength maxLength and the distance table
+      SHARD       shard nShards
+      NEXTFILE    index of the next file in the sorted list
+      LASTFILE    last file completed
+      DBSIZE      size of the text database
+      NRECORDS    records in the text database
+      COORDSSIZE  size of the coordinate file (-1 if none)
+      MFSIZE      size of the manifest (-1 if none)
+
+   It is written to a temporary file which is then renamed so that a
+   crash while checkpointing leaves the previous checkpoint intact.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define CK_HEADER     "#LOOPDBCHECKPOINT 1"
+#define CK_PARAMS     "#PARAMS: "
+#define CK_MAXLINE    (MF_MAXPARAMS + 32)
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+
+
+/************************************************************************/
+/*>BOOL SyncFile(FILE *fp)
+   -----------------------
+*//**
+   \param[in]   *fp        File pointer
+   \return                 Success
+
+   Flushes a file and waits for it to reach the disk
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL SyncFile(FILE *fp)
+{
+   if(fflush(fp) || fsync(fileno(fp)))
+      return(FALSE);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>BOOL WriteCheckpoint(char *filename, CHECKPOINT *ck)
+   ---------------------------------------------------
+*//**
+   \param[in]   *filename  Checkpoint filename
+   \param[in]   *ck        Checkpoint
+   \return                 Success
+
+   Writes a checkpoint. The output files that it describes must already
+   have been synced with SyncFile().
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL WriteCheckpoint(char *filename, CHECKPOINT *ck)
+{
+   FILE *fp;
+   char tmpFile[CK_MAXFILE+8];
+   BOOL ok = TRUE;
+
+   sprintf(tmpFile, "%s.tmp", filename);
+   if((fp = fopen(tmpFile, "w"))==NULL)
+      return(FALSE);
+
+   fprintf(fp, "%s\n", CK_HEADER);
+   fprintf(fp, "%s%s\n", CK_PARAMS, ck->params);
+   fprintf(fp, "SHARD       %d %d\n", ck->shard, ck->nShards);
+   fprintf(fp, "NEXTFILE    %ld\n", ck->nextFile);
+   fprintf(fp, "LASTFILE    %s\n", ck->lastFile);
+   fprintf(fp, "DBSIZE      %ld\n", ck->dbSize);
+   fprintf(fp, "NRECORDS    %ld\n", ck->nRecords);
+   fprintf(fp, "COORDSSIZE  %ld\n", ck->coordsSize);
+   fprintf(fp, "MFSIZE      %ld\n", ck->mfSize);
+
+   if(!SyncFile(fp))
+      ok = FALSE;
+   if(fclose(fp))
+      ok = FALSE;
+   if(ok && rename(tmpFile, filename))
+      ok = FALSE;
+   if(!ok)
+      unlink(tmpFile);
+
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>BOOL ReadCheckpoint(char *filename, CHECKPOINT *ck)
+   --------------------------------------------------
+*//**
+   \param[in]   *filename  Checkpoint filename
+   \param[out]  *ck        Checkpoint
+   \return                 Success (FALSE if it can't be read or is
+                           incomplete)
+
+   Reads a checkpoint
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL ReadCheckpoint(char *filename, CHECKPOINT *ck)
+{
+   FILE *fp;
+   char buffer[CK_MAXLINE],
+        key[CK_MAXLINE];
+   int  nFound = 0;
+   BOOL ok     = TRUE;
+
+   if((fp = fopen(filename, "r"))==NULL)
+      return(FALSE);
+
+   ck->params[0] = ck->lastFile[0] = '\0';
+   if(!fgets(buffer, CK_MAXLINE, fp) ||
+      strncmp(buffer, CK_HEADER, strlen(CK_HEADER)))
+      ok = FALSE;
+
+   while(ok && fgets(buffer, CK_MAXLINE, fp))
+   {
+      TERMINATE(buffer);
+      if(!strncmp(buffer, CK_PARAMS, strlen(CK_PARAMS)))
+      {
+         strncpy(ck->params, buffer + strlen(CK_PARAMS), MF_MAXPARAMS);
+         ck->params[MF_MAXPARAMS-1] = '\0';
+         nFound++;
+         continue;
+      }
+
+      if(sscanf(buffer, "%s", key) != 1)
+         continue;
+      if(!strcmp(key, "SHARD"))
+         ok = (sscanf(buffer, "%*s %d %d",
+                      &(ck->shard), &(ck->nShards)) == 2);
+      else if(!strcmp(key, "NEXTFILE"))
+         ok = (sscanf(buffer, "%*s %ld", &(ck->nextFile)) == 1);
+      else if(!strcmp(key, "LASTFILE"))
+         ok = (sscanf(buffer, "%*s %255s", ck->lastFile) == 1);
+      else if(!strcmp(key, "DBSIZE"))
+         ok = (sscanf(buffer, "%*s %ld", &(ck->dbSize)) == 1);
+      else if(!strcmp(key, "NRECORDS"))
+         ok = (sscanf(buffer, "%*s %ld", &(ck->nRecords)) == 1);
+      else if(!strcmp(key, "COORDSSIZE"))
+         ok = (sscanf(buffer, "%*s %ld", &(ck->coordsSize)) == 1);
+      else if(!strcmp(key, "MFSIZE"))
+         ok = (sscanf(buffer, "%*s %ld", &(ck->mfSize)) == 1);
+      else
+         continue;
+      nFound++;
+   }
+   fclose(fp);
+
+   return(ok && (nFound == 8));
+}
@@ -0,0 +1,165 @@
+/************************************************************************/
+/**
+
+   \file       dbrecord.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Reading the header and records of a text loop database
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Routines shared by the programs that read a text loop database. The
+   header is a set of comment lines, one of which gives the number of
+   residues in each stem:
+      #STEM:   3
+   Databases written before the stem size could be changed have no such
+   line and have stems of NSTEM residues.
+
+   Each record is
+      pdb startRes endRes loopLength d[0][0] d[0][1] ... d[n-1][n-1]
+   where d[i][j] is the distance from the i'th residue of the N-terminal
+   stem to the j'th of the C-terminal stem.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+
+
+/************************************************************************/
+/*>int ReadDBStemSize(FILE *dbf)
+   -----------------------------
+*//**
+   \param[in]   *dbf       Text database
+   \return                 Residues in each stem (0 if the header gives
+                           an unsupported size)
+
+   Reads the stem size from the database header. The file is rewound
+   afterwards.
+
+-  18.10.26 Original   By: ACRM
+*/
+int ReadDBStemSize(FILE *dbf)
+{
+   char buffer[DB_MAXLINE];
+   int  nStem = NSTEM;
+
+   rewind(dbf);
+   while(fgets(buffer, DB_MAXLINE, dbf))
+   {
+      if((buffer[0] != '#') && (buffer[0] != '\n'))
+         break;
+      if(!strncmp(buffer, DB_STEMTAG, strlen(DB_STEMTAG)))
+      {
+         if((sscanf(buffer+strlen(DB_STEMTAG), "%d", &nStem) != 1) ||
+            (nStem < MINSTEM) || (nStem > MAXSTEM))
+            nStem = 0;
+         break;
+      }
+   }
+   rewind(dbf);
+
+   return(nStem);
+}
+
+
+/************************************************************************/
+/*>BOOL ParseDBRecord(char *buffer, int nStem, char *pdbCode, 
+                      char *startRes, char *endRes, int *loopLen,
+                      REAL distMat[MAXSTEM][MAXSTEM])
+   ----------------------------------------------------------------
+*//**
+   \param[in]   *buffer    Database record
+   \param[in]   nStem      Residues in each stem
+   \param[out]  *pdbCode   PDB code
+   \param[out]  *startRes  First residue of the N-terminal stem
+   \param[out]  *endRes    Last residue of the C-terminal stem
+   \param[out]  *loopLen   Loop length
+   \param[out]  distMat    Takeoff distances
+   \return                 All the fields were present
+
+   Splits a database record into its fields
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL ParseDBRecord(char *buffer, int nStem, char *pdbCode, 
+                   char *startRes, char *endRes, int *loopLen,
+                   REAL distMat[MAXSTEM][MAXSTEM])
+{
+   char *chp,
+        *end;
+   int  i, j,
+        nChar = 0;
+
+   if((sscanf(buffer, "%s%s%s%d%n", pdbCode, startRes, endRes, loopLen,
+              &nChar) != 4) || !nChar)
+      return(FALSE);
+
+   chp = buffer + nChar;
+   for(i=0; i<nStem; i++)
+   {
+      for(j=0; j<nStem; j++)
+      {
+         distMat[i][j] = (REAL)strtod(chp, &end);
+         if(end == chp)
+            return(FALSE);
+         chp = end;
+      }
+   }
+   return(TRUE);
+}
@@ -0,0 +1,662 @@
+/************************************************************************/
+/**
+
+   \file       dedup.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Find repeated copies of a chain so they are analysed once
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Homo-oligomers and structures deposited more than once put the same
+   loops in the database many times. buildloopdb --dedup uses these
+   routines to drop a chain that repeats one already analysed, writing
+   an alias for it instead.
+
+   A chain is an alias of an earlier (canonical) chain if their CAs have
+   the same residue numbers, insertion codes and residue names, every
+   distance between two CAs that could be in the same record differs by
+   no more than the tolerance, and the chain breaks are in the same
+   places. The alias would then have given the records of its canonical
+   chain, with its own chain label, to within the tolerance.
+
+   That holds only for records made entirely of CAs of the chain. A
+   loop can run from one chain into the next (its last takeoff
+   residues in the next chain) when the end of one lies within bonding
+   distance of the start of the next, as when a chain has been split
+   in two. A chain linked in this way to the chain before or after it
+   is therefore never made an alias, so that the loops running into
+   and out of it are still found, though it may be the canonical chain
+   of others.
+
+   Within an entry, each chain is compared with the earlier chains of
+   the entry. Across entries, the canonical chains of earlier entries
+   are kept, indexed by an FNV-1a hash of their residues, so only chains
+   with the same sequence and numbering are compared. This keeps the CAs
+   of every canonical chain in memory.
+
+   The alias file is a text file:
+      #LOOPDBALIASES 1
+      alias<TAB>chain<TAB>canonical<TAB>chain
+      ...
+   giving the PDB code and chain label of each alias and of its
+   canonical chain. A blank chain label is written as '-'.
+
+**************************************************************************
+
+   Usage:
+   ======
+   dd = OpenDedup(aliasFile, tolerance, window, acrossEntries);
+   pdb = DedupChains(dd, pdb, pdbCode);
+   ...
+   CloseDedup(dd);
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define DD_HEADER       "#LOOPDBALIASES 1"
+#define DD_NBUCKET      65536     /* Hash buckets across entries        */
+#define DD_MAXCODE      32        /* Max length of a PDB code kept      */
+
+typedef struct
+{
+   float x, y, z;
+   int   resnum;
+   char  resnam[4],
+         insert;
+}  DDRES;
+
+struct _ddchain
+{
+   struct _ddchain *next;
+   DDRES           *res;
+   unsigned long   hash;
+   int             nRes;
+   char            pdbCode[DD_MAXCODE],
+                   chain[blMAXCHAINLABEL];
+};
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+static DDRES *ChainResidues(PDB *chain, int *nRes, unsigned long *hash);
+static BOOL  SameChain(DEDUP *dd, DDCHAIN *canon, DDRES *res, int nRes,
+                       unsigned long hash);
+static void  WriteChainLabel(FILE *fp, char *chain);
+static void  FreeDDChain(DDCHAIN *c);
+static PDB   *FirstCa(PDB *chain);
+static PDB   *LastCa(PDB *chain);
+static BOOL  Linked(PDB *ca1, PDB *ca2);
+
+
+/************************************************************************/
+/*>DEDUP *OpenDedup(char *aliasFile, REAL tolerance, int window,
+                    BOOL acrossEntries)
+   -------------------------------------------------------------
+*//**
+   \param[in]   *aliasFile      Alias file to create
+   \param[in]   tolerance       Max difference in a CA-CA distance
+   \param[in]   window          Most residues apart that two CAs in
+                                the same record can be (0 = any)
+   \param[in]   acrossEntries   Also find aliases in earlier entries
+   \return                      Deduplication state (NULL on failure)
+
+   Creates the alias file and writes its header
+
+-  18.10.26 Original   By: ACRM
+*/
+DEDUP *OpenDedup(char *aliasFile, REAL tolerance, int window,
+                 BOOL acrossEntries)
+{
+   DEDUP *dd;
+
+   if((dd = (DEDUP *)calloc(1, sizeof(DEDUP)))==NULL)
+      return(NULL);
+
+   dd->tolerance     = tolerance;
+   dd->window        = window;
+   dd->acrossEntries = acrossEntries;
+
+   if(acrossEntries &&
+      ((dd->buckets = (DDCHAIN **)calloc(DD_NBUCKET,
+                                         sizeof(DDCHAIN *)))==NULL))
+   {
+      free(dd);
+      return(NULL);
+   }
+
+   if((dd->out = fopen(aliasFile, "w"))==NULL)
+   {
+      if(dd->buckets != NULL)
+         free(dd->buckets);
+      free(dd);
+      return(NULL);
+   }
+   fprintf(dd->out, "%s\n", DD_HEADER);
+
+   return(dd);
+}
+
+
+/************************************************************************/
+/*>void NewDedupEntry(DEDUP *dd)
+   -----------------------------
+*//**
+   \param[in,out]  *dd    Deduplication state
+
+   Starts a new entry. The canonical chains of the last entry are kept
+   for comparison with later entries if aliases are being found across
+   entries, otherwise they are freed.
+
+-  18.10.26 Original   By: ACRM
+*/
+void NewDedupEntry(DEDUP *dd)
+{
+   DDCHAIN *c,
+           *next;
+
+   for(c=dd->entry; c!=NULL; c=next)
+   {
+      next = c->next;
+      if(dd->acrossEntries)
+      {
+         c->next = dd->buckets[c->hash % DD_NBUCKET];
+         dd->buckets[c->hash % DD_NBUCKET] = c;
+      }
+      else
+      {
+         FreeDDChain(c);
+      }
+   }
+   dd->entry = NULL;
+}
+
+
+/************************************************************************/
+/*>BOOL DedupChain(DEDUP *dd, PDB *chain, char *pdbCode, BOOL linked,
+                    BOOL *isAlias)
+   --------------------------------------------------------------------
+*//**
+   \param[in,out]  *dd        Deduplication state
+   \param[in]      *chain     Atoms of one chain
+   \param[in]      *pdbCode   PDB code of the entry
+   \param[in]      linked     Loops can run between the chain and the
+                              chain before or after it
+   \param[out]     *isAlias   The chain repeats a canonical chain and
+                              its alias has been written
+   \return                    Success (FALSE if no memory)
+
+   Compares a chain with the canonical chains of this entry and, if
+   aliases are being found across entries, of earlier entries with the
+   same hash. If it matches none, it becomes a canonical chain itself.
+   A linked chain is not compared but becomes a canonical chain. A
+   chain with no CAs is left alone.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL DedupChain(DEDUP *dd, PDB *chain, char *pdbCode, BOOL linked,
+                BOOL *isAlias)
+{
+   DDCHAIN       *c,
+                 *canon = NULL,
+                 *last  = NULL;
+   DDRES         *res;
+   int           nRes;
+   unsigned long hash;
+   BOOL          sameEntry = TRUE;
+
+   *isAlias = FALSE;
+   if((res = ChainResidues(chain, &nRes, &hash))==NULL)
+      return(nRes == 0);
+
+   dd->nChains++;
+   for(c=dd->entry; c!=NULL; NEXT(c))
+   {
+      last = c;
+      if(!linked && (canon == NULL) && SameChain(dd, c, res, nRes, hash))
+         canon = c;
+   }
+   if(!linked && (canon == NULL) && dd->acrossEntries)
+   {
+      sameEntry = FALSE;
+      for(c=dd->buckets[hash % DD_NBUCKET]; c!=NULL; NEXT(c))
+      {
+         if(SameChain(dd, c, res, nRes, hash))
+         {
+            canon = c;
+            break;
+         }
+      }
+   }
+
+   if(canon != NULL)
+   {
+      free(res);
+      fprintf(dd->out, "%s\t", pdbCode);
+      WriteChainLabel(dd->out, chain->chain);
+      fprintf(dd->out, "\t%s\t", canon->pdbCode);
+      WriteChainLabel(dd->out, canon->chain);
+      fprintf(dd->out, "\n");
+      if(sameEntry)
+         dd->nWithin++;
+      else
+         dd->nAcross++;
+      *isAlias = TRUE;
+      return(TRUE);
+   }
+
+   /* Keep it as a canonical chain, in the order they were found       */
+   if((c = (DDCHAIN *)malloc(sizeof(DDCHAIN)))==NULL)
+   {
+      free(res);
+      return(FALSE);
+   }
+   c->next = NULL;
+   c->res  = res;
+   c->nRes = nRes;
+   c->hash = hash;
+   strncpy(c->pdbCode, pdbCode, DD_MAXCODE-1);
+   c->pdbCode[DD_MAXCODE-1] = '\0';
+   strcpy(c->chain, chain->chain);
+   if(last == NULL)
+      dd->entry  = c;
+   else
+      last->next = c;
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>PDB *DedupChains(DEDUP *dd, PDB *pdb, char *pdbCode)
+   ----------------------------------------------------
+*//**
+   \param[in,out]  *dd        Deduplication state
+   \param[in]      *pdb       Atoms of a new entry
+   \param[in]      *pdbCode   PDB code of the entry
+   \return                    The atoms with the aliased chains removed
+                              (NULL if every chain was an alias)
+
+   Starts a new entry and passes each chain to DedupChain(), freeing
+   the atoms of the chains that are aliases. A chain is linked if its
+   first CA lies within bonding distance of the last CA of the chain
+   before it, or its last CA of the first CA of the chain after it.
+   dd->error is set if there was no memory, in which case the chains
+   not yet compared are kept.
+
+-  18.10.26 Original   By: ACRM
+*/
+PDB *DedupChains(DEDUP *dd, PDB *pdb, char *pdbCode)
+{
+   PDB  *start,
+        *end,
+        *nextChain,
+        *kept   = NULL,
+        *lastCa = NULL,
+        prevCa;
+   BOOL isAlias,
+        linked;
+
+   NewDedupEntry(dd);
+
+   for(start=pdb; start!=NULL; start=nextChain)
+   {
+      /* Cut the chain from the list                                    */
+      for(end=start;
+          (end->next!=NULL) && CHAINMATCH(end->next->chain, start->chain);
+          NEXT(end))
+         ;
+      nextChain = end->next;
+      end->next = NULL;
+
+      /* The chain before may have been freed, so its last CA is kept  */
+      linked = Linked(lastCa, FirstCa(start)) ||
+               Linked(LastCa(start), FirstCa(nextChain));
+      if((lastCa = LastCa(start)) != NULL)
+      {
+         prevCa = *lastCa;
+         lastCa = &prevCa;
+      }
+
+      if(!DedupChain(dd, start, pdbCode, linked, &isAlias))
+      {
+         dd->error = TRUE;
+         end->next = nextChain;
+         if(kept == NULL)
+            pdb = start;
+         else
+            kept->next = start;
+         return(pdb);
+      }
+
+      if(isAlias)
+      {
+         FREELIST(start, PDB);
+      }
+      else
+      {
+         if(kept == NULL)
+            pdb = start;
+         else
+            kept->next = start;
+         kept = end;
+      }
+   }
+
+   if(kept == NULL)
+      return(NULL);
+   kept->next = NULL;
+   return(pdb);
+}
+
+
+/************************************************************************/
+/*>BOOL CloseDedup(DEDUP *dd)
+   --------------------------
+*//**
+   \param[in]   *dd    Deduplication state (freed)
+   \return             The alias file was written successfully
+
+   Closes the alias file and frees all the canonical chains
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL CloseDedup(DEDUP *dd)
+{
+   DDCHAIN *c,
+           *next;
+   BOOL    ok;
+   int     i;
+
+   dd->acrossEntries = FALSE;
+   NewDedupEntry(dd);
+   if(dd->buckets != NULL)
+   {
+      for(i=0; i<DD_NBUCKET; i++)
+      {
+         for(c=dd->buckets[i]; c!=NULL; c=next)
+         {
+            next = c->next;
+            FreeDDChain(c);
+         }
+      }
+      free(dd->buckets);
+   }
+
+   ok = (fclose(dd->out) == 0);
+   free(dd);
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>static DDRES *ChainResidues(PDB *chain, int *nRes,
+                               unsigned long *hash)
+   ---------------------------------------------------
+*//**
+   \param[in]   *chain    Atoms of one chain
+   \param[out]  *nRes     Number of CAs
+   \param[out]  *hash     FNV-1a hash of the residue numbers, insertion
+                          codes and names
+   \return                The CAs (NULL if there are none or no memory)
+
+   Extracts the CAs of a chain (the atoms named CA as selected by
+   blSelectCaPDB())
+
+-  18.10.26 Original   By: ACRM
+*/
+static DDRES *ChainResidues(PDB *chain, int *nRes, unsigned long *hash)
+{
+   PDB   *p;
+   DDRES *res;
+   int   i,
+         n = 0;
+
+   *nRes = 0;
+   *hash = 14695981039346656037UL;
+
+   for(p=chain; p!=NULL; NEXT(p))
+   {
+      if(!strncmp(p->atnam, "CA  ", 4))
+         n++;
+   }
+   if(n == 0)
+      return(NULL);
+   if((res = (DDRES *)malloc(n * sizeof(DDRES)))==NULL)
+   {
+      *nRes = n;
+      return(NULL);
+   }
+
+   for(p=chain, n=0; p!=NULL; NEXT(p))
+   {
+      if(!strncmp(p->atnam, "CA  ", 4))
+      {
+         res[n].x      = (float)p->x;
+         res[n].y      = (float)p->y;
+         res[n].z      = (float)p->z;
+         res[n].resnum = p->resnum;
+         res[n].insert = p->insert[0];
+         memcpy(res[n].resnam, p->resnam, 4);
+
+         for(i=0; i<4; i++)
+         {
+            *hash ^= (unsigned char)res[n].resnam[i];
+            *hash *= 1099511628211UL;
+            *hash ^= (unsigned char)((res[n].resnum >> (8*i)) & 0xff);
+            *hash *= 1099511628211UL;
+         }
+         *hash ^= (unsigned char)res[n].insert;
+         *hash *= 1099511628211UL;
+         n++;
+      }
+   }
+   *nRes = n;
+   return(res);
+}
+
+
+/************************************************************************/
+/*>static BOOL SameChain(DEDUP *dd, DDCHAIN *canon, DDRES *res,
+                         int nRes, unsigned long hash)
+   ----------------------------------------------------------------
+*//**
+   \param[in]   *dd      Deduplication state
+   \param[in]   *canon   A canonical chain
+   \param[in]   *res     CAs of the chain being checked
+   \param[in]   nRes     Number of CAs
+   \param[in]   hash     Hash of the chain being checked
+   \return               The chain is an alias of canon
+
+   Checks that the residues are the same and that every CA-CA distance
+   within dd->window residues agrees to within dd->tolerance, with the
+   same chain breaks
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL SameChain(DEDUP *dd, DDCHAIN *canon, DDRES *res, int nRes,
+                      unsigned long hash)
+{
+   DDRES  *a = canon->res,
+          *b = res;
+   int    i, j,
+          last;
+   double dA, dB;
+
+   if((canon->nRes != nRes) || (canon->hash != hash))
+      return(FALSE);
+
+   for(i=0; i<nRes; i++)
+   {
+      if((a[i].resnum != b[i].resnum) || (a[i].insert != b[i].insert) ||
+         strncmp(a[i].resnam, b[i].resnam, 4))
+         return(FALSE);
+   }
+
+   for(i=0; i<nRes; i++)
+   {
+      last = ((dd->window > 0) && (i + dd->window < nRes)) ?
+             (i + dd->window) : nRes;
+      for(j=i+1; j<last; j++)
+      {
+         dA = DISTSQ(&(a[i]), &(a[j]));
+         dB = DISTSQ(&(b[i]), &(b[j]));
+         if((j == i+1) &&
+            ((dA > MAX_CA_CA_DISTANCE_SQ) != (dB > MAX_CA_CA_DISTANCE_SQ)))
+            return(FALSE);
+         if(ABS(sqrt(dA) - sqrt(dB)) > dd->tolerance)
+            return(FALSE);
+      }
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static void WriteChainLabel(FILE *fp, char *chain)
+   --------------------------------------------------
+*//**
+   \param[in]   *fp      Alias file
+   \param[in]   *chain   Chain label
+
+   Writes a chain label, or '-' if it is blank
+
+-  18.10.26 Original   By: ACRM
+*/
+static void WriteChainLabel(FILE *fp, char *chain)
+{
+   char *chp;
+
+   for(chp=chain; *chp==' '; chp++)
+      ;
+   fprintf(fp, "%s", (*chp)?chain:"-");
+}
+
+
+/************************************************************************/
+/*>static void FreeDDChain(DDCHAIN *c)
+   -----------------------------------
+*//**
+   \param[in]   *c     Canonical chain (freed)
+
+-  18.10.26 Original   By: ACRM
+*/
+static void FreeDDChain(DDCHAIN *c)
+{
+   free(c->res);
+   free(c);
+}
+
+
+/************************************************************************/
+/*>static PDB *FirstCa(PDB *chain)
+   -------------------------------
+*//**
+   \param[in]   *chain   Atoms of a chain (or NULL), continuing into the
+                         next chains
+   \return               The first CA of the chain (NULL if none)
+
+-  18.10.26 Original   By: ACRM
+*/
+static PDB *FirstCa(PDB *chain)
+{
+   PDB *p;
+
+   for(p=chain; (p!=NULL) && CHAINMATCH(p->chain, chain->chain); NEXT(p))
+   {
+      if(!strncmp(p->atnam, "CA  ", 4))
+         return(p);
+   }
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>static PDB *LastCa(PDB *chain)
+   ------------------------------
+*//**
+   \param[in]   *chain   Atoms of a chain, cut from the list
+   \return               The last CA of the chain (NULL if none)
+
+-  18.10.26 Original   By: ACRM
+*/
+static PDB *LastCa(PDB *chain)
+{
+   PDB *p,
+       *ca = NULL;
+
+   for(p=chain; p!=NULL; NEXT(p))
+   {
+      if(!strncmp(p->atnam, "CA  ", 4))
+         ca = p;
+   }
+   return(ca);
+}
+
+
+/************************************************************************/
+/*>static BOOL Linked(PDB *ca1, PDB *ca2)
+   --------------------------------------
+*//**
+   \param[in]   *ca1   Last CA of a chain (or NULL)
+   \param[in]   *ca2   First CA of the next chain (or NULL)
+   \return             The CAs are within bonding distance, as judged
+                       by buildloopdb, so loops can run between the
+                       chains
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL Linked(PDB *ca1, PDB *ca2)
+{
+   if((ca1 == NULL) || (ca2 == NULL))
+      return(FALSE);
+   return(DISTSQ(ca1, ca2) <= MAX_CA_CA_DISTANCE_SQ);
+}
@@ -0,0 +1,174 @@
+/************************************************************************/
+/**
+
+   \file       disttable.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Takeoff distance ranges used to select loops
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Sets up the tables of minimum and maximum takeoff distances that a
+   loop must satisfy, either from the means and standard deviations in
+   distances.h or from a user-supplied table. Shared by buildloopdb and
+   mergeloopdb, which must use the same ranges for the sidecar scale.
+
+   The defaults in distances.h are for stems of NSTEM residues; other
+   stem sizes need a table.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original, split out of buildloopdb.c   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXBUFF 160
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+
+
+/************************************************************************/
+/*>BOOL ReadDistanceTable(char *distTable, int nStem,
+                          REAL minTable[MAXSTEM][MAXSTEM], 
+                          REAL maxTable[MAXSTEM][MAXSTEM])
+   ------------------------------------------------------------
+*//**
+   \param[in]   *distTable    Distance table filename
+   \param[in]   nStem         Residues in each stem
+   \param[out]  minTable[][]  table of minimum distances
+   \param[out]  maxTable[][]  table of maximum distances
+   \return                    Table read with exactly nStem*nStem
+                              min/max pairs
+
+   Reads a user-specified distance matrix table instead of using the
+   defaults coded in distances.h. The pairs are given row by row
+   (n0-c0, n0-c1, ... n1-c0, ...).
+
+-  14.07.15 Original   By: ACRM
+-  18.10.26 Moved from buildloopdb.c
+-  18.10.26 Takes the stem size and returns success
+*/
+BOOL ReadDistanceTable(char *distTable, int nStem,
+                       REAL minTable[MAXSTEM][MAXSTEM],
+                       REAL maxTable[MAXSTEM][MAXSTEM])
+{
+   FILE *fp = NULL;
+   char buffer[MAXBUFF];
+   int  i = 0,
+        j = 0;
+   BOOL ok = TRUE;
+   
+   if((fp=fopen(distTable, "r"))==NULL)
+      return(FALSE);
+
+   while(fgets(buffer, MAXBUFF, fp))
+   {
+      char *chp;
+      TERMINATE(buffer);
+      if((chp = strchr(buffer, '#'))!=NULL)
+         *chp = '\0';
+      KILLTRAILSPACES(buffer);
+      if(strlen(buffer))
+      {
+         if((i >= nStem) ||
+            (sscanf(buffer,"%lf %lf", 
+                    &(minTable[i][j]), &(maxTable[i][j])) != 2))
+         {
+            ok = FALSE;
+            break;
+         }
+         if((++j)==nStem)
+         {
+            j=0;
+            i++;
+         }
+      }
+   }
+   fclose(fp);
+
+   return(ok && (i == nStem));
+}
+
+
+/************************************************************************/
+/*>void SetUpMinMaxTables(REAL minTable[MAXSTEM][MAXSTEM], 
+                          REAL maxTable[MAXSTEM][MAXSTEM])
+   ----------------------------------------------------------
+*//**
+   \param[out]  minTable[][]  table of minimum distances
+   \param[out]  maxTable[][]  table of maximum distances
+
+   Initializes the minimum and maximum distance matrices based on
+   mean and standard deviation distances in distances.h. These are
+   for stems of NSTEM residues.
+
+-  15.07.15 Original   By: ACRM
+-  18.10.26 Moved from buildloopdb.c
+-  18.10.26 Tables are MAXSTEM x MAXSTEM
+*/
+void SetUpMinMaxTables(REAL minTable[MAXSTEM][MAXSTEM], 
+                       REAL maxTable[MAXSTEM][MAXSTEM])
+{
+   int i, j;
+
+   #include "distances.h"
+
+   for(i=0; i<NSTEM; i++)
+   {
+      for(j=0; j<NSTEM; j++)
+      {
+         minTable[i][j] = means[i][j] - sdMult * sds[i][j];
+         maxTable[i][j] = means[i][j] + sdMult * sds[i][j];
+      }
+   }
+}
@@ -0,0 +1,522 @@
+/************************************************************************/
+/**
+
+   \file       exptl.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Experimental method, resolution and R-factor of an entry
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Lets buildloopdb reject entries by experimental method, resolution
+   and R-factor before their atoms are read, and lets scanloopdb apply
+   the same filters to records carrying these values.
+
+   ReadExptl() reads the header of a PDB file (EXPDTA, REMARK 2
+   RESOLUTION and the REMARK 3 working set R value) or the items of an
+   mmCIF file before the atom_site loop (_exptl.method,
+   _refine.ls_d_res_high or _em_3d_reconstruction.resolution, and
+   _refine.ls_R_factor_R_work or _refine.ls_R_factor_obs). A resolution
+   or R-factor of zero means that it was not given.
+
+   A database built with these details has the header line
+      #EXPTL:  1
+   and each record then ends with the method (as named by
+   ExptlMethodName()), the resolution and the R-factor of the entry.
+
+**************************************************************************
+
+   Usage:
+   ======
+   if(ReadExptl(fp, &exptl) && ExptlPasses(&exptl, &filter)) ...
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define EX_MAXLINE    1024
+
+/************************************************************************/
+/* Globals
+*/
+static char *sMethodNames[NEXPTLMETHOD] =
+{
+   "UNKNOWN", "XRAY", "NMR", "EM", "NEUTRON", "ELECTDIFF", "FIBER",
+   "MODEL", "OTHER"
+};
+
+/************************************************************************/
+/* Prototypes
+*/
+static int  MethodFromText(char *text);
+static void ReadPDBExptl(FILE *in, char *line, EXPTL *exptl);
+static void ReadCifExptl(FILE *in, EXPTL *exptl);
+static BOOL CifItem(FILE *in, char *line, char *item, char *value);
+static REAL ExptlValue(char *text);
+
+
+/************************************************************************/
+/*>BOOL ReadExptl(FILE *in, EXPTL *exptl)
+   --------------------------------------
+*//**
+   \param[in]   *in       PDB or mmCIF file
+   \param[out]  *exptl    Experimental method, resolution and R-factor
+   \return                Success (FALSE if the file can't be returned
+                          to where it was)
+
+   Reads the experimental details from the header, stopping at the
+   first coordinate record. An entry without an EXPDTA record that
+   gives a resolution is taken to be X-ray. The file is left where it
+   started.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL ReadExptl(FILE *in, EXPTL *exptl)
+{
+   char line[EX_MAXLINE];
+   long start;
+
+   exptl->method     = EX_UNKNOWN;
+   exptl->resolution = exptl->rFactor = (REAL)0.0;
+
+   if((start = ftell(in)) < 0L)
+      return(FALSE);
+
+   if(fgets(line, EX_MAXLINE, in) != NULL)
+   {
+      if(!strncmp(line, "data_", 5))
+         ReadCifExptl(in, exptl);
+      else
+         ReadPDBExptl(in, line, exptl);
+   }
+
+   if((exptl->method == EX_UNKNOWN) && (exptl->resolution > 0.0))
+      exptl->method = EX_XRAY;
+
+   return(fseek(in, start, SEEK_SET) == 0);
+}
+
+
+/************************************************************************/
+/*>BOOL ExptlPasses(EXPTL *exptl, EXPTLFILTER *filter)
+   ---------------------------------------------------
+*//**
+   \param[in]   *exptl    Experimental details of an entry
+   \param[in]   *filter   Thresholds (0 for no limit)
+   \return                Does the entry pass?
+
+   An entry with no resolution or R-factor fails a limit on it
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL ExptlPasses(EXPTL *exptl, EXPTLFILTER *filter)
+{
+   if(filter->xray && (exptl->method != EX_XRAY))
+      return(FALSE);
+   if(filter->noNMR && (exptl->method == EX_NMR))
+      return(FALSE);
+   if((filter->maxResolution > 0.0) &&
+      ((exptl->resolution <= 0.0) ||
+       (exptl->resolution > filter->maxResolution)))
+      return(FALSE);
+   if((filter->maxRFactor > 0.0) &&
+      ((exptl->rFactor <= 0.0) ||
+       (exptl->rFactor > filter->maxRFactor)))
+      return(FALSE);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>char *ExptlMethodName(int method)
+   ---------------------------------
+*//**
+   \param[in]   method    EX_ method code
+   \return                Name used in database records
+
+-  18.10.26 Original   By: ACRM
+*/
+char *ExptlMethodName(int method)
+{
+   if((method < 0) || (method >= NEXPTLMETHOD))
+      method = EX_UNKNOWN;
+   return(sMethodNames[method]);
+}
+
+
+/************************************************************************/
+/*>int ExptlMethodCode(char *name)
+   -------------------------------
+*//**
+   \param[in]   *name     Name used in database records
+   \return                EX_ method code (EX_UNKNOWN if not known)
+
+-  18.10.26 Original   By: ACRM
+*/
+int ExptlMethodCode(char *name)
+{
+   int i;
+
+   for(i=0; i<NEXPTLMETHOD; i++)
+   {
+      if(!strcmp(name, sMethodNames[i]))
+         return(i);
+   }
+   return(EX_UNKNOWN);
+}
+
+
+/************************************************************************/
+/*>BOOL ReadDBExptl(FILE *dbf)
+   ---------------------------
+*//**
+   \param[in]   *dbf       Text database
+   \return                 Do the records give the experimental
+                           details?
+
+   Looks for the DB_EXPTLTAG line in the database header. The file is
+   rewound afterwards.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL ReadDBExptl(FILE *dbf)
+{
+   char buffer[DB_MAXLINE];
+   BOOL exptl = FALSE;
+
+   rewind(dbf);
+   while(fgets(buffer, DB_MAXLINE, dbf))
+   {
+      if((buffer[0] != '#') && (buffer[0] != '\n'))
+         break;
+      if(!strncmp(buffer, DB_EXPTLTAG, strlen(DB_EXPTLTAG)))
+      {
+         exptl = TRUE;
+         break;
+      }
+   }
+   rewind(dbf);
+
+   return(exptl);
+}
+
+
+/************************************************************************/
+/*>BOOL ParseDBExptl(char *buffer, int nStem, EXPTL *exptl)
+   --------------------------------------------------------
+*//**
+   \param[in]   *buffer    Database record
+   \param[in]   nStem      Residues in each stem
+   \param[out]  *exptl     Experimental details of the entry
+   \return                 Were the details present?
+
+   Gets the experimental details from the end of a record in a
+   database whose header has the DB_EXPTLTAG line
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL ParseDBExptl(char *buffer, int nStem, EXPTL *exptl)
+{
+   char   method[DB_MAXLINE];
+   double resolution,
+          rFactor;
+   int    i,
+          nChar = 0;
+
+   /* Skip the PDB code, residues, length and distances                 */
+   for(i=0; i<4+nStem*nStem; i++)
+   {
+      if((sscanf(buffer, "%*s%n", &nChar) == EOF) || !nChar)
+         return(FALSE);
+      buffer += nChar;
+      nChar   = 0;
+   }
+
+   if(sscanf(buffer, "%s%lf%lf", method, &resolution, &rFactor) != 3)
+      return(FALSE);
+   exptl->method     = ExptlMethodCode(method);
+   exptl->resolution = (REAL)resolution;
+   exptl->rFactor    = (REAL)rFactor;
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static int MethodFromText(char *text)
+   -------------------------------------
+*//**
+   \param[in]   *text     EXPDTA text or _exptl.method value
+   \return                EX_ method code
+
+   Works out the method from the wording used by the PDB. Only the
+   first of several methods is used.
+
+-  18.10.26 Original   By: ACRM
+*/
+static int MethodFromText(char *text)
+{
+   char method[EX_MAXLINE],
+        *chp;
+   int  i;
+
+   for(i=0; text[i] && (text[i] != ';') && (i < EX_MAXLINE-1); i++)
+      method[i] = (char)toupper(text[i]);
+   method[i] = '\0';
+
+   if(strstr(method, "X-RAY") != NULL)
+      return(EX_XRAY);
+   if(strstr(method, "NMR") != NULL)
+      return(EX_NMR);
+   if(((chp = strstr(method, "ELECTRON")) != NULL) &&
+      (strstr(chp, "MICROSCOPY") != NULL))
+      return(EX_EM);
+   if(strstr(method, "CRYO") != NULL)
+      return(EX_EM);
+   if(strstr(method, "NEUTRON") != NULL)
+      return(EX_NEUTRON);
+   if(strstr(method, "ELECTRON") != NULL)
+      return(EX_ELECTDIFF);
+   if(strstr(method, "FIBER") != NULL)
+      return(EX_FIBER);
+   if(strstr(method, "MODEL") != NULL)
+      return(EX_MODEL);
+   for(chp=method; *chp; chp++)
+   {
+      if(!isspace(*chp))
+         return(EX_OTHER);
+   }
+   return(EX_UNKNOWN);
+}
+
+
+/************************************************************************/
+/*>static void ReadPDBExptl(FILE *in, char *line, EXPTL *exptl)
+   ------------------------------------------------------------
+*//**
+   \param[in]   *in       PDB file
+   \param[in]   *line     First line of the file (used as a buffer)
+   \param[out]  *exptl    Experimental details
+
+   Reads the EXPDTA record, the resolution from REMARK 2 and the
+   working set R value from REMARK 3 (or the working + test set value
+   if that is all there is)
+
+-  18.10.26 Original   By: ACRM
+*/
+static void ReadPDBExptl(FILE *in, char *line, EXPTL *exptl)
+{
+   char *chp;
+   BOOL gotWork = FALSE;
+
+   do
+   {
+      if(!strncmp(line, "ATOM  ", 6) || !strncmp(line, "HETATM", 6) ||
+         !strncmp(line, "MODEL ", 6))
+         break;
+
+      if(!strncmp(line, "EXPDTA", 6) && (exptl->method == EX_UNKNOWN))
+      {
+         exptl->method = MethodFromText(line+6);
+      }
+      else if(!strncmp(line, "REMARK   2 RESOLUTION.", 22))
+      {
+         exptl->resolution = ExptlValue(line+22);
+      }
+      else if(!strncmp(line, "REMARK   3", 10) && !gotWork)
+      {
+         for(chp=line+10; *chp == ' '; chp++)
+            ;
+         if(!strncmp(chp, "R VALUE", 7) &&
+            ((chp = strchr(chp, ':')) != NULL))
+         {
+            if(strstr(line, "(WORKING SET)") != NULL)
+            {
+               exptl->rFactor = ExptlValue(chp+1);
+               gotWork        = TRUE;
+            }
+            else if(exptl->rFactor <= 0.0)
+            {
+               exptl->rFactor = ExptlValue(chp+1);
+            }
+         }
+      }
+   }  while(fgets(line, EX_MAXLINE, in) != NULL);
+}
+
+
+/************************************************************************/
+/*>static void ReadCifExptl(FILE *in, EXPTL *exptl)
+   ------------------------------------------------
+*//**
+   \param[in]   *in       mmCIF file just after the data_ line
+   \param[out]  *exptl    Experimental details
+
+   Reads the experimental items given as item/value pairs before the
+   atom_site loop. Items in loops (such as a list of several methods)
+   are not read.
+
+-  18.10.26 Original   By: ACRM
+*/
+static void ReadCifExptl(FILE *in, EXPTL *exptl)
+{
+   char line[EX_MAXLINE],
+        value[EX_MAXLINE];
+   REAL rObs  = (REAL)0.0,
+        emRes = (REAL)0.0;
+   BOOL inLoop = FALSE;
+
+   while(fgets(line, EX_MAXLINE, in) != NULL)
+   {
+      if(!strncmp(line, "loop_", 5))
+      {
+         inLoop = TRUE;
+         continue;
+      }
+      if(line[0] != '_')
+      {
+         inLoop = FALSE;
+         continue;
+      }
+      if(!strncmp(line, "_atom_site.", 11))
+         break;
+      if(inLoop)
+         continue;
+
+      if(CifItem(in, line, "_exptl.method", value))
+         exptl->method = MethodFromText(value);
+      else if(CifItem(in, line, "_refine.ls_d_res_high", value))
+         exptl->resolution = ExptlValue(value);
+      else if(CifItem(in, line, "_em_3d_reconstruction.resolution",
+                      value))
+         emRes = ExptlValue(value);
+      else if(CifItem(in, line, "_refine.ls_R_factor_R_work", value))
+         exptl->rFactor = ExptlValue(value);
+      else if(CifItem(in, line, "_refine.ls_R_factor_obs", value))
+         rObs = ExptlValue(value);
+   }
+
+   if(exptl->resolution <= 0.0)
+      exptl->resolution = emRes;
+   if(exptl->rFactor <= 0.0)
+      exptl->rFactor = rObs;
+}
+
+
+/************************************************************************/
+/*>static BOOL CifItem(FILE *in, char *line, char *item, char *value)
+   ------------------------------------------------------------------
+*//**
+   \param[in]   *in       mmCIF file
+   \param[in]   *line     Line starting with an item name
+   \param[in]   *item     Item wanted
+   \param[out]  *value    Its value (without quotes)
+   \return                Is this the item wanted?
+
+   Gets the value of an item, which may be on the same line or on the
+   next (quoted or as a semicolon text field)
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL CifItem(FILE *in, char *line, char *item, char *value)
+{
+   char next[EX_MAXLINE],
+        *chp,
+        *end;
+   int  len = strlen(item);
+
+   if(strncmp(line, item, len) || !isspace(line[len]))
+      return(FALSE);
+
+   for(chp=line+len; *chp && isspace(*chp); chp++)
+      ;
+   if(*chp == '\0')
+   {
+      if(fgets(next, EX_MAXLINE, in) == NULL)
+         return(FALSE);
+      chp = next;
+      if(*chp == ';')
+         chp++;
+      while(*chp && isspace(*chp))
+         chp++;
+   }
+
+   if((*chp == '\'') || (*chp == '"'))
+   {
+      if((end = strchr(chp+1, *chp)) == NULL)
+         end = chp + strlen(chp);
+      chp++;
+   }
+   else
+   {
+      /* An unquoted value runs to the end of the line (as in a text
+         field)
+      */
+      end = chp + strlen(chp);
+   }
+   strncpy(value, chp, end - chp);
+   value[end - chp] = '\0';
+   KILLTRAILSPACES(value);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static REAL ExptlValue(char *text)
+   ----------------------------------
+*//**
+   \param[in]   *text     Text starting with a number
+   \return                The number (0 if it is missing, NULL or ?)
+
+-  18.10.26 Original   By: ACRM
+*/
+static REAL ExptlValue(char *text)
+{
+   double value;
+
+   if(sscanf(text, "%lf", &value) != 1)
+      return((REAL)0.0);
+   return((REAL)((value > 0.0) ? value : 0.0));
+}
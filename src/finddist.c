@@ -2,13 +2,14 @@
 /**
 
    \file       finddist.c
-   
-   \version    V1.0
-   \date       15.07.15
-   \brief      A quick routine to find the distance matrix for a given
-               PDB file. Not designed to be used by the end user
-   
-   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 1988-2015
+
+   \version    V2.0
+   \date       18.10.26
+   \brief      Finds the takeoff distance matrix for a set of PDB files
+               and the statistics used for distances.h. Not designed
+               to be used by the end user
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 1988-2026
    \author     Dr. Andrew C. R. Martin
    \par
                Institute of Structural & Molecular Biology,
@@ -19,7 +20,7 @@
    \par
                andrew@bioinf.org.uk
                andrew.martin@ucl.ac.uk
-               
+
 **************************************************************************
 
    This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
@@ -29,16 +30,25 @@
    The code may be modified as required, but any modifications must be
    documented so that the person responsible can be identified.
 
-   The code may not be sold commercially or included as part of a 
+   The code may not be sold commercially or included as part of a
    commercial product except as described in the file COPYING.DOC.
 
 **************************************************************************
 
    Description:
    ============
-   This is a very quick routine to calculate the distance matrix for the
-   takeoff region around CDR-H3. It is designed to be used only by
-   makedistances.pl with input from a numbered antibody file.
+   Calculates the distance matrix between the N- and C-terminal key
+   residues (by default the takeoff region around CDR-H3) for each of
+   a set of numbered antibody files. Directories are expanded to all
+   the files they contain.
+
+   By default one line of distances is printed for each file. With -H
+   the mean and standard deviation of each distance are written in the
+   form of distances.h and with -T the mean +/- sdMult SDs are written
+   as a distance table for buildloopdb -t. The files are read by a pool
+   of threads and the statistics are accumulated in a single pass
+   (Welford's method) in the order the files were given, so the output
+   doesn't depend on the number of threads.
 
 **************************************************************************
 
@@ -50,18 +60,55 @@
    Revision History:
    =================
    V1.0   15.07.15  Original   By: ACRM
+   V2.0   18.10.26  Handles many files and directories using threads.
+                    Key residues may be given with -n and -c. Writes
+                    distances.h (-H) or a distance table (-T) directly
+                    rather than via makedistances.pl
 
 *************************************************************************/
 /* Includes
 */
+#define _POSIX_C_SOURCE 200112L
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
 #include "bioplib/pdb.h"
+#include "bioplib/macros.h"
+#include "loopdb.h"
 
 /************************************************************************/
 /* Defines and macros
 */
+#define MAXBUFF     1024
+#define DEF_SDMULT  2.0
+#define DEF_KEYRESN "H92,H93,H94"
+#define DEF_KEYRESC "H103,H104,H105"
+
+#define OUT_LINES   0         /* One line of distances per file         */
+#define OUT_HEADER  1         /* distances.h                            */
+#define OUT_TABLE   2         /* Distance table for buildloopdb -t      */
+
+/************************************************************************/
+/* Structure definitions
+*/
+typedef struct
+{
+   char **files,
+        **keyResN,
+        **keyResC;
+   REAL *dists;               /* nStem*nStem distances for each file    */
+   BOOL *found;               /* All key residues found in each file    */
+   int  nFiles,
+        nStem,
+        nThreads,
+        thread;
+}  DISTJOB;
 
 /************************************************************************/
 /* Globals
@@ -70,6 +117,26 @@
 /************************************************************************/
 /* Prototypes
 */
+int  main(int argc, char **argv);
+BOOL ParseCmdLine(int argc, char **argv, char *keyListN, char *keyListC,
+                  int *nThreads, int *outMode, REAL *sdMult,
+                  int *firstFile);
+void Usage(void);
+int  SplitKeyResidues(char *keyList, char **keyRes);
+char **ListFiles(char **args, int nArgs, int *nFiles);
+static int cmpFilenames(const void *p1, const void *p2);
+void CalcAllDistances(DISTJOB *job);
+static void *DistThread(void *arg);
+BOOL CalcFileDistances(char *filename, char **keyResN, char **keyResC,
+                       int nStem, REAL *dists);
+void CalcStatistics(REAL *dists, BOOL *found, int nFiles, int nStem,
+                    REAL *means, REAL *sds, int *nUsed);
+void WriteDistancesHeader(FILE *out, REAL *means, REAL *sds, int nStem,
+                          REAL sdMult);
+void WriteDistanceTable(FILE *out, REAL *means, REAL *sds, int nStem,
+                        REAL sdMult, char **keyResN, char **keyResC,
+                        int nUsed);
+
 
 /************************************************************************/
 /*>int main(int argc, char **argv)
@@ -77,75 +144,700 @@
 *//**
    Main program
 
-   15.07.15   Original   By: ACRM
+-  15.07.15 Original   By: ACRM
+-  18.10.26 Handles many files with threads and writes the statistics
 */
 int main(int argc, char **argv)
 {
-   FILE *fp;
-   char *keyResN[] = {"H92",  "H93",  "H94"};
-   char *keyResC[] = {"H103", "H104", "H105"};
-   PDB *pdb, *pN[3], *pC[3];
-   int i, j;
+   char    keyListN[MAXBUFF],
+           keyListC[MAXBUFF],
+           *keyResN[MAXSTEM],
+           *keyResC[MAXSTEM],
+           **files;
+   REAL    means[MAXDIST],
+           sds[MAXDIST],
+           sdMult   = DEF_SDMULT;
+   DISTJOB job;
+   int     nThreads = 0,
+           outMode  = OUT_LINES,
+           firstFile,
+           nFiles,
+           nStem,
+           nUsed,
+           i, j;
 
-   if((argc < 2) || (!strncmp(argv[1], "-h", 2)))
+   if(!ParseCmdLine(argc, argv, keyListN, keyListC, &nThreads, &outMode,
+                    &sdMult, &firstFile))
    {
-      fprintf(stderr,"\nUsage: finddist file.pdb\n");
-      fprintf(stderr,"\nThis code is designed to be called by \
-makedistances.pl\n\n");
+      Usage();
       return(1);
    }
-   
-   if((fp = fopen(argv[1], "r"))!=NULL)
+
+   nStem = SplitKeyResidues(keyListN, keyResN);
+   if((nStem < MINSTEM) ||
+      (SplitKeyResidues(keyListC, keyResC) != nStem))
    {
-      int natoms;
-      
-      if((pdb=blReadPDB(fp, &natoms))!=NULL)
+      fprintf(stderr,"Error (finddist): Give the same number (%d-%d) of \
+N- and C-terminal\n", MINSTEM, MAXSTEM);
+      fprintf(stderr,"                  key residues\n");
+      return(1);
+   }
+   if((outMode == OUT_HEADER) && (nStem != NSTEM))
+   {
+      fprintf(stderr,"Error (finddist): distances.h is for stems of %d \
+residues; use -T\n", NSTEM);
+      return(1);
+   }
+
+   if((files = ListFiles(argv+firstFile, argc-firstFile, &nFiles))==NULL)
+   {
+      fprintf(stderr,"Error (finddist): No files to read\n");
+      return(1);
+   }
+
+   job.files    = files;
+   job.nFiles   = nFiles;
+   job.keyResN  = keyResN;
+   job.keyResC  = keyResC;
+   job.nStem    = nStem;
+   job.nThreads = nThreads;
+   job.dists    = (REAL *)malloc(nFiles * nStem * nStem * sizeof(REAL));
+   job.found    = (BOOL *)malloc(nFiles * sizeof(BOOL));
+   if((job.dists == NULL) || (job.found == NULL))
+   {
+      fprintf(stderr,"Error (finddist): No memory for distances\n");
+      return(1);
+   }
+
+   CalcAllDistances(&job);
+
+   if(outMode == OUT_LINES)
+   {
+      for(i=0; i<nFiles; i++)
       {
-         if((pdb=blSelectCaPDB(pdb))!=NULL)
+         if(job.found[i])
          {
-            for(i=0; i<3; i++)
-            {
-               if((pN[i] = blFindResidueSpec(pdb, keyResN[i]))==NULL)
-               {
-                  fprintf(stderr,"Residue not found: %s (%s)\n",
-                          keyResN[i], argv[1]);
-                  return(1);
-               }
-               if((pC[i] = blFindResidueSpec(pdb, keyResC[i]))==NULL)
-               {
-                  fprintf(stderr,"Residue not found: %s (%s)\n",
-                          keyResC[i], argv[1]);
-                  return(1);
-               }
-            }
+            for(j=0; j<nStem*nStem; j++)
+               printf("%.3f ", job.dists[i*nStem*nStem + j]);
+            printf("\n");
+         }
+      }
+   }
+   else
+   {
+      CalcStatistics(job.dists, job.found, nFiles, nStem, means, sds,
+                     &nUsed);
+      if(nUsed < 2)
+      {
+         fprintf(stderr,"Error (finddist): Key residues found in fewer \
+than 2 files\n");
+         return(1);
+      }
+      if(outMode == OUT_HEADER)
+         WriteDistancesHeader(stdout, means, sds, nStem, sdMult);
+      else
+         WriteDistanceTable(stdout, means, sds, nStem, sdMult,
+                            keyResN, keyResC, nUsed);
+   }
+
+   for(i=0; i<nFiles; i++)
+      free(files[i]);
+   free(files);
+   free(job.dists);
+   free(job.found);
+
+   return(0);
+}
 
-            for(i=0; i<3; i++)
+
+/************************************************************************/
+/*>int SplitKeyResidues(char *keyList, char **keyRes)
+   --------------------------------------------------
+*//**
+   \param[in,out]  *keyList   Comma-separated residue IDs (the commas
+                              are replaced by terminators)
+   \param[out]     **keyRes   Pointers to the residue IDs
+   \return                    Number of residues (0 if more than
+                              MAXSTEM)
+
+   Splits a list of key residues
+
+-  18.10.26 Original   By: ACRM
+*/
+int SplitKeyResidues(char *keyList, char **keyRes)
+{
+   char *chp;
+   int  nRes = 0;
+
+   for(chp=keyList; chp!=NULL; )
+   {
+      if(nRes == MAXSTEM)
+         return(0);
+      keyRes[nRes++] = chp;
+      if((chp = strchr(chp, ','))!=NULL)
+         *(chp++) = '\0';
+   }
+   return(nRes);
+}
+
+
+/************************************************************************/
+/*>char **ListFiles(char **args, int nArgs, int *nFiles)
+   -----------------------------------------------------
+*//**
+   \param[in]   **args    Files and directories from the command line
+   \param[in]   nArgs     Number of arguments
+   \param[out]  *nFiles   Number of files
+   \return                Array of filenames (NULL if none or no memory)
+
+   Makes the list of files to read. Each directory is replaced by the
+   files it contains in sorted order.
+
+-  18.10.26 Original   By: ACRM
+*/
+char **ListFiles(char **args, int nArgs, int *nFiles)
+{
+   char          **files = NULL,
+                 **newFiles,
+                 filename[MAXBUFF];
+   struct stat   st;
+   struct dirent *dent;
+   DIR           *dp;
+   int           maxFiles = 0,
+                 i, j,
+                 dirStart;
+
+   *nFiles = 0;
+   for(i=0; i<nArgs; i++)
+   {
+      dirStart = *nFiles;
+      dp       = NULL;
+      if(!stat(args[i], &st) && S_ISDIR(st.st_mode))
+      {
+         if((dp = opendir(args[i]))==NULL)
+         {
+            fprintf(stderr,"Warning (finddist): Unable to read directory \
+%s\n", args[i]);
+            continue;
+         }
+      }
+
+      while(1)
+      {
+         if(dp != NULL)
+         {
+            if((dent = readdir(dp))==NULL)
+               break;
+            if(dent->d_name[0] == '.')
+               continue;
+            sprintf(filename, "%.*s/%.*s", MAXBUFF/2, args[i],
+                    MAXBUFF/2-2, dent->d_name);
+         }
+         else
+         {
+            strncpy(filename, args[i], MAXBUFF-1);
+            filename[MAXBUFF-1] = '\0';
+         }
+
+         if(*nFiles == maxFiles)
+         {
+            maxFiles = maxFiles ? (2 * maxFiles) : 256;
+            if((newFiles = (char **)realloc(files,
+                                            maxFiles * sizeof(char *)))
+               == NULL)
             {
-               for(j=0; j<3; j++)
-               {
-                  printf("%.3f ", DIST(pN[i], pC[j]));
-               }
+               for(j=0; j<*nFiles; j++)
+                  free(files[j]);
+               free(files);
+               return(NULL);
             }
-            printf("\n");
+            files = newFiles;
          }
-         else
+         if((files[*nFiles] = (char *)malloc(strlen(filename)+1))==NULL)
          {
-            fprintf(stderr,"No CA atoms extracted from PDB\n");
-            return(1);
+            for(j=0; j<*nFiles; j++)
+               free(files[j]);
+            free(files);
+            return(NULL);
          }
-         
+         strcpy(files[(*nFiles)++], filename);
+
+         if(dp == NULL)
+            break;
       }
+
+      if(dp != NULL)
+      {
+         closedir(dp);
+         qsort(files+dirStart, *nFiles-dirStart, sizeof(char *),
+               cmpFilenames);
+      }
+   }
+
+   if(*nFiles == 0)
+   {
+      free(files);
+      return(NULL);
+   }
+   return(files);
+}
+
+
+/************************************************************************/
+/*>static int cmpFilenames(const void *p1, const void *p2)
+   -------------------------------------------------------
+*//**
+   \param[in]  *p1    Pointer to first filename pointer
+   \param[in]  *p2    Pointer to second filename pointer
+   \return            strcmp() of the filenames
+
+   Comparison routine used by qsort()
+
+-  18.10.26 Original   By: ACRM
+*/
+static int cmpFilenames(const void *p1, const void *p2)
+{
+   return(strcmp(*(char **)p1, *(char **)p2));
+}
+
+
+/************************************************************************/
+/*>void CalcAllDistances(DISTJOB *job)
+   -----------------------------------
+*//**
+   \param[in,out]  *job   Files to read; the distances and whether all
+                          key residues were found are filled in
+
+   Calculates the distances for every file using a pool of threads
+
+-  18.10.26 Original   By: ACRM
+*/
+void CalcAllDistances(DISTJOB *job)
+{
+   DISTJOB   *jobs;
+   pthread_t *threads;
+   int       nThreads = job->nThreads,
+             i;
+
+   if(nThreads < 1)
+   {
+      long nCPU = sysconf(_SC_NPROCESSORS_ONLN);
+      nThreads  = (nCPU > 0)?(int)nCPU:1;
+   }
+   if(nThreads > job->nFiles)
+      nThreads = job->nFiles;
+
+   jobs    = (DISTJOB *)malloc(nThreads * sizeof(DISTJOB));
+   threads = (pthread_t *)malloc(nThreads * sizeof(pthread_t));
+   if((jobs == NULL) || (threads == NULL))
+   {
+      free(jobs);
+      free(threads);
+      job->nThreads = 1;
+      job->thread   = 0;
+      DistThread(job);
+      return;
+   }
+
+   for(i=0; i<nThreads; i++)
+   {
+      jobs[i]          = *job;
+      jobs[i].nThreads = nThreads;
+      jobs[i].thread   = i;
+   }
+
+   /* Thread 0 is this one; if a thread can't be started its share of
+      the work is done here instead
+   */
+   for(i=1; i<nThreads; i++)
+   {
+      if(pthread_create(&(threads[i]), NULL, DistThread, &(jobs[i])))
+      {
+         DistThread(&(jobs[i]));
+         jobs[i].thread = -1;
+      }
+   }
+   DistThread(&(jobs[0]));
+   for(i=1; i<nThreads; i++)
+   {
+      if(jobs[i].thread >= 0)
+         pthread_join(threads[i], NULL);
+   }
+
+   free(jobs);
+   free(threads);
+}
+
+
+/************************************************************************/
+/*>static void *DistThread(void *arg)
+   ----------------------------------
+*//**
+   \param[in]  *arg    The DISTJOB for this thread
+   \return             NULL
+
+   Reads every nThreads'th file starting from the thread number. Each
+   file has its own slot in the results so no locking is needed.
+
+-  18.10.26 Original   By: ACRM
+*/
+static void *DistThread(void *arg)
+{
+   DISTJOB *job = (DISTJOB *)arg;
+   int     i,
+           nDist = job->nStem * job->nStem;
+
+   for(i=job->thread; i<job->nFiles; i+=job->nThreads)
+   {
+      job->found[i] = CalcFileDistances(job->files[i], job->keyResN,
+                                        job->keyResC, job->nStem,
+                                        job->dists + i * nDist);
+   }
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>BOOL CalcFileDistances(char *filename, char **keyResN,
+                          char **keyResC, int nStem, REAL *dists)
+   -------------------------------------------------------------------
+*//**
+   \param[in]   *filename  PDB file
+   \param[in]   **keyResN  N-terminal key residues
+   \param[in]   **keyResC  C-terminal key residues
+   \param[in]   nStem      Number of key residues at each end
+   \param[out]  *dists     nStem*nStem distances (n0-c0, n0-c1, ...)
+   \return                 File read and all key residues found
+
+   Calculates the CA distances between the key residues of one file
+
+-  15.07.15 Original (as main())   By: ACRM
+-  18.10.26 Split out of main() and reads only ATOM records
+*/
+BOOL CalcFileDistances(char *filename, char **keyResN, char **keyResC,
+                       int nStem, REAL *dists)
+{
+   FILE *fp;
+   PDB  *pdb,
+        *pN[MAXSTEM],
+        *pC[MAXSTEM];
+   int  natoms,
+        i, j;
+   BOOL ok = TRUE;
+
+   if((fp = fopen(filename, "r"))==NULL)
+   {
+      fprintf(stderr,"Warning (finddist): Unable to open %s\n",
+              filename);
+      return(FALSE);
+   }
+   pdb = blReadPDBAtoms(fp, &natoms);
+   fclose(fp);
+
+   if((pdb == NULL) || ((pdb = blSelectCaPDB(pdb))==NULL))
+   {
+      fprintf(stderr,"Warning (finddist): No CA atoms read from %s\n",
+              filename);
+      return(FALSE);
+   }
+
+   for(i=0; i<nStem; i++)
+   {
+      if((pN[i] = blFindResidueSpec(pdb, keyResN[i]))==NULL)
+      {
+         fprintf(stderr,"Residue not found: %s (%s)\n", keyResN[i],
+                 filename);
+         ok = FALSE;
+         break;
+      }
+      if((pC[i] = blFindResidueSpec(pdb, keyResC[i]))==NULL)
+      {
+         fprintf(stderr,"Residue not found: %s (%s)\n", keyResC[i],
+                 filename);
+         ok = FALSE;
+         break;
+      }
+   }
+
+   if(ok)
+   {
+      for(i=0; i<nStem; i++)
+      {
+         for(j=0; j<nStem; j++)
+         {
+            dists[i*nStem + j] = DIST(pN[i], pC[j]);
+         }
+      }
+   }
+
+   FREELIST(pdb, PDB);
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>void CalcStatistics(REAL *dists, BOOL *found, int nFiles, int nStem,
+                       REAL *means, REAL *sds, int *nUsed)
+   --------------------------------------------------------------------
+*//**
+   \param[in]   *dists    Distances for each file
+   \param[in]   *found    Whether each file had all the key residues
+   \param[in]   nFiles    Number of files
+   \param[in]   nStem     Number of key residues at each end
+   \param[out]  *means    Mean of each distance
+   \param[out]  *sds      Sample standard deviation of each distance
+   \param[out]  *nUsed    Number of files contributing
+
+   Calculates the mean and standard deviation of each distance in a
+   single pass with Welford's method, which doesn't lose precision as
+   the sum of squares does
+
+-  18.10.26 Original (replaces CalcExtSD() in makedistances.pl)
+            By: ACRM
+*/
+void CalcStatistics(REAL *dists, BOOL *found, int nFiles, int nStem,
+                    REAL *means, REAL *sds, int *nUsed)
+{
+   REAL m2[MAXDIST],
+        delta;
+   int  nDist = nStem * nStem,
+        i, j;
+
+   *nUsed = 0;
+   for(j=0; j<nDist; j++)
+      means[j] = m2[j] = sds[j] = 0.0;
+
+   for(i=0; i<nFiles; i++)
+   {
+      if(!found[i])
+         continue;
+
+      (*nUsed)++;
+      for(j=0; j<nDist; j++)
+      {
+         REAL x = dists[i*nDist + j];
+         delta     = x - means[j];
+         means[j] += delta / *nUsed;
+         m2[j]    += delta * (x - means[j]);
+      }
+   }
+
+   if(*nUsed > 1)
+   {
+      for(j=0; j<nDist; j++)
+         sds[j] = sqrt(m2[j] / (*nUsed - 1));
+   }
+}
+
+
+/************************************************************************/
+/*>void WriteDistancesHeader(FILE *out, REAL *means, REAL *sds,
+                             int nStem, REAL sdMult)
+   ---------------------------------------------------------------
+*//**
+   \param[in]   *out      Output file
+   \param[in]   *means    Mean of each distance
+   \param[in]   *sds      Standard deviation of each distance
+   \param[in]   nStem     Number of key residues at each end
+   \param[in]   sdMult    Multiple of the SD used for the min/max
+
+   Writes the statistics in the form of distances.h
+
+-  18.10.26 Original (replaces makedistances.pl)   By: ACRM
+*/
+void WriteDistancesHeader(FILE *out, REAL *means, REAL *sds, int nStem,
+                          REAL sdMult)
+{
+   int i, j;
+
+   fprintf(out, "/*** This file auto-generated by finddist ***/\n\n");
+   fprintf(out, "REAL sdMult = %.1f;\n", sdMult);
+   for(i=0; i<nStem; i++)
+   {
+      if(i==0)
+         fprintf(out, "REAL means[%d][%d] = {{", nStem, nStem);
       else
+         fprintf(out, "                    {");
+      for(j=0; j<nStem; j++)
+         fprintf(out, "%.6f%s", means[i*nStem+j], (j<nStem-1)?", ":"");
+      fprintf(out, "}%s\n", (i<nStem-1)?",":"};");
+   }
+   for(i=0; i<nStem; i++)
+   {
+      if(i==0)
+         fprintf(out, "REAL sds[%d][%d]   = {{", nStem, nStem);
+      else
+         fprintf(out, "                    {");
+      for(j=0; j<nStem; j++)
+         fprintf(out, "%.6f%s", sds[i*nStem+j], (j<nStem-1)?", ":"");
+      fprintf(out, "}%s\n", (i<nStem-1)?",":"};");
+   }
+}
+
+
+/************************************************************************/
+/*>void WriteDistanceTable(FILE *out, REAL *means, REAL *sds, int nStem,
+                           REAL sdMult, char **keyResN, char **keyResC,
+                           int nUsed)
+   ---------------------------------------------------------------------
+*//**
+   \param[in]   *out      Output file
+   \param[in]   *means    Mean of each distance
+   \param[in]   *sds      Standard deviation of each distance
+   \param[in]   nStem     Number of key residues at each end
+   \param[in]   sdMult    Multiple of the SD for the min/max
+   \param[in]   **keyResN N-terminal key residues
+   \param[in]   **keyResC C-terminal key residues
+   \param[in]   nUsed     Number of files contributing
+
+   Writes the mean +/- sdMult SDs as a distance table in the format of
+   distanceTable.txt for buildloopdb -t
+
+-  18.10.26 Original   By: ACRM
+*/
+void WriteDistanceTable(FILE *out, REAL *means, REAL *sds, int nStem,
+                        REAL sdMult, char **keyResN, char **keyResC,
+                        int nUsed)
+{
+   int  i, j;
+   REAL dMin;
+
+   fprintf(out, "# These pairs of distances represent the minimum and \
+maximum distances\n");
+   fprintf(out, "# from an Nter residue to a Cter residue: the mean \
++/- %.1f SDs over\n", sdMult);
+   fprintf(out, "# %d structures (written by finddist)\n", nUsed);
+   fprintf(out, "#\n");
+   for(i=0; i<nStem; i++)
+   {
+      fprintf(out, "# From %s to", keyResN[i]);
+      for(j=0; j<nStem; j++)
+         fprintf(out, " %s", keyResC[j]);
+      fprintf(out, "\n");
+
+      for(j=0; j<nStem; j++)
       {
-         fprintf(stderr,"No atoms read from PDB file\n");
-         return(1);
+         dMin = means[i*nStem+j] - sdMult * sds[i*nStem+j];
+         fprintf(out, "%.2f  %.2f\n", (dMin < 0.0)?0.0:dMin,
+                 means[i*nStem+j] + sdMult * sds[i*nStem+j]);
       }
    }
-   else
+}
+
+
+/************************************************************************/
+/*>BOOL ParseCmdLine(int argc, char **argv, char *keyListN,
+                     char *keyListC, int *nThreads, int *outMode,
+                     REAL *sdMult, int *firstFile)
+   ---------------------------------------------------------------
+*//**
+   \param[in]   argc        Argument count
+   \param[in]   **argv      Argument array
+   \param[out]  *keyListN   Comma-separated N-terminal key residues
+   \param[out]  *keyListC   Comma-separated C-terminal key residues
+   \param[out]  *nThreads   Number of threads (0 = one per processor)
+   \param[out]  *outMode    OUT_LINES, OUT_HEADER or OUT_TABLE
+   \param[out]  *sdMult     Multiple of the SD for -T (and written to
+                            distances.h)
+   \param[out]  *firstFile  Index in argv of the first file
+   \return                  Success
+
+   Parse the command line
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL ParseCmdLine(int argc, char **argv, char *keyListN, char *keyListC,
+                  int *nThreads, int *outMode, REAL *sdMult,
+                  int *firstFile)
+{
+   int arg;
+
+   strcpy(keyListN, DEF_KEYRESN);
+   strcpy(keyListC, DEF_KEYRESC);
+
+   for(arg=1; arg<argc; arg++)
    {
-      fprintf(stderr,"Unable to open PDB file\n");
-      return(1);
+      if(argv[arg][0] != '-')
+         break;
+
+      switch(argv[arg][1])
+      {
+      case 'n':
+         if(++arg >= argc)
+            return(FALSE);
+         strncpy(keyListN, argv[arg], MAXBUFF-1);
+         keyListN[MAXBUFF-1] = '\0';
+         break;
+      case 'c':
+         if(++arg >= argc)
+            return(FALSE);
+         strncpy(keyListC, argv[arg], MAXBUFF-1);
+         keyListC[MAXBUFF-1] = '\0';
+         break;
+      case 'j':
+         if((++arg >= argc) || !sscanf(argv[arg], "%d", nThreads))
+            return(FALSE);
+         break;
+      case 'm':
+         if((++arg >= argc) || !sscanf(argv[arg], "%lf", sdMult))
+            return(FALSE);
+         break;
+      case 'H':
+         *outMode = OUT_HEADER;
+         break;
+      case 'T':
+         *outMode = OUT_TABLE;
+         break;
+      default:
+         return(FALSE);
+      }
    }
-   
-   return(0);
+
+   *firstFile = arg;
+   return(arg < argc);
+}
+
+
+/************************************************************************/
+/*>void Usage(void)
+   ----------------
+*//**
+   Prints a usage message
+
+-  15.07.15 Original (in main())   By: ACRM
+-  18.10.26 Split out of main() and describes the new options
+*/
+void Usage(void)
+{
+   fprintf(stderr,"\nfinddist V2.0 (c) 1988-2026 UCL, Dr. Andrew C.R. \
+Martin.\n");
+
+   fprintf(stderr,"\nUsage: finddist [-n res,res...][-c res,res...]\
+[-j nthreads]\n");
+   fprintf(stderr,"                [-H | -T [-m sdmult]] file.pdb|dir \
+...\n");
+   fprintf(stderr,"\n                -n N-terminal key residues [%s]\n",
+           DEF_KEYRESN);
+   fprintf(stderr,"                -c C-terminal key residues [%s]\n",
+           DEF_KEYRESC);
+   fprintf(stderr,"                -j Number of threads [one per \
+CPU]\n");
+   fprintf(stderr,"                -H Write the statistics as \
+distances.h\n");
+   fprintf(stderr,"                -T Write a distance table for \
+buildloopdb -t\n");
+   fprintf(stderr,"                -m Multiple of the SD for the \
+minimum and maximum\n");
+   fprintf(stderr,"                   distances [%.1f]\n", DEF_SDMULT);
+
+   fprintf(stderr,"\nCalculates the CA distances from each N-terminal \
+key residue to each\n");
+   fprintf(stderr,"C-terminal key residue in numbered antibody files. \
+Directories are\n");
+   fprintf(stderr,"expanded to the files they contain. By default the \
+distances are printed\n");
+   fprintf(stderr,"for each file; -H or -T write their statistics \
+instead. Files lacking\n");
+   fprintf(stderr,"a key residue are skipped. Used by 'make \
+distances.h'\n\n");
 }
@@ -0,0 +1,1834 @@
+/************************************************************************/
+/**
+
+   \file       libloopdb.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Library for querying a loop database
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Lets a program that makes many queries open a loop database once and
+   scan it as often as it likes, without the cost of starting
+   scanloopdb and re-reading the database each time.
+
+   LoopDBOpen() reads the text database (and optionally the loop
+   coordinate file from buildloopdb -c) into a LOOPDB handle. The
+   records are indexed by loop length. A query is set up in a
+   LOOPDBQUERY with LoopDBMakeQuery() and scanned with LoopDBScan(),
+   which places the best hits in an array supplied by the caller. The
+   handle is not changed by a scan, so any number of threads may scan
+   the same handle at once. LoopDBClose() frees it.
+
+   Records are checked with the kernels in scankernel.h and hits are
+   ranked as by LoopDBRankMatches() (and so scanloopdb): by the sum of
+   the differences from the query distances, ties being ranked by
+   record number, and then, if coordinates are available and the
+   query has its takeoff atoms, the best shortList are reranked by the
+   RMSD of the takeoff residues and the rest dropped. test/difftest.sh
+   checks that LoopDBScan() gives the hits printed by scanloopdb.
+
+   A program making a single query (such as scanloopdb) needn't load
+   the database. It describes the database file, its sidecar and query
+   cache in a LOOPDBFILE and scans it once with LoopDBScanFile(), which
+   reads the records from the file, and then ranks the hits with
+   LoopDBRankMatches(). The query is set up in the same way.
+
+   Link with libloopdb.a and the bioplib and pthread libraries.
+
+**************************************************************************
+
+   Usage:
+   ======
+   LOOPDB      *db;
+   LOOPDBQUERY query;
+   LOOPDBHIT   hits[20];
+   int         nHits, i;
+
+   db = LoopDBOpen("loops.db", NULL);
+   if(LoopDBMakeQuery(caPDB, "H95", "H102", 0, LoopDBStemSize(db),
+                      &query))
+   {
+      query.tolerance = 1.0;
+      nHits = LoopDBScan(db, &query, hits, 20, NULL);
+      for(i=0; i<nHits; i++)
+         printf("%s : %f\n", LoopDBRecord(db, hits[i].record),
+                hits[i].score);
+   }
+   LoopDBClose(db);
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bioplib/pdb.h"
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define SMALLBUFF 16
+
+/* ScanReference() passes sscanf() room for 5x5 distances               */
+#if (MAXSTEM > 5)
+#error "ScanReference() reads at most 5x5 distances"
+#endif
+
+/************************************************************************/
+/* Structure definitions
+*/
+typedef struct
+{
+   long *records;             /* Records of this length in order        */
+   long nRecords;
+}  LDBLENGTH;
+
+struct _loopdb
+{
+   char       *text,          /* The database file; each record is
+                                 terminated in place                    */
+              **records,      /* Start of each record                   */
+              **distances;    /* ...and of its distances                */
+   int        *loopLen;       /* Loop length of each record (-1 if the
+                                 fields could not be read)              */
+   long       nRecords;
+   int        nStem,
+              maxLen;
+   LDBLENGTH  *lengths;       /* Records by loop length (0..maxLen)     */
+   LOOPCOORDS *lc;            /* Loop coordinates (or NULL)             */
+};
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Record scoring kernels, one for each stem size from MINSTEM to 
+   MAXSTEM (see scankernel.h)
+*/
+#define STEM_K 2
+#include "scankernel.h"
+#undef STEM_K
+#define STEM_K 3
+#include "scankernel.h"
+#undef STEM_K
+#define STEM_K 4
+#include "scankernel.h"
+#undef STEM_K
+#define STEM_K 5
+#include "scankernel.h"
+#undef STEM_K
+
+typedef BOOL (*SCORESTEMS)(char *distances, 
+                           REAL distMat[MAXSTEM][MAXSTEM],
+                           REAL tolerance, REAL *score, int *failCell);
+static SCORESTEMS sScoreStems[MAXSTEM+1] = 
+{
+   NULL, NULL, ScoreStems2, ScoreStems3, ScoreStems4, ScoreStems5
+};
+
+/************************************************************************/
+/* Prototypes
+*/
+static BOOL ReadRecords(LOOPDB *db);
+static BOOL IndexLengths(LOOPDB *db);
+static void AddHit(LOOPDBHIT *hits, int *nHits, int maxHits, long record,
+                   REAL score);
+static int  cmpHits(const void *p1, const void *p2);
+static int  cmpHitRMSD(const void *p1, const void *p2);
+static LOOP *ScanMatrix(REAL distMat[MAXSTEM][MAXSTEM], int nStem, 
+                        int loopLen, FILE *dbf, REAL tolerance,
+                        LOOPDBSTATS *stats);
+static LOOP *ScanMatrixQF(REAL distMat[MAXSTEM][MAXSTEM], int nStem, 
+                          int loopLen, FILE *dbf, QFILTER *qf,
+                          REAL tolerance, LOOPDBSTATS *stats);
+static LOOP *ScanReference(REAL distMat[MAXSTEM][MAXSTEM], int nStem,
+                           int loopLen, FILE *dbf, REAL tolerance);
+static BOOL ScanRecord(char *buffer, REAL distMat[MAXSTEM][MAXSTEM],
+                       int nStem, int loopLen, REAL tolerance,
+                       long *record, LOOP **pLoops, LOOP **pLast,
+                       LOOPDBSTATS *stats);
+static LOOP *ScanWithCache(REAL distMat[MAXSTEM][MAXSTEM], int nStem, 
+                           int loopLen, FILE *dbf, QFILTER *qf, 
+                           REAL tolerance, char *dbFile, char *cacheDir, 
+                           REAL grid, LOOPDBSTATS *stats);
+static LOOP *ScanCacheEntry(REAL distMat[MAXSTEM][MAXSTEM], int nStem, 
+                            int loopLen, FILE *cfp, REAL tolerance,
+                            LOOPDBSTATS *stats);
+static LOOP **IndexResults(LOOP *loops, int *nLoops);
+static void RescoreByRMSD(LOOP **indx, int nLoops, LOOPCOORDS *lc,
+                          SUPATOMS *queryStems);
+static int  cmpResults(const void *p1, const void *p2);
+static int  cmpRMSD(const void *p1, const void *p2);
+
+
+/************************************************************************/
+/*>LOOPDB *LoopDBOpen(char *dbFile, char *coordsFile)
+   --------------------------------------------------
+*//**
+   \param[in]   *dbFile      Text database from buildloopdb
+   \param[in]   *coordsFile  Loop coordinate file (NULL or blank if
+                             not used)
+   \return                   Database handle (NULL if the database
+                             can't be read, has an unsupported stem
+                             size, the coordinate file is missing or
+                             doesn't match, or there is no memory)
+
+   Reads a loop database into memory
+
+-  18.10.26 Original   By: ACRM
+*/
+LOOPDB *LoopDBOpen(char *dbFile, char *coordsFile)
+{
+   LOOPDB *db;
+   FILE   *dbf;
+   long   size;
+   BOOL   ok = FALSE;
+
+   if((dbf = fopen(dbFile, "r"))==NULL)
+      return(NULL);
+   if((db = (LOOPDB *)calloc(1, sizeof(LOOPDB)))==NULL)
+   {
+      fclose(dbf);
+      return(NULL);
+   }
+
+   if(((db->nStem = ReadDBStemSize(dbf)) != 0) &&
+      !fseek(dbf, 0L, SEEK_END) &&
+      ((size = ftell(dbf)) >= 0) &&
+      !fseek(dbf, 0L, SEEK_SET) &&
+      ((db->text = (char *)malloc(size + 1))!=NULL) &&
+      (fread(db->text, 1, size, dbf) == (size_t)size))
+   {
+      db->text[size] = '\0';
+      ok = TRUE;
+   }
+
+   if(ok && (coordsFile != NULL) && coordsFile[0])
+   {
+      if(((db->lc = OpenLoopCoords(coordsFile, dbf))==NULL) ||
+         (db->lc->header->nStem != db->nStem))
+         ok = FALSE;
+   }
+   fclose(dbf);
+
+   if(ok && ReadRecords(db) && IndexLengths(db))
+      return(db);
+
+   CloseLoopCoords(db->lc);
+   db->lc = NULL;
+   free(db->text);
+   free(db->records);
+   free(db->distances);
+   free(db->loopLen);
+   free(db->lengths);
+   free(db);
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>void LoopDBClose(LOOPDB *db)
+   ----------------------------
+*//**
+   \param[in]   *db      Database handle (may be NULL)
+
+   Frees a database handle. No scans may be running.
+
+-  18.10.26 Original   By: ACRM
+*/
+void LoopDBClose(LOOPDB *db)
+{
+   int i;
+
+   if(db == NULL)
+      return;
+
+   for(i=0; i<=db->maxLen; i++)
+      free(db->lengths[i].records);
+   CloseLoopCoords(db->lc);
+   free(db->text);
+   free(db->records);
+   free(db->distances);
+   free(db->loopLen);
+   free(db->lengths);
+   free(db);
+}
+
+
+/************************************************************************/
+/*>int LoopDBStemSize(LOOPDB *db)
+   ------------------------------
+*//**
+   \param[in]   *db      Database handle
+   \return               Residues in each stem
+
+-  18.10.26 Original   By: ACRM
+*/
+int LoopDBStemSize(LOOPDB *db)
+{
+   return(db->nStem);
+}
+
+
+/************************************************************************/
+/*>long LoopDBNRecords(LOOPDB *db)
+   -------------------------------
+*//**
+   \param[in]   *db      Database handle
+   \return               Number of records
+
+-  18.10.26 Original   By: ACRM
+*/
+long LoopDBNRecords(LOOPDB *db)
+{
+   return(db->nRecords);
+}
+
+
+/************************************************************************/
+/*>long LoopDBCandidates(LOOPDB *db, int loopLen)
+   ----------------------------------------------
+*//**
+   \param[in]   *db      Database handle
+   \param[in]   loopLen  Loop length
+   \return               Number of records of this length; no scan
+                         can find more hits than this
+
+-  18.10.26 Original   By: ACRM
+*/
+long LoopDBCandidates(LOOPDB *db, int loopLen)
+{
+   if((loopLen < 0) || (loopLen > db->maxLen))
+      return(0);
+   return(db->lengths[loopLen].nRecords);
+}
+
+
+/************************************************************************/
+/*>char *LoopDBRecord(LOOPDB *db, long record)
+   -------------------------------------------
+*//**
+   \param[in]   *db      Database handle
+   \param[in]   record   Record number (from 0)
+   \return               The record as printed by scanloopdb (NULL if
+                         it doesn't exist). Must not be changed or
+                         freed.
+
+-  18.10.26 Original   By: ACRM
+*/
+char *LoopDBRecord(LOOPDB *db, long record)
+{
+   if((record < 0) || (record >= db->nRecords))
+      return(NULL);
+   return(db->records[record]);
+}
+
+
+/************************************************************************/
+/*>LOOPCOORDS *LoopDBCoords(LOOPDB *db)
+   ------------------------------------
+*//**
+   \param[in]   *db      Database handle
+   \return               Loop coordinates (NULL if none were opened)
+
+-  18.10.26 Original   By: ACRM
+*/
+LOOPCOORDS *LoopDBCoords(LOOPDB *db)
+{
+   return(db->lc);
+}
+
+
+/************************************************************************/
+/*>BOOL LoopDBMakeQuery(PDB *pdb, char *startRes, char *endRes,
+                        int loopLen, int nStem, LOOPDBQUERY *query)
+   ---------------------------------------------------------------
+*//**
+   \param[in]   *pdb       CA-only PDB linked list
+   \param[in]   *startRes  Residue identifier for first residue
+   \param[in]   *endRes    Residue identifier for last residue
+   \param[in]   loopLen    Loop length wanted (0 = same as structure)
+   \param[in]   nStem      Residues in each stem of the database
+   \param[out]  *query     The query. The tolerance is set to
+                           DEF_LDBTOLERANCE and the short list to
+                           DEF_LDBSHORTLIST.
+   \return                 FALSE if the loop or its stems are not in
+                           the structure
+
+   Calculates the distance matrix between the nStem residues before
+   and after a loop and records where they are
+
+-  14.07.15 Original (as part of FindLoops() in scanloopdb.c) By: ACRM
+-  17.07.15 Handles loop length as a parameter
+-  18.10.26 Takes the stem size and records the takeoff residues
+-  18.10.26 Moved into the library. Checks that all the stem residues
+            are present
+*/
+BOOL LoopDBMakeQuery(PDB *pdb, char *startRes, char *endRes,
+                     int loopLen, int nStem, LOOPDBQUERY *query)
+{
+   PDB  *p,
+        *pStartRes,
+        *pEndRes,
+        *n[MAXSTEM],
+        *c[MAXSTEM];
+   int  i, j,
+        resIndex;
+
+   if((nStem < MINSTEM) || (nStem > MAXSTEM))
+      return(FALSE);
+   if((pStartRes = blFindResidueSpec(pdb, startRes))==NULL)
+      return(FALSE);
+   if((pEndRes = blFindResidueSpec(pdb, endRes))==NULL)
+      return(FALSE);
+
+   /* If loop length not specified, see how long the one in the PDB file
+      is and use that length
+   */
+   if(loopLen == 0)
+   {
+      for(p=pStartRes; p!=pEndRes->next; NEXT(p))
+         loopLen++;
+   }
+
+   /* Find the nStem residues before the start of the loop              */
+   for(i=0; i<nStem; i++)
+      n[i] = NULL;
+   for(p=pdb, resIndex=0; p!=pStartRes; NEXT(p), resIndex++)
+   {
+      for(i=0; i<nStem-1; i++)
+         n[i] = n[i+1];
+      n[nStem-1] = p;
+   }
+
+   /* pdb is a CA-only list so these are also residue positions         */
+   for(i=0; i<nStem; i++)
+      query->stemIndex[i] = resIndex - nStem + i;
+   for(p=pStartRes; p!=pEndRes; NEXT(p))
+      resIndex++;
+   for(i=0; i<nStem; i++)
+      query->stemIndex[i+nStem] = resIndex + 1 + i;
+
+   /* Find the nStem residues after the end of the loop                 */
+   c[0] = pEndRes->next;
+   for(i=1; i<nStem; i++)
+      c[i] = (c[i-1] != NULL)?c[i-1]->next:NULL;
+
+   /* Build the distance matrix                                         */
+   for(i=0; i<nStem; i++)
+   {
+      if((n[i] == NULL) || (c[i] == NULL))
+         return(FALSE);
+   }
+   for(i=0; i<nStem; i++)
+   {
+      for(j=0; j<nStem; j++)
+      {
+         query->distMat[i][j] = DIST(n[i], c[j]);
+      }
+   }
+
+   query->loopLen   = loopLen;
+   query->nStem     = nStem;
+   query->tolerance = DEF_LDBTOLERANCE;
+   query->shortList = DEF_LDBSHORTLIST;
+   query->haveStems = FALSE;
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>BOOL LoopDBQueryStems(LOOPDBQUERY *query, BBRES *backbone, int nRes)
+   --------------------------------------------------------------------
+*//**
+   \param[in,out] *query     Query from LoopDBMakeQuery()
+   \param[in]     *backbone  Backbone of the query structure (from
+                             ExtractBackbone())
+   \param[in]     nRes       Number of residues in backbone
+   \return                   FALSE if a takeoff residue is missing
+
+   Adds the takeoff atoms to a query so that hits can be reranked by
+   RMSD
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL LoopDBQueryStems(LOOPDBQUERY *query, BBRES *backbone, int nRes)
+{
+   query->haveStems = GetStemAtoms(backbone, nRes, query->nStem,
+                                   query->stemIndex, &(query->stems));
+   return(query->haveStems);
+}
+
+
+/************************************************************************/
+/*>int LoopDBScan(LOOPDB *db, LOOPDBQUERY *query, LOOPDBHIT *hits,
+                  int maxHits, LOOPDBSTATS *stats)
+   ---------------------------------------------------------------
+*//**
+   \param[in]   *db        Database handle
+   \param[in]   *query     The query
+   \param[out]  *hits      Space for maxHits hits
+   \param[in]   maxHits    Number of hits wanted
+   \param[out]  *stats     Counts of records checked and rejected (NULL
+                           if not wanted)
+   \return                 Number of hits placed in hits (-1 if the
+                           query doesn't match the database's stem size
+                           or there is no memory)
+
+   Scans the database for loops of the query's length whose distances
+   are all within the tolerance of the query's. The hits are ranked by
+   the sum of the differences. If the database has coordinates and the
+   query has takeoff atoms, the best shortList are then reranked by
+   RMSD and the rest dropped, so the best maxHits of these are
+   returned just as scanloopdb -c -n maxHits would print them.
+   stats->nMatched gives the total number of matches.
+
+   Thread safe: any number of scans may run on the same handle.
+
+-  18.10.26 Original   By: ACRM
+*/
+int LoopDBScan(LOOPDB *db, LOOPDBQUERY *query, LOOPDBHIT *hits,
+               int maxHits, LOOPDBSTATS *stats)
+{
+   LDBLENGTH *len;
+   LOOPDBHIT *best = hits;
+   REAL      score;
+   int       nBest,
+             nHits = 0,
+             failCell,
+             i;
+   long      r;
+   BOOL      rerank;
+
+   if(query->nStem != db->nStem)
+      return(-1);
+   if(stats != NULL)
+   {
+      memset(stats, 0, sizeof(LOOPDBSTATS));
+      stats->nRecords = db->nRecords;
+      stats->nLength  = db->nRecords;
+   }
+   if((query->loopLen < 0) || (query->loopLen > db->maxLen))
+      return(0);
+   len = db->lengths + query->loopLen;
+   if(stats != NULL)
+      stats->nLength -= len->nRecords;
+
+   /* When reranking, hits beyond maxHits may move up into it, so keep
+      the whole short list until it has been reranked
+   */
+   rerank = (db->lc != NULL) && query->haveStems;
+   nBest  = maxHits;
+   if(rerank)
+   {
+      if((query->shortList <= 0) || (query->shortList > len->nRecords))
+         nBest = MAX(nBest, len->nRecords);
+      else
+         nBest = MAX(nBest, query->shortList);
+   }
+   if((nBest > maxHits) &&
+      ((best = (LOOPDBHIT *)malloc(nBest * sizeof(LOOPDBHIT)))==NULL))
+      return(-1);
+
+   for(r=0; r<len->nRecords; r++)
+   {
+      if((*sScoreStems[db->nStem])(db->distances[len->records[r]],
+                                   query->distMat, query->tolerance,
+                                   &score, &failCell))
+      {
+         if(stats != NULL)
+            stats->nMatched++;
+         AddHit(best, &nHits, nBest, len->records[r], score);
+      }
+      else if(stats != NULL)
+      {
+         if(failCell < 0)
+            stats->nMalformed++;
+         else
+            stats->cellReject[failCell]++;
+      }
+   }
+
+   if(nHits)
+      qsort(best, nHits, sizeof(LOOPDBHIT), cmpHits);
+
+   /* Rerank the best by RMSD                                           */
+   if(rerank)
+   {
+      if((query->shortList > 0) && (nHits > query->shortList))
+         nHits = query->shortList;
+      for(i=0; i<nHits; i++)
+         best[i].rmsd = LoopRMSD(db->lc, best[i].record,
+                                 &(query->stems));
+      qsort(best, nHits, sizeof(LOOPDBHIT), cmpHitRMSD);
+   }
+
+   if(nHits > maxHits)
+      nHits = maxHits;
+   if(best != hits)
+   {
+      for(i=0; i<nHits; i++)
+         hits[i] = best[i];
+      free(best);
+   }
+   return(nHits);
+}
+
+
+/************************************************************************/
+/*>BOOL LoopDBMakeReferenceQuery(PDB *pdb, char *startRes,
+                                 char *endRes, int loopLen, int nStem,
+                                 LOOPDBQUERY *query)
+   ----------------------------------------------------------------------
+*//**
+   \param[in]   *pdb       CA-only PDB linked list
+   \param[in]   *startRes  Residue identifier for first residue
+   \param[in]   *endRes    Residue identifier for last residue
+   \param[in]   loopLen    Desired loop length (0 = same as structure)
+   \param[in]   nStem      Number of takeoff residues each side
+   \param[out]  *query     The distance matrix, loop length and
+                           positions of the takeoff residues
+   \return                 FALSE if the loop or its stems are not in
+                           the structure
+
+   The reference implementation of LoopDBMakeQuery(), used by
+   scanloopdb --reference. The tolerance, short list and takeoff atoms
+   are not set. This is the query construction of the original
+   FindLoops(), changed only to handle the stem size, to check that the
+   stems are present and to record the positions of the takeoff
+   residues for RMSD reranking. It is kept separate so that
+   test/difftest.sh also checks LoopDBMakeQuery() and should not be
+   optimized.
+
+-  14.07.15 Original (as part of FindLoops())   By: ACRM
+-  17.07.15 Handles loop length as a parameter
+-  18.10.26 Handles the stem size, checks the stems are present and
+            records the positions of the takeoff residues
+-  18.10.26 Moved into the library as LoopDBMakeReferenceQuery()
+*/
+BOOL LoopDBMakeReferenceQuery(PDB *pdb, char *startRes, char *endRes,
+                              int loopLen, int nStem, LOOPDBQUERY *query)
+{
+   PDB  *p,
+        *pStartRes,
+        *pEndRes,
+        *n[MAXSTEM],
+        *c[MAXSTEM];
+   int  i, j,
+        resIndex = 0;
+
+
+   if((pStartRes = blFindResidueSpec(pdb, startRes))==NULL)
+      return(FALSE);
+   if((pEndRes = blFindResidueSpec(pdb, endRes))==NULL)
+      return(FALSE);
+   
+   /* If loop length not specified, see how long the one in the PDB file
+      is and use that length
+   */
+   if(loopLen == 0)
+   {
+      for(p=pStartRes; p!=pEndRes->next; NEXT(p))
+      {
+         loopLen++;
+      }
+   }
+   
+
+   /* Find the nStem residues before the start of the loop              */
+   for(i=0; i<nStem; i++)
+      n[i] = NULL;
+   for(p=pdb; p!=pStartRes; NEXT(p))
+   {
+      for(i=0; i<nStem-1; i++)
+         n[i] = n[i+1];
+      n[nStem-1] = p;
+      resIndex++;
+   }
+   for(i=0; i<nStem; i++)
+      query->stemIndex[i] = resIndex - nStem + i;
+
+   /* Find the nStem residues after the end of the loop                 */
+   c[0] = pEndRes->next;
+   for(i=1; i<nStem; i++)
+      c[i] = (c[i-1] != NULL)?c[i-1]->next:NULL;
+   for(p=pStartRes; p!=pEndRes->next; NEXT(p))
+      resIndex++;
+   for(i=0; i<nStem; i++)
+      query->stemIndex[nStem+i] = resIndex + i;
+
+   for(i=0; i<nStem; i++)
+   {
+      if((n[i] == NULL) || (c[i] == NULL))
+         return(FALSE);
+   }
+
+   /* Build the distance matrix                                         */
+   for(i=0; i<nStem; i++)
+   {
+      for(j=0; j<nStem; j++)
+      {
+         query->distMat[i][j] = DIST(n[i], c[j]);
+      }
+   }
+
+   query->loopLen = loopLen;
+   query->nStem   = nStem;
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>LOOP *LoopDBScanFile(LOOPDBFILE *file, LOOPDBQUERY *query,
+                        LOOPDBSTATS *stats)
+   -----------------------------------------------------------
+*//**
+   \param[in]   *file     The database file and how to scan it
+   \param[in]   *query    The query
+   \param[out]  *stats    Counts of records read and rejected, bytes
+                          read and use of the sidecar and cache (NULL
+                          if not wanted)
+   \return                Linked list of the loops that match, in
+                          database order (NULL if there are none or
+                          memory allocation failed)
+
+   Scans a database file once for a single query, as scanloopdb does.
+   The file is read from its current position. If a cache directory is
+   given the query is looked up in the cache; otherwise the sidecar, if
+   given, is used to skip records that can't match. With
+   file->reference the reference implementation is used and the
+   sidecar and cache are ignored. The loops are the same whichever way
+   the file is scanned. They are ranked by LoopDBRankMatches() and
+   freed with FREELIST().
+
+   This is for a single query. A LOOPDBFILE must not be scanned by two
+   threads at once; use a LOOPDB handle for many queries.
+
+-  14.07.15 Original (as part of FindLoops() in scanloopdb.c) By: ACRM
+-  18.10.26 Uses the sidecar and query cache
+-  18.10.26 Uses ScanReference() with --reference
+-  18.10.26 Moved into the library. Counts into stats rather than a
+            global
+*/
+LOOP *LoopDBScanFile(LOOPDBFILE *file, LOOPDBQUERY *query,
+                     LOOPDBSTATS *stats)
+{
+   if(stats != NULL)
+      memset(stats, 0, sizeof(LOOPDBSTATS));
+   if((query->nStem < MINSTEM) || (query->nStem > MAXSTEM))
+      return(NULL);
+
+   if(file->reference)
+      return(ScanReference(query->distMat, query->nStem, query->loopLen,
+                           file->dbf, query->tolerance));
+   if((file->cacheDir != NULL) && file->cacheDir[0])
+      return(ScanWithCache(query->distMat, query->nStem, query->loopLen,
+                           file->dbf, file->qf, query->tolerance,
+                           file->dbFile, file->cacheDir, file->grid,
+                           stats));
+   if(file->qf != NULL)
+      return(ScanMatrixQF(query->distMat, query->nStem, query->loopLen,
+                          file->dbf, file->qf, query->tolerance, stats));
+   return(ScanMatrix(query->distMat, query->nStem, query->loopLen,
+                     file->dbf, query->tolerance, stats));
+}
+
+
+/************************************************************************/
+/*>LOOP **LoopDBRankMatches(LOOP *loops, int *nLoops, LOOPCOORDS *lc,
+                            LOOPDBQUERY *query)
+   --------------------------------------------------------------------
+*//**
+   \param[in]  *loops      Linked list of loops from LoopDBScanFile()
+   \param[out] *nLoops     Number of loops in the index
+   \param[in]  *lc         Loop coordinates (or NULL)
+   \param[in]  *query      The query
+   \return                 Index of loops in rank order (NULL if 
+                           memory allocation failed). Free with free();
+                           the loops stay in the list.
+
+   Sorts the loops by their fit to the distance matrix. If loop
+   coordinates are available and the query has its takeoff atoms, the
+   best shortList hits are then reranked by RMSD of the takeoff
+   residues and only these are kept.
+
+-  14.07.15 Original (as part of PrintLoops() in scanloopdb.c) By: ACRM
+-  18.10.26 Added RMSD reranking
+-  18.10.26 Split out of PrintLoops() as RankLoops()
+-  18.10.26 Moved into the library. Takes the takeoff atoms and short
+            list from the query
+*/
+LOOP **LoopDBRankMatches(LOOP *loops, int *nLoops, LOOPCOORDS *lc,
+                         LOOPDBQUERY *query)
+{
+   LOOP **indx = NULL;
+
+   /* Create and sort an array to index the linked list                 */
+   if((indx = IndexResults(loops, nLoops))==NULL)
+      return(NULL);
+
+   if((lc != NULL) && query->haveStems)
+   {
+      if((query->shortList > 0) && (*nLoops > query->shortList))
+         *nLoops = query->shortList;
+      RescoreByRMSD(indx, *nLoops, lc, &(query->stems));
+   }
+
+   return(indx);
+}
+
+
+
+
+/************************************************************************/
+/*>REAL LoopRMSD(LOOPCOORDS *lc, long record, SUPATOMS *queryStems)
+   ----------------------------------------------------------------
+*//**
+   \param[in]   *lc          Loop coordinates
+   \param[in]   record       Database record (from 0)
+   \param[in]   *queryStems  Takeoff atoms from the query structure
+   \return                   RMSD of the takeoff atoms after
+                             superposition (-1 if the coordinates
+                             are not available)
+
+   Superimposes the takeoff residues of a loop on those of the query
+
+-  18.10.26 Original (as part of RescoreByRMSD() in scanloopdb.c)
+                                                               By: ACRM
+*/
+REAL LoopRMSD(LOOPCOORDS *lc, long record, SUPATOMS *queryStems)
+{
+   BBRES    *residues;
+   SUPATOMS loopStems;
+   int      j,
+            nRes,
+            nStem = lc->header->nStem,
+            stemIndex[2*MAXSTEM];
+
+   if(((residues = GetLoopCoords(lc, record, &nRes))==NULL) ||
+      (nRes < 2*nStem))
+      return((REAL)(-1.0));
+
+   for(j=0; j<nStem; j++)
+   {
+      stemIndex[j]       = j;
+      stemIndex[j+nStem] = nRes - nStem + j;
+   }
+   if(!GetStemAtoms(residues, nRes, nStem, stemIndex, &loopStems))
+      return((REAL)(-1.0));
+   return(SuperposeRMSD(&loopStems, queryStems, NULL, NULL, NULL));
+}
+
+
+/************************************************************************/
+/*>BOOL GetStemAtoms(BBRES *backbone, int nRes, int nStem,
+                     int stemIndex[2*MAXSTEM], SUPATOMS *stems)
+   --------------------------------------------------------------
+*//**
+   \param[in]  *backbone   Backbone of the query structure
+   \param[in]  nRes        Number of residues in backbone
+   \param[in]  nStem       Number of takeoff residues each side
+   \param[in]  stemIndex   Positions of the 2*nStem takeoff residues
+   \param[out] *stems      N, CA, C and O atoms of the takeoff residues
+   \return                 FALSE if a takeoff residue is missing
+
+   Collects the takeoff atoms in the same order as they are taken from
+   a loop in the coordinate file
+
+-  18.10.26 Original (in scanloopdb.c)   By: ACRM
+*/
+BOOL GetStemAtoms(BBRES *backbone, int nRes, int nStem,
+                  int stemIndex[2*MAXSTEM], SUPATOMS *stems)
+{
+   int i, j;
+
+   stems->nAtoms = 0;
+   for(i=0; i<2*nStem; i++)
+   {
+      if((stemIndex[i] < 0) || (stemIndex[i] >= nRes))
+         return(FALSE);
+
+      for(j=0; j<NBBATOM; j++)
+      {
+         stems->x[stems->nAtoms] = backbone[stemIndex[i]].xyz[j][0];
+         stems->y[stems->nAtoms] = backbone[stemIndex[i]].xyz[j][1];
+         stems->z[stems->nAtoms] = backbone[stemIndex[i]].xyz[j][2];
+         stems->nAtoms++;
+      }
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL ReadRecords(LOOPDB *db)
+   -----------------------------------
+*//**
+   \param[in,out]  *db    Handle with the text read
+
+   Finds the records in the text and reads each one's loop length. As
+   in scanloopdb, anything after a # is ignored, trailing spaces are
+   removed and empty lines are not records.
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL ReadRecords(LOOPDB *db)
+{
+   char *line,
+        *next,
+        *chp,
+        *end;
+   long maxRecords = 1,
+        value;
+   int  field;
+
+   for(chp=db->text; *chp; chp++)
+   {
+      if(*chp == '\n')
+         maxRecords++;
+   }
+   db->records   = (char **)malloc(maxRecords * sizeof(char *));
+   db->distances = (char **)malloc(maxRecords * sizeof(char *));
+   db->loopLen   = (int *)malloc(maxRecords * sizeof(int));
+   if((db->records == NULL) || (db->distances == NULL) ||
+      (db->loopLen == NULL))
+      return(FALSE);
+
+   db->nRecords = 0;
+   db->maxLen   = 0;
+   for(line=db->text; line!=NULL; line=next)
+   {
+      if((next = strchr(line, '\n'))!=NULL)
+         *(next++) = '\0';
+      if((chp = strchr(line, '#'))!=NULL)
+         *chp = '\0';
+      KILLTRAILSPACES(line);
+      if(!line[0])
+         continue;
+
+      /* The PDB code and residues, then the length                     */
+      db->records[db->nRecords] = line;
+      db->loopLen[db->nRecords] = -1;
+      chp = line;
+      for(field=0; field<3; field++)
+      {
+         while((*chp == ' ') || (*chp == '\t'))
+            chp++;
+         if(!*chp)
+            break;
+         while(*chp && (*chp != ' ') && (*chp != '\t'))
+            chp++;
+      }
+      if(field == 3)
+      {
+         value = strtol(chp, &end, 10);
+         if((end != chp) && (value >= 0) && (value <= LDB_MAXLENGTH))
+         {
+            db->loopLen[db->nRecords]   = (int)value;
+            db->distances[db->nRecords] = end;
+            db->maxLen = MAX(db->maxLen, (int)value);
+         }
+      }
+      db->nRecords++;
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL IndexLengths(LOOPDB *db)
+   ------------------------------------
+*//**
+   \param[in,out]  *db    Handle with the records read
+
+   Makes the list of records of each length, in database order
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL IndexLengths(LOOPDB *db)
+{
+   LDBLENGTH *len;
+   long      r;
+   int       i;
+
+   if((db->lengths = (LDBLENGTH *)calloc(db->maxLen + 1,
+                                         sizeof(LDBLENGTH)))==NULL)
+      return(FALSE);
+
+   for(r=0; r<db->nRecords; r++)
+   {
+      if(db->loopLen[r] >= 0)
+         db->lengths[db->loopLen[r]].nRecords++;
+   }
+   for(i=0; i<=db->maxLen; i++)
+   {
+      len = db->lengths + i;
+      if(len->nRecords &&
+         ((len->records = (long *)malloc(len->nRecords * sizeof(long)))
+          ==NULL))
+      {
+         for(i--; i>=0; i--)
+            free(db->lengths[i].records);
+         return(FALSE);
+      }
+      len->nRecords = 0;
+   }
+   for(r=0; r<db->nRecords; r++)
+   {
+      if(db->loopLen[r] >= 0)
+      {
+         len = db->lengths + db->loopLen[r];
+         len->records[len->nRecords++] = r;
+      }
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static void AddHit(LOOPDBHIT *hits, int *nHits, int maxHits,
+                      long record, REAL score)
+   ------------------------------------------------------------
+*//**
+   \param[in,out]  *hits     The best hits so far, as a heap with the
+                             worst first
+   \param[in,out]  *nHits    Number of hits in the heap
+   \param[in]      maxHits   Size of the heap
+   \param[in]      record    Record that matched
+   \param[in]      score     Its score
+
+   Keeps the best maxHits hits. Hits with equal scores are ranked in
+   database order.
+
+-  18.10.26 Original   By: ACRM
+*/
+static void AddHit(LOOPDBHIT *hits, int *nHits, int maxHits, long record,
+                   REAL score)
+{
+   LOOPDBHIT hit,
+             tmp;
+   int       i,
+             child;
+
+   if(maxHits < 1)
+      return;
+
+   hit.record = record;
+   hit.score  = score;
+   hit.rmsd   = (REAL)(-1.0);
+
+   if(*nHits < maxHits)
+   {
+      /* Sift up                                                        */
+      i = (*nHits)++;
+      hits[i] = hit;
+      while((i > 0) && (cmpHits(&(hits[(i-1)/2]), &(hits[i])) < 0))
+      {
+         tmp             = hits[(i-1)/2];
+         hits[(i-1)/2]   = hits[i];
+         hits[i]         = tmp;
+         i               = (i-1)/2;
+      }
+      return;
+   }
+
+   /* Records arrive in order so an equal score is never better         */
+   if(score >= hits[0].score)
+      return;
+
+   /* Replace the worst and sift down                                   */
+   hits[0] = hit;
+   i = 0;
+   while((child = 2*i + 1) < *nHits)
+   {
+      if((child+1 < *nHits) &&
+         (cmpHits(&(hits[child+1]), &(hits[child])) > 0))
+         child++;
+      if(cmpHits(&(hits[i]), &(hits[child])) >= 0)
+         break;
+      tmp         = hits[i];
+      hits[i]     = hits[child];
+      hits[child] = tmp;
+      i           = child;
+   }
+}
+
+
+/************************************************************************/
+/*>static int cmpHits(const void *p1, const void *p2)
+   --------------------------------------------------
+*//**
+   \param[in]  *p1    Pointer to first hit
+   \param[in]  *p2    Pointer to second hit
+   \return            -1, 0 or 1 for ranking by score, then database
+                      order
+
+   Comparison routine used by qsort()
+
+-  18.10.26 Original   By: ACRM
+*/
+static int cmpHits(const void *p1, const void *p2)
+{
+   LOOPDBHIT *h1 = (LOOPDBHIT *)p1,
+             *h2 = (LOOPDBHIT *)p2;
+
+   if(h1->score < h2->score)
+      return(-1);
+   if(h1->score > h2->score)
+      return(+1);
+   if(h1->record < h2->record)
+      return(-1);
+   if(h1->record > h2->record)
+      return(+1);
+   return(0);
+}
+
+
+/************************************************************************/
+/*>static int cmpHitRMSD(const void *p1, const void *p2)
+   -----------------------------------------------------
+*//**
+   \param[in]  *p1    Pointer to first hit
+   \param[in]  *p2    Pointer to second hit
+   \return            -1, 0 or 1 for ranking by RMSD. Hits without an
+                      RMSD (negative) sort after all others and ties
+                      are ranked as by cmpHits()
+
+   Comparison routine used by qsort() when reranking by RMSD
+
+-  18.10.26 Original   By: ACRM
+*/
+static int cmpHitRMSD(const void *p1, const void *p2)
+{
+   REAL r1 = ((LOOPDBHIT *)p1)->rmsd,
+        r2 = ((LOOPDBHIT *)p2)->rmsd;
+
+   if((r1 < 0.0) != (r2 < 0.0))
+      return((r1 < 0.0)?(+1):(-1));
+   if(r1 < r2)
+      return(-1);
+   if(r2 < r1)
+      return(+1);
+   return(cmpHits(p1, p2));
+}
+
+
+/************************************************************************/
+/*>static LOOP *ScanMatrix(REAL distMat[MAXSTEM][MAXSTEM], int nStem, 
+                           int loopLen, FILE *dbf, REAL tolerance,
+                           LOOPDBSTATS *stats)
+   --------------------------------------------------------------------
+*//**
+   \param[in]  distMat[][] distance matrix from our structure
+   \param[in]  nStem       Stem size of the database
+   \param[in]  loopLen     Loop length
+   \param[in]  *dbf        File pointer for database file
+   \param[in]  tolerance   Allowed tolerance for an individual distance
+   \param[in,out] *stats   Counts (or NULL)
+   \return                 Linked list of loops that match the criteria
+
+   Does the actual work of sanning the distance matrix for the residues
+   in question against the database
+
+-  14.07.15 Original   By: ACRM
+-  18.10.26 Record checking moved into ScanRecord()
+-  18.10.26 Counts bytes read for --stats
+-  18.10.26 Counts into stats rather than a global. Moved into the
+            library
+*/
+static LOOP *ScanMatrix(REAL distMat[MAXSTEM][MAXSTEM], int nStem, 
+                        int loopLen, FILE *dbf, REAL tolerance,
+                        LOOPDBSTATS *stats)
+{
+   char buffer[DB_MAXLINE];
+   long record = 0;
+   LOOP *loops = NULL,
+        *l = NULL;
+
+
+   while(fgets(buffer, DB_MAXLINE, dbf))
+   {
+      if(stats != NULL)
+         stats->bytesRead += strlen(buffer);
+      if(!ScanRecord(buffer, distMat, nStem, loopLen, tolerance, &record,
+                     &loops, &l, stats))
+         return(NULL);
+   }
+   return(loops);
+}
+
+
+/************************************************************************/
+/*>static LOOP *ScanMatrixQF(REAL distMat[MAXSTEM][MAXSTEM],
+                             int nStem, int loopLen, FILE *dbf,
+                             QFILTER *qf, REAL tolerance,
+                             LOOPDBSTATS *stats)
+   --------------------------------------------------------------
+*//**
+   \param[in]  distMat[][] distance matrix from our structure
+   \param[in]  nStem       Stem size of the database
+   \param[in]  loopLen     Loop length
+   \param[in]  *dbf        File pointer for database file
+   \param[in]  *qf         Quantized filter sidecar for the database
+   \param[in]  tolerance   Allowed tolerance for an individual distance
+   \param[in,out] *stats   Counts (or NULL)
+   \return                 Linked list of loops that match the criteria
+
+   As ScanMatrix(), but runs the coarse filter over the sidecar first
+   and only reads and checks the records that survive it. Survivors are
+   visited in database order so the results are identical to those
+   from ScanMatrix().
+
+-  18.10.26 Original   By: ACRM
+*/
+static LOOP *ScanMatrixQF(REAL distMat[MAXSTEM][MAXSTEM], int nStem, 
+                          int loopLen, FILE *dbf, QFILTER *qf,
+                          REAL tolerance, LOOPDBSTATS *stats)
+{
+   char          buffer[DB_MAXLINE];
+   unsigned char cMin[MAXDIST],
+                 cMax[MAXDIST],
+                 ok[QF_BLOCKSIZE];
+   long          block;
+   int           r;
+   LOOP          *loops = NULL,
+                 *l = NULL;
+
+   QFilterBounds(qf, distMat, tolerance, cMin, cMax);
+   if(stats != NULL)
+      stats->nSidecar += qf->header->nRecords;
+
+   for(block=0; block<qf->nBlocks; block++)
+   {
+      if(QFilterBlock(qf, block, loopLen, cMin, cMax, ok))
+      {
+         for(r=0; r<QF_BLOCKSIZE; r++)
+         {
+            if(ok[r])
+            {
+               long record = block * QF_BLOCKSIZE + r;
+               
+               if(fseek(dbf, qf->offsets[record], SEEK_SET) ||
+                  !fgets(buffer, DB_MAXLINE, dbf))
+               {
+                  fprintf(stderr,"Error: Failed to read database record \
+%ld\n", record);
+                  FREELIST(loops, LOOP);
+                  return(NULL);
+               }
+               if(stats != NULL)
+               {
+                  stats->nPassed++;
+                  stats->bytesRead += strlen(buffer);
+               }
+               
+               if(!ScanRecord(buffer, distMat, nStem, loopLen, 
+                              tolerance, &record, &loops, &l, stats))
+                  return(NULL);
+            }
+         }
+      }
+   }
+   return(loops);
+}
+
+
+/************************************************************************/
+/*>static LOOP *ScanReference(REAL distMat[MAXSTEM][MAXSTEM],
+                              int nStem, int loopLen, FILE *dbf,
+                              REAL tolerance)
+   ---------------------------------------------------------------
+*//**
+   \param[in]  distMat[][] distance matrix from our structure
+   \param[in]  nStem       Stem size of the database
+   \param[in]  loopLen     Loop length
+   \param[in]  *dbf        File pointer for database file
+   \param[in]  tolerance   Allowed tolerance for an individual distance
+   \return                 Linked list of loops that match the criteria
+
+   The reference implementation of ScanMatrix(), used with --reference.
+   This is the original scan, changed only to handle the stem size and
+   to record what the RMSD reranking needs: every record is read in
+   full with sscanf() before any distance is checked. It is kept
+   simple so that faster scans can be checked against it (see
+   test/difftest.sh) and must give exactly the same list, so it should
+   not be optimized.
+
+-  14.07.15 Original (as ScanMatrix())   By: ACRM
+-  18.10.26 Handles the stem size. Records the record number for RMSD
+            reranking
+-  18.10.26 Terminates the saved record
+-  18.10.26 Moved into the library
+*/
+static LOOP *ScanReference(REAL distMat[MAXSTEM][MAXSTEM], int nStem,
+                           int loopLen, FILE *dbf, REAL tolerance)
+{
+   char buffer[DB_MAXLINE],
+        format[SMALLBUFF + 4*MAXSTEM*MAXSTEM],
+        pdbCode[SMALLBUFF],
+        startRes[SMALLBUFF],
+        endRes[SMALLBUFF];
+   REAL thisMat[MAXSTEM*MAXSTEM];
+   int  i, j,
+        thisLoopLen;
+   long record = 0;
+   LOOP *loops = NULL,
+        *l = NULL;
+
+   /* The record format for this stem size                              */
+   strcpy(format, "%s%s%s%d");
+   for(i=0; i<nStem*nStem; i++)
+      strcat(format, "%lf");
+
+   while(fgets(buffer, DB_MAXLINE, dbf))
+   {
+      char *chp;
+      TERMINATE(buffer);
+      if((chp = strchr(buffer, '#'))!=NULL)
+         *chp = '\0';
+      KILLTRAILSPACES(buffer);
+      if(strlen(buffer))
+      {
+         record++;
+         if(sscanf(buffer, format,
+                   pdbCode, startRes, endRes, &thisLoopLen,
+                   &(thisMat[0]),  &(thisMat[1]),  &(thisMat[2]),
+                   &(thisMat[3]),  &(thisMat[4]),  &(thisMat[5]),
+                   &(thisMat[6]),  &(thisMat[7]),  &(thisMat[8]),
+                   &(thisMat[9]),  &(thisMat[10]), &(thisMat[11]),
+                   &(thisMat[12]), &(thisMat[13]), &(thisMat[14]),
+                   &(thisMat[15]), &(thisMat[16]), &(thisMat[17]),
+                   &(thisMat[18]), &(thisMat[19]), &(thisMat[20]),
+                   &(thisMat[21]), &(thisMat[22]), &(thisMat[23]),
+                   &(thisMat[24])) == 4 + nStem*nStem)
+         {
+            REAL score = 0.0;
+
+            if(thisLoopLen == loopLen)
+            {
+               BOOL ok = TRUE;
+               for(i=0; i<nStem; i++)
+               {
+                  for(j=0; j<nStem; j++)
+                  {
+                     REAL badness = ABS(distMat[i][j] - 
+                                        thisMat[i*nStem + j]);
+                     if(badness > tolerance)
+                     {
+                        ok = FALSE;
+                        i = j = 10;
+                        break;
+                     }
+                     score += badness;
+                  }
+               }
+               if(ok)
+               {
+                  if(loops == NULL)
+                  {
+                     INIT(loops, LOOP);
+                     l = loops;
+                  }
+                  else
+                  {
+                     ALLOCNEXT(l, LOOP);
+                  }
+
+                  if(l==NULL)
+                  {
+                     FREELIST(loops, LOOP);
+                     return(NULL);
+                  }
+
+                  /* Save the data                                      */
+                  l->score  = score;
+                  l->rmsd   = (REAL)(-1.0);
+                  l->record = record - 1;
+                  strncpy(l->buffer,   buffer,   DB_MAXLINE-1);
+                  l->buffer[DB_MAXLINE-1] = '\0';
+                  strncpy(l->pdbcode,  pdbCode,  LDB_MAXFIELD);
+                  strncpy(l->startRes, startRes, LDB_MAXFIELD);
+                  strncpy(l->endRes,   endRes,   LDB_MAXFIELD);
+               }
+            }
+         }
+      }
+   }
+   return(loops);
+}
+
+
+/************************************************************************/
+/*>static BOOL ScanRecord(char *buffer, REAL distMat[MAXSTEM][MAXSTEM], 
+                          int nStem, int loopLen, REAL tolerance, 
+                          long *record, LOOP **pLoops, LOOP **pLast,
+                          LOOPDBSTATS *stats)
+   ----------------------------------------------------------------------
+*//**
+   \param[in]     *buffer     Line from the database file
+   \param[in]     distMat[][] distance matrix from our structure
+   \param[in]     nStem       Stem size of the database
+   \param[in]     loopLen     Loop length
+   \param[in]     tolerance   Allowed tolerance for an individual 
+                              distance
+   \param[in,out] *record     Record number of this line; incremented
+                              if the line is a record rather than a
+                              comment
+   \param[in,out] **pLoops    Linked list of loops that match
+   \param[in,out] **pLast     Last item in the linked list
+   \param[in,out] *stats      Counts (or NULL)
+   \return                    FALSE if memory allocation failed (the
+                              list is freed)
+
+   Checks a single database record against the distance matrix and
+   appends it to the list of loops if it matches. The distances are
+   only read if the loop length matches and are then checked by the
+   kernel for the stem size (see scankernel.h).
+
+-  18.10.26 Original, split out of ScanMatrix()   By: ACRM
+*/
+static BOOL ScanRecord(char *buffer, REAL distMat[MAXSTEM][MAXSTEM],
+                       int nStem, int loopLen, REAL tolerance,
+                       long *record, LOOP **pLoops, LOOP **pLast,
+                       LOOPDBSTATS *stats)
+{
+   char pdbCode[SMALLBUFF],
+        startRes[SMALLBUFF],
+        endRes[SMALLBUFF],
+        *chp;
+   REAL score;
+   int  thisLoopLen,
+        nChar    = 0,
+        failCell = 0;
+   BOOL match    = FALSE;
+   double t      = 0.0;
+   LOOP *l = *pLast;
+
+   TERMINATE(buffer);
+   if((chp = strchr(buffer, '#'))!=NULL)
+      *chp = '\0';
+   KILLTRAILSPACES(buffer);
+   if(strlen(buffer))
+   {
+      (*record)++;
+      if(stats != NULL)
+         stats->nRecords++;
+
+      if((sscanf(buffer,"%s%s%s%d%n", pdbCode, startRes, endRes, 
+                 &thisLoopLen, &nChar) == 4) &&
+         (thisLoopLen == loopLen))
+      {
+         if(stats != NULL)
+            t = StatsClock();
+         match = (*sScoreStems[nStem])(buffer+nChar, distMat, tolerance,
+                                       &score, &failCell);
+         if(stats != NULL)
+         {
+            stats->tMatch += StatsClock() - t;
+            if(match)
+               stats->nMatched++;
+            else if(failCell < 0)
+               stats->nMalformed++;
+            else
+               stats->cellReject[failCell]++;
+         }
+      }
+      else if(stats != NULL)
+      {
+         stats->nLength++;
+      }
+      
+      if(match)
+      {
+         if(*pLoops == NULL)
+         {
+            INIT((*pLoops), LOOP);
+            l = *pLoops;
+         }
+         else
+         {
+            ALLOCNEXT(l, LOOP);
+         }
+
+         if(l==NULL)
+         {
+            FREELIST((*pLoops), LOOP);
+            return(FALSE);
+         }
+
+         /* Save the data                                               */
+         l->score  = score;
+         l->rmsd   = (REAL)(-1.0);
+         l->record = *record - 1;
+         strncpy(l->buffer,   buffer,   DB_MAXLINE-1);
+         l->buffer[DB_MAXLINE-1] = '\0';
+         strncpy(l->pdbcode,  pdbCode,  LDB_MAXFIELD);
+         strncpy(l->startRes, startRes, LDB_MAXFIELD);
+         strncpy(l->endRes,   endRes,   LDB_MAXFIELD);
+         *pLast = l;
+      }
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static LOOP *ScanWithCache(REAL distMat[MAXSTEM][MAXSTEM],
+                              int nStem, int loopLen, FILE *dbf,
+                              QFILTER *qf, REAL tolerance,
+                              char *dbFile, char *cacheDir, REAL grid,
+                              LOOPDBSTATS *stats)
+   ---------------------------------------------------------------
+*//**
+   \param[in]  distMat[][] distance matrix from our structure
+   \param[in]  nStem       Stem size of the database
+   \param[in]  loopLen     Loop length
+   \param[in]  *dbf        File pointer for database file
+   \param[in]  *qf         Quantized filter sidecar (or NULL)
+   \param[in]  tolerance   Allowed tolerance for an individual distance
+   \param[in]  *dbFile     Database filename
+   \param[in]  *cacheDir   Query cache directory
+   \param[in]  grid        Grid for rounding cache keys
+   \param[in,out] *stats   Counts (or NULL)
+   \return                 Linked list of loops that match the criteria
+
+   Looks for the query in the cache. On a hit the cached records are
+   rescored against the actual query. On a miss the database is
+   scanned around the grid point with the widened tolerance, the
+   records are saved as a new cache entry and then rescored. Either
+   way the hits are the same as from a direct scan. Empty results are
+   not cached since they can't be told apart from a failed scan.
+
+-  18.10.26 Original   By: ACRM
+*/
+static LOOP *ScanWithCache(REAL distMat[MAXSTEM][MAXSTEM], int nStem, 
+                           int loopLen, FILE *dbf, QFILTER *qf, 
+                           REAL tolerance, char *dbFile, char *cacheDir, 
+                           REAL grid, LOOPDBSTATS *stats)
+{
+   char key[QC_MAXKEY],
+        cacheFile[QC_MAXFILE],
+        tmpFile[QC_MAXFILE],
+        buffer[DB_MAXLINE];
+   REAL centre[MAXSTEM][MAXSTEM],
+        wideTolerance;
+   FILE *cfp;
+   LOOP *loops = NULL,
+        *l     = NULL,
+        *superset,
+        *s;
+
+   if(!MakeCacheKey(dbFile, loopLen, tolerance, grid, nStem, distMat, 
+                    cacheDir, key, cacheFile, centre, &wideTolerance))
+   {
+      fprintf(stderr,"Warning: Unable to create cache key; cache not \
+used\n");
+      if(qf != NULL)
+         return(ScanMatrixQF(distMat, nStem, loopLen, dbf, qf, 
+                             tolerance, stats));
+      return(ScanMatrix(distMat, nStem, loopLen, dbf, tolerance, stats));
+   }
+
+   /* Cache hit - just rescore the cached records                       */
+   if((cfp = OpenCacheEntry(cacheFile, key))!=NULL)
+   {
+      if(stats != NULL)
+         stats->cache = LDB_CACHEHIT;
+      loops = ScanCacheEntry(distMat, nStem, loopLen, cfp, tolerance,
+                             stats);
+      fclose(cfp);
+      return(loops);
+   }
+
+   /* Cache miss - find everything that could match a query in this
+      grid cell
+   */
+   if(stats != NULL)
+      stats->cache = LDB_CACHEMISS;
+   if(qf != NULL)
+      superset = ScanMatrixQF(centre, nStem, loopLen, dbf, qf, 
+                              wideTolerance, stats);
+   else
+      superset = ScanMatrix(centre, nStem, loopLen, dbf, wideTolerance,
+                            stats);
+
+   if(superset == NULL)
+      return(NULL);
+
+   if((cfp = CreateCacheEntry(cacheFile, key, tmpFile))!=NULL)
+   {
+      for(s=superset; s!=NULL; NEXT(s))
+         fprintf(cfp, "%ld\t%s\n", s->record, s->buffer);
+      if(!CommitCacheEntry(cfp, tmpFile, cacheFile))
+         fprintf(stderr,"Warning: Unable to write cache entry %s\n", 
+                 cacheFile);
+   }
+   else
+   {
+      fprintf(stderr,"Warning: Unable to write cache entry %s\n", 
+              cacheFile);
+   }
+
+   /* Rescore against the actual query                                  */
+   for(s=superset; s!=NULL; NEXT(s))
+   {
+      long record = s->record;
+      
+      strncpy(buffer, s->buffer, DB_MAXLINE);
+      if(!ScanRecord(buffer, distMat, nStem, loopLen, tolerance, 
+                     &record, &loops, &l, stats))
+      {
+         loops = NULL;
+         break;
+      }
+   }
+   
+   FREELIST(superset, LOOP);
+   return(loops);
+}
+
+
+/************************************************************************/
+/*>static LOOP *ScanCacheEntry(REAL distMat[MAXSTEM][MAXSTEM],
+                               int nStem, int loopLen, FILE *cfp,
+                               REAL tolerance, LOOPDBSTATS *stats)
+   ----------------------------------------------------------------
+*//**
+   \param[in]  distMat[][] distance matrix from our structure
+   \param[in]  nStem       Stem size of the database
+   \param[in]  loopLen     Loop length
+   \param[in]  *cfp        Cache entry from OpenCacheEntry()
+   \param[in]  tolerance   Allowed tolerance for an individual distance
+   \param[in,out] *stats   Counts (or NULL)
+   \return                 Linked list of loops that match the criteria
+
+   Rescores the records in a cache entry. Each line holds the database
+   record number, a tab and the record itself.
+
+-  18.10.26 Original   By: ACRM
+*/
+static LOOP *ScanCacheEntry(REAL distMat[MAXSTEM][MAXSTEM], int nStem, 
+                            int loopLen, FILE *cfp, REAL tolerance,
+                            LOOPDBSTATS *stats)
+{
+   char buffer[DB_MAXLINE+SMALLBUFF],
+        *chp;
+   long record;
+   LOOP *loops = NULL,
+        *l = NULL;
+
+   while(fgets(buffer, DB_MAXLINE+SMALLBUFF, cfp))
+   {
+      record = strtol(buffer, &chp, 10);
+      if((chp == buffer) || (*chp != '\t'))
+         continue;
+      if(stats != NULL)
+         stats->bytesRead += strlen(buffer);
+      
+      if(!ScanRecord(chp+1, distMat, nStem, loopLen, tolerance, 
+                     &record, &loops, &l, stats))
+         return(NULL);
+   }
+   return(loops);
+}
+
+
+/************************************************************************/
+/*>static LOOP **IndexResults(LOOP *loops, int *nLoops)
+   ----------------------------------------------------
+*//**
+   \param[in]  *loops  Linked list of LOOP structures
+   \param[out] *nLoops Number of loops
+   \return             Array of loop pointers (or NULL if malloc() fails)
+
+   Performs an index sort on an array of pointers to the loop structures.
+   Sorting is on the basis of the score stored in each loop structure.
+
+-  14.07.15 Original   By: ACRM
+-  18.10.26 Moved into the library
+*/
+static LOOP **IndexResults(LOOP *loops, int *nLoops)
+{
+   LOOP *l, 
+        **indx;
+
+   *nLoops = 0;
+
+   /* Count the number of results                                       */
+   for(l=loops; l!=NULL; NEXT(l))
+      (*nLoops)++;
+
+   if((indx = (LOOP **)malloc((*nLoops) * sizeof(LOOP *)))!=NULL)
+   {
+      *nLoops = 0;
+      for(l=loops; l!=NULL; NEXT(l))
+      {
+         indx[(*nLoops)++] = l;
+      }
+
+      qsort(indx, *nLoops, sizeof(LOOP *), cmpResults);
+   }
+
+   return(indx);
+}
+
+
+/************************************************************************/
+/*>static void RescoreByRMSD(LOOP **indx, int nLoops, LOOPCOORDS *lc,
+                             SUPATOMS *queryStems)
+   ------------------------------------------------------------------
+*//**
+   \param[in,out] **indx      Index of loops sorted by score
+   \param[in]     nLoops      Number of loops to rescore
+   \param[in]     *lc         Loop coordinates
+   \param[in]     *queryStems Takeoff atoms from the query structure
+
+   Superimposes the takeoff residues of each loop on those of the query
+   and sorts the index by the resulting RMSD. Loops whose coordinates
+   are not available are placed at the end with an RMSD of -1.
+
+-  18.10.26 Original   By: ACRM
+*/
+static void RescoreByRMSD(LOOP **indx, int nLoops, LOOPCOORDS *lc,
+                          SUPATOMS *queryStems)
+{
+   int i;
+
+   for(i=0; i<nLoops; i++)
+      indx[i]->rmsd = LoopRMSD(lc, indx[i]->record, queryStems);
+
+   qsort(indx, nLoops, sizeof(LOOP *), cmpRMSD);
+}
+
+
+/************************************************************************/
+/*>static int cmpResults(const void *p1, const void *p2)
+   -----------------------------------------------------
+*//**
+   \param[in]  *p1    Pointer to first LOOP pointer
+   \param[in]  *p2    Pointer to second LOOP pointer
+   \return            -1: First is smaller;
+                       0: Values are equal;
+                      +1: First is larger
+
+   Comparison routine used by qsort(). Equal scores are ranked by
+   record number, as by cmpHits(), since qsort() need not keep them in
+   database order.
+
+-  14.07.15 Original   By: ACRM
+-  18.10.26 Moved into the library
+-  18.10.26 Ties are broken on the record number
+*/
+static int cmpResults(const void *p1, const void *p2)
+{
+   REAL s1, s2;
+   long r1, r2;
+
+   /* The input values are pointers to the LOOP pointers. We therefore
+      first cast them to the correct type (LOOP **), dereference this
+      to get a LOOP pointer and then extract the score from this.
+   */
+   s1 = (*((LOOP **)p1))->score;
+   s2 = (*((LOOP **)p2))->score;
+
+   if(s1 < s2)
+   {
+      return(-1);
+   }
+   if(s2 < s1)
+   {
+      return(+1);
+   }
+
+   r1 = (*((LOOP **)p1))->record;
+   r2 = (*((LOOP **)p2))->record;
+   if(r1 < r2)
+   {
+      return(-1);
+   }
+   if(r2 < r1)
+   {
+      return(+1);
+   }
+   return(0);
+}
+
+
+/************************************************************************/
+/*>static int cmpRMSD(const void *p1, const void *p2)
+   --------------------------------------------------
+*//**
+   \param[in]  *p1    Pointer to first LOOP pointer
+   \param[in]  *p2    Pointer to second LOOP pointer
+   \return            -1: First is smaller;
+                       0: Values are equal;
+                      +1: First is larger
+
+   Comparison routine used by qsort() when ranking by RMSD. Loops
+   without an RMSD (negative) sort after all others and ties are broken
+   on the distance score.
+
+-  18.10.26 Original   By: ACRM
+*/
+static int cmpRMSD(const void *p1, const void *p2)
+{
+   REAL r1, r2;
+
+   r1 = (*((LOOP **)p1))->rmsd;
+   r2 = (*((LOOP **)p2))->rmsd;
+
+   if((r1 < 0.0) != (r2 < 0.0))
+   {
+      return((r1 < 0.0)?(+1):(-1));
+   }
+   if(r1 < r2)
+   {
+      return(-1);
+   }
+   if(r2 < r1)
+   {
+      return(+1);
+   }
+   return(cmpResults(p1, p2));
+}
@@ -0,0 +1,330 @@
+/************************************************************************/
+/**
+
+   \file       libscantest.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Runs a scanloopdb query through a libloopdb handle
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   A driver for test/difftest.sh. Takes the query options of
+   scanloopdb (-l, -t, -n, -r, -c and -M), loads the database with
+   LoopDBOpen() and scans it with LoopDBScan(), printing the hits as
+   scanloopdb prints them. The output should be the same as that of
+   scanloopdb given the same options.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bioplib/pdb.h"
+#include "bioplib/general.h"
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXBUFF 160
+#define SMALLBUFF 16
+#define DEF_STARTRES  "H95"       /* As scanloopdb                       */
+#define DEF_ENDRES    "H102"
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+int  main(int argc, char **argv);
+BOOL ParseCmdLine(int argc, char **argv, char *dbFile, char *infile,
+                  char *outfile, char *coordsFile, char *startRes,
+                  char *endRes, REAL *tolerance, int *numResult,
+                  int *loopLen, int *shortList);
+void Usage(void);
+
+
+/************************************************************************/
+/*>int main(int argc, char **argv)
+   -------------------------------
+*//**
+   Main program
+
+-  18.10.26 Original   By: ACRM
+*/
+int main(int argc, char **argv)
+{
+   char        dbFile[MAXBUFF],
+               infile[MAXBUFF],
+               outfile[MAXBUFF],
+               coordsFile[MAXBUFF],
+               startRes[SMALLBUFF],
+               endRes[SMALLBUFF];
+   REAL        tolerance;
+   int         numResult,
+               loopLen,
+               shortList,
+               natoms,
+               nRes = 0,
+               nHits,
+               i;
+   long        maxHits;
+   BOOL        withRMSD;
+   LOOPDB      *db;
+   LOOPDBQUERY query;
+   LOOPDBHIT   *hits;
+   PDB         *pdb;
+   BBRES       *backbone = NULL;
+   FILE        *in  = stdin,
+               *out = stdout;
+
+   if(!ParseCmdLine(argc, argv, dbFile, infile, outfile, coordsFile,
+                    startRes, endRes, &tolerance, &numResult, &loopLen,
+                    &shortList))
+   {
+      Usage();
+      return(0);
+   }
+
+   if((db = LoopDBOpen(dbFile, coordsFile))==NULL)
+   {
+      fprintf(stderr,"Error (libscantest): Unable to load database %s\n",
+              dbFile);
+      return(1);
+   }
+
+   if(!blOpenStdFiles(infile, outfile, &in, &out))
+   {
+      fprintf(stderr,"Error (libscantest): Unable to open input/output \
+files\n");
+      return(1);
+   }
+
+   if((pdb = blReadPDBAtoms(in, &natoms))==NULL)
+   {
+      fprintf(stderr,"Error (libscantest): No atoms read from PDB \
+file\n");
+      return(1);
+   }
+   if((LoopDBCoords(db) != NULL) &&
+      ((backbone = ExtractBackbone(pdb, &nRes))==NULL))
+   {
+      fprintf(stderr,"Error (libscantest): No memory for backbone\n");
+      return(1);
+   }
+   if((pdb = blSelectCaPDB(pdb))==NULL)
+      return(0);
+
+   /* As scanloopdb, a loop that isn't there gives no hits              */
+   if(!LoopDBMakeQuery(pdb, startRes, endRes, loopLen,
+                       LoopDBStemSize(db), &query))
+      return(0);
+   query.tolerance = tolerance;
+   query.shortList = shortList;
+   withRMSD = (backbone != NULL) &&
+              LoopDBQueryStems(&query, backbone, nRes);
+
+   maxHits = LoopDBCandidates(db, query.loopLen);
+   if((numResult > 0) && (numResult < maxHits))
+      maxHits = numResult;
+   if((hits = (LOOPDBHIT *)malloc((maxHits+1) * sizeof(LOOPDBHIT)))
+      ==NULL)
+   {
+      fprintf(stderr,"Error (libscantest): No memory for hits\n");
+      return(1);
+   }
+
+   if((nHits = LoopDBScan(db, &query, hits, (int)maxHits, NULL)) < 0)
+   {
+      fprintf(stderr,"Error (libscantest): Scan failed\n");
+      return(1);
+   }
+
+   for(i=0; i<nHits; i++)
+   {
+      if(withRMSD)
+         fprintf(out, "%s : %f %f\n", LoopDBRecord(db, hits[i].record),
+                 hits[i].score, hits[i].rmsd);
+      else
+         fprintf(out, "%s : %f\n", LoopDBRecord(db, hits[i].record),
+                 hits[i].score);
+   }
+
+   free(hits);
+   FREELIST(pdb, PDB);
+   free(backbone);
+   LoopDBClose(db);
+
+   return(0);
+}
+
+
+/************************************************************************/
+/*>BOOL ParseCmdLine(int argc, char **argv, char *dbFile, char *infile,
+                     char *outfile, char *coordsFile, char *startRes,
+                     char *endRes, REAL *tolerance, int *numResult,
+                     int *loopLen, int *shortList)
+   ---------------------------------------------------------------------
+*//**
+   \param[in]  argc         Argument count
+   \param[in]  **argv       Argument array
+   \param[out] *dbFile      Database file
+   \param[out] *infile      Input file (or blank string)
+   \param[out] *outfile     Output file (or blank string)
+   \param[out] *coordsFile  Loop coordinate file (or blank string)
+   \param[out] *startRes    First residue of the loop
+   \param[out] *endRes      Last residue of the loop
+   \param[out] *tolerance   Max deviation on an individual distance
+   \param[out] *numResult   Number of results to print (0 = all)
+   \param[out] *loopLen     Loop length (0 = as in the query)
+   \param[out] *shortList   Number of hits to rerank by RMSD
+   \return                  Success
+
+   Parse the command line. The options and defaults are those of
+   scanloopdb.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL ParseCmdLine(int argc, char **argv, char *dbFile, char *infile,
+                  char *outfile, char *coordsFile, char *startRes,
+                  char *endRes, REAL *tolerance, int *numResult,
+                  int *loopLen, int *shortList)
+{
+   int arg;
+
+   dbFile[0] = infile[0] = outfile[0] = coordsFile[0] = '\0';
+   strcpy(startRes, DEF_STARTRES);
+   strcpy(endRes,   DEF_ENDRES);
+   *tolerance = DEF_LDBTOLERANCE;
+   *shortList = DEF_LDBSHORTLIST;
+   *numResult = *loopLen = 0;
+
+   for(arg=1; arg<argc; arg++)
+   {
+      if(argv[arg][0] != '-')
+         break;
+
+      switch(argv[arg][1])
+      {
+      case 't':
+         if((++arg >= argc) || !sscanf(argv[arg], "%lf", tolerance))
+            return(FALSE);
+         break;
+      case 'n':
+         if((++arg >= argc) || !sscanf(argv[arg], "%d", numResult))
+            return(FALSE);
+         break;
+      case 'l':
+         if((++arg >= argc) || !sscanf(argv[arg], "%d", loopLen))
+            return(FALSE);
+         break;
+      case 'r':
+         if((arg+2 >= argc) || (strlen(argv[arg+1]) >= SMALLBUFF) ||
+            (strlen(argv[arg+2]) >= SMALLBUFF))
+            return(FALSE);
+         strcpy(startRes, argv[++arg]);
+         strcpy(endRes,   argv[++arg]);
+         break;
+      case 'c':
+         if(++arg >= argc)
+            return(FALSE);
+         strncpy(coordsFile, argv[arg], MAXBUFF-1);
+         coordsFile[MAXBUFF-1] = '\0';
+         break;
+      case 'M':
+         if((++arg >= argc) || !sscanf(argv[arg], "%d", shortList) ||
+            (*shortList < 1))
+            return(FALSE);
+         break;
+      default:
+         return(FALSE);
+      }
+   }
+
+   if((arg >= argc) || (argc - arg > 3))
+      return(FALSE);
+   strncpy(dbFile, argv[arg++], MAXBUFF-1);
+   dbFile[MAXBUFF-1] = '\0';
+   if(arg < argc)
+   {
+      strncpy(infile, argv[arg++], MAXBUFF-1);
+      infile[MAXBUFF-1] = '\0';
+   }
+   if(arg < argc)
+   {
+      strncpy(outfile, argv[arg++], MAXBUFF-1);
+      outfile[MAXBUFF-1] = '\0';
+   }
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void Usage(void)
+   ----------------
+*//**
+   Prints a usage message
+
+-  18.10.26 Original   By: ACRM
+*/
+void Usage(void)
+{
+   fprintf(stderr,"\nlibscantest V1.0 (c) 2015-26 UCL, Dr. Andrew C.R. \
+Martin.\n");
+
+   fprintf(stderr,"\nUsage: libscantest [-l length][-t tol][-n count]\
+[-r startres endres]\n");
+   fprintf(stderr,"                   [-c coords.bb [-M count]] \
+loopdb.db [in.pdb [out.txt]]\n");
+
+   fprintf(stderr,"\nRuns a scanloopdb query through LoopDBOpen() and \
+LoopDBScan() and\n");
+   fprintf(stderr,"prints the hits as scanloopdb would. The options \
+are those of scanloopdb.\n");
+   fprintf(stderr,"Used by test/difftest.sh to check that the library \
+and scanloopdb agree.\n\n");
+}
@@ -0,0 +1,4006 @@
+/************************************************************************/
+/**
+
+   \file       loopbuild.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Builds a loop database behind a libloopdb build handle
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   The build pipeline of buildloopdb, as part of libloopdb, so that a
+   program can build a database without running buildloopdb.
+
+   The options are set in a LOOPDBBUILDOPTS, starting from the defaults
+   given by LoopDBBuildDefaults(); each field corresponds to an option
+   of buildloopdb (see loopdb.h). LoopDBBuildOpen() checks the options
+   and opens the inputs and outputs, giving an opaque LOOPDBBUILD
+   handle which holds everything the build needs.
+   LoopDBBuildRun() works through the PDB files (or the CA pack, or a
+   single PDB file) and LoopDBBuildClose() completes the outputs and
+   writes the --stats report.
+
+   Each PDB file is read (after an optional pre-screen and filtering on
+   the experimental details), checked for a complete backbone, reduced
+   to its CAs and searched for stretches whose takeoff distances lie
+   within the distance tables of each output (see RunAnalysis()).
+
+   Errors part way through the build, such as running out of memory or
+   failing to write an output, are reported and stop the build; they
+   never end the program. LoopDBBuildRun() then returns FALSE and the
+   last checkpoint is kept so that the build can be resumed.
+   The hardware counters used for a countersFile are process-wide (see
+   runstats.c) so only one build at a time should use them.
+
+   Link with libloopdb.a and the bioplib and pthread libraries.
+
+**************************************************************************
+
+   Usage:
+   ======
+   LOOPDBBUILDOPTS opts;
+   LOOPDBBUILD     *build;
+   BOOL            ok;
+
+   LoopDBBuildDefaults(&opts);
+   strcpy(opts.infile,  "pdbdir");
+   strcpy(opts.outfile, "loops.db");
+   if((build = LoopDBBuildOpen(&opts))!=NULL)
+   {
+      ok = LoopDBBuildRun(build);
+      if(!LoopDBBuildClose(build) || !ok)
+         return(1);
+   }
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original, from buildloopdb V1.19. The globals are
+                    now fields of the build handle   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <time.h>
+#include <unistd.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "bioplib/pdb.h"
+#include "bioplib/general.h"
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXBUFF                160
+#define MAX_BOND_DISTANCE_SQ     4.0  /* max bond length of 2.0A        */
+#define NSLOWFILES              10    /* Slowest files in --stats       */
+
+/* Phases timed for --stats and --counters                             */
+#define BP_READ                  0
+#define BP_BACKBONE              1
+#define BP_SELECTCA              2
+#define BP_ANALYSIS              3
+#define BP_OUTPUT                4
+#define BP_DEDUP                 5
+#define NBUILDPHASE              6
+
+/* Time a phase; STATS_STOP() also starts the next one                  */
+#define STATS_START(s, m)                                                \
+   do { if((s) != NULL) StatsMark(&((s)->phases), &(m)); }               \
+   while(0)
+#define STATS_STOP(s, m, phase)                                          \
+   do { if((s) != NULL) StatsPhase(&((s)->phases), &(m), phase); }      \
+   while(0)
+
+typedef struct dboutput
+{
+   struct dboutput *next; /* Output for another loop type (or NULL)     */
+   REAL     minTable[MAXSTEM][MAXSTEM], /* Distance ranges for this     */
+            maxTable[MAXSTEM][MAXSTEM]; /* loop type                    */
+   int      nStem,      /* Residues in each stem                        */
+            minLength,  /* Loop length range (maxLength 0 = no limit)   */
+            maxLength;
+   BOOL     wanted;     /* Used by RunAnalysis()                        */
+   int      failCell;   /* Distance (i*nStem+j) that rejected the last
+                           candidate; set by the stem kernels           */
+   FILE     *out;       /* Text database                                */
+   long     offset;     /* Current byte offset in the text database     */
+   QFWRITER *qw;        /* Quantized filter sidecar (or NULL)           */
+   LCWRITER *lw;        /* Loop coordinate file (or NULL)               */
+   FILE     *mf;        /* Manifest (or NULL)                           */
+   CPWRITER *cw;        /* CA pack being written (or NULL)              */
+   long     nRecords;   /* Records written                              */
+}  DBOUTPUT;
+
+typedef struct
+{
+   MANIFEST   *manifest; /* Manifest of the previous build              */
+   FILE       *db;       /* Previous database                           */
+   long       *offsets,  /* Offset of each record in the previous db    */
+              nRecords;
+   LOOPCOORDS *lc;       /* Previous coordinates (or NULL)              */
+}  PREVBUILD;
+
+typedef struct
+{
+   char     file[MAXBUFF];
+   double   seconds;
+   long     atoms;
+}  SLOWFILE;
+
+typedef struct
+{
+   double   tStart;     /* When the build started                       */
+   PHASESTATS phases;   /* Time (and counters) in each phase            */
+   FILE     *fpCounters;/* Per-file counters for --counters (or NULL)   */
+   long     nFiles,     /* Files processed                              */
+            nReused,    /* Files whose records came from -u             */
+            nUnreadable,
+            nNoAtoms,
+            nIncomplete,/* Rejected by BackboneComplete()               */
+            nNoCa,
+            nExptl,     /* Rejected by the experimental filters         */
+            nChains,    /* Chains compared by --dedup                   */
+            nWithin,    /* ...aliases of a chain in the same entry      */
+            nAcross,    /* ...aliases of a chain in an earlier entry    */
+            nAtoms,
+            nResidues,
+            nCandidates,/* Stem pairs tested                            */
+            nChainBreak,/* ...rejected by a chain break                 */
+            nLength,    /* ...not wanted by any output at that length   */
+            nAccepted,  /* ...accepted by at least one output           */
+            nRecords,   /* Records written (over all outputs)           */
+            cellReject[MAXDIST]; /* ...rejected by each distance        */
+   int      nStem,
+            nSlow;
+   SLOWFILE slow[NSLOWFILES]; /* Slowest files, slowest first           */
+}  BUILDSTATS;
+
+typedef struct
+{
+   PDB      *n0,        /* First N-terminal stem residue                */
+            *c0;        /* First C-terminal stem residue                */
+   int      nIndex,     /* Index of n0 among the CA atoms               */
+            separation; /* Loop length                                  */
+   unsigned long outputs; /* Bit for each output that wants the loop    */
+   REAL     distMat[MAXSTEM][MAXSTEM];
+}  BUILDHIT;
+
+typedef struct
+{
+   PDB      *start,     /* First n[0] searched                          */
+            *stop;      /* n[0] after the last one searched             */
+   int      nIndex;     /* Index of start among the CA atoms            */
+   BUILDHIT *hits;      /* Loops found, in the order found              */
+   long     nHits,
+            maxHits,
+            nLoops,     /* Loops written (summed over outputs)          */
+            nCandidates,/* Counts for --stats (see BUILDSTATS)          */
+            nChainBreak,
+            nLength,
+            nAccepted,
+            cellReject[MAXDIST];
+   BOOL     failed;     /* No memory for the hits                       */
+}  BUILDTASK;
+
+typedef struct
+{
+   LOOPDBBUILD *build;  /* Build the structure is part of               */
+   DBOUTPUT  *dbOut;    /* Database output(s)                           */
+   char      *pdbCode;
+   BBRES     *backbone; /* Backbone for each CA (or NULL)               */
+   STATSMARK *mark;     /* Phase timing (used only if direct)           */
+   BUILDTASK *tasks;
+   int       *nBreaks,  /* Chain breaks before each CA                  */
+             minLength, /* Overall length range of the outputs          */
+             maxLength,
+             nTasks,
+             nextTask;  /* Next task to be started                      */
+   BOOL      direct;    /* Write the loops as they are found            */
+   pthread_mutex_t lock;/* Protects nextTask                            */
+}  BUILDPOOL;
+
+typedef struct
+{
+   BUILDPOOL *pool;
+   DBOUTPUT  check[MAXLOOPTYPES+1]; /* This thread's copy of the outputs
+                                       for the stem kernels             */
+   int       thread;
+}  BUILDWORKER;
+
+struct _loopdbbuild
+{
+   LOOPDBBUILDOPTS opts;
+   char       params[MF_MAXPARAMS]; /* Build parameters for the manifest
+                                       and checkpoint                   */
+   FILE       *in,      /* PDB file (when not a directory)              */
+              *out;     /* Main text database                           */
+   DBOUTPUT   dbOut;    /* Database output(s)                           */
+   PREVBUILD  prevBuild,
+              *prev;    /* Previous build to reuse (or NULL)            */
+   CHECKPOINT ck;
+   CAPACK     *pack;    /* CA pack to run from (or NULL)                */
+   STRINGLIST *fileList;/* PDB files read from the directory            */
+   char       **files;  /* Sorted PDB files (from fileList or the pack) */
+   int        nFiles,
+              first,    /* This run's part of files[]                   */
+              last;
+   BUILDSTATS statsData,
+              *stats;   /* Only set with --stats or --counters          */
+   DEDUP      *dedup;   /* Only set with --dedup                        */
+   EXPTL      entry;    /* Experimental data for this entry             */
+   long       screened[NPRESCREEN]; /* Files skipped by the pre-screen  */
+   int        nThreads; /* Threads for large structures                 */
+   BOOL       preScreen,/* Off with --noprescreen or --reference        */
+              exptl,    /* Records give experimental data               */
+              counters, /* The hardware counters were opened            */
+              failed;   /* An error has stopped the build               */
+};
+
+/************************************************************************/
+/* Globals
+*/
+static char *sScreenReasons[NPRESCREEN] =
+{
+   "usable", "no protein", "CA only", "too short"
+};
+static char *sBuildPhases[NBUILDPHASE] =
+{
+   "read", "backbone_complete", "select_ca", "analysis", "output",
+   "dedup"
+};
+
+/************************************************************************/
+/* Stem kernels, one for each stem size from MINSTEM to MAXSTEM (see
+   buildkernel.h)
+*/
+#define STEM_K 2
+#include "buildkernel.h"
+#undef STEM_K
+#define STEM_K 3
+#include "buildkernel.h"
+#undef STEM_K
+#define STEM_K 4
+#include "buildkernel.h"
+#undef STEM_K
+#define STEM_K 5
+#include "buildkernel.h"
+#undef STEM_K
+
+typedef int (*CHECKSTEMS)(PDB **n, PDB **c, DBOUTPUT *dbOut, int nWanted,
+                          REAL distMat[MAXSTEM][MAXSTEM]);
+static CHECKSTEMS sCheckStems[MAXSTEM+1] =
+{
+   NULL, NULL, CheckStems2, CheckStems3, CheckStems4, CheckStems5
+};
+
+/************************************************************************/
+/* Prototypes
+*/
+static BOOL OpenDirectoryBuild(LOOPDBBUILD *build,
+                               REAL minTable[MAXSTEM][MAXSTEM],
+                               REAL maxTable[MAXSTEM][MAXSTEM]);
+static BOOL OpenFileBuild(LOOPDBBUILD *build,
+                          REAL minTable[MAXSTEM][MAXSTEM],
+                          REAL maxTable[MAXSTEM][MAXSTEM]);
+static void AbandonBuild(LOOPDBBUILD *build);
+static int  RunAnalysis(LOOPDBBUILD *build, DBOUTPUT *dbOut, PDB *pdb,
+                        BBRES *backbone, char *breakAfter,
+                        char *pdbCode);
+static void PrintResults(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                         char *pdbCode, int separation, PDB **n,
+                         PDB **c, REAL distMat[MAXSTEM][MAXSTEM],
+                         BBRES *backbone);
+static void AnalyseTask(BUILDPOOL *pool, BUILDTASK *task,
+                        DBOUTPUT *check);
+static BOOL AddBuildHit(BUILDTASK *task, PDB *n0, PDB *c0, int nIndex,
+                        int separation, unsigned long outputs, int nStem,
+                        REAL distMat[MAXSTEM][MAXSTEM]);
+static void RunAnalysisThreads(BUILDPOOL *pool, int nThreads);
+static void *AnalysisThread(void *arg);
+static int  RunReferenceAnalysis(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                                 PDB *pdb, char *pdbCode);
+static BOOL ChainIsIntact(PDB *start, PDB *end);
+static void PrintReferenceResults(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                                  char *pdbCode, int separation,
+                                  PDB **n, PDB **c,
+                                  REAL distMat[MAXSTEM][MAXSTEM]);
+static void ProcessFile(LOOPDBBUILD *build, FILE *in, DBOUTPUT *dbOut,
+                        char *pdbCode, BOOL verbose);
+static void ProcessFileByChain(LOOPDBBUILD *build, FILE *in,
+                               DBOUTPUT *dbOut, char *pdbCode,
+                               BOOL verbose);
+static int  ScreenResidues(DBOUTPUT *dbOut);
+static BOOL OpenAliases(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                        char *aliasFile, REAL tolerance,
+                        BOOL acrossEntries);
+static BOOL CloseAliases(LOOPDBBUILD *build);
+static int  AnalyseStructure(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                             PDB *pdb, char *pdbCode, PDB *nextCa);
+static void ProcessPackedFile(LOOPDBBUILD *build, CAPACK *pack,
+                              long file, DBOUTPUT *dbOut, char *pdbCode,
+                              BOOL verbose);
+static BOOL ListFiles(LOOPDBBUILD *build);
+static BOOL ProcessAllFiles(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                            BOOL verbose, PREVBUILD *prev,
+                            char *ckFile, int ckInterval,
+                            CHECKPOINT *ck, CAPACK *pack);
+static void InitDBOutput(DBOUTPUT *dbOut, FILE *out, int nStem,
+                         int minLength, int maxLength,
+                         REAL minTable[MAXSTEM][MAXSTEM],
+                         REAL maxTable[MAXSTEM][MAXSTEM]);
+static BOOL OpenDBOutput(DBOUTPUT *dbOut, FILE *out, int nStem,
+                         int minLength, int maxLength,
+                         REAL minTable[MAXSTEM][MAXSTEM],
+                         REAL maxTable[MAXSTEM][MAXSTEM], char *qfFile,
+                         char *coordsFile, char *mfFile, char *params,
+                         char *ckFile);
+static BOOL ResumeDBOutput(DBOUTPUT *dbOut, FILE *out, int nStem,
+                           int minLength, int maxLength,
+                           REAL minTable[MAXSTEM][MAXSTEM],
+                           REAL maxTable[MAXSTEM][MAXSTEM],
+                           char *qfFile, char *coordsFile, char *mfFile,
+                           CHECKPOINT *ck);
+static BOOL CloseDBOutput(DBOUTPUT *dbOut);
+static BOOL OpenLoopTypeOutputs(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                                LOOPTYPE *loopTypes, int nLoopTypes,
+                                char *dirName, int shard, int nShards,
+                                char *qfFile, char *coordsFile);
+static BOOL ReadTables(char *distTable, int nStem,
+                       REAL minTable[MAXSTEM][MAXSTEM],
+                       REAL maxTable[MAXSTEM][MAXSTEM]);
+static BOOL CloseLoopTypeOutputs(DBOUTPUT *dbOut);
+static BOOL Checkpoint(DBOUTPUT *dbOut, CHECKPOINT *ck, char *ckFile);
+static BOOL AddSidecarRecord(QFWRITER *qw, long offset, char *buffer);
+static BOOL OpenPrevBuild(PREVBUILD *prev, char *prevDb, char *prevMf,
+                          char *coordsFile, char *params);
+static void ClosePrevBuild(PREVBUILD *prev);
+static BOOL ReusePrevRecords(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                             PREVBUILD *prev, char *fname,
+                             MFENTRY *entry);
+static void PrintHeader(LOOPDBBUILD *build, FILE *out, char *dirName,
+                        int nStem, int shard, int nShards);
+static int  cmpFilenames(const void *p1, const void *p2);
+static char *MarkChainBreaks(PDB *pdb, int *nRes);
+static BOOL BackboneComplete(PDB *pdb);
+static void RecordFileStats(LOOPDBBUILD *build, char *fname,
+                            double seconds, long atoms);
+static BOOL WriteBuildStats(LOOPDBBUILD *build, char *statsFile);
+
+
+/************************************************************************/
+/*>void LoopDBBuildDefaults(LOOPDBBUILDOPTS *opts)
+   -----------------------------------------------
+*//**
+   \param[out]  *opts     Build options
+
+   Sets the options to the defaults of buildloopdb: a directory of PDB
+   files, loops of at least one residue, stems of NSTEM residues and
+   the default distance table, with none of the extra outputs. All the
+   filenames are blank and the other options are zero (or FALSE).
+
+-  18.10.26 Original, from buildloopdb's ParseCmdLine()   By: ACRM
+*/
+void LoopDBBuildDefaults(LOOPDBBUILDOPTS *opts)
+{
+   memset(opts, 0, sizeof(LOOPDBBUILDOPTS));
+   opts->minLength   = 1;
+   opts->nStem       = NSTEM;
+   opts->ckInterval  = DEF_CKINTERVAL;
+   opts->isDirectory = TRUE;
+   opts->dedupTol    = DEF_DEDUPTOL;
+}
+
+
+/************************************************************************/
+/*>LOOPDBBUILD *LoopDBBuildOpen(LOOPDBBUILDOPTS *opts)
+   ---------------------------------------------------
+*//**
+   \param[in]   *opts     Build options (copied)
+   \return                Build handle (NULL if the options can't be
+                          used together or an input or output can't be
+                          opened; the reason is reported)
+
+   Checks the options and opens everything the build needs: the
+   statistics and counters, the distance tables, the CA pack to run
+   from, the checkpoint to resume from, the previous build to update
+   and the database outputs.
+
+   With packIn, infile is ignored and the PDB directory is the one the
+   pack was built from. When isDirectory is not set, infile is a single
+   PDB file (blank for standard input).
+
+-  18.10.26 Original, from buildloopdb's main()   By: ACRM
+*/
+LOOPDBBUILD *LoopDBBuildOpen(LOOPDBBUILDOPTS *opts)
+{
+   LOOPDBBUILD *build;
+   REAL        minTable[MAXSTEM][MAXSTEM],
+               maxTable[MAXSTEM][MAXSTEM];
+   BOOL        ok;
+
+   if((build = (LOOPDBBUILD *)calloc(1, sizeof(LOOPDBBUILD)))==NULL)
+   {
+      fprintf(stderr,"Error (buildloopdb): No memory for the build\n");
+      return(NULL);
+   }
+   build->opts = *opts;
+   opts        = &(build->opts);
+   build->in   = stdin;
+   build->out  = stdout;
+
+   /* The reference implementation only writes the database            */
+   if(opts->reference &&
+      (opts->qfFile[0] || opts->coordsFile[0] || opts->packFile[0] ||
+       opts->packIn[0] || opts->prevDb[0] || opts->ckFile[0]))
+   {
+      fprintf(stderr,"Error (buildloopdb): --reference cannot be used \
+with -q, -c, -P, -R,\n");
+      fprintf(stderr,"                    -u or -k\n");
+      AbandonBuild(build);
+      return(NULL);
+   }
+   build->preScreen = !(opts->reference || opts->noScreen);
+
+   /* Streaming reads each file twice, one chain at a time, so needs a
+      file and each file's CAs can't go in a pack in one piece
+   */
+   if(opts->stream &&
+      (opts->packFile[0] || opts->packIn[0] || opts->reference))
+   {
+      fprintf(stderr,"Error (buildloopdb): --stream cannot be used \
+with -P, -R or --reference\n");
+      AbandonBuild(build);
+      return(NULL);
+   }
+   if(opts->stream && !opts->isDirectory && !opts->infile[0])
+   {
+      fprintf(stderr,"Error (buildloopdb): --stream needs a PDB \
+file rather than standard\n");
+      fprintf(stderr,"                    input\n");
+      AbandonBuild(build);
+      return(NULL);
+   }
+
+   /* The experimental details are read from the header of each file
+      and are then written at the end of each record
+   */
+   build->exptl = opts->exptl || opts->filter.xray ||
+                  opts->filter.noNMR ||
+                  (opts->filter.maxResolution > 0.0) ||
+                  (opts->filter.maxRFactor > 0.0);
+   if(build->exptl && opts->packIn[0])
+   {
+      fprintf(stderr,"Error (buildloopdb): --exptl and the \
+experimental filters cannot\n");
+      fprintf(stderr,"                    be used with -R\n");
+      AbandonBuild(build);
+      return(NULL);
+   }
+   if(build->exptl && !opts->isDirectory && !opts->infile[0])
+   {
+      fprintf(stderr,"Error (buildloopdb): --exptl and the \
+experimental filters need a\n");
+      fprintf(stderr,"                    PDB file rather than \
+standard input\n");
+      AbandonBuild(build);
+      return(NULL);
+   }
+
+   /* The alias file only covers the files analysed in this run and a
+      CA pack holds every chain
+   */
+   if(opts->dedupAll && !opts->aliasFile[0])
+   {
+      fprintf(stderr,"Error (buildloopdb): --dedupall needs \
+--dedup\n");
+      AbandonBuild(build);
+      return(NULL);
+   }
+   if(opts->aliasFile[0] && (opts->prevDb[0] || opts->resume ||
+                             opts->packFile[0] || opts->packIn[0]))
+   {
+      fprintf(stderr,"Error (buildloopdb): --dedup cannot be used \
+with -u, --resume, -P or -R\n");
+      AbandonBuild(build);
+      return(NULL);
+   }
+
+   /* The manifest and checkpoint only describe the main database      */
+   if(opts->nLoopTypes &&
+      (opts->mfFile[0] || opts->prevDb[0] || opts->ckFile[0]))
+   {
+      fprintf(stderr,"Error (buildloopdb): -T cannot be used with \
+-M, -u or -k\n");
+      AbandonBuild(build);
+      return(NULL);
+   }
+
+   /* Threads are used to split up large structures                    */
+   build->nThreads = opts->nThreads;
+   if(build->nThreads < 1)
+   {
+      long nCPU = sysconf(_SC_NPROCESSORS_ONLN);
+      build->nThreads = (nCPU > 0)?(int)nCPU:1;
+   }
+   if(opts->reference)
+      build->nThreads = 1;
+
+   if(opts->statsFile[0] || opts->countersFile[0])
+   {
+      build->stats         = &(build->statsData);
+      build->stats->tStart = StatsClock();
+      build->stats->nStem  = opts->nStem;
+   }
+   if(opts->countersFile[0])
+   {
+      if((build->stats->fpCounters = fopen(opts->countersFile, "w"))
+         ==NULL)
+      {
+         fprintf(stderr,"Error (buildloopdb): Unable to write \
+counters to %s\n", opts->countersFile);
+         AbandonBuild(build);
+         return(NULL);
+      }
+      build->counters = TRUE;
+      if(!(build->stats->phases.counters = (HWCountersOpen() > 0)))
+         fprintf(stderr,"Warning (buildloopdb): Hardware counters \
+are not available; only\n                      times will be \
+reported\n");
+      else if((build->nThreads > 1) && !HWCountersAllThreads())
+         fprintf(stderr,"Warning (buildloopdb): Hardware counters \
+only count the main\n                      thread; use -j 1 to \
+count all the analysis\n");
+   }
+
+   /* Default distance ranges are for CDR-H3                           */
+   if(!ReadTables(opts->distTable[0]?opts->distTable:"-", opts->nStem,
+                  minTable, maxTable))
+   {
+      AbandonBuild(build);
+      return(NULL);
+   }
+   ManifestParams(build->params, opts->nStem, opts->minLength,
+                  opts->maxLength, minTable, maxTable);
+   if(build->exptl)
+      sprintf(build->params+strlen(build->params),
+              " exptl %d %d %.3f %.3f", opts->filter.xray,
+              opts->filter.noNMR, opts->filter.maxResolution,
+              opts->filter.maxRFactor);
+   if(opts->aliasFile[0])
+      sprintf(build->params+strlen(build->params), " dedup %d %.3f",
+              opts->dedupAll, opts->dedupTol);
+
+   if(opts->isDirectory)
+      ok = OpenDirectoryBuild(build, minTable, maxTable);
+   else
+      ok = OpenFileBuild(build, minTable, maxTable);
+   if(!ok)
+   {
+      AbandonBuild(build);
+      return(NULL);
+   }
+
+   return(build);
+}
+
+
+/************************************************************************/
+/*>BOOL LoopDBBuildRun(LOOPDBBUILD *build)
+   ---------------------------------------
+*//**
+   \param[in,out] *build   Build handle from LoopDBBuildOpen()
+   \return                 Success (FALSE if an error, such as running
+                           out of memory or failing to write an output,
+                           stopped the build; the reason is reported)
+
+   Processes the PDB files of the build (or those in the CA pack),
+   writing the loops found to the outputs. When resuming, the files up
+   to the checkpoint are skipped. When isDirectory is not set, the
+   single PDB file is processed.
+
+   The build must still be closed with LoopDBBuildClose() if this
+   fails. The outputs are then incomplete, but the last checkpoint is
+   kept so that the build can be resumed.
+
+-  18.10.26 Original, from buildloopdb's main()   By: ACRM
+*/
+BOOL LoopDBBuildRun(LOOPDBBUILD *build)
+{
+   LOOPDBBUILDOPTS *opts = &(build->opts);
+   double          tFile = 0.0;
+
+   if(opts->isDirectory)
+   {
+      return(ProcessAllFiles(build, &(build->dbOut), opts->verbose,
+                             build->prev, opts->ckFile, opts->ckInterval,
+                             &(build->ck), build->pack));
+   }
+
+   if(build->stats != NULL)
+   {
+      StatsResetItem(&(build->stats->phases));
+      tFile = StatsClock();
+   }
+   ProcessFile(build, build->in, &(build->dbOut),
+               blFNam2PDB(opts->infile), opts->verbose);
+   if(build->stats != NULL)
+      RecordFileStats(build, opts->infile[0]?opts->infile:"stdin",
+                      StatsClock() - tFile, build->stats->nAtoms);
+
+   return(!build->failed);
+}
+
+
+/************************************************************************/
+/*>BOOL LoopDBBuildClose(LOOPDBBUILD *build)
+   -----------------------------------------
+*//**
+   \param[in]   *build    Build handle from LoopDBBuildOpen(). Freed
+   \return                Success
+
+   Completes and closes the outputs and the alias file, writes the
+   --stats report and closes the counters. The checkpoint of a build
+   that has been completed is removed since there is nothing left to
+   resume; that of a build stopped by an error is kept.
+
+-  18.10.26 Original, from buildloopdb's main()   By: ACRM
+*/
+BOOL LoopDBBuildClose(LOOPDBBUILD *build)
+{
+   LOOPDBBUILDOPTS *opts = &(build->opts);
+   STATSMARK       mark;
+   BOOL            ok    = TRUE;
+
+   STATS_START(build->stats, mark);
+   if(!CloseAliases(build))
+      ok = FALSE;
+   if(!CloseLoopTypeOutputs(&(build->dbOut)))
+      ok = FALSE;
+   if(!CloseDBOutput(&(build->dbOut)))
+      ok = FALSE;
+   STATS_STOP(build->stats, mark, BP_OUTPUT);
+   if(build->prev != NULL)
+      ClosePrevBuild(build->prev);
+   if(build->pack != NULL)
+      CloseCAPack(build->pack);
+   FCLOSE(build->in);
+   FCLOSE(build->out);
+
+   if(build->files != NULL)
+      free(build->files);
+   blFreeStringList(build->fileList);
+
+   /* A finished build has nothing to resume                           */
+   if(opts->isDirectory && opts->ckFile[0] && ok && !build->failed)
+      unlink(opts->ckFile);
+
+   if(opts->statsFile[0] && !WriteBuildStats(build, opts->statsFile))
+   {
+      fprintf(stderr,"Error (buildloopdb): Unable to write statistics \
+to %s\n", opts->statsFile);
+      ok = FALSE;
+   }
+   if(build->counters)
+   {
+      HWCountersClose();
+      if(fclose(build->stats->fpCounters))
+      {
+         fprintf(stderr,"Error (buildloopdb): Unable to write \
+counters to %s\n", opts->countersFile);
+         ok = FALSE;
+      }
+   }
+
+   free(build);
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>static BOOL OpenDirectoryBuild(LOOPDBBUILD *build, 
+                                  REAL minTable[MAXSTEM][MAXSTEM],
+                                  REAL maxTable[MAXSTEM][MAXSTEM])
+   --------------------------------------------------------------
+*//**
+   \param[in,out] *build    Build being opened
+   \param[in]     minTable  table of minimum distances
+   \param[in]     maxTable  table of maximum distances
+   \return                  Success
+
+   The part of LoopDBBuildOpen() for a directory of PDB files (or a CA
+   pack): opens the pack, reads the checkpoint when resuming, makes the
+   file list, opens the previous build when updating and creates (or
+   reopens) the outputs
+
+-  18.10.26 Original, from buildloopdb's main()   By: ACRM
+*/
+static BOOL OpenDirectoryBuild(LOOPDBBUILD *build,
+                               REAL minTable[MAXSTEM][MAXSTEM],
+                               REAL maxTable[MAXSTEM][MAXSTEM])
+{
+   LOOPDBBUILDOPTS *opts = &(build->opts);
+   CHECKPOINT      *ck   = &(build->ck);
+
+   if(opts->packFile[0] &&
+      (opts->packIn[0] || opts->prevDb[0] || opts->ckFile[0]))
+   {
+      fprintf(stderr,"Error (buildloopdb): -P cannot be used with \
+-R, -u or -k\n");
+      return(FALSE);
+   }
+   if(opts->packIn[0] && opts->prevDb[0])
+   {
+      fprintf(stderr,"Error (buildloopdb): -R cannot be used with \
+-u\n");
+      return(FALSE);
+   }
+
+   /* With a CA pack, the PDB directory is the one the pack was built
+      from
+   */
+   if(opts->packIn[0])
+   {
+      if((build->pack = OpenCAPack(opts->packIn))==NULL)
+      {
+         fprintf(stderr,"Error (buildloopdb): Unable to read CA \
+pack %s\n", opts->packIn);
+         return(FALSE);
+      }
+      if(opts->coordsFile[0] && !build->pack->header->hasBackbone)
+      {
+         fprintf(stderr,"Error (buildloopdb): CA pack %s has no \
+backbone coordinates.\n", opts->packIn);
+         fprintf(stderr,"                    Build it with -c to \
+use -c with -R\n");
+         return(FALSE);
+      }
+      strncpy(opts->infile, build->pack->header->pdbDir, 
+              LDB_MAXFILE-1);
+      opts->infile[LDB_MAXFILE-1] = '\0';
+   }
+
+   if(opts->resume && !opts->ckFile[0])
+   {
+      fprintf(stderr,"Error (buildloopdb): --resume needs a \
+checkpoint file (-k)\n");
+      return(FALSE);
+   }
+   if(opts->ckFile[0] && !opts->outfile[0])
+   {
+      fprintf(stderr,"Error (buildloopdb): The database must be \
+written to a file\n");
+      fprintf(stderr,"                    when checkpointing.\n");
+      return(FALSE);
+   }
+
+   /* When resuming, check the checkpoint matches this build and reopen
+      the database for updating rather than creating it
+   */
+   if(opts->resume)
+   {
+      if(!ReadCheckpoint(opts->ckFile, ck))
+      {
+         fprintf(stderr,"Error (buildloopdb): Unable to read \
+checkpoint %s\n", opts->ckFile);
+         return(FALSE);
+      }
+      if(strcmp(ck->params, build->params) || 
+         (ck->shard != opts->shard) || (ck->nShards != opts->nShards))
+      {
+         fprintf(stderr,"Error (buildloopdb): Checkpoint %s is \
+for a build with\n", opts->ckFile);
+         fprintf(stderr,"                    different \
+parameters\n");
+         return(FALSE);
+      }
+   }
+
+   /* The file list is checked against the checkpoint before the
+      outputs are reopened
+   */
+   if(!ListFiles(build))
+      return(FALSE);
+
+   if(opts->resume)
+   {
+      if((build->out = fopen(opts->outfile, "r+"))==NULL)
+      {
+         build->out = stdout;
+         fprintf(stderr,"Error (buildloopdb): Unable to reopen \
+database %s\n", opts->outfile);
+         return(FALSE);
+      }
+   }
+   else
+   {
+      strcpy(ck->params, build->params);
+      ck->shard   = opts->shard;
+      ck->nShards = opts->nShards;
+      if(!blOpenStdFiles(NULL, opts->outfile, NULL, &(build->out)))
+         return(FALSE);
+   }
+
+   if(opts->prevDb[0])
+   {
+      if(!strcmp(opts->prevDb, opts->outfile))
+      {
+         fprintf(stderr,"Error (buildloopdb): The updated \
+database must be written to\n");
+         fprintf(stderr,"                    a new file\n");
+         return(FALSE);
+      }
+      if(OpenPrevBuild(&(build->prevBuild), opts->prevDb, opts->prevMf,
+                       opts->coordsFile, build->params))
+         build->prev = &(build->prevBuild);
+      else
+         fprintf(stderr,"Warning (buildloopdb): Processing \
+all files\n");
+   }
+
+   if(opts->resume)
+   {
+      if(!ResumeDBOutput(&(build->dbOut), build->out, opts->nStem,
+                         opts->minLength, opts->maxLength, minTable,
+                         maxTable, opts->qfFile, opts->coordsFile,
+                         opts->mfFile, ck))
+         return(FALSE);
+   }
+   else
+   {
+      PrintHeader(build, build->out, opts->infile, opts->nStem,
+                  opts->shard, opts->nShards);
+      if(!OpenDBOutput(&(build->dbOut), build->out, opts->nStem,
+                       opts->minLength, opts->maxLength, minTable,
+                       maxTable, opts->qfFile, opts->coordsFile,
+                       opts->mfFile, build->params, opts->ckFile))
+         return(FALSE);
+      if(!OpenLoopTypeOutputs(build, &(build->dbOut), opts->loopTypes,
+                              opts->nLoopTypes, opts->infile,
+                              opts->shard, opts->nShards, opts->qfFile,
+                              opts->coordsFile))
+         return(FALSE);
+   }
+   if(opts->packFile[0] &&
+      ((build->dbOut.cw = OpenCAPackWriter(opts->packFile, opts->infile,
+                                           (opts->coordsFile[0]!='\0')))
+       ==NULL))
+   {
+      fprintf(stderr,"Error (buildloopdb): Unable to create CA \
+pack %s\n", opts->packFile);
+      return(FALSE);
+   }
+   if(opts->aliasFile[0] &&
+      !OpenAliases(build, &(build->dbOut), opts->aliasFile,
+                   opts->dedupTol, opts->dedupAll))
+      return(FALSE);
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL OpenFileBuild(LOOPDBBUILD *build,
+                             REAL minTable[MAXSTEM][MAXSTEM],
+                             REAL maxTable[MAXSTEM][MAXSTEM])
+   ---------------------------------------------------------
+*//**
+   \param[in,out] *build    Build being opened
+   \param[in]     minTable  table of minimum distances
+   \param[in]     maxTable  table of maximum distances
+   \return                  Success
+
+   The part of LoopDBBuildOpen() for a single PDB file: opens the file
+   and creates the outputs. There is no header for a single file, but
+   the stem size is needed to read the records.
+
+-  18.10.26 Original, from buildloopdb's main()   By: ACRM
+*/
+static BOOL OpenFileBuild(LOOPDBBUILD *build,
+                          REAL minTable[MAXSTEM][MAXSTEM],
+                          REAL maxTable[MAXSTEM][MAXSTEM])
+{
+   LOOPDBBUILDOPTS *opts = &(build->opts);
+
+   if(!blOpenStdFiles(opts->infile, opts->outfile, &(build->in),
+                      &(build->out)))
+      return(FALSE);
+
+   fprintf(build->out,"%s   %d\n", DB_STEMTAG, opts->nStem);
+   if(build->exptl)
+      fprintf(build->out,"%s  1\n", DB_EXPTLTAG);
+   if(!OpenDBOutput(&(build->dbOut), build->out, opts->nStem,
+                    opts->minLength, opts->maxLength, minTable,
+                    maxTable, opts->qfFile, opts->coordsFile, "",
+                    build->params, ""))
+      return(FALSE);
+   if(!OpenLoopTypeOutputs(build, &(build->dbOut), opts->loopTypes,
+                           opts->nLoopTypes, opts->infile, 0, 0,
+                           opts->qfFile, opts->coordsFile))
+      return(FALSE);
+   if(opts->aliasFile[0] &&
+      !OpenAliases(build, &(build->dbOut), opts->aliasFile,
+                   opts->dedupTol, opts->dedupAll))
+      return(FALSE);
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static void AbandonBuild(LOOPDBBUILD *build)
+   --------------------------------------------
+*//**
+   \param[in]   *build    Build that could not be opened. Freed
+
+   Closes the inputs and files opened so far by LoopDBBuildOpen()
+   before it fails. Outputs that had been started are left incomplete,
+   as they were when buildloopdb gave up.
+
+-  18.10.26 Original   By: ACRM
+*/
+static void AbandonBuild(LOOPDBBUILD *build)
+{
+   DBOUTPUT *o,
+            *next;
+
+   for(o=build->dbOut.next; o!=NULL; o=next)
+   {
+      next = o->next;
+      fclose(o->out);
+      free(o);
+   }
+   if(build->dedup != NULL)
+      CloseDedup(build->dedup);
+   if(build->prev != NULL)
+      ClosePrevBuild(build->prev);
+   if(build->pack != NULL)
+      CloseCAPack(build->pack);
+   if(build->files != NULL)
+      free(build->files);
+   blFreeStringList(build->fileList);
+   FCLOSE(build->in);
+   FCLOSE(build->out);
+   if(build->counters)
+      HWCountersClose();
+   if((build->stats != NULL) && (build->stats->fpCounters != NULL))
+      fclose(build->stats->fpCounters);
+   free(build);
+}
+
+
+/************************************************************************/
+/*>static void PrintHeader(LOOPDBBUILD *build, FILE *out, char *dirName,
+                           int nStem, int shard, int nShards)
+   ---------------------------------------------------------------------
+   \param[in]   *build    The build
+   \param[in]   *out      Output file pointer
+   \param[in]   *dirName  Name of directory being processed
+   \param[in]   nStem     Residues in each stem
+   \param[in]   shard     Shard being built (from 1)
+   \param[in]   nShards   Number of shards (0 if not sharded)
+
+   Prints a short header for the database file
+*//**
+-  14.07.15 Original   By: ACRM
+-  18.10.26 Added the shard
+-  18.10.26 Added the stem size
+-  18.10.26 Added DB_EXPTLTAG if the records give experimental data
+-  18.10.26 Takes the build handle rather than using globals
+*/
+static void PrintHeader(LOOPDBBUILD *build, FILE *out, char *dirName,
+                        int nStem, int shard, int nShards)
+
+{
+   time_t tm;
+   
+   time(&tm);
+   fprintf(out,"#PDBDIR: %s\n",dirName);
+   fprintf(out,"%s   %d\n", DB_STEMTAG, nStem);
+   if(build->exptl)
+      fprintf(out,"%s  1\n", DB_EXPTLTAG);
+   if(nShards)
+      fprintf(out,"#SHARD:  %d/%d\n", shard, nShards);
+   fprintf(out,"#DATE:   %s\n",ctime(&tm));
+}
+
+
+/************************************************************************/
+/*>static void InitDBOutput(DBOUTPUT *dbOut, FILE *out, int nStem, 
+                            int minLength, int maxLength, 
+                            REAL minTable[MAXSTEM][MAXSTEM], 
+                            REAL maxTable[MAXSTEM][MAXSTEM])
+   -------------------------------------------------------------------
+*//**
+   \param[out]  *dbOut      Database output structure
+   \param[in]   *out        Text database file pointer
+   \param[in]   nStem       Residues in each stem
+   \param[in]   minLength   Minimum loop length
+   \param[in]   maxLength   Maximum loop length (0 = no limit)
+   \param[in]   minTable    table of minimum distances
+   \param[in]   maxTable    table of maximum distances
+
+   Sets up a database output for the given loop type with no auxiliary
+   files
+
+-  18.10.26 Original   By: ACRM
+*/
+static void InitDBOutput(DBOUTPUT *dbOut, FILE *out, int nStem, int minLength,
+                         int maxLength, REAL minTable[MAXSTEM][MAXSTEM], 
+                         REAL maxTable[MAXSTEM][MAXSTEM])
+{
+   int i, j;
+
+   for(i=0; i<nStem; i++)
+   {
+      for(j=0; j<nStem; j++)
+      {
+         dbOut->minTable[i][j] = minTable[i][j];
+         dbOut->maxTable[i][j] = maxTable[i][j];
+      }
+   }
+   dbOut->nStem     = nStem;
+   dbOut->minLength = minLength;
+   dbOut->maxLength = maxLength;
+   dbOut->next      = NULL;
+   dbOut->wanted    = FALSE;
+   dbOut->out       = out;
+   dbOut->offset    = 0;
+   dbOut->qw        = NULL;
+   dbOut->lw        = NULL;
+   dbOut->mf        = NULL;
+   dbOut->cw        = NULL;
+   dbOut->nRecords  = 0;
+}
+
+
+/************************************************************************/
+/*>static BOOL OpenDBOutput(DBOUTPUT *dbOut, FILE *out, int nStem, 
+                            int minLength, int maxLength, 
+                            REAL minTable[MAXSTEM][MAXSTEM], 
+                            REAL maxTable[MAXSTEM][MAXSTEM], char *qfFile, 
+                            char *coordsFile, char *mfFile, char *params, 
+                            char *ckFile)
+   -------------------------------------------------------------------------
+*//**
+   \param[out]  *dbOut      Database output structure
+   \param[in]   *out        Text database file pointer
+   \param[in]   nStem       Residues in each stem
+   \param[in]   minLength   Minimum loop length
+   \param[in]   maxLength   Maximum loop length (0 = no limit)
+   \param[in]   minTable    table of minimum distances
+   \param[in]   maxTable    table of maximum distances
+   \param[in]   *qfFile     Quantized filter sidecar filename (or blank)
+   \param[in]   *coordsFile Loop coordinate filename (or blank)
+   \param[in]   *mfFile    Manifest filename (or blank)
+   \param[in]   *params    Build parameters for the manifest
+   \param[in]   *ckFile    Checkpoint filename (or blank)
+   \return                 Success
+
+   Sets up the database output. If a sidecar, coordinate file, 
+   manifest or checkpoint is requested, the text database must be a
+   real file since these record its size and the sidecar stores the
+   offset of each record.
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL OpenDBOutput(DBOUTPUT *dbOut, FILE *out, int nStem, int minLength,
+                         int maxLength, REAL minTable[MAXSTEM][MAXSTEM], 
+                         REAL maxTable[MAXSTEM][MAXSTEM], char *qfFile, 
+                         char *coordsFile, char *mfFile, char *params, 
+                         char *ckFile)
+{
+   InitDBOutput(dbOut, out, nStem, minLength, maxLength, minTable, 
+                maxTable);
+
+   if(qfFile[0] || coordsFile[0] || mfFile[0] || ckFile[0])
+   {
+      if((dbOut->offset = ftell(out)) < 0)
+      {
+         fprintf(stderr,"Error (buildloopdb): The database must be \
+written to a file\n");
+         fprintf(stderr,"                    when a sidecar, \
+coordinate file, manifest or\n");
+         fprintf(stderr,"                    checkpoint is \
+requested.\n");
+         return(FALSE);
+      }
+   }
+
+   if(mfFile[0])
+   {
+      if((dbOut->mf = OpenManifestWriter(mfFile, params))==NULL)
+      {
+         fprintf(stderr,"Error (buildloopdb): Unable to create \
+manifest %s\n", mfFile);
+         return(FALSE);
+      }
+   }
+
+   if(coordsFile[0])
+   {
+      if((dbOut->lw = OpenLoopCoordsWriter(coordsFile, nStem))==NULL)
+      {
+         fprintf(stderr,"Error (buildloopdb): Unable to create \
+coordinate file %s\n", coordsFile);
+         return(FALSE);
+      }
+   }
+
+   if(qfFile[0])
+   {
+      if((dbOut->qw = OpenQFilterWriter(qfFile, nStem, minTable, 
+                                        maxTable)) == NULL)
+      {
+         fprintf(stderr,"Error (buildloopdb): Unable to create sidecar \
+file %s\n", qfFile);
+         return(FALSE);
+      }
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL ResumeDBOutput(DBOUTPUT *dbOut, FILE *out, int nStem, 
+                              int minLength, int maxLength, 
+                              REAL minTable[MAXSTEM][MAXSTEM], 
+                              REAL maxTable[MAXSTEM][MAXSTEM], char *qfFile, 
+                              char *coordsFile, char *mfFile, CHECKPOINT *ck)
+   --------------------------------------------------------------------------
+*//**
+   \param[out]  *dbOut      Database output structure
+   \param[in]   *out        Text database left by the interrupted build
+                            (open for reading and writing)
+   \param[in]   nStem       Residues in each stem
+   \param[in]   minLength   Minimum loop length
+   \param[in]   maxLength   Maximum loop length (0 = no limit)
+   \param[in]   minTable    table of minimum distances
+   \param[in]   maxTable    table of maximum distances
+   \param[in]   *qfFile     Quantized filter sidecar filename (or blank)
+   \param[in]   *coordsFile Loop coordinate filename (or blank)
+   \param[in]   *mfFile     Manifest filename (or blank)
+   \param[in]   *ck         Last checkpoint of the interrupted build
+   \return                  Success
+
+   Sets up the database output to carry on from a checkpoint. The text
+   database, coordinate file and manifest are truncated to their sizes
+   at the checkpoint. The sidecar is never flushed mid-build so it is
+   rebuilt from the records already in the text database.
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL ResumeDBOutput(DBOUTPUT *dbOut, FILE *out, int nStem, 
+                           int minLength, int maxLength, 
+                           REAL minTable[MAXSTEM][MAXSTEM], 
+                           REAL maxTable[MAXSTEM][MAXSTEM], char *qfFile, 
+                           char *coordsFile, char *mfFile, CHECKPOINT *ck)
+{
+   char buffer[DB_MAXLINE];
+   long offset   = 0,
+        nRecords = 0;
+
+   InitDBOutput(dbOut, out, nStem, minLength, maxLength, minTable, 
+                maxTable);
+   dbOut->offset   = ck->dbSize;
+   dbOut->nRecords = ck->nRecords;
+
+   if((coordsFile[0] != '\0') != (ck->coordsSize >= 0) ||
+      (mfFile[0] != '\0') != (ck->mfSize >= 0))
+   {
+      fprintf(stderr,"Error (buildloopdb): The coordinate file and \
+manifest options must\n");
+      fprintf(stderr,"                    be the same as for the \
+interrupted build\n");
+      return(FALSE);
+   }
+
+   if(mfFile[0])
+   {
+      if((dbOut->mf = ReopenManifestWriter(mfFile, ck->mfSize))==NULL)
+      {
+         fprintf(stderr,"Error (buildloopdb): Unable to reopen \
+manifest %s\n", mfFile);
+         return(FALSE);
+      }
+   }
+
+   if(coordsFile[0])
+   {
+      if((dbOut->lw = ReopenLoopCoordsWriter(coordsFile, ck->coordsSize,
+                                             ck->nRecords))==NULL)
+      {
+         fprintf(stderr,"Error (buildloopdb): Unable to reopen \
+coordinate file %s\n", coordsFile);
+         return(FALSE);
+      }
+   }
+
+   if(qfFile[0])
+   {
+      if((dbOut->qw = OpenQFilterWriter(qfFile, nStem, minTable, 
+                                        maxTable)) == NULL)
+      {
+         fprintf(stderr,"Error (buildloopdb): Unable to create sidecar \
+file %s\n", qfFile);
+         return(FALSE);
+      }
+   }
+
+   /* Check the records up to the checkpoint are all there, adding them
+      to the sidecar
+   */
+   rewind(out);
+   while((offset < ck->dbSize) && fgets(buffer, DB_MAXLINE, out))
+   {
+      if((buffer[0] != '#') && (buffer[0] != '\n'))
+      {
+         if((dbOut->qw != NULL) &&
+            !AddSidecarRecord(dbOut->qw, offset, buffer))
+            return(FALSE);
+         nRecords++;
+      }
+      offset += strlen(buffer);
+   }
+
+   if((offset != ck->dbSize) || (nRecords != ck->nRecords) ||
+      ftruncate(fileno(out), (off_t)ck->dbSize) ||
+      fseek(out, ck->dbSize, SEEK_SET))
+   {
+      fprintf(stderr,"Error (buildloopdb): The database does not match \
+the checkpoint\n");
+      return(FALSE);
+   }
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL Checkpoint(DBOUTPUT *dbOut, CHECKPOINT *ck, char *ckFile)
+   ---------------------------------------------------------------------
+*//**
+   \param[in]     *dbOut    Database output
+   \param[in,out] *ck       Checkpoint (the position in the file list
+                            must be set; the output sizes are filled in)
+   \param[in]     *ckFile   Checkpoint filename
+   \return                  Success
+
+   Flushes the text database, coordinate file and manifest to disk and
+   records their sizes in a checkpoint
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL Checkpoint(DBOUTPUT *dbOut, CHECKPOINT *ck, char *ckFile)
+{
+   ck->dbSize     = dbOut->offset;
+   ck->nRecords   = dbOut->nRecords;
+   ck->coordsSize = -1;
+   ck->mfSize     = -1;
+
+   if(!SyncFile(dbOut->out))
+      return(FALSE);
+   if(dbOut->lw != NULL)
+   {
+      if(!SyncFile(dbOut->lw->fp))
+         return(FALSE);
+      ck->coordsSize = dbOut->lw->dataOffset;
+   }
+   if(dbOut->mf != NULL)
+   {
+      if(!SyncFile(dbOut->mf) || ((ck->mfSize = ftell(dbOut->mf)) < 0))
+         return(FALSE);
+   }
+
+   return(WriteCheckpoint(ckFile, ck));
+}
+
+
+/************************************************************************/
+/*>static BOOL AddSidecarRecord(QFWRITER *qw, long offset, char *buffer)
+   ---------------------------------------------------------------------
+*//**
+   \param[in]   *qw        Sidecar writer
+   \param[in]   offset     Offset of the record in the text database
+   \param[in]   *buffer    The record
+   \return                 Success (the reason for a failure is
+                           reported)
+
+   Adds a record that has already been written to the text database to
+   the sidecar
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL AddSidecarRecord(QFWRITER *qw, long offset, char *buffer)
+{
+   char pdbCode[DB_MAXLINE],
+        startRes[DB_MAXLINE],
+        endRes[DB_MAXLINE];
+   REAL distMat[MAXSTEM][MAXSTEM];
+   int  loopLen;
+
+   if(!ParseDBRecord(buffer, qw->header.nStem, pdbCode, startRes, 
+                     endRes, &loopLen, distMat))
+   {
+      fprintf(stderr,"Error (buildloopdb): Bad database record: %s",
+              buffer);
+      return(FALSE);
+   }
+   if(!WriteQFilterRecord(qw, offset, loopLen, distMat))
+   {
+      fprintf(stderr,"Error (buildloopdb): No memory for sidecar \
+offsets\n");
+      return(FALSE);
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL CloseDBOutput(DBOUTPUT *dbOut)
+   ------------------------------------------
+*//**
+   \param[in]   *dbOut     Database output structure
+   \return                 Success
+
+   Completes any sidecar, coordinate, manifest and CA pack files. The
+   text database itself is closed by the caller.
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL CloseDBOutput(DBOUTPUT *dbOut)
+{
+   BOOL ok = TRUE;
+
+   fflush(dbOut->out);
+   if(dbOut->cw != NULL)
+   {
+      if(!CloseCAPackWriter(dbOut->cw))
+      {
+         fprintf(stderr,"Error (buildloopdb): Failed writing CA pack\n");
+         ok = FALSE;
+      }
+      dbOut->cw = NULL;
+   }
+
+   if(dbOut->mf != NULL)
+   {
+      if(!CloseManifestWriter(dbOut->mf, dbOut->offset))
+      {
+         fprintf(stderr,"Error (buildloopdb): Failed writing manifest\n");
+         ok = FALSE;
+      }
+      dbOut->mf = NULL;
+   }
+
+   if(dbOut->lw != NULL)
+   {
+      if(!CloseLoopCoordsWriter(dbOut->lw, dbOut->offset))
+      {
+         fprintf(stderr,"Error (buildloopdb): Failed writing coordinate \
+file\n");
+         ok = FALSE;
+      }
+      dbOut->lw = NULL;
+   }
+
+   if(dbOut->qw != NULL)
+   {
+      if(!CloseQFilterWriter(dbOut->qw, dbOut->offset))
+      {
+         fprintf(stderr,"Error (buildloopdb): Failed writing sidecar \
+file\n");
+         ok = FALSE;
+      }
+      dbOut->qw = NULL;
+   }
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>static BOOL OpenLoopTypeOutputs(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                                   LOOPTYPE *loopTypes, int nLoopTypes,
+                                   char *dirName, int shard, int nShards,
+                                   char *qfFile, char *coordsFile)
+   ----------------------------------------------------------------------
+*//**
+   \param[in]     *build      The build
+   \param[in,out] *dbOut      Main database output
+   \param[in]     *loopTypes  Extra loop types from -T
+   \param[in]     nLoopTypes  Number of extra loop types
+   \param[in]     *dirName    Directory being processed (for the header)
+   \param[in]     shard       Shard being built (from 1)
+   \param[in]     nShards     Number of shards (0 if not sharded)
+   \param[in]     *qfFile     Main sidecar filename (or blank)
+   \param[in]     *coordsFile Main coordinate filename (or blank)
+   \return                    Success
+
+   Creates a database for each extra loop type and chains it on to the
+   main output so that RunAnalysis() fills them all in one pass. If the
+   main database has a sidecar or coordinate file, so does each extra
+   database, named by giving its database the same extension.
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL OpenLoopTypeOutputs(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                                LOOPTYPE *loopTypes, int nLoopTypes,
+                                char *dirName, int shard, int nShards,
+                                char *qfFile, char *coordsFile)
+{
+   DBOUTPUT *o,
+            *last = dbOut;
+   FILE     *out;
+   REAL     minTable[MAXSTEM][MAXSTEM],
+            maxTable[MAXSTEM][MAXSTEM];
+   char     typeQf[LC_MAXFILE],
+            typeCoords[LC_MAXFILE];
+   int      i;
+
+   for(i=0; i<nLoopTypes; i++)
+   {
+      if(!ReadTables(loopTypes[i].distTable, dbOut->nStem, minTable, 
+                     maxTable))
+         return(FALSE);
+
+      typeQf[0] = typeCoords[0] = '\0';
+      if((qfFile[0] && 
+          !CompanionFile(loopTypes[i].outfile, qfFile, typeQf)) ||
+         (coordsFile[0] &&
+          !CompanionFile(loopTypes[i].outfile, coordsFile, typeCoords)))
+      {
+         fprintf(stderr,"Error (buildloopdb): The sidecar and \
+coordinate files need an\n");
+         fprintf(stderr,"                    extension to name those \
+for %s\n", loopTypes[i].outfile);
+         return(FALSE);
+      }
+
+      if((out = fopen(loopTypes[i].outfile, "w"))==NULL)
+      {
+         fprintf(stderr,"Error (buildloopdb): Unable to create \
+database %s\n", loopTypes[i].outfile);
+         return(FALSE);
+      }
+      if((o = (DBOUTPUT *)malloc(sizeof(DBOUTPUT)))==NULL)
+      {
+         fprintf(stderr,"Error (buildloopdb): No memory for loop \
+types\n");
+         return(FALSE);
+      }
+
+      PrintHeader(build, out, dirName, dbOut->nStem, shard, nShards);
+
+      if(!OpenDBOutput(o, out, dbOut->nStem, loopTypes[i].minLength, 
+                       loopTypes[i].maxLength, minTable, maxTable,
+                       typeQf, typeCoords, "", "", ""))
+         return(FALSE);
+      last->next = o;
+      last       = o;
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL ReadTables(char *distTable, int nStem, 
+                          REAL minTable[MAXSTEM][MAXSTEM], 
+                          REAL maxTable[MAXSTEM][MAXSTEM])
+   ----------------------------------------------------------
+*//**
+   \param[in]   *distTable  Distance table filename ("-" for the
+                            defaults in distances.h)
+   \param[in]   nStem       Residues in each stem
+   \param[out]  minTable    table of minimum distances
+   \param[out]  maxTable    table of maximum distances
+   \return                  Success
+
+   Sets up the distance tables for a loop type, reporting any error.
+   The defaults are only available for stems of NSTEM residues.
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL ReadTables(char *distTable, int nStem, 
+                       REAL minTable[MAXSTEM][MAXSTEM], 
+                       REAL maxTable[MAXSTEM][MAXSTEM])
+{
+   if(!strcmp(distTable, "-"))
+   {
+      if(nStem != NSTEM)
+      {
+         fprintf(stderr,"Error (buildloopdb): The default distances are \
+for stems of %d\n", NSTEM);
+         fprintf(stderr,"                    residues. Give a distance \
+table for stems of %d\n", nStem);
+         return(FALSE);
+      }
+      SetUpMinMaxTables(minTable, maxTable);
+   }
+   else if(!ReadDistanceTable(distTable, nStem, minTable, maxTable))
+   {
+      fprintf(stderr,"Error (buildloopdb): Unable to read distance \
+table %s\n", distTable);
+      fprintf(stderr,"                    (it must have %d min/max \
+pairs)\n", nStem*nStem);
+      return(FALSE);
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL CloseLoopTypeOutputs(DBOUTPUT *dbOut)
+   -------------------------------------------------
+*//**
+   \param[in,out] *dbOut     Main database output
+   \return                   Success
+
+   Completes and closes the databases for the extra loop types, leaving
+   the main output to be closed by the caller.
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL CloseLoopTypeOutputs(DBOUTPUT *dbOut)
+{
+   DBOUTPUT *o,
+            *next;
+   BOOL     ok = TRUE;
+
+   for(o=dbOut->next; o!=NULL; o=next)
+   {
+      next = o->next;
+      if(!CloseDBOutput(o))
+         ok = FALSE;
+      if(fclose(o->out))
+         ok = FALSE;
+      free(o);
+   }
+   dbOut->next = NULL;
+   return(ok);
+}
+
+   
+/************************************************************************/
+/*>static BOOL OpenPrevBuild(PREVBUILD *prev, char *prevDb, char *prevMf,
+                             char *coordsFile, char *params)
+   ----------------------------------------------------------------------
+*//**
+   \param[out]  *prev       Previous build
+   \param[in]   *prevDb     Previous database
+   \param[in]   *prevMf     Manifest of the previous database
+   \param[in]   *coordsFile Loop coordinate filename for this build (or
+                            blank)
+   \param[in]   *params     Build parameters for this build
+   \return                  Previous build can be used
+
+   Opens a previous build so that its records can be reused. The
+   manifest must describe the database and have been built with the
+   same parameters. If a coordinate file is being written, the previous
+   database must have one with the same extension.
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL OpenPrevBuild(PREVBUILD *prev, char *prevDb, char *prevMf,
+                          char *coordsFile, char *params)
+{
+   char buffer[DB_MAXLINE],
+        prevCoords[LC_MAXFILE];
+   long maxRecords = 0,
+        offset;
+
+   prev->db       = NULL;
+   prev->offsets  = NULL;
+   prev->nRecords = 0;
+   prev->lc       = NULL;
+
+   if((prev->manifest = ReadManifest(prevMf))==NULL)
+   {
+      fprintf(stderr,"Warning (buildloopdb): Unable to read manifest \
+%s\n", prevMf);
+      return(FALSE);
+   }
+   if(strcmp(prev->manifest->params, params))
+   {
+      fprintf(stderr,"Warning (buildloopdb): Previous database was \
+built with different\n");
+      fprintf(stderr,"                      options or distance \
+table\n");
+      ClosePrevBuild(prev);
+      return(FALSE);
+   }
+
+   if(((prev->db = fopen(prevDb, "r"))==NULL) ||
+      fseek(prev->db, 0L, SEEK_END) ||
+      (ftell(prev->db) != prev->manifest->dbSize))
+   {
+      fprintf(stderr,"Warning (buildloopdb): Previous database %s \
+missing or does not\n", prevDb);
+      fprintf(stderr,"                      match its manifest\n");
+      ClosePrevBuild(prev);
+      return(FALSE);
+   }
+   rewind(prev->db);
+
+   if(coordsFile[0] &&
+      (!CompanionFile(prevDb, coordsFile, prevCoords) ||
+       ((prev->lc = OpenLoopCoords(prevCoords, prev->db))==NULL)))
+   {
+      fprintf(stderr,"Warning (buildloopdb): No coordinate file \
+matching %s\n", prevDb);
+      ClosePrevBuild(prev);
+      return(FALSE);
+   }
+
+   /* Index the records of the previous database                        */
+   for(offset=0; fgets(buffer, DB_MAXLINE, prev->db); 
+       offset=ftell(prev->db))
+   {
+      if((buffer[0] == '#') || (buffer[0] == '\n'))
+         continue;
+      if(prev->nRecords == maxRecords)
+      {
+         long *offsets;
+         maxRecords = (maxRecords == 0)?65536:(2 * maxRecords);
+         if((offsets = (long *)realloc(prev->offsets, 
+                                       maxRecords * sizeof(long)))==NULL)
+         {
+            fprintf(stderr,"Error (buildloopdb): No memory to index \
+previous database\n");
+            ClosePrevBuild(prev);
+            return(FALSE);
+         }
+         prev->offsets = offsets;
+      }
+      prev->offsets[prev->nRecords++] = offset;
+   }
+   
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static void ClosePrevBuild(PREVBUILD *prev)
+   -------------------------------------------
+*//**
+   \param[in]   *prev       Previous build
+
+   Frees everything associated with a previous build
+
+-  18.10.26 Original   By: ACRM
+*/
+static void ClosePrevBuild(PREVBUILD *prev)
+{
+   if(prev->manifest != NULL)
+      FreeManifest(prev->manifest);
+   if(prev->db != NULL)
+      fclose(prev->db);
+   if(prev->offsets != NULL)
+      free(prev->offsets);
+   if(prev->lc != NULL)
+      CloseLoopCoords(prev->lc);
+   prev->manifest = NULL;
+   prev->db       = NULL;
+   prev->offsets  = NULL;
+   prev->lc       = NULL;
+}
+
+
+/************************************************************************/
+/*>static BOOL ReusePrevRecords(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                                PREVBUILD *prev, char *fname,
+                                MFENTRY *entry)
+   ------------------------------------------------------------------
+*//**
+   \param[in,out] *build    The build
+   \param[in]     *dbOut    Database output
+   \param[in]     *prev     Previous build
+   \param[in]     *fname    PDB file
+   \param[in,out] *entry    Manifest entry for the file (first must be 
+                            set; details are filled in)
+   \return                  The file was unchanged and its records 
+                            have been copied
+
+   If a file has the same size and modification time as in the previous
+   build, or the same size and contents, copies its records from the
+   previous database. If the records can't be copied, build->failed is
+   set and FALSE is returned.
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL ReusePrevRecords(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                             PREVBUILD *prev, char *fname,
+                             MFENTRY *entry)
+{
+   MFENTRY *old;
+   char    buffer[DB_MAXLINE];
+   long    r,
+           offset;
+
+   if(((old = FindManifestEntry(prev->manifest, fname))==NULL) ||
+      !GetFileDetails(fname, entry, FALSE) ||
+      (entry->size != old->size))
+      return(FALSE);
+
+   if(entry->mtime != old->mtime)
+   {
+      if(!GetFileDetails(fname, entry, TRUE) ||
+         (entry->hash != old->hash))
+         return(FALSE);
+   }
+   entry->hash = old->hash;
+
+   if(old->first + old->nRecords > prev->nRecords)
+      return(FALSE);
+   
+   for(r=old->first; r<old->first + old->nRecords; r++)
+   {
+      if(fseek(prev->db, prev->offsets[r], SEEK_SET) ||
+         !fgets(buffer, DB_MAXLINE, prev->db))
+      {
+         fprintf(stderr,"Error (buildloopdb): Failed reading previous \
+database\n");
+         build->failed = TRUE;
+         return(FALSE);
+      }
+      TERMINATE(buffer);
+
+      offset = dbOut->offset;
+      dbOut->offset += fprintf(dbOut->out, "%s\n", buffer);
+      dbOut->nRecords++;
+
+      if((dbOut->qw != NULL) &&
+         !AddSidecarRecord(dbOut->qw, offset, buffer))
+      {
+         build->failed = TRUE;
+         return(FALSE);
+      }
+
+      if(dbOut->lw != NULL)
+      {
+         BBRES *residues;
+         int   nRes;
+
+         if(((residues = GetLoopCoords(prev->lc, r, &nRes))==NULL) ||
+            !WriteLoopCoords(dbOut->lw, residues, nRes))
+         {
+            fprintf(stderr,"Error (buildloopdb): Failed copying \
+coordinates\n");
+            build->failed = TRUE;
+            return(FALSE);
+         }
+      }
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL ListFiles(LOOPDBBUILD *build)
+   -----------------------------------------
+*//**
+   \param[in,out] *build    Build being opened
+   \return                  Success
+
+   Makes the list of PDB files in the directory (or the CA pack) and
+   selects the part of it that this run processes. This is done when
+   the build is opened so that a checkpoint that does not match the
+   file list is found before the outputs are reopened.
+
+   The files are sorted by name so that the database does not depend on
+   the order in which the directory happens to be read. A limit takes
+   the first files of the sorted list, so that it gives the same files
+   wherever it is run. When sharding, the list is then split into
+   nShards contiguous parts and only part 'shard' is processed, so
+   concatenating the shards in order gives the same records in the
+   same order as building everything at once. On resuming, the files up
+   to the checkpoint are skipped.
+
+-  18.10.26 Original, from ProcessAllFiles()   By: ACRM
+*/
+static BOOL ListFiles(LOOPDBBUILD *build)
+{
+   LOOPDBBUILDOPTS *opts = &(build->opts);
+   CHECKPOINT      *ck   = &(build->ck);
+   DIR             *dp;
+   struct dirent   *dent;
+   char            filename[MAXBUFF];
+   STRINGLIST      *string;
+   int             i;
+
+   /* Get the list of PDB files; a pack is already sorted               */
+   if(build->pack != NULL)
+   {
+      build->nFiles = (int)build->pack->header->nFiles;
+      if(build->nFiles &&
+         (build->files = (char **)malloc(build->nFiles * 
+                                         sizeof(char *)))==NULL)
+      {
+         fprintf(stderr,"Error (buildloopdb): No memory for file \
+list.\n");
+         return(FALSE);
+      }
+      for(i=0; i<build->nFiles; i++)
+         build->files[i] = CAPackPath(build->pack, i);
+   }
+   else
+   {
+      if((dp=opendir(opts->infile))!=NULL)
+      {
+         while((dent=readdir(dp))!=NULL)
+         {
+            if(dent->d_name[0] != '.')
+            {
+               sprintf(filename,"%s/%s",opts->infile,dent->d_name);
+               if((string = blStoreString(build->fileList, filename))
+                  ==NULL)
+               {
+                  fprintf(stderr,"Error (buildloopdb): No memory for \
+file list.\n");
+                  closedir(dp);
+                  return(FALSE);
+               }
+               build->fileList = string;
+
+               if(opts->verbose)
+               {
+                  fprintf(stderr,"Listing: %s\n", filename);
+               }
+            }
+         }
+         closedir(dp);
+      }
+
+      /* Sort the list so the order is reproducible                     */
+      for(string=build->fileList; string!=NULL; NEXT(string))
+         build->nFiles++;
+      if(build->nFiles &&
+         (build->files = (char **)malloc(build->nFiles * 
+                                         sizeof(char *)))==NULL)
+      {
+         fprintf(stderr,"Error (buildloopdb): No memory for file \
+list.\n");
+         return(FALSE);
+      }
+      for(i=0, string=build->fileList; string!=NULL; NEXT(string))
+         build->files[i++] = string->string;
+      if(build->nFiles)
+         qsort(build->files, build->nFiles, sizeof(char *), 
+               cmpFilenames);
+   }
+
+   /* The limit takes the first files of the sorted list                */
+   if(opts->limit)
+      build->nFiles = MIN(build->nFiles, opts->limit);
+
+   /* Select this shard's part of the list                              */
+   build->first = 0;
+   build->last  = build->nFiles;
+   if(opts->nShards)
+   {
+      build->first = (int)(((long)build->nFiles * (opts->shard-1)) / 
+                           opts->nShards);
+      build->last  = (int)(((long)build->nFiles * opts->shard) / 
+                           opts->nShards);
+      if(opts->verbose)
+         fprintf(stderr,"Shard %d/%d: files %d to %d of %d\n", 
+                 opts->shard, opts->nShards, build->first+1, 
+                 build->last, build->nFiles);
+   }
+   
+   /* Skip the files that were done before the checkpoint              */
+   if(opts->resume)
+   {
+      if((ck->nextFile <= build->first) || (ck->nextFile > build->last) ||
+         strcmp(build->files[ck->nextFile-1], ck->lastFile))
+      {
+         fprintf(stderr,"Error (buildloopdb): The file list does not \
+match the checkpoint\n");
+         return(FALSE);
+      }
+      build->first = (int)ck->nextFile;
+      if(opts->verbose)
+         fprintf(stderr,"Resuming after: %s\n", ck->lastFile);
+   }
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL ProcessAllFiles(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                               BOOL verbose, PREVBUILD *prev,
+                               char *ckFile, int ckInterval,
+                               CHECKPOINT *ck, CAPACK *pack)
+   ------------------------------------------------------------------
+*//**
+   \param[in,out] *build   The build
+   \param[in]   *dbOut     Database output(s)
+   \param[in]   verbose    Verbose mode
+   \param[in]   *prev      Previous build to reuse records from (or 
+                           NULL)
+   \param[in]   *ckFile    Checkpoint filename (or blank)
+   \param[in]   ckInterval Seconds between checkpoints
+   \param[in,out] *ck      Checkpoint
+   \param[in]   *pack      CA pack to take the files from (or NULL)
+   \return                 Success (FALSE if an error stopped the
+                           build; the reason is reported)
+
+   Steps through this run's part of the file list (see ListFiles())
+   and processes each file via calls to ProcessFile()
+
+   When updating a previous build, the records for files that have not
+   changed are copied from the previous database instead of processing
+   the file again.
+
+   When checkpointing, a checkpoint is written after a file has been 
+   completed if ckInterval seconds have passed since the last one. On
+   resuming, the outputs have already been truncated to match the
+   checkpoint.
+
+   When running from a CA pack, the CAs of each file come from the pack
+   and the PDB files are not read.
+
+-  14.07.15 Original   By: ACRM
+-  03.11.15 Now reads the file list first and then works through.
+            It seemed to be failing, maybe because the directory was
+            changing?
+-  04.11.15 Added limit
+-  18.10.26 Takes a DBOUTPUT rather than a FILE
+-  18.10.26 Sorts the file list, applying the limit afterwards, and
+            added sharding
+-  18.10.26 Reuses records from a previous build and writes the
+            manifest
+-  18.10.26 Added checkpointing
+-  18.10.26 Added running from a CA pack and writing one
+-  18.10.26 Lengths and distance tables are part of the DBOUTPUT
+-  18.10.26 Records per-file statistics for --stats
+-  18.10.26 Reports the files skipped by the pre-screen
+-  18.10.26 Takes the build handle rather than using globals
+-  18.10.26 The file list is made by ListFiles() when the build is
+            opened. Stops and returns FALSE on an error rather than
+            exiting
+*/
+static BOOL ProcessAllFiles(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                            BOOL verbose, PREVBUILD *prev,
+                            char *ckFile, int ckInterval,
+                            CHECKPOINT *ck, CAPACK *pack)
+
+{
+   char          *fname;
+   FILE          *in;
+   int           i;
+   time_t        lastCk;
+   double        tFile   = 0.0;
+   long          atoms   = 0;
+   
+   time(&lastCk);
+   
+   /* now work through the file list processing each in turn            */
+   for(i=build->first; (i<build->last) && !build->failed; i++)
+   {
+      MFENTRY entry;
+      
+      fname          = build->files[i];
+      entry.first    = dbOut->nRecords;
+      entry.hash     = 0;
+      if(build->stats != NULL)
+      {
+         StatsResetItem(&(build->stats->phases));
+         tFile = StatsClock();
+         atoms = build->stats->nAtoms;
+      }
+      
+      if(pack != NULL)
+      {
+         CPENTRY *e = pack->entries + i;
+         fprintf(stderr,"Processing: %s\n", fname);
+         ProcessPackedFile(build, pack, (long)i, dbOut, 
+                           blFNam2PDB(fname), verbose);
+         if(build->stats != NULL)
+            RecordFileStats(build, fname, StatsClock() - tFile, 
+                            build->stats->nAtoms - atoms);
+         entry.size  = e->size;
+         entry.mtime = e->mtime;
+         entry.hash  = e->hash;
+      }
+      else if((prev != NULL) && 
+              ReusePrevRecords(build, dbOut, prev, fname, &entry))
+      {
+         if(verbose)
+            fprintf(stderr,"Unchanged: %s\n", fname);
+         if(build->stats != NULL)
+            build->stats->nReused++;
+      }
+      else if(build->failed)
+      {
+         break;
+      }
+      else if((in=fopen(fname, "r"))!=NULL)
+      {
+         char *pdbCode;
+         pdbCode = blFNam2PDB(fname);
+         fprintf(stderr,"Processing: %s\n", fname);
+         ProcessFile(build, in, dbOut, pdbCode, verbose);
+         fclose(in);
+         if(build->stats != NULL)
+            RecordFileStats(build, fname, StatsClock() - tFile, 
+                            build->stats->nAtoms - atoms);
+
+
+         if((dbOut->mf != NULL) || (dbOut->cw != NULL))
+         {
+            BOOL gotDetails = GetFileDetails(fname, &entry, TRUE);
+
+            if(!gotDetails)
+               entry.size = entry.mtime = 0;
+            if((dbOut->cw != NULL) && 
+               !EndCAPackFile(dbOut->cw, fname, &entry))
+            {
+               fprintf(stderr,"Error (buildloopdb): Failed writing CA \
+pack\n");
+               build->failed = TRUE;
+            }
+            if(!gotDetails)
+               continue;
+         }
+      }
+      else
+      {
+         if(verbose)
+            fprintf(stderr,"Could not open file: %s\n", fname);
+         if(build->stats != NULL)
+            build->stats->nUnreadable++;
+         continue;
+      }
+
+      /* A file that failed part way through is neither in the manifest
+         nor checkpointed
+      */
+      if(build->failed)
+         break;
+
+      if(dbOut->mf != NULL)
+      {
+         entry.path     = fname;
+         entry.nRecords = dbOut->nRecords - entry.first;
+         WriteManifestEntry(dbOut->mf, &entry);
+      }
+
+      if(ckFile[0] && (time(NULL) - lastCk >= ckInterval))
+      {
+         ck->nextFile = i+1;
+         strncpy(ck->lastFile, fname, CK_MAXFILE);
+         ck->lastFile[CK_MAXFILE-1] = '\0';
+         if(Checkpoint(dbOut, ck, ckFile))
+         {
+            if(verbose)
+               fprintf(stderr,"Checkpoint: %s\n", fname);
+         }
+         else
+         {
+            fprintf(stderr,"Warning (buildloopdb): Unable to write \
+checkpoint %s\n", ckFile);
+         }
+         time(&lastCk);
+      }
+   }
+
+   if(build->screened[PS_NOPROTEIN] || build->screened[PS_CAONLY] ||
+      build->screened[PS_SHORT])
+   {
+      fprintf(stderr,"Skipped by pre-screen: %ld no protein, %ld CA \
+only, %ld too short\n", build->screened[PS_NOPROTEIN],
+              build->screened[PS_CAONLY], build->screened[PS_SHORT]);
+   }
+
+   return(!build->failed);
+}
+
+
+/************************************************************************/
+/*>static int cmpFilenames(const void *p1, const void *p2)
+   -------------------------------------------------------
+*//**
+   \param[in]  *p1    Pointer to first filename pointer
+   \param[in]  *p2    Pointer to second filename pointer
+   \return            Comparison as for strcmp()
+
+   Comparison routine used by qsort() to sort the file list
+
+-  18.10.26 Original   By: ACRM
+*/
+static int cmpFilenames(const void *p1, const void *p2)
+{
+   return(strcmp(*((char **)p1), *((char **)p2)));
+}
+
+/************************************************************************/
+/*>static void ProcessFile(LOOPDBBUILD *build, FILE *in, DBOUTPUT *dbOut,
+                           char *pdbCode, BOOL verbose)
+   ----------------------------------------------------------------------
+*//**
+   \param[in]   *build     The build
+   \param[in]   *in        Input file pointer (for PDB file)
+   \param[in]   *dbOut     Database output(s)
+   \param[in]   pdbCode    PDB code for this file
+   \param[in]   verbose    Verbose mode
+
+   Obtains the PDB data and calls AnalyseStructure() to do the real
+   work. With --stream, ProcessFileByChain() is used instead. Unless
+   --noprescreen or --reference is given, files that PreScreenFile()
+   shows can't contain a loop are skipped without being parsed. Before
+   that, the experimental details are read from the header if they are
+   to be written or filtered on, and entries failing the filters are
+   rejected. With --dedup, chains repeating one already analysed are
+   removed (see dedup.c). If an error stops the build, it is reported
+   and build->failed is set.
+
+-  14.07.15 Original   By: ACRM
+-  03.11.15 RunAnalysis() now returns number of loops found
+-  10.12.15 Added check that PDB backbone has no missing atoms
+-  18.10.26 Takes a DBOUTPUT rather than a FILE
+-  18.10.26 Extracts the backbone for the coordinate file
+-  18.10.26 Finds chain breaks and writes the CA pack
+-  18.10.26 Lengths and distance tables are part of the DBOUTPUT
+-  18.10.26 Times each phase and counts rejected files for --stats
+-  18.10.26 Calls RunReferenceAnalysis() instead with --reference
+-  18.10.26 The analysis of the atoms is now in AnalyseStructure()
+-  18.10.26 Pre-screens the file
+-  18.10.26 Reads the experimental details and applies the filters
+-  18.10.26 Removes the chains that are aliases with --dedup
+-  18.10.26 Takes the build handle rather than using globals
+-  18.10.26 Sets build->failed rather than exiting on an error
+*/
+static void ProcessFile(LOOPDBBUILD *build, FILE *in, DBOUTPUT *dbOut,
+                        char *pdbCode, BOOL verbose)
+
+{
+   PDB       *pdb;
+   int       natoms,
+             nLoops,
+             screen;
+   BOOL      complete;
+   STATSMARK mark;
+
+   if(build->exptl)
+   {
+      STATS_START(build->stats, mark);
+      if(!ReadExptl(in, &(build->entry)))
+      {
+         fprintf(stderr,"Error (buildloopdb): Unable to rewind %s after \
+reading its header\n", pdbCode);
+         build->failed = TRUE;
+         return;
+      }
+      STATS_STOP(build->stats, mark, BP_READ);
+      if(!ExptlPasses(&(build->entry), &(build->opts.filter)))
+      {
+         if(build->stats != NULL)
+            build->stats->nExptl++;
+         if(verbose)
+            fprintf(stderr,"Rejected: %s, resolution %.2f, R-factor \
+%.3f\n", ExptlMethodName(build->entry.method),
+                    build->entry.resolution, build->entry.rFactor);
+         return;
+      }
+   }
+
+   if(build->preScreen)
+   {
+      STATS_START(build->stats, mark);
+      screen = PreScreenFile(in, ScreenResidues(dbOut));
+      STATS_STOP(build->stats, mark, BP_READ);
+      if(screen != PS_USABLE)
+      {
+         build->screened[screen]++;
+         if(verbose)
+            fprintf(stderr,"Skipped by pre-screen: %s\n", 
+                    sScreenReasons[screen]);
+         return;
+      }
+   }
+
+   if(build->opts.stream)
+   {
+      ProcessFileByChain(build, in, dbOut, pdbCode, verbose);
+      return;
+   }
+
+   STATS_START(build->stats, mark);
+   pdb = blReadPDBAtoms(in, &natoms);
+   STATS_STOP(build->stats, mark, BP_READ);
+
+   if(pdb != NULL)
+   {
+      if(build->stats != NULL)
+         build->stats->nAtoms += natoms;
+
+      STATS_START(build->stats, mark);
+      complete = BackboneComplete(pdb);
+      STATS_STOP(build->stats, mark, BP_BACKBONE);
+
+      if(complete && (build->dedup != NULL))
+      {
+         STATS_START(build->stats, mark);
+         pdb = DedupChains(build->dedup, pdb, pdbCode);
+         STATS_STOP(build->stats, mark, BP_DEDUP);
+         if(build->dedup->error)
+         {
+            fprintf(stderr,"Error (buildloopdb): No memory to compare \
+chains\n");
+            FREELIST(pdb, PDB);
+            build->failed = TRUE;
+            return;
+         }
+      }
+
+      if(complete && (pdb == NULL))
+      {
+         if(verbose)
+            fprintf(stderr,"Every chain is an alias\n");
+      }
+      else if(complete)
+      {
+         nLoops = AnalyseStructure(build, dbOut, pdb, pdbCode, NULL);
+         if(build->failed)
+            return;
+         if(nLoops < 0)
+         {
+            if(build->stats != NULL)
+               build->stats->nNoCa++;
+            if(verbose)
+               fprintf(stderr,"No CA atoms extracted\n");
+         }
+         else if(verbose)
+         {
+            fprintf(stderr,"%d loops found\n", nLoops);
+         }
+      }
+      else
+      {
+         if(build->stats != NULL)
+            build->stats->nIncomplete++;
+         FREELIST(pdb, PDB);
+      }
+   }
+   else
+   {
+      if(build->stats != NULL)
+         build->stats->nNoAtoms++;
+      if(verbose)
+         fprintf(stderr,"No atoms read from PDB file\n");
+   }
+}
+
+
+/************************************************************************/
+/*>static int ScreenResidues(DBOUTPUT *dbOut)
+   ------------------------------------------
+*//**
+   \param[in]   *dbOut     Database output(s)
+   \return                 Fewest CA atoms that can hold a loop for the
+                           pre-screen
+
+   Two stems and the shortest loop wanted by any output. When a CA pack
+   is being written, short files must still be read so that their CAs
+   go in the pack, so 0 is returned.
+
+-  18.10.26 Original   By: ACRM
+*/
+static int ScreenResidues(DBOUTPUT *dbOut)
+{
+   DBOUTPUT *o;
+   int      minLength = dbOut->minLength;
+
+   if(dbOut->cw != NULL)
+      return(0);
+   for(o=dbOut->next; o!=NULL; NEXT(o))
+   {
+      if(o->minLength < minLength)
+         minLength = o->minLength;
+   }
+   return(2 * dbOut->nStem + ((minLength > 1) ? minLength : 1));
+}
+
+
+/************************************************************************/
+/*>static BOOL OpenAliases(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                           char *aliasFile, REAL tolerance,
+                           BOOL acrossEntries)
+   -------------------------------------------------------------
+*//**
+   \param[in,out] *build        The build (its dedup is set)
+   \param[in]   *dbOut          Database output(s)
+   \param[in]   *aliasFile      Alias file to write
+   \param[in]   tolerance       Max difference in a CA-CA distance
+   \param[in]   acrossEntries   Also find aliases in earlier entries
+   \return                      Success
+
+   Starts deduplication for --dedup. Only the distances between CAs
+   close enough in the chain to be in the same record of one of the
+   outputs need to be compared.
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL OpenAliases(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                        char *aliasFile, REAL tolerance,
+                        BOOL acrossEntries)
+{
+   DBOUTPUT *o;
+   int      maxLength = dbOut->maxLength;
+
+   for(o=dbOut->next; o!=NULL; NEXT(o))
+   {
+      if(maxLength && ((o->maxLength == 0) || (o->maxLength > maxLength)))
+         maxLength = o->maxLength;
+   }
+
+   if((build->dedup = OpenDedup(aliasFile, tolerance, 
+                                maxLength?(maxLength + 2*dbOut->nStem):0,
+                                acrossEntries))==NULL)
+   {
+      fprintf(stderr,"Error (buildloopdb): Unable to create alias file \
+%s\n", aliasFile);
+      return(FALSE);
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static BOOL CloseAliases(LOOPDBBUILD *build)
+   --------------------------------------------
+*//**
+   \param[in,out] *build  The build (its dedup is closed)
+   \return                Success
+
+   Reports the aliases found with --dedup, keeps the counts for the
+   --stats report and closes the alias file
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL CloseAliases(LOOPDBBUILD *build)
+{
+   DEDUP *dd = build->dedup;
+   BOOL  ok;
+
+   if(dd == NULL)
+      return(TRUE);
+
+   if(dd->nWithin || dd->nAcross)
+   {
+      fprintf(stderr,"Aliases: %ld of %ld chains, %ld in the same \
+entry, %ld in earlier entries\n", dd->nWithin + dd->nAcross,
+              dd->nChains, dd->nWithin, dd->nAcross);
+   }
+   if(build->stats != NULL)
+   {
+      build->stats->nChains = dd->nChains;
+      build->stats->nWithin = dd->nWithin;
+      build->stats->nAcross = dd->nAcross;
+   }
+
+   if(!(ok = CloseDedup(dd)))
+
+      fprintf(stderr,"Error (buildloopdb): Failed writing alias \
+file\n");
+   build->dedup = NULL;
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>static void ProcessFileByChain(LOOPDBBUILD *build, FILE *in,
+                                  DBOUTPUT *dbOut, char *pdbCode,
+                                  BOOL verbose)
+   --------------------------------------------------------------
+*//**
+   \param[in]   *build     The build
+   \param[in]   *in        Input file pointer (for PDB file)
+   \param[in]   *dbOut     Database output(s)
+   \param[in]   pdbCode    PDB code for this file
+   \param[in]   verbose    Verbose mode
+
+   As ProcessFile() but, for --stream, reads and analyses one chain at
+   a time (see chainread.c) so that memory is bounded by the largest
+   chain rather than the whole structure.
+
+   The file is read twice. The first pass checks that the backbone of
+   every chain is complete, since a file with any incomplete chain is
+   rejected as a whole, and keeps the first CA of each chain. In the
+   second pass each chain is analysed with the first CA of the next
+   chain after it, so that the link between them is checked as it is
+   in the whole structure. The records are the same as from
+   ProcessFile() except that loops running from one chain into the
+   next, which need the end of one chain to lie within bonding
+   distance of the start of the next, are not found.
+
+   With --dedup, each chain is compared with the earlier ones as it is
+   read and is not analysed if it is an alias. If an error stops the
+   build, it is reported and build->failed is set.
+
+-  18.10.26 Original   By: ACRM
+*/
+static void ProcessFileByChain(LOOPDBBUILD *build, FILE *in,
+                               DBOUTPUT *dbOut, char *pdbCode,
+                               BOOL verbose)
+{
+   CHAINREADER *cr;
+   PDB         *pdb,
+               *p,
+               *firstCa = NULL,
+               *moreCa;
+   char        *hasCa   = NULL,
+               *moreHas;
+   int         natoms,
+               nChainLoops,
+               nLoops   = 0,
+               nChains  = 0,
+               maxChains = 0,
+               chain,
+               next,
+               nAliases = 0;
+   long        nAtoms   = 0;
+   BOOL        complete = TRUE,
+               gotCa    = FALSE,
+               isAlias  = FALSE;
+   STATSMARK   mark;
+
+   if((cr = OpenChainReader(in))==NULL)
+   {
+      fprintf(stderr,"Error (buildloopdb): No memory to read %s\n",
+              pdbCode);
+      build->failed = TRUE;
+      return;
+   }
+
+   /* Check every chain before writing anything, keeping the first CA
+      of each
+   */
+   STATS_START(build->stats, mark);
+   while(complete && ReadNextChain(cr, &pdb, &natoms))
+   {
+      STATS_STOP(build->stats, mark, BP_READ);
+      if(nChains == maxChains)
+      {
+         maxChains += 64;
+         if((moreCa = (PDB *)realloc(firstCa, 
+                                     maxChains * sizeof(PDB)))!=NULL)
+            firstCa = moreCa;
+         if((moreHas = (char *)realloc(hasCa, maxChains))!=NULL)
+            hasCa = moreHas;
+         if((moreCa == NULL) || (moreHas == NULL))
+         {
+            fprintf(stderr,"Error (buildloopdb): No memory for \
+chains\n");
+            FREELIST(pdb, PDB);
+            build->failed = TRUE;
+            break;
+         }
+      }
+      hasCa[nChains] = 0;
+      for(p=pdb; p!=NULL; NEXT(p))
+      {
+         if(!strncmp(p->atnam, "CA  ", 4))
+         {
+            firstCa[nChains] = *p;
+            hasCa[nChains]   = 1;
+            break;
+         }
+      }
+      nChains++;
+
+      if(pdb != NULL)
+      {
+         nAtoms  += natoms;
+         complete = BackboneComplete(pdb);
+         FREELIST(pdb, PDB);
+      }
+      STATS_STOP(build->stats, mark, BP_BACKBONE);
+   }
+   STATS_STOP(build->stats, mark, BP_READ);
+
+   if(build->stats != NULL)
+      build->stats->nAtoms += nAtoms;
+
+   if(build->failed)
+   {
+      /* The error has been reported                                   */
+   }
+   else if(!cr->error && (nAtoms == 0))
+   {
+      if(build->stats != NULL)
+         build->stats->nNoAtoms++;
+      if(verbose)
+         fprintf(stderr,"No atoms read from PDB file\n");
+   }
+   else if(!cr->error && !complete)
+   {
+      if(build->stats != NULL)
+         build->stats->nIncomplete++;
+   }
+   else if(!cr->error)
+   {
+      if(!RewindChainReader(cr))
+      {
+         fprintf(stderr,"Error (buildloopdb): Unable to rewind %s\n",
+                 pdbCode);
+         build->failed = TRUE;
+      }
+
+      /* Now find the loops one chain at a time                         */
+      if(build->dedup != NULL)
+         NewDedupEntry(build->dedup);
+      STATS_START(build->stats, mark);
+      for(chain=0; 
+          !build->failed && ReadNextChain(cr, &pdb, &natoms); 
+          chain++)
+      {
+         STATS_STOP(build->stats, mark, BP_READ);
+         for(next=chain+1; (next < nChains) && !hasCa[next]; next++)
+            ;
+         /* No loops run from one chain into the next with --stream, so
+            no chain is linked to another
+         */
+         if((pdb != NULL) && (build->dedup != NULL))
+         {
+            if(!DedupChain(build->dedup, pdb, pdbCode, FALSE, &isAlias))
+            {
+               fprintf(stderr,"Error (buildloopdb): No memory to \
+compare chains\n");
+               FREELIST(pdb, PDB);
+               build->failed = TRUE;
+               break;
+            }
+            STATS_STOP(build->stats, mark, BP_DEDUP);
+            if(isAlias)
+            {
+               FREELIST(pdb, PDB);
+               nAliases++;
+            }
+         }
+         if((pdb != NULL) &&
+            ((nChainLoops = AnalyseStructure(build, dbOut, pdb, pdbCode,
+                                             (next < nChains) ?
+                                             firstCa + next : NULL))
+             >= 0))
+
+         {
+            nLoops += nChainLoops;
+            gotCa   = TRUE;
+         }
+         STATS_START(build->stats, mark);
+      }
+      STATS_STOP(build->stats, mark, BP_READ);
+
+      if(build->failed)
+      {
+         /* The error has been reported                                */
+      }
+      else if(!gotCa && nAliases)
+      {
+         if(verbose)
+            fprintf(stderr,"Every chain is an alias\n");
+      }
+      else if(!gotCa)
+      {
+         if(build->stats != NULL)
+            build->stats->nNoCa++;
+         if(verbose)
+            fprintf(stderr,"No CA atoms extracted\n");
+      }
+      else if(verbose)
+      {
+         fprintf(stderr,"%d loops found\n", nLoops);
+      }
+   }
+
+   if(cr->error && !build->failed)
+   {
+      fprintf(stderr,"Error (buildloopdb): Failed reading %s one \
+chain at a time\n", pdbCode);
+      build->failed = TRUE;
+   }
+   CloseChainReader(cr);
+   free(firstCa);
+   free(hasCa);
+}
+
+
+/************************************************************************/
+/*>static int AnalyseStructure(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                               PDB *pdb, char *pdbCode, PDB *nextCa)
+   -------------------------------------------------------------------
+*//**
+   \param[in]   *build     The build
+   \param[in]   *dbOut     Database output(s)
+   \param[in]   *pdb       Atoms of a structure with a complete
+                           backbone. Freed
+   \param[in]   pdbCode    PDB code for this file
+   \param[in]   *nextCa    With --stream, the first CA of the chain
+                           after this one (or NULL)
+   \return                 Number of loops found (-1 if there are no
+                           CA atoms or an error has stopped the build,
+                           when build->failed is set)
+
+   Selects the CAs and calls RunAnalysis() to find the loops. If 
+   coordinates are being written, the backbone is extracted before the
+   CAs are selected. If a CA pack is being written, the CAs are added
+   to it. A copy of nextCa is added to the end of the CAs so that the
+   link to the next chain is checked for breaks as it would be if the
+   whole structure were being analysed. It is then marked as followed
+   by a break so that no loop can include it, as a loop ending in it
+   would run into the next chain and the backbone (and the rest of the
+   next chain) are not available for it.
+
+-  18.10.26 Original, from ProcessFile()   By: ACRM
+*/
+static int AnalyseStructure(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                            PDB *pdb, char *pdbCode, PDB *nextCa)
+{
+   PDB       *p;
+   BBRES     *backbone = NULL;
+   char      *breakAfter;
+   int       nRes      = 0,
+             nCa,
+             nLoops    = -1;
+   BOOL      wantBackbone;
+   STATSMARK mark;
+
+   /* ExtractBackbone() also gives NULL if there are no CAs, which is
+      only an error if blSelectCaPDB() finds some
+   */
+   wantBackbone = (dbOut->lw != NULL) ||
+                  ((dbOut->cw != NULL) && dbOut->cw->header.hasBackbone);
+   if(wantBackbone)
+      backbone = ExtractBackbone(pdb, &nRes);
+
+   /* Extract the CAs                                                   */
+   STATS_START(build->stats, mark);
+   pdb = blSelectCaPDB(pdb);
+   STATS_STOP(build->stats, mark, BP_SELECTCA);
+
+   if(pdb != NULL)
+   {
+      if(wantBackbone && (backbone == NULL))
+      {
+         fprintf(stderr,"Error (buildloopdb): No memory for \
+backbone\n");
+         build->failed = TRUE;
+      }
+
+      /* The backbone must line up with the CA list                     */
+      if(backbone != NULL)
+      {
+         for(p=pdb; p!=NULL; NEXT(p))
+            nRes--;
+         if(nRes != 0)
+         {
+            fprintf(stderr,"Error (buildloopdb): Backbone does \
+not match CA atoms for %s\n", pdbCode);
+            build->failed = TRUE;
+         }
+      }
+
+      if(!build->failed && (nextCa != NULL))
+      {
+         for(p=pdb; p->next!=NULL; NEXT(p))
+            ;
+         ALLOCNEXT(p, PDB);
+         if(p == NULL)
+         {
+            fprintf(stderr,"Error (buildloopdb): No memory for next \
+chain\n");
+            build->failed = TRUE;
+         }
+         else
+         {
+            *p      = *nextCa;
+            p->next = NULL;
+         }
+      }
+            
+      if(!build->failed &&
+         ((breakAfter = MarkChainBreaks(pdb, &nCa))==NULL))
+      {
+         fprintf(stderr,"Error (buildloopdb): No memory for \
+chain breaks\n");
+         build->failed = TRUE;
+      }
+      if(build->failed)
+      {
+         FREELIST(pdb, PDB);
+         if(backbone != NULL)
+            free(backbone);
+         return(-1);
+      }
+      if(nextCa != NULL)
+         breakAfter[nCa-1] = 1;
+
+      if((dbOut->cw != NULL) &&
+         !WriteCAPackResidues(dbOut->cw, pdb, backbone, breakAfter))
+      {
+         fprintf(stderr,"Error (buildloopdb): Failed writing CA \
+pack\n");
+         build->failed = TRUE;
+      }
+            
+      /* Run the analysis                                               */
+      if(build->stats != NULL)
+         build->stats->nResidues += (nextCa != NULL) ? nCa - 1 : nCa;
+      if(build->failed)
+         nLoops = -1;
+      else if(build->opts.reference)
+         nLoops = RunReferenceAnalysis(build, dbOut, pdb, pdbCode);
+      else
+         nLoops = RunAnalysis(build, dbOut, pdb, backbone, breakAfter,
+                              pdbCode);
+            
+      free(breakAfter);
+      FREELIST(pdb, PDB);
+   }
+
+   if(backbone != NULL)
+      free(backbone);
+   return(nLoops);
+}
+
+
+
+/************************************************************************/
+/*>static void ProcessPackedFile(LOOPDBBUILD *build, CAPACK *pack,
+                                 long file, DBOUTPUT *dbOut,
+                                 char *pdbCode, BOOL verbose)
+   ---------------------------------------------------------------
+*//**
+   \param[in]   *build     The build
+   \param[in]   *pack      CA pack
+   \param[in]   file       File number in the pack
+   \param[in]   *dbOut     Database output(s)
+   \param[in]   pdbCode    PDB code for this file
+   \param[in]   verbose    Verbose mode
+
+   As ProcessFile() but takes the CAs, and the backbone if needed, from
+   a CA pack rather than reading the PDB file.
+
+-  18.10.26 Original   By: ACRM
+*/
+static void ProcessPackedFile(LOOPDBBUILD *build, CAPACK *pack,
+                              long file, DBOUTPUT *dbOut,
+                              char *pdbCode, BOOL verbose)
+{
+   PDB   *pdb;
+   CARES *res;
+   BBRES *backbone;
+   char  *breakAfter;
+   int   nRes,
+         nLoops,
+         i;
+   STATSMARK mark;
+
+   STATS_START(build->stats, mark);
+   res = CAPackResidues(pack, file, &nRes, &backbone);
+   if(nRes == 0)
+   {
+      STATS_STOP(build->stats, mark, BP_READ);
+      return;
+   }
+
+   pdb = CAPackToPDB(res, nRes);
+   if((pdb == NULL) ||
+      ((breakAfter = (char *)malloc(nRes * sizeof(char)))==NULL))
+   {
+      STATS_STOP(build->stats, mark, BP_READ);
+      fprintf(stderr,"Error (buildloopdb): No memory for CA atoms\n");
+      FREELIST(pdb, PDB);
+      build->failed = TRUE;
+      return;
+   }
+   for(i=0; i<nRes; i++)
+      breakAfter[i] = (char)((res[i].flags & CP_BREAK)?1:0);
+   STATS_STOP(build->stats, mark, BP_READ);
+
+   if(build->stats != NULL)
+   {
+      build->stats->nAtoms    += nRes;
+      build->stats->nResidues += nRes;
+   }
+   nLoops = RunAnalysis(build, dbOut, pdb, backbone, breakAfter,
+                        pdbCode);
+
+   if(verbose)
+      fprintf(stderr,"%d loops found\n", nLoops);
+
+   free(breakAfter);
+   FREELIST(pdb, PDB);
+}
+
+
+/************************************************************************/
+/*>static int RunAnalysis(LOOPDBBUILD *build, DBOUTPUT *dbOut, PDB *pdb,
+                          BBRES *backbone, char *breakAfter,
+                          char *pdbCode)
+   ----------------------------------------------------------------------
+*//**
+   \param[in]   *build      The build
+   \param[in]   *dbOut      Database output(s)
+   \param[in]   *pdb        Pointer to PDB linked list
+   \param[in]   *backbone   Backbone for each CA in the list (or NULL)
+   \param[in]   *breakAfter Chain break flags from MarkChainBreaks()
+   \param[in]   *pdbCode    PDB code for this file    
+   \return                  Number of loops found (summed over outputs)
+
+   Does the real work of analyzing a structure. Steps through N-ter and
+   C-ter triplets of residues to find those that match the requirements
+   of the minTable and maxTable distance matrices as well as any specified
+   loop length requirements.
+
+   Each output in the dbOut list has its own length range and distance
+   tables. A candidate is tested against all the outputs that accept its
+   length; each distance is calculated once and shared between them and
+   the calculation stops as soon as every output has rejected it.
+
+   The stems have dbOut->nStem residues and the distances are checked
+   by the kernel compiled for that size (see buildkernel.h).
+
+   A structure of at least BL_MINPARALLEL residues is split into tasks,
+   one for each chain or each BL_TASKSIZE positions of n[0] in a long
+   chain, which are run by build->nThreads threads (see AnalysisThread()).
+   The loops found by each task are kept and written once they have all
+   finished, in task order, so the records are the same as those from a
+   single thread. Smaller structures are done by this thread as a
+   single task, writing the loops as they are found. If an error stops
+   the build, it is reported and build->failed is set.
+
+-  14.07.15 Original   By: ACRM
+-  03.11.15 Now returns number of loops found
+-  04.11.15 Now calls blFindNextChain() rather than blFindNextChainPDB()
+            so the the first chain isn't terminated.
+-  13.12.17 Added check on chain change when finding Nter and Cter
+            residues (fixed bug with 2nd and subsequent chains being
+            done multiple times).
+-  18.10.26 Takes a DBOUTPUT rather than a FILE
+-  18.10.26 Tracks the position of n[0] so the backbone can be output
+-  18.10.26 Uses precalculated chain breaks rather than ChainIsIntact()
+-  18.10.26 Lengths and distance tables now come from the DBOUTPUT and
+            all the outputs in the list are handled in one pass
+-  18.10.26 Any stem size, using the specialized kernels
+-  18.10.26 Counts candidates and rejections for --stats
+-  18.10.26 Times the analysis itself, less the output
+-  18.10.26 The search itself is in AnalyseTask(). Large structures are
+            split into tasks run by several threads
+-  18.10.26 Takes the build handle rather than using globals
+-  18.10.26 Sets build->failed rather than exiting on an error
+*/
+static int RunAnalysis(LOOPDBBUILD *build, DBOUTPUT *dbOut, PDB *pdb,
+                       BBRES *backbone, char *breakAfter, char *pdbCode)
+
+{
+   BUILDPOOL  pool;
+   BUILDTASK  *tasks = NULL,
+              *task;
+   BUILDHIT   *hit;
+   PDB        *n[MAXSTEM], *c[MAXSTEM],
+              *p,
+              *nextChain;
+   DBOUTPUT   *o;
+   int        i, j, k, t,
+              nStem    = dbOut->nStem,
+              nloops   = 0,
+              nRes     = 0,
+              nTasks   = 0,
+              nThreads = build->nThreads;
+   long       h;
+   unsigned long bit;
+   STATSMARK  mark;
+   
+   STATS_START(build->stats, mark);
+
+   /* The overall length range covered by the outputs                   */
+   pool.minLength = dbOut->minLength;
+   pool.maxLength = dbOut->maxLength;
+   for(o=dbOut->next; o!=NULL; NEXT(o))
+   {
+      if(o->minLength < pool.minLength)
+         pool.minLength = o->minLength;
+      if(pool.maxLength && 
+         ((o->maxLength == 0) || (o->maxLength > pool.maxLength)))
+         pool.maxLength = o->maxLength;
+   }
+
+   /* nBreaks[i] is the number of breaks before CA i, so a stretch is
+      intact if the count doesn't change across it
+   */
+   for(p=pdb; p!=NULL; NEXT(p))
+      nRes++;
+   if((pool.nBreaks = (int *)malloc((nRes + 1) * sizeof(int)))==NULL)
+   {
+      fprintf(stderr,"Error (buildloopdb): No memory for chain \
+breaks\n");
+      build->failed = TRUE;
+      STATS_STOP(build->stats, mark, BP_ANALYSIS);
+      return(0);
+   }
+   pool.nBreaks[0] = 0;
+   for(i=0; i<nRes; i++)
+      pool.nBreaks[i+1] = pool.nBreaks[i] + (breakAfter[i]?1:0);
+
+   pool.build    = build;
+   pool.dbOut    = dbOut;
+   pool.pdbCode  = pdbCode;
+   pool.backbone = backbone;
+   pool.mark     = &mark;
+   pool.nextTask = 0;
+
+   /* Split a large structure into tasks at the start of each chain and
+      every BL_TASKSIZE residues within a chain
+   */
+   if((nRes >= BL_MINPARALLEL) && (nThreads > 1))
+   {
+      for(i=0, p=pdb, nextChain=pdb; p!=NULL; NEXT(p), i++)
+      {
+         if((p == nextChain) || ((i % BL_TASKSIZE) == 0))
+            nTasks++;
+         if(p == nextChain)
+         {
+            nextChain = blFindNextChain(p);
+            i         = 0;
+         }
+      }
+      if((tasks = (BUILDTASK *)calloc(nTasks, sizeof(BUILDTASK)))==NULL)
+         nTasks = 0;
+   }
+
+   if(nTasks > 1)
+   {
+      for(i=0, k=0, p=pdb, nextChain=pdb, task=tasks-1; 
+          p!=NULL; 
+          NEXT(p), i++, k++)
+      {
+         if((p == nextChain) || ((i % BL_TASKSIZE) == 0))
+         {
+            task++;
+            task->start  = p;
+            task->nIndex = k;
+         }
+         if(p == nextChain)
+         {
+            nextChain = blFindNextChain(p);
+            i         = 0;
+         }
+         if((p->next == NULL) || (p->next == nextChain) ||
+            (((i + 1) % BL_TASKSIZE) == 0))
+            task->stop = p->next;
+      }
+
+      pool.direct = FALSE;
+      pool.tasks  = tasks;
+      pool.nTasks = nTasks;
+      RunAnalysisThreads(&pool, nThreads);
+      STATS_STOP(build->stats, mark, BP_ANALYSIS);
+
+      /* Write the loops in the order they would have been found by a
+         single thread
+      */
+      for(t=0, task=tasks; t<nTasks; t++, task++)
+      {
+         if(task->failed && !build->failed)
+         {
+            fprintf(stderr,"Error (buildloopdb): No memory for \
+loops found\n");
+            build->failed = TRUE;
+         }
+         for(h=0, hit=task->hits; 
+             (h<task->nHits) && !build->failed; 
+             h++, hit++)
+         {
+            n[0] = hit->n0;
+            c[0] = hit->c0;
+            for(i=1; i<nStem; i++)
+            {
+               n[i] = n[i-1]->next;
+               c[i] = c[i-1]->next;
+            }
+            for(o=dbOut, bit=1; o!=NULL; NEXT(o), bit<<=1)
+            {
+               if(hit->outputs & bit)
+               {
+                  nloops++;
+                  PrintResults(build, o, pdbCode, hit->separation, n, c,
+                               hit->distMat, (backbone==NULL)?NULL:
+                               backbone+hit->nIndex);
+               }
+            }
+         }
+         free(task->hits);
+      }
+      STATS_STOP(build->stats, mark, BP_OUTPUT);
+   }
+   else
+   {
+      nTasks = 1;
+      if(tasks == NULL)
+      {
+         if((tasks = (BUILDTASK *)calloc(1, sizeof(BUILDTASK)))==NULL)
+         {
+            fprintf(stderr,"Error (buildloopdb): No memory for \
+analysis\n");
+            build->failed = TRUE;
+            free(pool.nBreaks);
+            STATS_STOP(build->stats, mark, BP_ANALYSIS);
+            return(0);
+         }
+      }
+      tasks->start  = pdb;
+      tasks->stop   = NULL;
+      tasks->nIndex = 0;
+
+      /* The kernels work on the outputs themselves                     */
+      pool.direct   = TRUE;
+      AnalyseTask(&pool, tasks, dbOut);
+      nloops        = tasks->nLoops;
+   }
+
+   if(build->stats != NULL)
+   {
+      for(t=0, task=tasks; t<nTasks; t++, task++)
+      {
+         build->stats->nCandidates += task->nCandidates;
+         build->stats->nChainBreak += task->nChainBreak;
+         build->stats->nLength     += task->nLength;
+         build->stats->nAccepted   += task->nAccepted;
+         for(j=0; j<nStem*nStem; j++)
+            build->stats->cellReject[j] += task->cellReject[j];
+      }
+      build->stats->nRecords += nloops;
+   }
+
+   free(tasks);
+   free(pool.nBreaks);
+   STATS_STOP(build->stats, mark, BP_ANALYSIS);
+   return(nloops);
+}
+
+
+/************************************************************************/
+/*>static void AnalyseTask(BUILDPOOL *pool, BUILDTASK *task, DBOUTPUT *check)
+   --------------------------------------------------------------------------
+*//**
+   \param[in]     *pool    The structure being analysed
+   \param[in,out] *task    The range of n[0] to search; the loops found
+                           and the counts for --stats are added to it
+   \param[in]     *check   Outputs used by the stem kernels; their
+                           wanted and failCell fields are changed
+
+   Searches for loops whose first N-terminal stem residue, n[0], is from
+   task->start up to (but not including) task->stop. If pool->direct is
+   set, check must be pool->dbOut and the loops are written as they are
+   found; otherwise check is a copy of the outputs belonging to this
+   thread and the loops are kept in the task to be written later.
+
+-  18.10.26 Original, from RunAnalysis()   By: ACRM
+*/
+static void AnalyseTask(BUILDPOOL *pool, BUILDTASK *task, DBOUTPUT *check)
+{
+   PDB      *n[MAXSTEM], *c[MAXSTEM],
+            *nextChain;
+   DBOUTPUT *o;
+   REAL     distMat[MAXSTEM][MAXSTEM];
+   CHECKSTEMS checkStems = sCheckStems[check->nStem];
+   int      i,
+            nStem     = check->nStem,
+            minLength = pool->minLength,
+            maxLength = pool->maxLength,
+            *nBreaks  = pool->nBreaks,
+            nIndex    = task->nIndex,
+            separation,
+            nWanted;
+   unsigned long outputs,
+            bit;
+
+   /* Find an N-terminal residue                                        */
+   nextChain = blFindNextChain(task->start);
+   for(n[0]=task->start; 
+       n[0]!=NULL && n[0]!=task->stop;
+       NEXT(n[0]), nIndex++)
+   {
+      if(n[0] == nextChain)
+         nextChain = blFindNextChain(n[0]);
+
+      /* And find the rest of the stem                                  */
+      for(i=1; i<nStem; i++)
+         n[i] = (n[i-1])?n[i-1]->next:NULL;
+
+      /* If they are all valid                                          */
+      if((n[nStem-1] == NULL) || (n[nStem-1]->next == NULL))
+         continue;
+
+      separation = 0;
+            
+      /* Find a C-terminal residue                                      */
+      for(c[0]=n[nStem-1]->next->next; 
+          c[0]!=NULL && c[0]!=nextChain;
+          NEXT(c[0]))
+      {
+         /* If the spacing between N and Cter is too long or not long
+            enough, break out
+         */
+         separation++;
+         if(maxLength && (separation > maxLength))
+            break;
+         if(separation < minLength)
+            continue;
+
+         /* And find the rest of the stem                               */
+         for(i=1; i<nStem; i++)
+            c[i] = (c[i-1])?c[i-1]->next:NULL;
+         if(c[nStem-1] == NULL)
+            continue;
+
+         /* There must be no breaks from n[0] up to and including the
+            link after the last residue of the C-terminal stem
+         */
+         task->nCandidates++;
+         if(nBreaks[nIndex+separation+2*nStem] != nBreaks[nIndex])
+         {
+            task->nChainBreak++;
+            continue;
+         }
+
+         /* Which outputs want a loop of this length                    */
+         nWanted = 0;
+         for(o=check; o!=NULL; NEXT(o))
+         {
+            o->wanted = (separation >= o->minLength) &&
+                        ((o->maxLength == 0) || 
+                         (separation <= o->maxLength));
+            if(o->wanted)
+               nWanted++;
+         }
+         if(!nWanted)
+         {
+            task->nLength++;
+            continue;
+         }
+
+         /* Create the distance matrix, dropping outputs as their tables
+            reject a distance
+         */
+         if(!(nWanted = (*checkStems)(n, c, check, nWanted, distMat)))
+         {
+            task->cellReject[check->failCell]++;
+            continue;
+         }
+         task->nAccepted++;
+
+         if(pool->direct)
+         {
+            STATS_STOP(pool->build->stats, *(pool->mark), BP_ANALYSIS);
+            for(o=check; o!=NULL; NEXT(o))
+            {
+               if(o->wanted)
+               {
+                  task->nLoops++;
+                  PrintResults(pool->build, o, pool->pdbCode,
+                               separation, n, c, distMat,
+                               (pool->backbone==NULL)?NULL:
+                               pool->backbone+nIndex);
+               }
+            }
+            STATS_STOP(pool->build->stats, *(pool->mark), BP_OUTPUT);
+         }
+         else if(!task->failed)
+         {
+            outputs = 0;
+            for(o=check, bit=1; o!=NULL; NEXT(o), bit<<=1)
+            {
+               if(o->wanted)
+                  outputs |= bit;
+            }
+            task->failed = !AddBuildHit(task, n[0], c[0], nIndex,
+                                        separation, outputs, nStem,
+                                        distMat);
+         }
+      }
+   }
+}
+
+
+/************************************************************************/
+/*>static BOOL AddBuildHit(BUILDTASK *task, PDB *n0, PDB *c0,
+                           int nIndex, int separation,
+                           unsigned long outputs, int nStem,
+                           REAL distMat[MAXSTEM][MAXSTEM])
+   -----------------------------------------------------------
+*//**
+   \param[in,out] *task        Task finding the loop
+   \param[in]     *n0          First N-terminal stem residue
+   \param[in]     *c0          First C-terminal stem residue
+   \param[in]     nIndex       Index of n0 among the CA atoms
+   \param[in]     separation   Loop length
+   \param[in]     outputs      Bit for each output that wants the loop
+   \param[in]     nStem        Residues in each stem
+   \param[in]     distMat      Distance matrix
+   \return                     Success (FALSE if no memory)
+
+   Keeps a loop found by a task so that it can be written later
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL AddBuildHit(BUILDTASK *task, PDB *n0, PDB *c0, int nIndex,
+                        int separation, unsigned long outputs, int nStem,
+                        REAL distMat[MAXSTEM][MAXSTEM])
+{
+   BUILDHIT *hit;
+   int      i, j;
+
+   if(task->nHits == task->maxHits)
+   {
+      task->maxHits = task->maxHits ? 2 * task->maxHits : 64;
+      if((hit = (BUILDHIT *)realloc(task->hits, 
+                                    task->maxHits * sizeof(BUILDHIT)))
+         ==NULL)
+         return(FALSE);
+      task->hits = hit;
+   }
+
+   hit = task->hits + task->nHits++;
+   hit->n0         = n0;
+   hit->c0         = c0;
+   hit->nIndex     = nIndex;
+   hit->separation = separation;
+   hit->outputs    = outputs;
+   for(i=0; i<nStem; i++)
+   {
+      for(j=0; j<nStem; j++)
+         hit->distMat[i][j] = distMat[i][j];
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static void RunAnalysisThreads(BUILDPOOL *pool, int nThreads)
+   -------------------------------------------------------------
+*//**
+   \param[in,out] *pool      The structure and its tasks
+   \param[in]     nThreads   Number of threads to use
+
+   Runs the tasks in the pool with up to nThreads threads, each taking
+   the next task that hasn't been started until there are none left.
+   If there is no memory for the threads, the tasks are all marked as
+   failed.
+
+-  18.10.26 Original   By: ACRM
+*/
+static void RunAnalysisThreads(BUILDPOOL *pool, int nThreads)
+{
+   BUILDWORKER *workers;
+   pthread_t   *threads;
+   DBOUTPUT    *o;
+   int         i, j;
+
+   if(nThreads > pool->nTasks)
+      nThreads = pool->nTasks;
+
+   workers = (BUILDWORKER *)malloc(nThreads * sizeof(BUILDWORKER));
+   threads = (pthread_t *)malloc(nThreads * sizeof(pthread_t));
+   if((workers == NULL) || (threads == NULL))
+   {
+      fprintf(stderr,"Error (buildloopdb): No memory for threads\n");
+      for(i=0; i<pool->nTasks; i++)
+         pool->tasks[i].failed = TRUE;
+      free(workers);
+      free(threads);
+      return;
+   }
+   pthread_mutex_init(&(pool->lock), NULL);
+
+   /* Each thread has its own copy of the outputs for the kernels to
+      mark which want the loop
+   */
+   for(i=0; i<nThreads; i++)
+   {
+      workers[i].pool   = pool;
+      workers[i].thread = i;
+      for(o=pool->dbOut, j=0; o!=NULL; NEXT(o), j++)
+      {
+         workers[i].check[j]      = *o;
+         workers[i].check[j].next = (o->next == NULL) ? NULL :
+                                    &(workers[i].check[j+1]);
+      }
+   }
+
+   /* Thread 0 is this one; if a thread can't be started the others
+      share its tasks
+   */
+   for(i=1; i<nThreads; i++)
+   {
+      if(pthread_create(&(threads[i]), NULL, AnalysisThread, 
+                        &(workers[i])))
+         workers[i].thread = -1;
+   }
+   AnalysisThread(&(workers[0]));
+   for(i=1; i<nThreads; i++)
+   {
+      if(workers[i].thread >= 0)
+         pthread_join(threads[i], NULL);
+   }
+
+   pthread_mutex_destroy(&(pool->lock));
+   free(workers);
+   free(threads);
+}
+
+
+/************************************************************************/
+/*>static void *AnalysisThread(void *arg)
+   --------------------------------------
+*//**
+   \param[in]  *arg    The BUILDWORKER for this thread
+   \return             NULL
+
+   Runs tasks from the pool until they have all been started
+
+-  18.10.26 Original   By: ACRM
+*/
+static void *AnalysisThread(void *arg)
+{
+   BUILDWORKER *worker = (BUILDWORKER *)arg;
+   BUILDPOOL   *pool   = worker->pool;
+   int         task;
+
+   for(;;)
+   {
+      pthread_mutex_lock(&(pool->lock));
+      task = pool->nextTask++;
+      pthread_mutex_unlock(&(pool->lock));
+      if(task >= pool->nTasks)
+         break;
+      AnalyseTask(pool, pool->tasks + task, worker->check);
+   }
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>static char *MarkChainBreaks(PDB *pdb, int *nRes)
+   -------------------------------------------------
+*//**
+   \param[in]    *pdb    CA atoms
+   \param[out]   *nRes   Number of CA atoms
+   \return               Array flagging each CA that is too far from the
+                         next one to be joined to it (NULL if no memory)
+
+   Finds the chain breaks once so that checking whether a stretch is
+   intact is a simple count. Replaces ChainIsIntact() which walked the
+   stretch for every candidate loop (and is now only used by the
+   reference implementation).
+
+-  18.10.26 Original   By: ACRM
+*/
+static char *MarkChainBreaks(PDB *pdb, int *nRes)
+{
+   PDB  *p;
+   char *breakAfter;
+   int  i = 0;
+
+   *nRes = 0;
+   for(p=pdb; p!=NULL; NEXT(p))
+      (*nRes)++;
+
+   if((breakAfter = (char *)malloc((*nRes + 1) * sizeof(char)))==NULL)
+      return(NULL);
+
+   for(p=pdb; p!=NULL; NEXT(p))
+   {
+      breakAfter[i++] = (char)((p->next != NULL) &&
+                               (DISTSQ(p, p->next) > 
+                                MAX_CA_CA_DISTANCE_SQ));
+   }
+   
+   return(breakAfter);
+}
+
+
+/************************************************************************/
+/*>static void PrintResults(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                            char *pdbCode, int separation, PDB **n,
+                            PDB **c, REAL distMat[MAXSTEM][MAXSTEM],
+                            BBRES *backbone) 
+   --------------------------------------------------------------
+*//**
+   \param[in]   *build        The build
+   \param[in]   *dbOut        Database output
+   \param[in]   *pdbCode      PDB code
+   \param[in]   separation    loop length
+   \param[in]   **n           N-ter stem PDB pointers
+   \param[in]   **c           C-ter stem PDB pointers
+   \param[in]   *distMat[][]  Distance matrix
+   \param[in]   *backbone     Backbone starting at n[0] (or NULL)
+
+   Prints the results for a loop already determined to match criteria
+   and adds the record to the sidecar and coordinate file if these are
+   being written. The sidecar is given the distances as printed so that
+   it is the same as one rebuilt from the text by mergeloopdb. If the
+   sidecar or coordinates can't be written, build->failed is set and
+   nothing more is printed.
+
+-  14.07.15 Original   By: ACRM
+-  18.10.26 Tracks the record offset and writes the sidecar
+-  18.10.26 Writes the coordinates
+-  18.10.26 Sidecar uses the printed distances
+-  18.10.26 Any stem size
+-  18.10.26 Takes the build handle rather than using globals
+-  18.10.26 Sets build->failed rather than exiting on an error
+*/
+static void PrintResults(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                         char *pdbCode, int separation, PDB **n,
+                         PDB **c, REAL distMat[MAXSTEM][MAXSTEM],
+                         BBRES *backbone) 
+{
+   char resid1[16],
+        resid2[16],
+        dist[32];
+   REAL printed[MAXSTEM][MAXSTEM];
+   int  i, j,
+        nStem = dbOut->nStem;
+   long offset = dbOut->offset;
+
+   if(build->failed)
+      return;
+               
+   MAKERESID(resid1, n[0]);
+   MAKERESID(resid2, c[nStem-1]);
+   
+   dbOut->offset += fprintf(dbOut->out, "%s %s %s %d ", 
+                            (pdbCode!=NULL)?pdbCode:"",
+                            resid1, resid2, separation);
+   for(i=0; i<nStem; i++)
+   {
+      for(j=0; j<nStem; j++)
+      {
+         sprintf(dist, "%.3f ", distMat[i][j]);
+         dbOut->offset += fprintf(dbOut->out, "%s", dist);
+         printed[i][j]  = atof(dist);
+      }
+   }
+   if(build->exptl)
+      dbOut->offset += fprintf(dbOut->out, "%s %.2f %.3f",
+                               ExptlMethodName(build->entry.method),
+                               build->entry.resolution, build->entry.rFactor);
+   dbOut->offset += fprintf(dbOut->out, "\n");
+   dbOut->nRecords++;
+
+   if(dbOut->qw != NULL)
+   {
+      if(!WriteQFilterRecord(dbOut->qw, offset, separation, printed))
+      {
+         fprintf(stderr,"Error (buildloopdb): No memory for sidecar \
+offsets\n");
+         build->failed = TRUE;
+         return;
+      }
+   }
+
+   if((dbOut->lw != NULL) && (backbone != NULL))
+   {
+      if(!WriteLoopCoords(dbOut->lw, backbone, separation + 2*nStem))
+      {
+         fprintf(stderr,"Error (buildloopdb): Failed writing \
+coordinates\n");
+         build->failed = TRUE;
+      }
+   }
+}
+
+
+/************************************************************************/
+/*>static int RunReferenceAnalysis(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                                   PDB *pdb, char *pdbCode)
+   ---------------------------------------------------------------------
+*//**
+   \param[in]   *build      The build
+   \param[in]   *dbOut      Database output(s)
+   \param[in]   *pdb        Pointer to PDB linked list
+   \param[in]   *pdbCode    PDB code for this file    
+   \return                  Number of loops found (summed over outputs)
+
+   The reference implementation of RunAnalysis(), used with --reference.
+   This is the original algorithm, changed only to handle the stem size
+   and to run once for each output. It is kept as simple as possible so
+   that faster versions can be checked against it (see
+   test/difftest.sh): the chain is walked for every candidate to check
+   it is intact and every distance is calculated with no shared work or
+   specialized kernels. It must give exactly the same records as
+   RunAnalysis() so it should not be optimized.
+
+-  14.07.15 Original (as RunAnalysis())   By: ACRM
+-  03.11.15 Now returns number of loops found
+-  04.11.15 Now calls blFindNextChain() rather than blFindNextChainPDB()
+            so the the first chain isn't terminated.
+-  13.12.17 Added check on chain change when finding Nter and Cter
+            residues (fixed bug with 2nd and subsequent chains being
+            done multiple times).
+-  18.10.26 Handles the stem size and runs for each output
+-  18.10.26 Takes the build handle rather than using globals
+*/
+static int RunReferenceAnalysis(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                                PDB *pdb, char *pdbCode)
+{
+   PDB      *n[MAXSTEM], *c[MAXSTEM],
+            *chain,
+            *nextChain;
+   DBOUTPUT *o;
+   REAL     distMat[MAXSTEM][MAXSTEM];
+   int      i, j, 
+            nStem  = dbOut->nStem,
+            nloops = 0,
+            separation;
+   
+   for(o=dbOut; o!=NULL; NEXT(o))
+   {
+      for(chain=pdb; chain!=NULL; chain=nextChain)
+      {
+         nextChain = blFindNextChain(chain);
+      
+         /* Find an N-terminal residue                                  */
+         for(n[0]=chain; 
+             n[0]!=NULL && n[0]!=nextChain;
+             NEXT(n[0]))
+         {
+
+            /* And find the rest of the stem                            */
+            for(i=1; i<nStem; i++)
+               n[i] = (n[i-1])?n[i-1]->next:NULL;
+
+            /* If they are all valid                                    */
+            if((n[nStem-1] != NULL) && (n[nStem-1]->next != NULL))
+            {
+               separation = 0;
+            
+               /* Find a C-terminal residue                             */
+               for(c[0]=n[nStem-1]->next->next; 
+                   c[0]!=NULL && c[0]!=nextChain;
+                   NEXT(c[0]))
+               {
+                  /* If the spacing between N and Cter is too long or
+                     not long enough, break out
+                  */
+                  separation++;
+                  if(o->maxLength && (separation > o->maxLength))
+                     break;
+
+                  if(separation >= o->minLength)
+                  {
+                     /* And find the rest of the stem                   */
+                     for(i=1; i<nStem; i++)
+                        c[i] = (c[i-1])?c[i-1]->next:NULL;
+
+                     /* If they are all valid                           */
+                     if(c[nStem-1] != NULL)
+                     {
+                        BOOL badDistance = FALSE;
+                  
+                        if(ChainIsIntact((PDB*)(n[0]), c[nStem-1]->next))
+                        {
+                           /* Create the distance matrix                */
+                           for(i=0; i<nStem; i++)
+                           {
+                              for(j=0; j<nStem; j++)
+                              {
+                                 distMat[i][j] = DIST(n[i], c[j]);
+                              
+                                 if((distMat[i][j] < o->minTable[i][j]) ||
+                                    (distMat[i][j] > o->maxTable[i][j]))
+                                 {
+                                    badDistance = TRUE;
+                                    i=MAXSTEM+1; /* Break out of outer
+                                                    loop                */
+                                    break;
+                                 }
+                              }
+                           }
+
+                           if(!badDistance)
+                           {
+                              nloops++;
+                              PrintReferenceResults(build, o,
+                                                    pdbCode,
+                                                    separation, n, c, 
+                                                    distMat);
+                           }
+                        
+                        }
+                     }
+                  }
+               }  
+            }
+         }
+      }
+   }
+   return(nloops);
+}
+
+
+/************************************************************************/
+/*>static BOOL ChainIsIntact(PDB *start, PDB *end)
+   -----------------------------------------------
+*//**
+   \param[in]   *start   First CA
+   \param[in]   *end     CA after the last one to check (may be NULL)
+   \return               No chain breaks from start up to end?
+
+   Checks that each CA from start up to (but not including) end is
+   close enough to the next one to be joined to it
+
+-  14.07.15 Original   By: ACRM
+-  18.10.26 Restored for RunReferenceAnalysis()
+*/
+static BOOL ChainIsIntact(PDB *start, PDB *end)
+{
+   PDB *p;
+   
+   for(p=start; p!=end; NEXT(p))
+   {
+      if((p!=NULL) && (p->next != NULL))
+      {
+         if(DISTSQ(p, p->next) > MAX_CA_CA_DISTANCE_SQ)
+         {
+            return(FALSE);
+         }
+      }
+   }
+   
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static void PrintReferenceResults(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                                     char *pdbCode, int separation,
+                                     PDB **n, PDB **c,
+                                     REAL distMat[MAXSTEM][MAXSTEM])
+   ---------------------------------------------------------------------
+*//**
+   \param[in]   *build        The build
+   \param[in]   *dbOut        Database output
+   \param[in]   *pdbCode      PDB code
+   \param[in]   separation    loop length
+   \param[in]   **n           N-ter stem PDB pointers
+   \param[in]   **c           C-ter stem PDB pointers
+   \param[in]   *distMat[][]  Distance matrix
+
+   The reference version of PrintResults(): prints the record directly
+   with no sidecar or coordinates. The offset and record count are kept
+   up to date for the manifest.
+
+-  18.10.26 Original, from the 14.07.15 PrintResults()   By: ACRM
+*/
+static void PrintReferenceResults(LOOPDBBUILD *build, DBOUTPUT *dbOut,
+                                  char *pdbCode, int separation,
+                                  PDB **n, PDB **c,
+                                  REAL distMat[MAXSTEM][MAXSTEM])
+{
+   char resid1[16],
+        resid2[16];
+   int  i, j,
+        nStem = dbOut->nStem;
+               
+   MAKERESID(resid1, n[0]);
+   MAKERESID(resid2, c[nStem-1]);
+   
+   dbOut->offset += fprintf(dbOut->out, "%s %s %s %d ", 
+                            (pdbCode!=NULL)?pdbCode:"",
+                            resid1, resid2, separation);
+   for(i=0; i<nStem; i++)
+   {
+      for(j=0; j<nStem; j++)
+      {
+         dbOut->offset += fprintf(dbOut->out, "%.3f ", distMat[i][j]);
+      }
+   }
+   if(build->exptl)
+      dbOut->offset += fprintf(dbOut->out, "%s %.2f %.3f",
+                               ExptlMethodName(build->entry.method),
+                               build->entry.resolution, build->entry.rFactor);
+   dbOut->offset += fprintf(dbOut->out, "\n");
+   dbOut->nRecords++;
+}
+
+
+/************************************************************************/
+/*>static BOOL BackboneComplete(PDB *pdb)
+   --------------------------------------
+*//**
+   \param[in]  *pdb   PDB linked list
+   \return            Is the backbone complete?
+
+   Checks whether the backbone is complete - thus rejecting CA-only files
+   like 3ixx
+
+-  10.12.15 Original  By: ACRM
+*/
+static BOOL BackboneComplete(PDB *pdb)
+{
+   PDB  *p, 
+        *start,
+        *nextRes,
+        *n     = NULL, 
+        *ca    = NULL,
+        *c     = NULL,
+        *o     = NULL,
+        *cPrev = NULL;
+   char chain[blMAXCHAINLABEL];
+
+   chain[0] = '\0';
+   
+   /* Step through the PDB file one residue at a time                   */
+   for(start=pdb; start!=NULL; start=nextRes)
+   {
+      nextRes = blFindNextResidue(start);
+      
+      /* If the chain has changed we reset everything                   */
+      if(!CHAINMATCH(start->chain, chain))
+      {
+         n = ca = c = o = cPrev = NULL;
+         strncpy(chain, start->chain, blMAXCHAINLABEL);
+      }
+      
+
+      /* Step through the residue finding the important atoms           */
+      cPrev = c;
+      for(p=start; p!=nextRes; NEXT(p))
+      {
+         if(!strncmp(p->atnam, "N   ", 4))
+            n=p;
+
+         if(!strncmp(p->atnam, "CA  ", 4))
+            ca=p;
+
+         if(!strncmp(p->atnam, "C   ", 4))
+            c=p;
+
+         if(!strncmp(p->atnam, "O   ", 4))
+            o=p;
+      }
+
+      /* Either all atoms must be found (protein) or none of the atoms
+         found (nucleic acid)
+      */
+      if((n==NULL) && (ca==NULL) && (c==NULL) && (o==NULL))     /* None */
+      {
+         continue;
+      }
+      else if((n!=NULL) && (ca!=NULL) && (c!=NULL) && (o!=NULL))/* All  */
+      {
+         /* Check the distances                                         */
+         if(cPrev!=NULL)
+         {
+            if(DISTSQ(cPrev,n) > MAX_BOND_DISTANCE_SQ)
+               return(FALSE);
+         }
+         if(DISTSQ(n,ca) > MAX_BOND_DISTANCE_SQ)
+            return(FALSE);
+         if(DISTSQ(ca,c) > MAX_BOND_DISTANCE_SQ)
+            return(FALSE);
+         if(DISTSQ(c,o)  > MAX_BOND_DISTANCE_SQ)
+            return(FALSE);
+      }
+      else
+      {
+         return(FALSE);
+      }
+   }
+   return(TRUE);
+}
+
+
+
+/************************************************************************/
+/*>static void RecordFileStats(LOOPDBBUILD *build, char *fname,
+                               double seconds, long atoms)
+   ------------------------------------------------------------
+*//**
+   \param[in]   *build     The build
+   \param[in]   *fname     File that has been processed
+   \param[in]   seconds    Time taken to process it
+   \param[in]   atoms      Atoms read from it
+
+   Counts a processed file for --stats and keeps it if it is one of the
+   NSLOWFILES slowest so far. With --counters, writes a line with the
+   threads and the counters for each phase for this file.
+
+-  18.10.26 Original   By: ACRM
+*/
+static void RecordFileStats(LOOPDBBUILD *build, char *fname,
+                            double seconds, long atoms)
+{
+   BUILDSTATS *stats = build->stats;
+   int        i;
+   
+   stats->nFiles++;
+
+   if(stats->fpCounters != NULL)
+   {
+      fprintf(stats->fpCounters, "{\"file\": ");
+      StatsPrintString(stats->fpCounters, fname);
+      fprintf(stats->fpCounters, ", \"threads\": %d, \"seconds\": %.6f, \
+\"atoms\": %ld, \"phases\": ", build->nThreads, seconds, atoms);
+      StatsPrintPhases(stats->fpCounters, &(stats->phases), 
+                       sBuildPhases, NBUILDPHASE, TRUE);
+      fprintf(stats->fpCounters, "}\n");
+   }
+
+   /* Find where it goes in the slowest files and shuffle the rest down */
+   for(i=stats->nSlow; i>0; i--)
+   {
+      if(stats->slow[i-1].seconds >= seconds)
+         break;
+      if(i < NSLOWFILES)
+         stats->slow[i] = stats->slow[i-1];
+   }
+
+   if(i < NSLOWFILES)
+   {
+      strncpy(stats->slow[i].file, fname, MAXBUFF-1);
+      stats->slow[i].file[MAXBUFF-1] = '\0';
+      stats->slow[i].seconds = seconds;
+      stats->slow[i].atoms   = atoms;
+      if(stats->nSlow < NSLOWFILES)
+         stats->nSlow++;
+   }
+}
+
+
+/************************************************************************/
+/*>static BOOL WriteBuildStats(LOOPDBBUILD *build, char *statsFile)
+   ----------------------------------------------------------------
+*//**
+   \param[in]   *build       The build
+   \param[in]   *statsFile   File for the report ("-" for stderr)
+   \return                   Success
+
+   Writes the --stats report as a JSON object: the time spent in each
+   phase, the throughput, the files rejected at each check, the
+   candidate stem pairs rejected at each stage (with the number
+   rejected by each distance as an nStem x nStem matrix), the peak
+   memory use and the slowest files.
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL WriteBuildStats(LOOPDBBUILD *build, char *statsFile)
+{
+   BUILDSTATS *stats = build->stats;
+   FILE       *fp;
+   double     wall;
+   long       nDist = 0;
+   int        i, j;
+
+
+   if(!strcmp(statsFile, "-"))
+      fp = stderr;
+   else if((fp = fopen(statsFile, "w"))==NULL)
+      return(FALSE);
+
+   wall = StatsClock() - stats->tStart;
+   for(i=0; i<stats->nStem*stats->nStem; i++)
+      nDist += stats->cellReject[i];
+
+   fprintf(fp, "{\n");
+   fprintf(fp, "  \"program\": \"buildloopdb\",\n");
+   fprintf(fp, "  \"version\": \"1.20\",\n");
+   fprintf(fp, "  \"stem\": %d,\n", stats->nStem);
+   fprintf(fp, "  \"threads\": %d,\n", build->nThreads);
+   fprintf(fp, "  \"wall_seconds\": %.6f,\n", wall);
+   fprintf(fp, "  \"files\": {\"processed\": %ld, \"reused\": %ld, \
+\"unreadable\": %ld,\n", stats->nFiles, stats->nReused,
+           stats->nUnreadable);
+   fprintf(fp, "            \"no_atoms\": %ld, \
+\"incomplete_backbone\": %ld, \"no_ca\": %ld,\n",
+           stats->nNoAtoms, stats->nIncomplete, stats->nNoCa);
+   fprintf(fp, "            \"exptl\": %ld,\n", stats->nExptl);
+   fprintf(fp, "            \"prescreened\": {\"no_protein\": %ld, \
+\"ca_only\": %ld, \"too_short\": %ld}},\n",
+           build->screened[PS_NOPROTEIN], build->screened[PS_CAONLY],
+           build->screened[PS_SHORT]);
+   fprintf(fp, "  \"chains\": {\"compared\": %ld, \"same_entry_aliases\": \
+%ld, \"other_entry_aliases\": %ld},\n", stats->nChains, stats->nWithin,
+           stats->nAcross);
+   fprintf(fp, "  \"atoms\": %ld,\n", stats->nAtoms);
+   fprintf(fp, "  \"residues\": %ld,\n", stats->nResidues);
+   fprintf(fp, "  \"files_per_second\": %.3f,\n",
+           (wall > 0.0) ? (double)stats->nFiles / wall : 0.0);
+   fprintf(fp, "  \"atoms_per_second\": %.1f,\n",
+           (wall > 0.0) ? (double)stats->nAtoms / wall : 0.0);
+   fprintf(fp, "  \"phases\": {\"read\": %.6f, \"backbone_complete\": \
+%.6f, \"select_ca\": %.6f,\n",
+           stats->phases.time[BP_READ], stats->phases.time[BP_BACKBONE],
+           stats->phases.time[BP_SELECTCA]);
+   fprintf(fp, "             \"analysis\": %.6f, \"output\": %.6f, \
+\"dedup\": %.6f},\n",
+           stats->phases.time[BP_ANALYSIS], 
+           stats->phases.time[BP_OUTPUT], stats->phases.time[BP_DEDUP]);
+   if(stats->fpCounters != NULL)
+   {
+      fprintf(fp, "  \"counters\": ");
+      StatsPrintPhases(fp, &(stats->phases), sBuildPhases, NBUILDPHASE,
+                       FALSE);
+      fprintf(fp, ",\n");
+   }
+   fprintf(fp, "  \"candidates\": {\"tested\": %ld, \"chain_break\": \
+%ld, \"length\": %ld,\n",
+           stats->nCandidates, stats->nChainBreak, stats->nLength);
+   fprintf(fp, "                 \"distance\": %ld, \"accepted\": \
+%ld},\n", nDist, stats->nAccepted);
+   fprintf(fp, "  \"records\": %ld,\n", stats->nRecords);
+   fprintf(fp, "  \"peak_memory_kb\": %ld,\n", StatsPeakMemory());
+
+   fprintf(fp, "  \"distance_rejections\": [");
+   for(i=0; i<stats->nStem; i++)
+   {
+      fprintf(fp, "%s[", i?",\n                          ":"");
+      for(j=0; j<stats->nStem; j++)
+         fprintf(fp, "%s%ld", j?", ":"", 
+                 stats->cellReject[i*stats->nStem+j]);
+      fprintf(fp, "]");
+   }
+   fprintf(fp, "],\n");
+
+   fprintf(fp, "  \"slowest_files\": [");
+   for(i=0; i<stats->nSlow; i++)
+   {
+      fprintf(fp, "%s{\"file\": ", i?",\n                    ":"");
+      StatsPrintString(fp, stats->slow[i].file);
+      fprintf(fp, ", \"seconds\": %.6f, \"atoms\": %ld}",
+              stats->slow[i].seconds, stats->slow[i].atoms);
+   }
+   fprintf(fp, "]\n");
+   fprintf(fp, "}\n");
+
+   if(fp != stderr)
+   {
+      if(fclose(fp))
+         return(FALSE);
+   }
+   return(TRUE);
+}
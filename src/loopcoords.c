@@ -0,0 +1,548 @@
+/************************************************************************/
+/**
+
+   \file       loopcoords.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Backbone coordinate file accompanying the loop database
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Writes and reads the coordinate file that may accompany a loop
+   database. For every record it holds the residue names and N, CA, C
+   and O coordinates of the loop and both takeoff stems, so that the
+   loop can be used without going back to the original PDB file.
+
+   The file consists of an LCHEADER, the records and then an index
+   giving the file offset of each record. Record n in the coordinate
+   file is record n (counting from zero and ignoring comments) in the
+   text database. Each record is an int giving the number of residues,
+   a spare int and then that many BBRES structures.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "bioplib/pdb.h"
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define OFFSET_CHUNK 65536
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+
+
+/************************************************************************/
+/*>LCWRITER *OpenLoopCoordsWriter(char *filename, int nStem)
+   ---------------------------------------------------------
+*//**
+   \param[in]   *filename  Coordinate file to create
+   \param[in]   nStem      Residues in each stem
+   \return                 Writer structure (NULL on failure)
+
+   Opens a loop coordinate file for writing
+
+-  18.10.26 Original   By: ACRM
+*/
+LCWRITER *OpenLoopCoordsWriter(char *filename, int nStem)
+{
+   LCWRITER *lw;
+
+   if((lw = (LCWRITER *)malloc(sizeof(LCWRITER)))==NULL)
+      return(NULL);
+
+   if((lw->fp = fopen(filename, "wb"))==NULL)
+   {
+      free(lw);
+      return(NULL);
+   }
+
+   memset(&(lw->header), 0, sizeof(LCHEADER));
+   memcpy(lw->header.magic, LC_MAGIC, 8);
+   lw->header.version = LC_VERSION;
+   lw->header.nStem   = nStem;
+   lw->header.nAtoms  = NBBATOM;
+   lw->offsets        = NULL;
+   lw->maxOffsets     = 0;
+   lw->dataOffset     = sizeof(LCHEADER);
+
+   /* Space for the header; rewritten with the final counts on close    */
+   if(fwrite(&(lw->header), sizeof(LCHEADER), 1, lw->fp) != 1)
+   {
+      fclose(lw->fp);
+      free(lw);
+      return(NULL);
+   }
+
+   return(lw);
+}
+
+
+/************************************************************************/
+/*>LCWRITER *ReopenLoopCoordsWriter(char *filename, long size, 
+                                    long nRecords)
+   -------------------------------------------------------------
+*//**
+   \param[in]   *filename  Partly written coordinate file
+   \param[in]   size       Size to truncate it to
+   \param[in]   nRecords   Number of records it should then contain
+   \return                 Writer structure (NULL on failure)
+
+   Reopens a coordinate file left by an interrupted build so that
+   records can be added to it. The record offsets are rebuilt by
+   walking the records that were written before the last checkpoint;
+   anything after that is discarded.
+
+-  18.10.26 Original   By: ACRM
+*/
+LCWRITER *ReopenLoopCoordsWriter(char *filename, long size, 
+                                 long nRecords)
+{
+   LCWRITER *lw;
+   long     r;
+   int      counts[2];
+   BOOL     ok = TRUE;
+
+   if((lw = (LCWRITER *)malloc(sizeof(LCWRITER)))==NULL)
+      return(NULL);
+   lw->offsets    = NULL;
+   lw->maxOffsets = 0;
+
+   if((lw->fp = fopen(filename, "r+b"))==NULL)
+   {
+      free(lw);
+      return(NULL);
+   }
+
+   if((fread(&(lw->header), sizeof(LCHEADER), 1, lw->fp) != 1) ||
+      strncmp(lw->header.magic, LC_MAGIC, 8) ||
+      (lw->header.version != LC_VERSION))
+      ok = FALSE;
+
+   if(ok)
+   {
+      lw->maxOffsets = ((nRecords / OFFSET_CHUNK) + 1) * OFFSET_CHUNK;
+      if((lw->offsets = (long *)malloc(lw->maxOffsets * sizeof(long)))
+         == NULL)
+         ok = FALSE;
+   }
+
+   lw->dataOffset = sizeof(LCHEADER);
+   for(r=0; ok && r<nRecords; r++)
+   {
+      lw->offsets[r] = lw->dataOffset;
+      if((fread(counts, sizeof(int), 2, lw->fp) != 2) ||
+         (counts[0] < 0))
+      {
+         ok = FALSE;
+         break;
+      }
+      lw->dataOffset += 2 * sizeof(int) + counts[0] * sizeof(BBRES);
+      if(fseek(lw->fp, lw->dataOffset, SEEK_SET))
+         ok = FALSE;
+   }
+
+   if(!ok || (lw->dataOffset != size) ||
+      ftruncate(fileno(lw->fp), (off_t)size) ||
+      fseek(lw->fp, size, SEEK_SET))
+   {
+      fclose(lw->fp);
+      if(lw->offsets != NULL)
+         free(lw->offsets);
+      free(lw);
+      return(NULL);
+   }
+
+   lw->header.nRecords    = nRecords;
+   lw->header.dbSize      = 0;
+   lw->header.indexOffset = 0;
+   return(lw);
+}
+
+
+/************************************************************************/
+/*>BOOL WriteLoopCoords(LCWRITER *lw, BBRES *residues, int nRes)
+   -------------------------------------------------------------
+*//**
+   \param[in]   *lw        Coordinate file writer
+   \param[in]   *residues  Backbone of the loop and its stems
+   \param[in]   nRes       Number of residues
+   \return                 Success
+
+   Adds a record to the coordinate file
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL WriteLoopCoords(LCWRITER *lw, BBRES *residues, int nRes)
+{
+   long nRecords = lw->header.nRecords;
+   int  counts[2];
+
+   if(nRecords >= lw->maxOffsets)
+   {
+      long *newOffsets;
+      if((newOffsets = (long *)realloc(lw->offsets,
+                                       (lw->maxOffsets + OFFSET_CHUNK) *
+                                       sizeof(long)))==NULL)
+         return(FALSE);
+      lw->offsets     = newOffsets;
+      lw->maxOffsets += OFFSET_CHUNK;
+   }
+   lw->offsets[nRecords] = lw->dataOffset;
+
+   counts[0] = nRes;
+   counts[1] = 0;
+   if((fwrite(counts, sizeof(int), 2, lw->fp) != 2) ||
+      (fwrite(residues, sizeof(BBRES), nRes, lw->fp) != (size_t)nRes))
+      return(FALSE);
+
+   lw->dataOffset += 2 * sizeof(int) + nRes * sizeof(BBRES);
+   lw->header.nRecords++;
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>BOOL CloseLoopCoordsWriter(LCWRITER *lw, long dbSize)
+   -----------------------------------------------------
+*//**
+   \param[in]   *lw        Coordinate file writer
+   \param[in]   dbSize     Final size of the text database
+   \return                 Success
+
+   Writes the index of record offsets and rewrites the header with the
+   final counts. Frees the writer.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL CloseLoopCoordsWriter(LCWRITER *lw, long dbSize)
+{
+   BOOL ok       = TRUE;
+   long nRecords = lw->header.nRecords;
+   char pad[8];
+
+   /* Align the index so it can be used directly from a mapped file     */
+   memset(pad, 0, 8);
+   if(lw->dataOffset % sizeof(long))
+   {
+      size_t nPad = sizeof(long) - (lw->dataOffset % sizeof(long));
+      if(fwrite(pad, 1, nPad, lw->fp) != nPad)
+         ok = FALSE;
+      lw->dataOffset += nPad;
+   }
+   lw->header.indexOffset = lw->dataOffset;
+   lw->header.dbSize      = dbSize;
+
+   if(ok && nRecords)
+   {
+      if(fwrite(lw->offsets, sizeof(long), nRecords, lw->fp) !=
+         (size_t)nRecords)
+         ok = FALSE;
+   }
+
+   if(ok)
+   {
+      if(fseek(lw->fp, 0L, SEEK_SET) ||
+         (fwrite(&(lw->header), sizeof(LCHEADER), 1, lw->fp) != 1))
+         ok = FALSE;
+   }
+
+   if(fclose(lw->fp))
+      ok = FALSE;
+   if(lw->offsets != NULL)
+      free(lw->offsets);
+   free(lw);
+
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>LOOPCOORDS *OpenLoopCoords(char *filename, FILE *dbf)
+   -----------------------------------------------------
+*//**
+   \param[in]   *filename  Coordinate file
+   \param[in]   *dbf       The text database it should describe (or
+                           NULL to skip the check)
+   \return                 Mapped coordinate file (NULL if it can't be
+                           opened or doesn't match the database)
+
+   Maps a loop coordinate file into memory
+
+-  18.10.26 Original   By: ACRM
+*/
+LOOPCOORDS *OpenLoopCoords(char *filename, FILE *dbf)
+{
+   LOOPCOORDS  *lc;
+   FILE        *fp;
+   struct stat st;
+   long        dbSize = -1;
+
+   if(dbf != NULL)
+   {
+      long here = ftell(dbf);
+      if(fseek(dbf, 0L, SEEK_END))
+         return(NULL);
+      dbSize = ftell(dbf);
+      fseek(dbf, here, SEEK_SET);
+   }
+
+   if((fp = fopen(filename, "rb"))==NULL)
+      return(NULL);
+
+   if(fstat(fileno(fp), &st) || (st.st_size < (off_t)sizeof(LCHEADER)))
+   {
+      fclose(fp);
+      return(NULL);
+   }
+
+   if((lc = (LOOPCOORDS *)malloc(sizeof(LOOPCOORDS)))==NULL)
+   {
+      fclose(fp);
+      return(NULL);
+   }
+
+   lc->mapSize = (size_t)st.st_size;
+   lc->map     = mmap(NULL, lc->mapSize, PROT_READ, MAP_SHARED,
+                      fileno(fp), 0);
+   fclose(fp);
+   if(lc->map == MAP_FAILED)
+   {
+      free(lc);
+      return(NULL);
+   }
+
+   lc->header  = (LCHEADER *)lc->map;
+   lc->offsets = (long *)((char *)lc->map + lc->header->indexOffset);
+
+   if(strncmp(lc->header->magic, LC_MAGIC, 8)    ||
+      (lc->header->version != LC_VERSION)        ||
+      (lc->header->nStem   < MINSTEM)            ||
+      (lc->header->nStem   > MAXSTEM)            ||
+      (lc->header->nAtoms  != NBBATOM)           ||
+      ((dbSize >= 0) && (lc->header->dbSize != dbSize)) ||
+      (lc->mapSize != lc->header->indexOffset +
+                      lc->header->nRecords * sizeof(long)))
+   {
+      CloseLoopCoords(lc);
+      return(NULL);
+   }
+
+   return(lc);
+}
+
+
+/************************************************************************/
+/*>BBRES *GetLoopCoords(LOOPCOORDS *lc, long record, int *nRes)
+   ------------------------------------------------------------
+*//**
+   \param[in]   *lc        Mapped coordinate file
+   \param[in]   record     Record number in the database (from 0)
+   \param[out]  *nRes      Number of residues (loop plus stems)
+   \return                 Residues in the mapped file (NULL if the
+                           record doesn't exist). Must not be freed.
+
+   Finds the backbone for a database record
+
+-  18.10.26 Original   By: ACRM
+*/
+BBRES *GetLoopCoords(LOOPCOORDS *lc, long record, int *nRes)
+{
+   int *counts;
+
+   if((record < 0) || (record >= lc->header->nRecords))
+      return(NULL);
+
+   counts = (int *)((char *)lc->map + lc->offsets[record]);
+   *nRes  = counts[0];
+   return((BBRES *)(counts + 2));
+}
+
+
+/************************************************************************/
+/*>void CloseLoopCoords(LOOPCOORDS *lc)
+   ------------------------------------
+*//**
+   \param[in]   *lc        Mapped coordinate file
+
+   Unmaps and frees a loop coordinate file
+
+-  18.10.26 Original   By: ACRM
+*/
+void CloseLoopCoords(LOOPCOORDS *lc)
+{
+   if(lc != NULL)
+   {
+      munmap(lc->map, lc->mapSize);
+      free(lc);
+   }
+}
+
+
+/************************************************************************/
+/*>BBRES *ExtractBackbone(PDB *pdb, int *nRes)
+   -------------------------------------------
+*//**
+   \param[in]   *pdb       PDB linked list (all atoms)
+   \param[out]  *nRes      Number of residues extracted
+   \return                 Malloc'd array of residue backbones (NULL if
+                           there are no CAs or no memory)
+
+   Extracts the N, CA, C and O coordinates of each residue that has a
+   CA. Entry i therefore corresponds to the i'th atom in the list
+   returned by blSelectCaPDB(). Missing N, C or O atoms are given the
+   CA coordinates; buildloopdb rejects such structures anyway.
+
+-  18.10.26 Original   By: ACRM
+*/
+BBRES *ExtractBackbone(PDB *pdb, int *nRes)
+{
+   PDB   *p,
+         *start,
+         *nextRes,
+         *atoms[NBBATOM];
+   BBRES *residues;
+   int   i,
+         count = 0;
+
+   *nRes = 0;
+
+   for(p=pdb; p!=NULL; NEXT(p))
+   {
+      if(!strncmp(p->atnam, "CA  ", 4))
+         count++;
+   }
+   if(count == 0)
+      return(NULL);
+
+   if((residues = (BBRES *)malloc(count * sizeof(BBRES)))==NULL)
+      return(NULL);
+
+   for(start=pdb; start!=NULL; start=nextRes)
+   {
+      nextRes = blFindNextResidue(start);
+
+      for(i=0; i<NBBATOM; i++)
+         atoms[i] = NULL;
+      for(p=start; p!=nextRes; NEXT(p))
+      {
+         if(!strncmp(p->atnam, "N   ", 4))
+            atoms[BB_N]  = p;
+         else if(!strncmp(p->atnam, "CA  ", 4))
+            atoms[BB_CA] = p;
+         else if(!strncmp(p->atnam, "C   ", 4))
+            atoms[BB_C]  = p;
+         else if(!strncmp(p->atnam, "O   ", 4))
+            atoms[BB_O]  = p;
+      }
+
+      if((atoms[BB_CA] != NULL) && (*nRes < count))
+      {
+         BBRES *r = residues + (*nRes)++;
+
+         memcpy(r->resnam, atoms[BB_CA]->resnam, 4);
+         for(i=0; i<NBBATOM; i++)
+         {
+            if(atoms[i] == NULL)
+               atoms[i] = atoms[BB_CA];
+            r->xyz[i][0] = (float)atoms[i]->x;
+            r->xyz[i][1] = (float)atoms[i]->y;
+            r->xyz[i][2] = (float)atoms[i]->z;
+         }
+      }
+   }
+
+   return(residues);
+}
+
+
+/************************************************************************/
+/*>BOOL CompanionFile(char *dbFile, char *example, char *companion)
+   ----------------------------------------------------------------
+*//**
+   \param[in]  *dbFile     Another database filename
+   \param[in]  *example    Our own companion filename
+   \param[out] *companion  The other database's companion filename
+                           (LC_MAXFILE)
+   \return                 FALSE if the example has no extension or
+                           the name is too long
+
+   Works out the name of another database's companion file by replacing
+   the extension of the database with that of our own companion file.
+   e.g. with -c loops.bb, shard3.db has coordinates in shard3.bb
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL CompanionFile(char *dbFile, char *example, char *companion)
+{
+   char *ext,
+        *chp;
+
+   if(((ext = strrchr(example, '.'))==NULL) || strchr(ext, '/'))
+      return(FALSE);
+   if(strlen(dbFile) + strlen(ext) >= LC_MAXFILE)
+      return(FALSE);
+
+   strcpy(companion, dbFile);
+   if(((chp = strrchr(companion, '.'))!=NULL) && !strchr(chp, '/'))
+      *chp = '\0';
+   strcat(companion, ext);
+
+   return(TRUE);
+}
@@ -0,0 +1,737 @@
+/************************************************************************/
+/**
+
+   \file       loopdb.h
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Shared definitions for the loop database auxiliary files
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Definitions shared by buildloopdb and scanloopdb for the binary files
+   that accompany a text loop database.
+
+   Each stem (the residues either side of a loop) has between MINSTEM
+   and MAXSTEM residues; the size is recorded in the database header
+   and there are nStem*nStem distances per record. Distance tables are
+   always held as MAXSTEM x MAXSTEM arrays of which the first nStem
+   rows and columns are used.
+
+   The quantized filter ('sidecar') file stores each of the takeoff
+   distances of every record as an 8-bit code on a per-column scale
+   together with an 8-bit loop length. Codes are stored in blocks of
+   QF_BLOCKSIZE records with each column stored contiguously so that
+   the coarse filter can be run over a whole block at once. The block
+   data are followed by the byte offset of each record in the text
+   database so that survivors can be re-read and checked exactly.
+
+   The query cache stores, for a query rounded to a grid, the records
+   that could match any query that rounds to the same grid point.
+
+   The manifest records which input files produced which records so
+   that a database can be updated rather than rebuilt.
+
+   A checkpoint records how far a build has got so that it can be
+   resumed after being interrupted.
+
+   The CA pack stores the CA trace of each PDB file so that a database
+   can be rebuilt with new parameters without reading the PDB files.
+
+   The coordinate file stores the N, CA, C and O coordinates of each
+   loop and its stems, addressed by record number, so that hits can be
+   used without re-reading the PDB files they came from.
+
+   The query log records the parameters of each scanloopdb query so
+   that the load can be replayed by replayloopdb.
+
+   The chain reader lets buildloopdb --stream hold one chain of a large
+   structure in memory at a time.
+
+   The deduplication state lets buildloopdb --dedup analyse repeated
+   copies of a chain once, writing an alias for each repeat.
+
+   libloopdb holds a database in memory behind an opaque LOOPDB handle
+   so that a program can run many queries (from many threads) without
+   re-reading it. It also holds the scans of a database file used by
+   scanloopdb for a single query, and the build pipeline of buildloopdb
+   behind an opaque LOOPDBBUILD handle set up from a LOOPDBBUILDOPTS.
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+#ifndef _LOOPDB_H
+#define _LOOPDB_H
+
+/************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include "bioplib/pdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define NSTEM           3     /* Default residues in each takeoff stem  */
+#define MINSTEM         2     /* Smallest supported stem                */
+#define MAXSTEM         5     /* Largest supported stem                 */
+#define MAXDIST         (MAXSTEM*MAXSTEM) /* Max distances per record   */
+
+#define DB_STEMTAG      "#STEM:"  /* Header line giving the stem size   */
+#define DB_MAXLINE      512   /* Max length of a database record        */
+#define DB_EXPTLTAG     "#EXPTL:" /* Header line present if records end
+                                     with method, resolution, R-factor
+                                     (see exptl.c)                      */
+
+#define EX_UNKNOWN      0     /* Experimental methods (see exptl.c)     */
+#define EX_XRAY         1
+#define EX_NMR          2     /* Solution or solid-state                */
+#define EX_EM           3
+#define EX_NEUTRON      4
+#define EX_ELECTDIFF    5     /* Electron crystallography               */
+#define EX_FIBER        6
+#define EX_MODEL        7
+#define EX_OTHER        8
+#define NEXPTLMETHOD    9
+
+#define QF_MAGIC        "LOOPDBQ8"
+#define QF_VERSION      2
+#define QF_BLOCKSIZE    64    /* Records per block of codes             */
+#define QF_NCODES       256   /* Codes per column                       */
+#define QF_MAXLENCODE   255   /* Length code meaning 'this or longer'   */
+#define QF_ROUNDING     0.001 /* Text database precision for distances  */
+
+#define QC_MAXKEY       512   /* Max length of a cache key              */
+#define QC_MAXFILE      640   /* Max length of a cache entry filename   */
+#define DEF_CACHEGRID   0.25  /* Default grid for rounding cache keys   */
+
+#define MF_MAXPARAMS    512   /* Max length of manifest parameter string*/
+#define CK_MAXFILE      256   /* Max length of a checkpointed filename  */
+
+#define LC_MAGIC        "LOOPDBBB"
+#define LC_VERSION      1
+#define NBBATOM         4     /* Backbone atoms stored per residue      */
+#define BB_N            0
+#define BB_CA           1
+#define BB_C            2
+#define BB_O            3
+#define LC_MAXFILE      256   /* Max length of a companion filename     */
+
+#define HW_CYCLES       0     /* Hardware counters for --counters       */
+#define HW_INSTRUCTIONS 1
+#define HW_CACHEREFS    2
+#define HW_CACHEMISSES  3
+#define HW_BRANCHES     4
+#define HW_BRANCHMISSES 5
+#define HW_NEVENTS      6
+#define MAXPHASE        8     /* Max phases timed by StatsPhase()       */
+
+#define QL_MAXFILE      256   /* Max length of a filename in the log    */
+
+#define DEF_LDBTOLERANCE 1.0  /* Default tolerance for LoopDBMakeQuery() */
+#define DEF_LDBSHORTLIST 100  /* Default hits reranked by RMSD          */
+#define LDB_MAXLENGTH   9999  /* Longest loop indexed by LoopDBOpen()   */
+#define LDB_MAXFIELD    16    /* Max length of a PDB code or residue ID
+                                 in a LOOP                              */
+#define LDB_CACHEOFF    0     /* Use of the query cache by
+                                 LoopDBScanFile()                       */
+#define LDB_CACHEHIT    1
+#define LDB_CACHEMISS   2
+
+#define CR_MAXLINE      1024  /* Max length of a PDB or mmCIF record    */
+
+#define PS_USABLE       0     /* PreScreenFile() results                */
+#define PS_NOPROTEIN    1     /* No CA atoms (e.g. nucleic acid only)   */
+#define PS_CAONLY       2     /* CA atoms but no N, C or O at all       */
+#define PS_SHORT        3     /* Too few CA atoms for a loop            */
+#define NPRESCREEN      4
+
+#define DEF_DEDUPTOL    0.1   /* Default max difference in a CA-CA
+                                 distance for chains to be aliases      */
+
+#define LDB_MAXFILE     160   /* Max length of a filename in the
+                                 LOOPDBBUILDOPTS                        */
+#define MAXLOOPTYPES    16    /* Max extra loop types (-T)              */
+#define DEF_CKINTERVAL  300   /* Seconds between checkpoints            */
+#define BL_TASKSIZE     256   /* n[0] positions in each analysis
+                                 task of a large structure              */
+#define BL_MINPARALLEL  2000  /* Residues for a structure to be
+                                 split between threads                  */
+
+#define CP_MAGIC        "LOOPDBCA"
+#define CP_VERSION      1
+#define CP_MAXDIR       256   /* Max length of the PDB directory name   */
+#define CP_BREAK        1     /* Flag: CA too far from the next one     */
+
+#define MAX_CA_CA_DISTANCE_SQ 16.0 /* A CA more than 4.0A from
+                                 the next is a chain break (loopbuild.c
+                                 and dedup.c)                           */
+
+#define MAXSUPATOMS     (2*MAXSTEM*NBBATOM) /* Atoms in both stems      */
+
+/* Bytes in one block: a length code and nDist distance codes for each
+   record
+*/
+#define QF_BLOCKBYTES(nDist) (QF_BLOCKSIZE * ((nDist)+1))
+
+/************************************************************************/
+/* Structure definitions
+*/
+typedef struct
+{
+   REAL resolution,           /* Angstroms (0 if not given)             */
+        rFactor;              /* Working set R-factor (0 if not given)  */
+   int  method;               /* EX_ code                               */
+}  EXPTL;
+
+typedef struct
+{
+   REAL maxResolution,        /* Limits (0 for none)                    */
+        maxRFactor;
+   BOOL xray,                 /* X-ray entries only                     */
+        noNMR;                /* Exclude NMR entries                    */
+}  EXPTLFILTER;
+
+typedef struct
+{
+   char magic[8];             /* QF_MAGIC (not NUL terminated)          */
+   int  version,              /* QF_VERSION                             */
+        blockSize,            /* QF_BLOCKSIZE                           */
+        nDist,                /* Distances per record (nStem*nStem)     */
+        nStem;                /* Residues in each stem                  */
+   long nRecords,             /* Number of records in the database      */
+        dbSize;               /* Size of the text database in bytes     */
+   REAL lo[MAXDIST],          /* Distance represented by code 0         */
+        step[MAXDIST];        /* Distance range of each code            */
+}  QFHEADER;
+
+typedef struct
+{
+   FILE          *fp;
+   QFHEADER      header;
+   unsigned char block[QF_BLOCKBYTES(MAXDIST)]; /* Block being filled   */
+   long          *offsets,               /* Record offsets in text db   */
+                 maxOffsets;
+}  QFWRITER;
+
+typedef struct
+{
+   QFHEADER      *header;     /* Points into the mapped file            */
+   unsigned char *blocks;     /* First block of codes                   */
+   long          *offsets,    /* Text database offset of each record    */
+                 nBlocks,
+                 blockBytes;  /* QF_BLOCKBYTES(header->nDist)           */
+   void          *map;        /* The mapped file                        */
+   size_t        mapSize;
+}  QFILTER;
+
+typedef struct
+{
+   char  resnam[4];           /* Residue name (not NUL terminated)      */
+   float xyz[NBBATOM][3];     /* N, CA, C, O coordinates                */
+}  BBRES;
+
+typedef struct
+{
+   char magic[8];             /* LC_MAGIC (not NUL terminated)          */
+   int  version,              /* LC_VERSION                             */
+        nStem,                /* Residues in each stem                  */
+        nAtoms,               /* NBBATOM                                */
+        spare;
+   long nRecords,             /* Number of records                      */
+        dbSize,               /* Size of the text database in bytes     */
+        indexOffset;          /* File offset of the record index        */
+}  LCHEADER;
+
+typedef struct
+{
+   FILE     *fp;
+   LCHEADER header;
+   long     *offsets,         /* File offset of each record             */
+            maxOffsets,
+            dataOffset;       /* Offset at which next record is written */
+}  LCWRITER;
+
+typedef struct
+{
+   LCHEADER *header;          /* Points into the mapped file            */
+   long     *offsets;         /* File offset of each record             */
+   void     *map;             /* The mapped file                        */
+   size_t   mapSize;
+}  LOOPCOORDS;
+
+typedef struct
+{
+   char          *path;       /* Input file                             */
+   long          size,        /* Size in bytes                          */
+                 mtime,       /* Modification time                      */
+                 first,       /* First database record it produced      */
+                 nRecords;    /* Number of records it produced          */
+   unsigned long hash;        /* Hash of the file contents              */
+}  MFENTRY;
+
+typedef struct
+{
+   MFENTRY *entries;          /* Sorted by path                         */
+   long    nEntries,
+           dbSize;            /* Size of the database it describes      */
+   char    params[MF_MAXPARAMS];
+}  MANIFEST;
+
+typedef struct
+{
+   char params[MF_MAXPARAMS], /* Build parameters from ManifestParams() */
+        lastFile[CK_MAXFILE]; /* Last input file completed              */
+   int  shard,                /* Shard being built (from 1)             */
+        nShards;              /* Number of shards (0 if not sharded)    */
+   long nextFile,             /* Index of next file in the sorted list  */
+        dbSize,               /* Size of the text database              */
+        nRecords,             /* Records in the text database           */
+        coordsSize,           /* Size of coordinate file (-1 if none)   */
+        mfSize;               /* Size of the manifest (-1 if none)      */
+}  CHECKPOINT;
+
+typedef struct
+{
+   REAL x, y, z;              /* CA coordinates                         */
+   int  resnum,
+        flags;                /* CP_BREAK                               */
+   char chain[8],
+        insert[8],
+        resnam[8];
+}  CARES;
+
+typedef struct
+{
+   char magic[8];             /* CP_MAGIC (not NUL terminated)          */
+   int  version,              /* CP_VERSION                             */
+        hasBackbone;          /* BBRES stored after each file's CARES   */
+   long nFiles,
+        nResidues,
+        indexOffset,          /* File offset of the CPENTRY array       */
+        stringsOffset,        /* File offset of the paths               */
+        stringsSize;
+   char pdbDir[CP_MAXDIR];    /* Directory the PDB files were read from */
+}  CPHEADER;
+
+typedef struct
+{
+   long          size,        /* Size of the PDB file in bytes          */
+                 mtime,       /* Modification time of the PDB file      */
+                 offset,      /* File offset of its residues            */
+                 nRes,        /* Number of residues                     */
+                 path;        /* Offset of its path in the strings      */
+   unsigned long hash;        /* Hash of the PDB file contents          */
+}  CPENTRY;
+
+typedef struct
+{
+   FILE     *fp;
+   CPHEADER header;
+   CPENTRY  *entries;
+   char     *strings;
+   long     maxEntries,
+            stringsSize,
+            maxStrings,
+            dataOffset,       /* Offset at which next data are written  */
+            fileOffset,       /* Offset of the current file's residues  */
+            fileRes;          /* Residues stored for the current file   */
+}  CPWRITER;
+
+typedef struct
+{
+   CPHEADER *header;          /* Points into the mapped file            */
+   CPENTRY  *entries;
+   char     *strings;
+   void     *map;             /* The mapped file                        */
+   size_t   mapSize;
+}  CAPACK;
+
+typedef struct
+{
+   int  nAtoms;
+   REAL x[MAXSUPATOMS],
+        y[MAXSUPATOMS],
+        z[MAXSUPATOMS];
+}  SUPATOMS;
+
+typedef struct
+{
+   double count[HW_NEVENTS];  /* Counts (-1 if not available)           */
+}  HWCOUNTS;
+
+typedef struct
+{
+   double   t;                /* Time and counts at the start of a phase*/
+   HWCOUNTS hw;
+}  STATSMARK;
+
+typedef struct
+{
+   double   time[MAXPHASE],   /* Totals for each phase                  */
+            itemTime[MAXPHASE]; /* ...for the current file or query     */
+   HWCOUNTS hw[MAXPHASE],
+            itemHw[MAXPHASE];
+   BOOL     counters;         /* Hardware counters are being read       */
+}  PHASESTATS;
+
+typedef struct
+{
+   char   dbFile[QL_MAXFILE], /* Database                               */
+          sidecar[QL_MAXFILE],/* Sidecar (blank if none)                */
+          query[QL_MAXFILE],  /* Query PDB file (blank for stdin)       */
+          startRes[16],       /* Loop in the query                      */
+          endRes[16];
+   double time,               /* Wall clock time of the query           */
+          tolerance;
+   REAL   distMat[MAXSTEM][MAXSTEM]; /* Query distance matrix           */
+   int    loopLen,            /* Loop length searched for               */
+          numResult,          /* -n (0 = all)                           */
+          nStem;              /* Stem size of the database              */
+}  QUERYREC;
+
+typedef struct
+{
+   FILE     *in;              /* PDB or mmCIF file being read           */
+   char     *header,          /* mmCIF data_ line and atom_site loop
+                                 header (NULL for a PDB file)           */
+            line[CR_MAXLINE], /* Record read ahead (the first of the
+                                 next chain)                            */
+            chain[CR_MAXLINE],/* Its chain                              */
+            model[CR_MAXLINE];/* mmCIF model being read                 */
+   int      authCol,          /* mmCIF columns of auth_asym_id,         */
+            labelCol,         /* label_asym_id, pdbx_PDB_model_num,     */
+            modelCol,         /* group_PDB and label_atom_id (-1 if     */
+            groupCol,         /* absent)                                */
+            atomCol;
+   BOOL     isCif,
+            pending,          /* line holds a record not yet used       */
+            error;
+}  CHAINREADER;
+
+typedef struct _ddchain DDCHAIN; /* Opaque; see dedup.c                 */
+
+typedef struct
+{
+   FILE     *out;             /* Alias file                             */
+   DDCHAIN  **buckets,        /* Canonical chains of earlier entries by
+                                 hash (NULL unless acrossEntries)       */
+            *entry;           /* Canonical chains of this entry         */
+   REAL     tolerance;        /* Max difference in a CA-CA distance     */
+   int      window;           /* Most residues apart compared (0 = any) */
+   long     nChains,          /* Chains compared                        */
+            nWithin,          /* Aliases of a chain in the same entry   */
+            nAcross;          /* ...and of one in an earlier entry      */
+   BOOL     acrossEntries,
+            error;            /* DedupChains() ran out of memory        */
+}  DEDUP;
+
+typedef struct _loopdb LOOPDB; /* Opaque; see libloopdb.c               */
+
+typedef struct
+{
+   REAL     distMat[MAXSTEM][MAXSTEM], /* Query takeoff distances       */
+            tolerance;        /* Max deviation on an individual distance*/
+   SUPATOMS stems;            /* Takeoff atoms for RMSD reranking       */
+   int      stemIndex[2*MAXSTEM], /* Positions of the takeoff residues  */
+            loopLen,          /* Loop length wanted                     */
+            nStem,            /* Residues in each stem                  */
+            shortList;        /* Best hits to rerank by RMSD (0 = all)  */
+   BOOL     haveStems;        /* stems have been set                    */
+}  LOOPDBQUERY;
+
+typedef struct
+{
+   long record;               /* Database record (from 0)               */
+   REAL score,                /* Sum of the differences in distance     */
+        rmsd;                 /* Takeoff RMSD (-1 if not reranked)      */
+}  LOOPDBHIT;
+
+typedef struct
+{
+   double tMatch;             /* Time checking distances (only timed by
+                                 LoopDBScanFile())                      */
+   long nRecords,             /* Records in the database (or read)      */
+        nLength,              /* ...rejected by loop length             */
+        nMalformed,           /* ...whose distances could not be read   */
+        nMatched,             /* ...within the tolerance                */
+        nSidecar,             /* Records screened by the sidecar        */
+        nPassed,              /* ...and passed by it                    */
+        bytesRead,            /* Bytes of database (or cache) records
+                                 read by LoopDBScanFile()               */
+        cellReject[MAXDIST];  /* Rejected by each distance              */
+   int  cache;                /* LDB_CACHEOFF, LDB_CACHEHIT or
+                                 LDB_CACHEMISS                          */
+}  LOOPDBSTATS;
+
+typedef struct
+{
+   FILE    *dbf;              /* Text database                          */
+   char    *dbFile,           /* ...and its name, for cache keys        */
+           *cacheDir;         /* Query cache directory (NULL or blank
+                                 if none)                               */
+   QFILTER *qf;               /* Sidecar (or NULL)                      */
+   REAL    grid;              /* Grid for rounding cache keys           */
+   BOOL    reference;         /* Scan with the reference implementation */
+}  LOOPDBFILE;
+
+typedef struct _loop
+{
+   struct _loop *next;
+   char pdbcode[LDB_MAXFIELD],
+        startRes[LDB_MAXFIELD],
+        endRes[LDB_MAXFIELD],
+        buffer[DB_MAXLINE];   /* The record                             */
+   REAL score,                /* Sum of the differences in distance     */
+        rmsd;                 /* Takeoff RMSD (-1 if not reranked)      */
+   long record;               /* Database record (from 0)               */
+}  LOOP;
+
+typedef struct
+{
+   char     distTable[LDB_MAXFILE], /* Distance table ("-" for the
+                                       default)                         */
+            outfile[LDB_MAXFILE];   /* Database for this loop type      */
+   int      minLength,
+            maxLength;
+}  LOOPTYPE;
+
+typedef struct
+{
+   char     infile[LDB_MAXFILE],    /* PDB directory (or file)          */
+            outfile[LDB_MAXFILE],   /* Text database (blank for stdout) */
+            distTable[LDB_MAXFILE], /* Distance table (blank for the
+                                       default)                         */
+            qfFile[LDB_MAXFILE],    /* Each output file is blank if it  */
+            coordsFile[LDB_MAXFILE],/* is not wanted                    */
+            mfFile[LDB_MAXFILE],
+            prevDb[LDB_MAXFILE],    /* Previous build to update         */
+            prevMf[LDB_MAXFILE],
+            ckFile[LDB_MAXFILE],
+            packFile[LDB_MAXFILE],  /* CA pack to write...              */
+            packIn[LDB_MAXFILE],    /* ...or to run from                */
+            statsFile[LDB_MAXFILE],
+            countersFile[LDB_MAXFILE],
+            aliasFile[LDB_MAXFILE]; /* Aliases written by --dedup       */
+   LOOPTYPE loopTypes[MAXLOOPTYPES]; /* Extra loop types (-T)           */
+   EXPTLFILTER filter;
+   REAL     dedupTol;
+   int      minLength,              /* Loop lengths (maxLength 0 = no   */
+            maxLength,              /* limit)                           */
+            limit,                  /* Max files to process (0 = all)   */
+            shard,                  /* Shard to build (from 1) and the  */
+            nShards,                /* number of shards (0 for all)     */
+            nLoopTypes,
+            nStem,
+            nThreads,               /* 0 for one per CPU                */
+            ckInterval;             /* Seconds between checkpoints      */
+   BOOL     isDirectory,
+            verbose,
+            resume,
+            reference,
+            stream,
+            noScreen,
+            exptl,
+            dedupAll;
+}  LOOPDBBUILDOPTS;
+
+typedef struct _loopdbbuild LOOPDBBUILD; /* Opaque; see loopbuild.c     */
+
+/************************************************************************/
+/* Prototypes
+*/
+/* disttable.c                                                          */
+BOOL ReadDistanceTable(char *distTable, int nStem,
+                       REAL minTable[MAXSTEM][MAXSTEM],
+                       REAL maxTable[MAXSTEM][MAXSTEM]);
+void SetUpMinMaxTables(REAL minTable[MAXSTEM][MAXSTEM], 
+                       REAL maxTable[MAXSTEM][MAXSTEM]);
+
+/* dbrecord.c                                                           */
+int  ReadDBStemSize(FILE *dbf);
+BOOL ParseDBRecord(char *buffer, int nStem, char *pdbCode, 
+                   char *startRes, char *endRes, int *loopLen,
+                   REAL distMat[MAXSTEM][MAXSTEM]);
+
+/* exptl.c                                                              */
+BOOL ReadExptl(FILE *in, EXPTL *exptl);
+BOOL ExptlPasses(EXPTL *exptl, EXPTLFILTER *filter);
+char *ExptlMethodName(int method);
+int  ExptlMethodCode(char *name);
+BOOL ReadDBExptl(FILE *dbf);
+BOOL ParseDBExptl(char *buffer, int nStem, EXPTL *exptl);
+
+/* qfilter.c                                                            */
+QFWRITER *OpenQFilterWriter(char *filename, int nStem,
+                            REAL minTable[MAXSTEM][MAXSTEM],
+                            REAL maxTable[MAXSTEM][MAXSTEM]);
+BOOL WriteQFilterRecord(QFWRITER *qw, long offset, int loopLen,
+                        REAL distMat[MAXSTEM][MAXSTEM]);
+BOOL CloseQFilterWriter(QFWRITER *qw, long dbSize);
+QFILTER *OpenQFilter(char *filename, FILE *dbf);
+void CloseQFilter(QFILTER *qf);
+void QFilterBounds(QFILTER *qf, REAL distMat[MAXSTEM][MAXSTEM],
+                   REAL tolerance, unsigned char *cMin,
+                   unsigned char *cMax);
+int  QFilterBlock(QFILTER *qf, long blockNum, int loopLen,
+                  unsigned char *cMin, unsigned char *cMax,
+                  unsigned char *ok);
+
+/* qcache.c                                                             */
+BOOL MakeCacheKey(char *dbFile, int loopLen, REAL tolerance, REAL grid,
+                  int nStem, REAL distMat[MAXSTEM][MAXSTEM], 
+                  char *cacheDir, char *key, char *cacheFile, 
+                  REAL centre[MAXSTEM][MAXSTEM], REAL *wideTolerance);
+FILE *OpenCacheEntry(char *cacheFile, char *key);
+FILE *CreateCacheEntry(char *cacheFile, char *key, char *tmpFile);
+BOOL CommitCacheEntry(FILE *fp, char *tmpFile, char *cacheFile);
+
+/* loopcoords.c                                                         */
+LCWRITER *OpenLoopCoordsWriter(char *filename, int nStem);
+BOOL WriteLoopCoords(LCWRITER *lw, BBRES *residues, int nRes);
+BOOL CloseLoopCoordsWriter(LCWRITER *lw, long dbSize);
+LOOPCOORDS *OpenLoopCoords(char *filename, FILE *dbf);
+BBRES *GetLoopCoords(LOOPCOORDS *lc, long record, int *nRes);
+void CloseLoopCoords(LOOPCOORDS *lc);
+BBRES *ExtractBackbone(PDB *pdb, int *nRes);
+BOOL CompanionFile(char *dbFile, char *example, char *companion);
+LCWRITER *ReopenLoopCoordsWriter(char *filename, long size, 
+                                 long nRecords);
+
+/* superpose.c                                                          */
+REAL SuperposeRMSD(SUPATOMS *mobile, SUPATOMS *fixed, REAL rotMat[3][3],
+                   REAL mobCentre[3], REAL fixCentre[3]);
+
+/* manifest.c                                                           */
+void ManifestParams(char *params, int nStem, int minLength, 
+                    int maxLength, REAL minTable[MAXSTEM][MAXSTEM], 
+                    REAL maxTable[MAXSTEM][MAXSTEM]);
+FILE *OpenManifestWriter(char *filename, char *params);
+BOOL WriteManifestEntry(FILE *fp, MFENTRY *entry);
+BOOL CloseManifestWriter(FILE *fp, long dbSize);
+MANIFEST *ReadManifest(char *filename);
+MFENTRY *FindManifestEntry(MANIFEST *mf, char *path);
+void FreeManifest(MANIFEST *mf);
+BOOL GetFileDetails(char *path, MFENTRY *entry, BOOL doHash);
+FILE *ReopenManifestWriter(char *filename, long size);
+
+/* checkpoint.c                                                         */
+BOOL SyncFile(FILE *fp);
+BOOL WriteCheckpoint(char *filename, CHECKPOINT *ck);
+BOOL ReadCheckpoint(char *filename, CHECKPOINT *ck);
+
+/* capack.c                                                             */
+CPWRITER *OpenCAPackWriter(char *filename, char *pdbDir,
+                           BOOL withBackbone);
+BOOL WriteCAPackResidues(CPWRITER *cw, PDB *pdb, BBRES *backbone,
+                         char *breakAfter);
+BOOL EndCAPackFile(CPWRITER *cw, char *path, MFENTRY *details);
+BOOL CloseCAPackWriter(CPWRITER *cw);
+CAPACK *OpenCAPack(char *filename);
+char *CAPackPath(CAPACK *cp, long file);
+CARES *CAPackResidues(CAPACK *cp, long file, int *nRes, BBRES **backbone);
+PDB *CAPackToPDB(CARES *res, int nRes);
+void CloseCAPack(CAPACK *cp);
+
+/* splice.c                                                             */
+int WriteSplicedModels(PDB *framework, char *startRes, char *endRes,
+                       LOOPCOORDS *lc, SUPATOMS *frameStems,
+                       long *records, int nModels, char *prefix,
+                       int nThreads);
+
+/* runstats.c                                                           */
+double StatsClock(void);
+long StatsPeakMemory(void);
+void StatsPrintString(FILE *fp, char *string);
+int  HWCountersOpen(void);
+void HWCountersClose(void);
+BOOL HWCountersAllThreads(void);
+void HWCountersRead(HWCOUNTS *hw);
+void StatsMark(PHASESTATS *ps, STATSMARK *mark);
+void StatsPhase(PHASESTATS *ps, STATSMARK *mark, int phase);
+void StatsResetItem(PHASESTATS *ps);
+void StatsPrintPhases(FILE *fp, PHASESTATS *ps, char **names, 
+                      int nPhases, BOOL item);
+
+/* querylog.c                                                           */
+double QueryLogTime(void);
+BOOL WriteQueryLog(char *filename, QUERYREC *query);
+QUERYREC *ReadQueryLog(char *filename, int *nQueries);
+
+/* chainread.c                                                          */
+CHAINREADER *OpenChainReader(FILE *in);
+BOOL RewindChainReader(CHAINREADER *cr);
+void CloseChainReader(CHAINREADER *cr);
+BOOL ReadNextChain(CHAINREADER *cr, PDB **pdb, int *natoms);
+int PreScreenFile(FILE *in, int minResidues);
+
+/* dedup.c                                                              */
+DEDUP *OpenDedup(char *aliasFile, REAL tolerance, int window,
+                 BOOL acrossEntries);
+void NewDedupEntry(DEDUP *dd);
+BOOL DedupChain(DEDUP *dd, PDB *chain, char *pdbCode, BOOL linked,
+                BOOL *isAlias);
+PDB *DedupChains(DEDUP *dd, PDB *pdb, char *pdbCode);
+BOOL CloseDedup(DEDUP *dd);
+
+/* libloopdb.c                                                          */
+LOOPDB *LoopDBOpen(char *dbFile, char *coordsFile);
+void LoopDBClose(LOOPDB *db);
+int  LoopDBStemSize(LOOPDB *db);
+long LoopDBNRecords(LOOPDB *db);
+long LoopDBCandidates(LOOPDB *db, int loopLen);
+char *LoopDBRecord(LOOPDB *db, long record);
+LOOPCOORDS *LoopDBCoords(LOOPDB *db);
+BOOL LoopDBMakeQuery(PDB *pdb, char *startRes, char *endRes,
+                     int loopLen, int nStem, LOOPDBQUERY *query);
+BOOL LoopDBQueryStems(LOOPDBQUERY *query, BBRES *backbone, int nRes);
+int  LoopDBScan(LOOPDB *db, LOOPDBQUERY *query, LOOPDBHIT *hits,
+                int maxHits, LOOPDBSTATS *stats);
+BOOL LoopDBMakeReferenceQuery(PDB *pdb, char *startRes, char *endRes,
+                              int loopLen, int nStem,
+                              LOOPDBQUERY *query);
+LOOP *LoopDBScanFile(LOOPDBFILE *file, LOOPDBQUERY *query,
+                     LOOPDBSTATS *stats);
+LOOP **LoopDBRankMatches(LOOP *loops, int *nLoops, LOOPCOORDS *lc,
+                         LOOPDBQUERY *query);
+REAL LoopRMSD(LOOPCOORDS *lc, long record, SUPATOMS *queryStems);
+BOOL GetStemAtoms(BBRES *backbone, int nRes, int nStem,
+                  int stemIndex[2*MAXSTEM], SUPATOMS *stems);
+
+/* loopbuild.c                                                          */
+void LoopDBBuildDefaults(LOOPDBBUILDOPTS *opts);
+LOOPDBBUILD *LoopDBBuildOpen(LOOPDBBUILDOPTS *opts);
+BOOL LoopDBBuildRun(LOOPDBBUILD *build);
+BOOL LoopDBBuildClose(LOOPDBBUILD *build);
+
+#endif
@@ -0,0 +1,440 @@
+/************************************************************************/
+/**
+
+   \file       manifest.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Manifest of the input files used to build a database
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   A manifest lists each PDB file that went into a database with its
+   size, modification time and a hash of its contents, together with
+   the range of database records that it produced. The build
+   parameters are recorded so that a manifest is only used with a
+   database built the same way.
+
+   The manifest is a text file:
+      #LOOPDBMANIFEST 1
+      #PARAMS: minLength maxLength and the distance table
+      path<TAB>size<TAB>mtime<TAB>hash<TAB>firstRecord<TAB>nRecords
+      ...
+      #DBSIZE: size of the database in bytes
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MF_HEADER     "#LOOPDBMANIFEST 1"
+#define MF_PARAMS     "#PARAMS: "
+#define MF_DBSIZE     "#DBSIZE: "
+#define MF_MAXLINE    (MF_MAXPARAMS + 32)
+#define MF_HASHBUFF   65536
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+static int cmpEntries(const void *p1, const void *p2);
+
+
+/************************************************************************/
+/*>void ManifestParams(char *params, int nStem, int minLength, 
+                       int maxLength, REAL minTable[MAXSTEM][MAXSTEM],
+                       REAL maxTable[MAXSTEM][MAXSTEM])
+   ---------------------------------------------------------------
+*//**
+   \param[out]  *params    Parameter string (MF_MAXPARAMS)
+   \param[in]   nStem      Residues in each stem
+   \param[in]   minLength  Minimum loop length
+   \param[in]   maxLength  Maximum loop length
+   \param[in]   minTable   table of minimum distances
+   \param[in]   maxTable   table of maximum distances
+
+   Builds the string describing the build parameters. Records can only
+   be reused from a build with an identical string.
+
+-  18.10.26 Original   By: ACRM
+*/
+void ManifestParams(char *params, int nStem, int minLength, 
+                    int maxLength, REAL minTable[MAXSTEM][MAXSTEM], 
+                    REAL maxTable[MAXSTEM][MAXSTEM])
+{
+   int i, j;
+
+   sprintf(params, "%d %d %d", nStem, minLength, maxLength);
+   for(i=0; i<nStem; i++)
+   {
+      for(j=0; j<nStem; j++)
+      {
+         params += strlen(params);
+         sprintf(params, " %.3f %.3f", minTable[i][j], maxTable[i][j]);
+      }
+   }
+}
+
+
+/************************************************************************/
+/*>FILE *OpenManifestWriter(char *filename, char *params)
+   ------------------------------------------------------
+*//**
+   \param[in]   *filename  Manifest filename
+   \param[in]   *params    Parameter string from ManifestParams()
+   \return                 File pointer (or NULL)
+
+   Creates a manifest and writes its header
+
+-  18.10.26 Original   By: ACRM
+*/
+FILE *OpenManifestWriter(char *filename, char *params)
+{
+   FILE *fp;
+
+   if((fp = fopen(filename, "w"))!=NULL)
+   {
+      fprintf(fp, "%s\n", MF_HEADER);
+      fprintf(fp, "%s%s\n", MF_PARAMS, params);
+   }
+   return(fp);
+}
+
+
+/************************************************************************/
+/*>FILE *ReopenManifestWriter(char *filename, long size)
+   -----------------------------------------------------
+*//**
+   \param[in]   *filename  Manifest filename
+   \param[in]   size       Size to truncate it to
+   \return                 File pointer (or NULL)
+
+   Reopens a partly written manifest to carry on adding entries after
+   an interrupted build. Anything after the given size was written
+   after the last checkpoint and is discarded.
+
+-  18.10.26 Original   By: ACRM
+*/
+FILE *ReopenManifestWriter(char *filename, long size)
+{
+   FILE *fp;
+
+   if((fp = fopen(filename, "r+"))==NULL)
+      return(NULL);
+   if(ftruncate(fileno(fp), (off_t)size) || fseek(fp, size, SEEK_SET))
+   {
+      fclose(fp);
+      return(NULL);
+   }
+   return(fp);
+}
+
+
+/************************************************************************/
+/*>BOOL WriteManifestEntry(FILE *fp, MFENTRY *entry)
+   -------------------------------------------------
+*//**
+   \param[in]   *fp        Manifest file pointer
+   \param[in]   *entry     Details of an input file
+   \return                 Success
+
+   Adds an input file to the manifest
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL WriteManifestEntry(FILE *fp, MFENTRY *entry)
+{
+   return(fprintf(fp, "%s\t%ld\t%ld\t%016lx\t%ld\t%ld\n", 
+                  entry->path, entry->size, entry->mtime, entry->hash,
+                  entry->first, entry->nRecords) > 0);
+}
+
+
+/************************************************************************/
+/*>BOOL CloseManifestWriter(FILE *fp, long dbSize)
+   -----------------------------------------------
+*//**
+   \param[in]   *fp        Manifest file pointer
+   \param[in]   dbSize     Size of the database in bytes
+   \return                 Success
+
+   Writes the size of the database that the manifest describes and
+   closes the file
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL CloseManifestWriter(FILE *fp, long dbSize)
+{
+   fprintf(fp, "%s%ld\n", MF_DBSIZE, dbSize);
+   return(fclose(fp) == 0);
+}
+
+
+/************************************************************************/
+/*>MANIFEST *ReadManifest(char *filename)
+   --------------------------------------
+*//**
+   \param[in]   *filename  Manifest filename
+   \return                 The manifest (NULL if it can't be read or
+                           is incomplete)
+
+   Reads a manifest. The entries are sorted by path for
+   FindManifestEntry()
+
+-  18.10.26 Original   By: ACRM
+*/
+MANIFEST *ReadManifest(char *filename)
+{
+   FILE     *fp;
+   MANIFEST *mf;
+   char     buffer[MF_MAXLINE],
+            *tab;
+   long     maxEntries = 0;
+   BOOL     ok = TRUE;
+
+   if((fp = fopen(filename, "r"))==NULL)
+      return(NULL);
+
+   if((mf = (MANIFEST *)malloc(sizeof(MANIFEST)))==NULL)
+   {
+      fclose(fp);
+      return(NULL);
+   }
+   mf->entries   = NULL;
+   mf->nEntries  = 0;
+   mf->dbSize    = -1;
+   mf->params[0] = '\0';
+
+   if(!fgets(buffer, MF_MAXLINE, fp) || 
+      strncmp(buffer, MF_HEADER, strlen(MF_HEADER)))
+      ok = FALSE;
+
+   while(ok && fgets(buffer, MF_MAXLINE, fp))
+   {
+      MFENTRY *e;
+
+      TERMINATE(buffer);
+      if(!strncmp(buffer, MF_PARAMS, strlen(MF_PARAMS)))
+      {
+         strncpy(mf->params, buffer + strlen(MF_PARAMS), MF_MAXPARAMS);
+         mf->params[MF_MAXPARAMS-1] = '\0';
+         continue;
+      }
+      if(!strncmp(buffer, MF_DBSIZE, strlen(MF_DBSIZE)))
+      {
+         sscanf(buffer + strlen(MF_DBSIZE), "%ld", &(mf->dbSize));
+         continue;
+      }
+
+      if(mf->nEntries == maxEntries)
+      {
+         MFENTRY *entries;
+         maxEntries = (maxEntries == 0)?1024:(2 * maxEntries);
+         if((entries = (MFENTRY *)realloc(mf->entries, 
+                                          maxEntries * sizeof(MFENTRY)))
+            == NULL)
+         {
+            ok = FALSE;
+            break;
+         }
+         mf->entries = entries;
+      }
+
+      /* The path is everything up to the first tab                     */
+      e = mf->entries + mf->nEntries;
+      if(((tab = strchr(buffer, '\t'))==NULL) ||
+         (sscanf(tab+1, "%ld %ld %lx %ld %ld", &(e->size), &(e->mtime),
+                 &(e->hash), &(e->first), &(e->nRecords)) != 5))
+      {
+         ok = FALSE;
+         break;
+      }
+      *tab = '\0';
+      if((e->path = (char *)malloc(strlen(buffer)+1))==NULL)
+      {
+         ok = FALSE;
+         break;
+      }
+      strcpy(e->path, buffer);
+      mf->nEntries++;
+   }
+   fclose(fp);
+
+   /* A manifest without its trailer was not finished                   */
+   if(!ok || (mf->dbSize < 0))
+   {
+      FreeManifest(mf);
+      return(NULL);
+   }
+
+   if(mf->nEntries)
+      qsort(mf->entries, mf->nEntries, sizeof(MFENTRY), cmpEntries);
+   return(mf);
+}
+
+
+/************************************************************************/
+/*>MFENTRY *FindManifestEntry(MANIFEST *mf, char *path)
+   ----------------------------------------------------
+*//**
+   \param[in]   *mf        Manifest from ReadManifest()
+   \param[in]   *path      Input file path
+   \return                 The entry for that file (or NULL)
+
+   Looks up an input file in a manifest
+
+-  18.10.26 Original   By: ACRM
+*/
+MFENTRY *FindManifestEntry(MANIFEST *mf, char *path)
+{
+   MFENTRY key;
+
+   if(mf->nEntries == 0)
+      return(NULL);
+   key.path = path;
+   return((MFENTRY *)bsearch(&key, mf->entries, mf->nEntries, 
+                             sizeof(MFENTRY), cmpEntries));
+}
+
+
+/************************************************************************/
+/*>void FreeManifest(MANIFEST *mf)
+   -------------------------------
+*//**
+   \param[in]   *mf        Manifest from ReadManifest()
+
+   Frees a manifest
+
+-  18.10.26 Original   By: ACRM
+*/
+void FreeManifest(MANIFEST *mf)
+{
+   long i;
+
+   for(i=0; i<mf->nEntries; i++)
+      free(mf->entries[i].path);
+   if(mf->entries != NULL)
+      free(mf->entries);
+   free(mf);
+}
+
+
+/************************************************************************/
+/*>BOOL GetFileDetails(char *path, MFENTRY *entry, BOOL doHash)
+   ------------------------------------------------------------
+*//**
+   \param[in]   *path      Input file path
+   \param[out]  *entry     Entry with path, size, mtime and (if doHash)
+                           hash filled in
+   \param[in]   doHash     Hash the contents of the file
+   \return                 Success
+
+   Finds the details of an input file that go in its manifest entry.
+   The hash is a 64-bit FNV-1a hash of the file contents.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL GetFileDetails(char *path, MFENTRY *entry, BOOL doHash)
+{
+   struct stat   st;
+   FILE          *fp;
+   unsigned char buffer[MF_HASHBUFF];
+   size_t        nRead,
+                 i;
+
+   if(stat(path, &st))
+      return(FALSE);
+
+   entry->path  = path;
+   entry->size  = (long)st.st_size;
+   entry->mtime = (long)st.st_mtime;
+   entry->hash  = 0;
+
+   if(doHash)
+   {
+      if((fp = fopen(path, "rb"))==NULL)
+         return(FALSE);
+
+      entry->hash = 14695981039346656037UL;
+      while((nRead = fread(buffer, 1, MF_HASHBUFF, fp)) > 0)
+      {
+         for(i=0; i<nRead; i++)
+         {
+            entry->hash ^= buffer[i];
+            entry->hash *= 1099511628211UL;
+         }
+      }
+      fclose(fp);
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static int cmpEntries(const void *p1, const void *p2)
+   -----------------------------------------------------
+*//**
+   \param[in]  *p1    Pointer to first MFENTRY
+   \param[in]  *p2    Pointer to second MFENTRY
+   \return            Comparison of the paths
+
+   Comparison routine used by qsort() and bsearch()
+
+-  18.10.26 Original   By: ACRM
+*/
+static int cmpEntries(const void *p1, const void *p2)
+{
+   return(strcmp(((MFENTRY *)p1)->path, ((MFENTRY *)p2)->path));
+}
@@ -0,0 +1,570 @@
+/************************************************************************/
+/**
+
+   \file       mergeloopdb.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Combine loop database shards built with buildloopdb
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Reads the shards written by buildloopdb --shard i/N and writes a
+   single database. The shards may be given in any order; they are
+   checked to be a complete set from the same directory and their
+   records are written in shard order, which is the order that a
+   single buildloopdb run would give. The header is replaced by a
+   single header for the whole database.
+
+   The quantized filter sidecar is rebuilt from the merged records and
+   the loop coordinate file is rebuilt from the shards' coordinate
+   files. All the shards must have been built with the same stem size
+   and either all or none must give the experimental details
+   (buildloopdb --exptl).
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bioplib/SysDefs.h"
+#include "bioplib/general.h"
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXBUFF     256
+
+typedef struct
+{
+   char *filename;
+   FILE *fp;
+   int  shard,
+        nShards,
+        nStem;
+   BOOL exptl;
+   char pdbDir[MAXBUFF];
+}  SHARD;
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+int  main(int argc, char **argv);
+BOOL ParseCmdLine(int argc, char **argv, char *outfile, char *distTable,
+                  char *qfFile, char *coordsFile, int *firstShard);
+void Usage(void);
+BOOL ReadShardHeader(SHARD *shard);
+BOOL CheckShards(SHARD *shards, int nShards);
+BOOL MergeShard(SHARD *shard, FILE *out, long *offset, QFWRITER *qw,
+                LCWRITER *lw, char *coordsFile);
+static int cmpShards(const void *p1, const void *p2);
+
+
+/************************************************************************/
+/*>int main(int argc, char **argv)
+   -------------------------------
+*//**
+   Main program for merging database shards
+
+-  18.10.26 Original   By: ACRM
+*/
+int main(int argc, char **argv)
+{
+   char     outfile[MAXBUFF],
+            distTable[MAXBUFF],
+            qfFile[MAXBUFF],
+            coordsFile[MAXBUFF];
+   SHARD    *shards;
+   FILE     *out;
+   QFWRITER *qw = NULL;
+   LCWRITER *lw = NULL;
+   REAL     minTable[MAXSTEM][MAXSTEM],
+            maxTable[MAXSTEM][MAXSTEM];
+   time_t   tm;
+   long     offset;
+   int      firstShard,
+            nShards,
+            i,
+            retval = 0;
+
+   if(!ParseCmdLine(argc, argv, outfile, distTable, qfFile, coordsFile,
+                    &firstShard))
+   {
+      Usage();
+      return(0);
+   }
+
+   nShards = argc - firstShard;
+   if((shards = (SHARD *)malloc(nShards * sizeof(SHARD)))==NULL)
+   {
+      fprintf(stderr,"Error (mergeloopdb): No memory for shards\n");
+      return(1);
+   }
+
+   for(i=0; i<nShards; i++)
+   {
+      shards[i].filename = argv[firstShard + i];
+      if((shards[i].fp = fopen(shards[i].filename, "r"))==NULL)
+      {
+         fprintf(stderr,"Error (mergeloopdb): Unable to read %s\n",
+                 shards[i].filename);
+         return(1);
+      }
+      if(!ReadShardHeader(&(shards[i])))
+      {
+         fprintf(stderr,"Error (mergeloopdb): %s was not built with \
+buildloopdb --shard\n", shards[i].filename);
+         return(1);
+      }
+   }
+
+   qsort(shards, nShards, sizeof(SHARD), cmpShards);
+   if(!CheckShards(shards, nShards))
+      return(1);
+
+   /* The sidecar scale must be the same as buildloopdb would use       */
+   if(qfFile[0])
+   {
+      if(distTable[0])
+      {
+         if(!ReadDistanceTable(distTable, shards[0].nStem, minTable, 
+                               maxTable))
+         {
+            fprintf(stderr,"Error (mergeloopdb): Unable to read distance \
+table %s\n", distTable);
+            fprintf(stderr,"                    (it must have %d min/max \
+pairs)\n", shards[0].nStem * shards[0].nStem);
+            return(1);
+         }
+      }
+      else if(shards[0].nStem == NSTEM)
+      {
+         SetUpMinMaxTables(minTable, maxTable);
+      }
+      else
+      {
+         fprintf(stderr,"Error (mergeloopdb): Give the distance table \
+used to build the\n");
+         fprintf(stderr,"                    shards to write a \
+sidecar\n");
+         return(1);
+      }
+   }
+
+   if((out = fopen(outfile, "w"))==NULL)
+   {
+      fprintf(stderr,"Error (mergeloopdb): Unable to write %s\n",
+              outfile);
+      return(1);
+   }
+
+   if(qfFile[0] &&
+      ((qw = OpenQFilterWriter(qfFile, shards[0].nStem, minTable, 
+                               maxTable))==NULL))
+   {
+      fprintf(stderr,"Error (mergeloopdb): Unable to create sidecar \
+file %s\n", qfFile);
+      return(1);
+   }
+   if(coordsFile[0] &&
+      ((lw = OpenLoopCoordsWriter(coordsFile, shards[0].nStem))==NULL))
+   {
+      fprintf(stderr,"Error (mergeloopdb): Unable to create coordinate \
+file %s\n", coordsFile);
+      return(1);
+   }
+
+   /* The same header as buildloopdb writes                             */
+   time(&tm);
+   offset  = fprintf(out,"#PDBDIR: %s\n", shards[0].pdbDir);
+   offset += fprintf(out,"%s   %d\n", DB_STEMTAG, shards[0].nStem);
+   if(shards[0].exptl)
+      offset += fprintf(out,"%s  1\n", DB_EXPTLTAG);
+   offset += fprintf(out,"#DATE:   %s\n", ctime(&tm));
+
+   for(i=0; i<nShards; i++)
+   {
+      if(!MergeShard(&(shards[i]), out, &offset, qw, lw, coordsFile))
+      {
+         retval = 1;
+         break;
+      }
+      fclose(shards[i].fp);
+   }
+
+   if(fclose(out))
+   {
+      fprintf(stderr,"Error (mergeloopdb): Failed writing %s\n",
+              outfile);
+      retval = 1;
+   }
+   if((lw != NULL) && !CloseLoopCoordsWriter(lw, offset))
+   {
+      fprintf(stderr,"Error (mergeloopdb): Failed writing coordinate \
+file\n");
+      retval = 1;
+   }
+   if((qw != NULL) && !CloseQFilterWriter(qw, offset))
+   {
+      fprintf(stderr,"Error (mergeloopdb): Failed writing sidecar \
+file\n");
+      retval = 1;
+   }
+
+   free(shards);
+   return(retval);
+}
+
+
+/************************************************************************/
+/*>BOOL ReadShardHeader(SHARD *shard)
+   ----------------------------------
+*//**
+   \param[in,out]  *shard    Shard with its file open
+   \return                   Header contained a shard number
+
+   Reads the header of a shard to get the directory it was built from,
+   its shard number, its stem size and whether it gives the
+   experimental details. The file is rewound afterwards.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL ReadShardHeader(SHARD *shard)
+{
+   char buffer[MAXBUFF];
+
+   shard->shard     = shard->nShards = 0;
+   shard->pdbDir[0] = '\0';
+
+   while(fgets(buffer, MAXBUFF, shard->fp))
+   {
+      if(buffer[0] != '#')
+         break;
+      TERMINATE(buffer);
+      if(!strncmp(buffer, "#PDBDIR: ", 9))
+         strncpy(shard->pdbDir, buffer+9, MAXBUFF);
+      else if(!strncmp(buffer, "#SHARD:", 7))
+         sscanf(buffer+7, "%d/%d", &(shard->shard), &(shard->nShards));
+   }
+   shard->nStem = ReadDBStemSize(shard->fp);
+   shard->exptl = ReadDBExptl(shard->fp);
+
+   return(shard->nShards > 0);
+}
+
+
+/************************************************************************/
+/*>BOOL CheckShards(SHARD *shards, int nShards)
+   --------------------------------------------
+*//**
+   \param[in]  *shards   Shards sorted by shard number
+   \param[in]  nShards   Number of shards given
+   \return               Shards are a complete set
+
+   Checks that every shard is present exactly once and that all were
+   built from the same directory with the same stem size and the same
+   --exptl setting
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL CheckShards(SHARD *shards, int nShards)
+{
+   int i;
+
+   for(i=0; i<nShards; i++)
+   {
+      if(shards[i].nShards != nShards)
+      {
+         fprintf(stderr,"Error (mergeloopdb): %s is one of %d shards \
+but %d were given\n", shards[i].filename, shards[i].nShards, nShards);
+         return(FALSE);
+      }
+      if(shards[i].shard != i+1)
+      {
+         fprintf(stderr,"Error (mergeloopdb): Shard %d is missing or \
+repeated\n", i+1);
+         return(FALSE);
+      }
+      if(strcmp(shards[i].pdbDir, shards[0].pdbDir))
+      {
+         fprintf(stderr,"Error (mergeloopdb): %s was built from %s not \
+%s\n", shards[i].filename, shards[i].pdbDir, shards[0].pdbDir);
+         return(FALSE);
+      }
+      if((shards[i].nStem == 0) || (shards[i].nStem != shards[0].nStem))
+      {
+         fprintf(stderr,"Error (mergeloopdb): %s has a different or \
+unsupported stem size\n", shards[i].filename);
+         return(FALSE);
+      }
+      if(shards[i].exptl != shards[0].exptl)
+      {
+         fprintf(stderr,"Error (mergeloopdb): %s %s built with --exptl \
+but %s %s\n", shards[i].filename, shards[i].exptl?"was":"was not",
+                 shards[0].filename, shards[0].exptl?"was":"was not");
+         return(FALSE);
+      }
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>BOOL MergeShard(SHARD *shard, FILE *out, long *offset, QFWRITER *qw,
+                   LCWRITER *lw, char *coordsFile)
+   --------------------------------------------------------------------
+*//**
+   \param[in]     *shard      Shard to copy
+   \param[in]     *out        Merged database
+   \param[in,out] *offset     Byte offset in the merged database
+   \param[in]     *qw         Sidecar writer (or NULL)
+   \param[in]     *lw         Coordinate writer (or NULL)
+   \param[in]     *coordsFile Merged coordinate filename (used to find
+                              the shard's coordinate file)
+   \return                    Success
+
+   Copies the records of a shard to the merged database, adding them
+   to the sidecar and coordinate file
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL MergeShard(SHARD *shard, FILE *out, long *offset, QFWRITER *qw,
+                LCWRITER *lw, char *coordsFile)
+{
+   char       buffer[DB_MAXLINE],
+              pdbCode[MAXBUFF],
+              startRes[MAXBUFF],
+              endRes[MAXBUFF],
+              shardCoords[LC_MAXFILE];
+   LOOPCOORDS *lc     = NULL;
+   REAL       distMat[MAXSTEM][MAXSTEM];
+   long       record  = 0;
+   int        loopLen;
+   BOOL       ok      = TRUE;
+
+   if(lw != NULL)
+   {
+      if(!CompanionFile(shard->filename, coordsFile, shardCoords) ||
+         ((lc = OpenLoopCoords(shardCoords, shard->fp))==NULL))
+      {
+         fprintf(stderr,"Error (mergeloopdb): No coordinate file \
+matching %s\n", shard->filename);
+         return(FALSE);
+      }
+   }
+
+   while(ok && fgets(buffer, DB_MAXLINE, shard->fp))
+   {
+      TERMINATE(buffer);
+      if((buffer[0] == '#') || (buffer[0] == '\0'))
+         continue;
+
+      if(!ParseDBRecord(buffer, shard->nStem, pdbCode, startRes, endRes,
+                        &loopLen, distMat))
+      {
+         fprintf(stderr,"Error (mergeloopdb): Bad record in %s: %s\n",
+                 shard->filename, buffer);
+         ok = FALSE;
+         break;
+      }
+
+      if((qw != NULL) &&
+         !WriteQFilterRecord(qw, *offset, loopLen, distMat))
+      {
+         fprintf(stderr,"Error (mergeloopdb): No memory for sidecar \
+offsets\n");
+         ok = FALSE;
+      }
+
+      if(lc != NULL)
+      {
+         BBRES *residues;
+         int   nRes;
+
+         if(((residues = GetLoopCoords(lc, record, &nRes))==NULL) ||
+            !WriteLoopCoords(lw, residues, nRes))
+         {
+            fprintf(stderr,"Error (mergeloopdb): Failed copying \
+coordinates of record %ld of %s\n", record, shard->filename);
+            ok = FALSE;
+         }
+      }
+
+      *offset += fprintf(out, "%s\n", buffer);
+      record++;
+   }
+
+   if(lc != NULL)
+      CloseLoopCoords(lc);
+
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>static int cmpShards(const void *p1, const void *p2)
+   ----------------------------------------------------
+*//**
+   \param[in]  *p1    Pointer to first SHARD
+   \param[in]  *p2    Pointer to second SHARD
+   \return            Comparison of shard numbers
+
+   Comparison routine used by qsort()
+
+-  18.10.26 Original   By: ACRM
+*/
+static int cmpShards(const void *p1, const void *p2)
+{
+   return(((SHARD *)p1)->shard - ((SHARD *)p2)->shard);
+}
+
+
+/************************************************************************/
+/*>BOOL ParseCmdLine(int argc, char **argv, char *outfile,
+                     char *distTable, char *qfFile, char *coordsFile,
+                     int *firstShard)
+   ---------------------------------------------------------------------
+*//**
+   \param[in]   argc              Argument count
+   \param[in]   **argv            Argument array
+   \param[out]  *outfile          Merged database filename
+   \param[out]  *distTable        Distance table filename
+   \param[out]  *qfFile           Quantized filter sidecar filename
+   \param[out]  *coordsFile       Loop coordinate filename
+   \param[out]  *firstShard       Index in argv of the first shard
+   \return                        Success
+
+   Parse the command line
+
+-  18.10.26 Original    By: ACRM
+*/
+BOOL ParseCmdLine(int argc, char **argv, char *outfile, char *distTable,
+                  char *qfFile, char *coordsFile, int *firstShard)
+{
+   int arg;
+
+   outfile[0] = distTable[0] = qfFile[0] = coordsFile[0] = '\0';
+
+   for(arg=1; arg<argc; arg++)
+   {
+      if(argv[arg][0] == '-')
+      {
+         switch(argv[arg][1])
+         {
+         case 't':
+            if(++arg >= argc)
+               return(FALSE);
+            strncpy(distTable, argv[arg], MAXBUFF);
+            break;
+         case 'q':
+            if(++arg >= argc)
+               return(FALSE);
+            strncpy(qfFile, argv[arg], MAXBUFF);
+            break;
+         case 'c':
+            if(++arg >= argc)
+               return(FALSE);
+            strncpy(coordsFile, argv[arg], MAXBUFF);
+            break;
+         default:
+            return(FALSE);
+            break;
+         }
+      }
+      else
+      {
+         /* Need the output file and at least one shard                 */
+         if(argc - arg < 2)
+            return(FALSE);
+         strncpy(outfile, argv[arg], MAXBUFF);
+         *firstShard = arg + 1;
+         return(TRUE);
+      }
+   }
+
+   return(FALSE);
+}
+
+
+/************************************************************************/
+/*>void Usage(void)
+   ----------------
+*//**
+   Prints a usage message
+
+-  18.10.26 Original   By: ACRM
+*/
+void Usage(void)
+{
+   fprintf(stderr,"\nmergeloopdb V1.0 (c) 2015-26 UCL, Dr. Andrew C.R. \
+Martin.\n");
+
+   fprintf(stderr,"\nUsage: mergeloopdb [-t disttable][-q sidecar]\
+[-c coords] out.db shard.db ...\n");
+
+   fprintf(stderr,"\n                   -t The distance table used to \
+build the shards\n");
+   fprintf(stderr,"                   -q Also write a quantized filter \
+sidecar\n");
+   fprintf(stderr,"                   -c Also write the loop \
+coordinates. Each shard must\n");
+   fprintf(stderr,"                      have a coordinate file with \
+the same extension\n");
+   fprintf(stderr,"                      (e.g. -c loops.bb reads \
+shard1.bb for shard1.db)\n");
+
+   fprintf(stderr,"\nCombines the shards written by buildloopdb --shard \
+i/N into a single\n");
+   fprintf(stderr,"database with the records in the same order as a \
+single buildloopdb\n");
+   fprintf(stderr,"run. All N shards must be given, in any order. -t \
+is needed with -q\n");
+   fprintf(stderr,"for shards built with a distance table or a stem \
+size other than %d.\n\n", NSTEM);
+}
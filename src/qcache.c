@@ -0,0 +1,272 @@
+/************************************************************************/
+/**
+
+   \file       qcache.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      On-disk cache of scanloopdb results
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Maintains a directory of cached scan results. The key is made from
+   the identity of the database file (device, inode, size and
+   modification time), the loop length, the tolerance and the query
+   distance matrix rounded to a grid.
+
+   A query lies within half a grid spacing of the grid point it rounds
+   to, so any record that matches the query must lie within
+   tolerance + grid/2 of the grid point. Each cache entry therefore
+   holds the database records that match the grid point with that
+   wider tolerance. Rescoring the entry against the actual query gives
+   exactly the same hits as scanning the whole database.
+
+   Each entry is a small text file containing a header line with the
+   full key followed by the matching database records in database
+   order. Each record is preceded by its record number in the database
+   and a tab.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define QC_HEADER    "#LOOPCACHE 2 "
+#define QC_EPSILON   1.0e-6   /* Guard against rounding in the widened
+                                 tolerance                              */
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+static unsigned long HashString(char *string);
+
+
+/************************************************************************/
+/*>BOOL MakeCacheKey(char *dbFile, int loopLen, REAL tolerance,
+                     REAL grid, int nStem, 
+                     REAL distMat[MAXSTEM][MAXSTEM], char *cacheDir,
+                     char *key, char *cacheFile, 
+                     REAL centre[MAXSTEM][MAXSTEM], REAL *wideTolerance)
+   --------------------------------------------------------------------
+*//**
+   \param[in]   *dbFile         Database filename
+   \param[in]   loopLen         Loop length
+   \param[in]   tolerance       Tolerance on an individual distance
+   \param[in]   grid            Grid spacing for rounding distances
+   \param[in]   nStem           Residues in each stem
+   \param[in]   distMat         Query distance matrix
+   \param[in]   *cacheDir       Cache directory
+   \param[out]  *key            Full key string (QC_MAXKEY)
+   \param[out]  *cacheFile      Filename for the entry (QC_MAXFILE)
+   \param[out]  centre          Query distances rounded to the grid
+   \param[out]  *wideTolerance  Tolerance to use around centre when
+                                building the entry
+   \return                      Success (FALSE if the database can't be
+                                examined)
+
+   Builds the cache key for a query and the name of the file that would
+   hold its entry.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL MakeCacheKey(char *dbFile, int loopLen, REAL tolerance, REAL grid,
+                  int nStem, REAL distMat[MAXSTEM][MAXSTEM], 
+                  char *cacheDir, char *key, char *cacheFile, 
+                  REAL centre[MAXSTEM][MAXSTEM], REAL *wideTolerance)
+{
+   struct stat st;
+   char        *chp;
+   int         i, j;
+
+   if(stat(dbFile, &st) || (grid <= 0.0))
+      return(FALSE);
+
+   sprintf(key, "%lu %lu %ld %ld %d %.6f %.6f",
+           (unsigned long)st.st_dev, (unsigned long)st.st_ino,
+           (long)st.st_size, (long)st.st_mtime, loopLen, tolerance, grid);
+   chp = key + strlen(key);
+
+   for(i=0; i<nStem; i++)
+   {
+      for(j=0; j<nStem; j++)
+      {
+         long cell = (long)floor(distMat[i][j] / grid + 0.5);
+         centre[i][j] = cell * grid;
+         sprintf(chp, " %ld", cell);
+         chp += strlen(chp);
+      }
+   }
+
+   *wideTolerance = tolerance + grid / 2.0 + QC_EPSILON;
+   sprintf(cacheFile, "%s/%016lx.lcache", cacheDir, HashString(key));
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>FILE *OpenCacheEntry(char *cacheFile, char *key)
+   ------------------------------------------------
+*//**
+   \param[in]   *cacheFile  Filename for the entry
+   \param[in]   *key        Full key string
+   \return                  File pointer positioned at the first cached
+                            record, or NULL if there is no entry
+
+   Opens a cache entry for reading if it exists and was written for
+   exactly this key
+
+-  18.10.26 Original   By: ACRM
+*/
+FILE *OpenCacheEntry(char *cacheFile, char *key)
+{
+   FILE *fp;
+   char header[QC_MAXKEY + 32];
+
+   if((fp = fopen(cacheFile, "r"))==NULL)
+      return(NULL);
+
+   if(!fgets(header, QC_MAXKEY + 32, fp) ||
+      strncmp(header, QC_HEADER, strlen(QC_HEADER)))
+   {
+      fclose(fp);
+      return(NULL);
+   }
+
+   TERMINATE(header);
+   if(strcmp(header + strlen(QC_HEADER), key))
+   {
+      fclose(fp);
+      return(NULL);
+   }
+
+   return(fp);
+}
+
+
+/************************************************************************/
+/*>FILE *CreateCacheEntry(char *cacheFile, char *key, char *tmpFile)
+   -----------------------------------------------------------------
+*//**
+   \param[in]   *cacheFile  Filename for the entry
+   \param[in]   *key        Full key string
+   \param[out]  *tmpFile    Temporary filename used while writing
+                            (QC_MAXFILE)
+   \return                  File pointer for writing records (or NULL)
+
+   Starts writing a cache entry. The entry is written to a temporary
+   file and only renamed into place by CommitCacheEntry() so that
+   concurrent scans never see a partial entry.
+
+-  18.10.26 Original   By: ACRM
+*/
+FILE *CreateCacheEntry(char *cacheFile, char *key, char *tmpFile)
+{
+   FILE *fp;
+
+   sprintf(tmpFile, "%s.%ld.tmp", cacheFile, (long)getpid());
+   if((fp = fopen(tmpFile, "w"))!=NULL)
+      fprintf(fp, "%s%s\n", QC_HEADER, key);
+
+   return(fp);
+}
+
+
+/************************************************************************/
+/*>BOOL CommitCacheEntry(FILE *fp, char *tmpFile, char *cacheFile)
+   ---------------------------------------------------------------
+*//**
+   \param[in]   *fp         File pointer from CreateCacheEntry()
+   \param[in]   *tmpFile    Temporary filename
+   \param[in]   *cacheFile  Filename for the entry
+   \return                  Success
+
+   Closes a new cache entry and moves it into place
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL CommitCacheEntry(FILE *fp, char *tmpFile, char *cacheFile)
+{
+   if(fclose(fp) || rename(tmpFile, cacheFile))
+   {
+      remove(tmpFile);
+      return(FALSE);
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static unsigned long HashString(char *string)
+   ---------------------------------------------
+*//**
+   \param[in]   *string     String to hash
+   \return                  64-bit FNV-1a hash of the string
+
+-  18.10.26 Original   By: ACRM
+*/
+static unsigned long HashString(char *string)
+{
+   unsigned long hash = 14695981039346656037UL;
+
+   for(; *string; string++)
+   {
+      hash ^= (unsigned char)*string;
+      hash *= 1099511628211UL;
+   }
+   return(hash);
+}
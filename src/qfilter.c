@@ -0,0 +1,559 @@
+/************************************************************************/
+/**
+
+   \file       qfilter.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Quantized coarse-filter sidecar for the loop database
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Writes and reads the quantized filter file that may accompany a loop
+   database. Each distance is coded as floor((d-lo)/step) clamped to
+   0..255 where lo and step come from the distance table used to build
+   the database. Since the coding is monotonic, a record can only pass
+   the exact tolerance test if every code lies between the codes of
+   (query-tolerance) and (query+tolerance). The bounds are widened by
+   one code to allow for rounding of the distances in the text file, so
+   the filter never rejects a record that the exact test would accept.
+
+   The header records the stem size; a block holds the length codes
+   followed by one column for each of the nStem*nStem distances.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define OFFSET_CHUNK 65536
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+static unsigned char QuantizeDistance(REAL d, REAL lo, REAL step);
+static BOOL FlushBlock(QFWRITER *qw);
+
+
+/************************************************************************/
+/*>QFWRITER *OpenQFilterWriter(char *filename, int nStem,
+                               REAL minTable[MAXSTEM][MAXSTEM],
+                               REAL maxTable[MAXSTEM][MAXSTEM])
+   ----------------------------------------------------------------
+*//**
+   \param[in]   *filename  Sidecar file to create
+   \param[in]   nStem      Residues in each stem
+   \param[in]   minTable   table of minimum distances
+   \param[in]   maxTable   table of maximum distances
+   \return                 Writer structure (NULL on failure)
+
+   Opens a quantized filter file for writing. The scale for each column
+   is taken from the distance table used to build the database since no
+   record can lie outside it.
+
+-  18.10.26 Original   By: ACRM
+*/
+QFWRITER *OpenQFilterWriter(char *filename, int nStem,
+                            REAL minTable[MAXSTEM][MAXSTEM],
+                            REAL maxTable[MAXSTEM][MAXSTEM])
+{
+   QFWRITER *qw;
+   int      i, j;
+
+   if((qw = (QFWRITER *)malloc(sizeof(QFWRITER)))==NULL)
+      return(NULL);
+
+   if((qw->fp = fopen(filename, "wb"))==NULL)
+   {
+      free(qw);
+      return(NULL);
+   }
+
+   memset(&(qw->header), 0, sizeof(QFHEADER));
+   memcpy(qw->header.magic, QF_MAGIC, 8);
+   qw->header.version   = QF_VERSION;
+   qw->header.blockSize = QF_BLOCKSIZE;
+   qw->header.nDist     = nStem * nStem;
+   qw->header.nStem     = nStem;
+   for(i=0; i<nStem; i++)
+   {
+      for(j=0; j<nStem; j++)
+      {
+         qw->header.lo[i*nStem+j]   = minTable[i][j];
+         qw->header.step[i*nStem+j] = (maxTable[i][j] - minTable[i][j]) /
+                                      QF_NCODES;
+      }
+   }
+
+   qw->offsets    = NULL;
+   qw->maxOffsets = 0;
+   memset(qw->block, 0, QF_BLOCKBYTES(qw->header.nDist));
+
+   /* Space for the header; rewritten with the final counts on close    */
+   if(fwrite(&(qw->header), sizeof(QFHEADER), 1, qw->fp) != 1)
+   {
+      fclose(qw->fp);
+      free(qw);
+      return(NULL);
+   }
+
+   return(qw);
+}
+
+
+/************************************************************************/
+/*>BOOL WriteQFilterRecord(QFWRITER *qw, long offset, int loopLen,
+                           REAL distMat[MAXSTEM][MAXSTEM])
+   ---------------------------------------------------------------
+*//**
+   \param[in]   *qw        Sidecar writer
+   \param[in]   offset     Offset of the record in the text database
+   \param[in]   loopLen    Loop length
+   \param[in]   distMat    Distance matrix for the record
+   \return                 Success
+
+   Adds a record to the quantized filter file
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL WriteQFilterRecord(QFWRITER *qw, long offset, int loopLen,
+                        REAL distMat[MAXSTEM][MAXSTEM])
+{
+   int  r, i, j,
+        nStem    = qw->header.nStem;
+   long nRecords = qw->header.nRecords;
+
+   /* Grow the offsets array if needed                                  */
+   if(nRecords >= qw->maxOffsets)
+   {
+      long *newOffsets;
+      if((newOffsets = (long *)realloc(qw->offsets,
+                                       (qw->maxOffsets + OFFSET_CHUNK) *
+                                       sizeof(long)))==NULL)
+         return(FALSE);
+      qw->offsets     = newOffsets;
+      qw->maxOffsets += OFFSET_CHUNK;
+   }
+   qw->offsets[nRecords] = offset;
+
+   /* Length codes are followed by each of the distance columns         */
+   r = (int)(nRecords % QF_BLOCKSIZE);
+   qw->block[r] = (unsigned char)((loopLen < QF_MAXLENCODE) ?
+                                  loopLen : QF_MAXLENCODE);
+   for(i=0; i<nStem; i++)
+   {
+      for(j=0; j<nStem; j++)
+      {
+         int k = i*nStem+j;
+         qw->block[(k+1)*QF_BLOCKSIZE + r] =
+            QuantizeDistance(distMat[i][j], qw->header.lo[k],
+                             qw->header.step[k]);
+      }
+   }
+
+   qw->header.nRecords++;
+   if(r == QF_BLOCKSIZE-1)
+      return(FlushBlock(qw));
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>BOOL CloseQFilterWriter(QFWRITER *qw, long dbSize)
+   --------------------------------------------------
+*//**
+   \param[in]   *qw        Sidecar writer
+   \param[in]   dbSize     Final size of the text database
+   \return                 Success
+
+   Writes any partial block and the record offsets, then rewrites the
+   header with the final record count and database size. Frees the
+   writer.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL CloseQFilterWriter(QFWRITER *qw, long dbSize)
+{
+   BOOL ok = TRUE;
+   long nRecords = qw->header.nRecords;
+
+   if(nRecords % QF_BLOCKSIZE)
+      ok = FlushBlock(qw);
+
+   if(ok && nRecords)
+   {
+      if(fwrite(qw->offsets, sizeof(long), nRecords, qw->fp) !=
+         (size_t)nRecords)
+         ok = FALSE;
+   }
+
+   qw->header.dbSize = dbSize;
+   if(ok)
+   {
+      if(fseek(qw->fp, 0L, SEEK_SET) ||
+         (fwrite(&(qw->header), sizeof(QFHEADER), 1, qw->fp) != 1))
+         ok = FALSE;
+   }
+
+   if(fclose(qw->fp))
+      ok = FALSE;
+   if(qw->offsets != NULL)
+      free(qw->offsets);
+   free(qw);
+
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>static BOOL FlushBlock(QFWRITER *qw)
+   ------------------------------------
+*//**
+   \param[in]   *qw        Sidecar writer
+   \return                 Success
+
+   Writes the current block and clears it. Unused slots in a partial
+   block have length code zero so can never match a query.
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL FlushBlock(QFWRITER *qw)
+{
+   size_t blockBytes = QF_BLOCKBYTES(qw->header.nDist);
+
+   if(fwrite(qw->block, blockBytes, 1, qw->fp) != 1)
+      return(FALSE);
+   memset(qw->block, 0, blockBytes);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static unsigned char QuantizeDistance(REAL d, REAL lo, REAL step)
+   -----------------------------------------------------------------
+*//**
+   \param[in]   d          Distance
+   \param[in]   lo         Distance for code 0
+   \param[in]   step       Distance range covered by a code
+   \return                 The 8-bit code
+
+   Codes a distance. Values outside the range are clamped so the coding
+   remains monotonic.
+
+-  18.10.26 Original   By: ACRM
+*/
+static unsigned char QuantizeDistance(REAL d, REAL lo, REAL step)
+{
+   REAL code;
+
+   if(step <= 0.0)
+      return(0);
+
+   code = floor((d - lo) / step);
+   if(code < 0.0)
+      return(0);
+   if(code > (QF_NCODES-1))
+      return(QF_NCODES-1);
+   return((unsigned char)code);
+}
+
+
+/************************************************************************/
+/*>QFILTER *OpenQFilter(char *filename, FILE *dbf)
+   -----------------------------------------------
+*//**
+   \param[in]   *filename  Sidecar file
+   \param[in]   *dbf       The text database it should describe
+   \return                 Mapped sidecar (NULL if it can't be opened or
+                           doesn't match the database)
+
+   Maps a quantized filter file into memory and checks that it was
+   written for this database.
+
+-  18.10.26 Original   By: ACRM
+*/
+QFILTER *OpenQFilter(char *filename, FILE *dbf)
+{
+   QFILTER     *qf;
+   FILE        *fp;
+   struct stat st;
+   long        dbSize,
+               nBlocks;
+
+   /* Find the size of the text database                                */
+   if(fseek(dbf, 0L, SEEK_END))
+      return(NULL);
+   dbSize = ftell(dbf);
+   rewind(dbf);
+
+   if((fp = fopen(filename, "rb"))==NULL)
+      return(NULL);
+
+   if(fstat(fileno(fp), &st) || (st.st_size < (off_t)sizeof(QFHEADER)))
+   {
+      fclose(fp);
+      return(NULL);
+   }
+
+   if((qf = (QFILTER *)malloc(sizeof(QFILTER)))==NULL)
+   {
+      fclose(fp);
+      return(NULL);
+   }
+
+   qf->mapSize = (size_t)st.st_size;
+   qf->map     = mmap(NULL, qf->mapSize, PROT_READ, MAP_SHARED,
+                      fileno(fp), 0);
+   fclose(fp);
+   if(qf->map == MAP_FAILED)
+   {
+      free(qf);
+      return(NULL);
+   }
+
+   qf->header  = (QFHEADER *)qf->map;
+   nBlocks     = (qf->header->nRecords + QF_BLOCKSIZE - 1) / QF_BLOCKSIZE;
+   qf->nBlocks = nBlocks;
+   qf->blockBytes = QF_BLOCKBYTES(qf->header->nDist);
+   qf->blocks  = (unsigned char *)qf->map + sizeof(QFHEADER);
+   qf->offsets = (long *)(qf->blocks + nBlocks * qf->blockBytes);
+
+   /* Check that this is a sidecar for this database                    */
+   if(strncmp(qf->header->magic, QF_MAGIC, 8)      ||
+      (qf->header->version   != QF_VERSION)        ||
+      (qf->header->blockSize != QF_BLOCKSIZE)      ||
+      (qf->header->nStem     < MINSTEM)            ||
+      (qf->header->nStem     > MAXSTEM)            ||
+      (qf->header->nDist     != qf->header->nStem * qf->header->nStem) ||
+      (qf->header->dbSize    != dbSize)            ||
+      (qf->mapSize != sizeof(QFHEADER) + nBlocks * qf->blockBytes +
+                      qf->header->nRecords * sizeof(long)))
+   {
+      CloseQFilter(qf);
+      return(NULL);
+   }
+
+   return(qf);
+}
+
+
+/************************************************************************/
+/*>void CloseQFilter(QFILTER *qf)
+   ------------------------------
+*//**
+   \param[in]   *qf        Mapped sidecar
+
+   Unmaps and frees a quantized filter
+
+-  18.10.26 Original   By: ACRM
+*/
+void CloseQFilter(QFILTER *qf)
+{
+   if(qf != NULL)
+   {
+      munmap(qf->map, qf->mapSize);
+      free(qf);
+   }
+}
+
+
+/************************************************************************/
+/*>void QFilterBounds(QFILTER *qf, REAL distMat[MAXSTEM][MAXSTEM],
+                      REAL tolerance,
+                      unsigned char *cMin, unsigned char *cMax)
+   -------------------------------------------------------------------
+*//**
+   \param[in]   *qf        Mapped sidecar
+   \param[in]   distMat    Distance matrix from the query structure
+   \param[in]   tolerance  Allowed tolerance for an individual distance
+   \param[out]  *cMin      Lowest acceptable code for each column
+   \param[out]  *cMax      Highest acceptable code for each column
+
+   Converts the query and tolerance to a range of acceptable codes for
+   each column. The range is conservative: it is widened by the
+   precision of the text database and by one code either side.
+
+-  18.10.26 Original   By: ACRM
+*/
+void QFilterBounds(QFILTER *qf, REAL distMat[MAXSTEM][MAXSTEM],
+                   REAL tolerance, unsigned char *cMin,
+                   unsigned char *cMax)
+{
+   int i, j, k,
+       nStem = qf->header->nStem;
+
+   for(i=0; i<nStem; i++)
+   {
+      for(j=0; j<nStem; j++)
+      {
+         k = i*nStem+j;
+         cMin[k] = QuantizeDistance(distMat[i][j]-tolerance-QF_ROUNDING,
+                                    qf->header->lo[k],
+                                    qf->header->step[k]);
+         cMax[k] = QuantizeDistance(distMat[i][j]+tolerance+QF_ROUNDING,
+                                    qf->header->lo[k],
+                                    qf->header->step[k]);
+         if(cMin[k] > 0)
+            cMin[k]--;
+         if(cMax[k] < QF_NCODES-1)
+            cMax[k]++;
+      }
+   }
+}
+
+
+/************************************************************************/
+/*>int QFilterBlock(QFILTER *qf, long blockNum, int loopLen,
+                    unsigned char *cMin, unsigned char *cMax,
+                    unsigned char *ok)
+   ---------------------------------------------------------
+*//**
+   \param[in]   *qf        Mapped sidecar
+   \param[in]   blockNum   Block to filter
+   \param[in]   loopLen    Required loop length
+   \param[in]   *cMin      Lowest acceptable code for each column
+   \param[in]   *cMax      Highest acceptable code for each column
+   \param[out]  *ok        Set non-zero for each record in the block
+                           that survives (QF_BLOCKSIZE entries)
+   \return                 Number of survivors
+
+   Runs the coarse filter over one block of records. Survivors must then
+   be checked exactly against the text database. Loops of QF_MAXLENCODE
+   or more residues share a length code, so these also need their
+   length checking.
+
+-  18.10.26 Original   By: ACRM
+*/
+int QFilterBlock(QFILTER *qf, long blockNum, int loopLen,
+                 unsigned char *cMin, unsigned char *cMax,
+                 unsigned char *ok)
+{
+   unsigned char *block  = qf->blocks + blockNum * qf->blockBytes,
+                 lenCode = (unsigned char)((loopLen < QF_MAXLENCODE) ?
+                                           loopLen : QF_MAXLENCODE);
+   int           r, k,
+                 nDist   = qf->header->nDist,
+                 nOK     = 0,
+                 nValid  = QF_BLOCKSIZE;
+
+   /* The last block may be partial                                     */
+   if((blockNum+1) * QF_BLOCKSIZE > qf->header->nRecords)
+      nValid = (int)(qf->header->nRecords - blockNum * QF_BLOCKSIZE);
+
+#ifdef __SSE2__
+   {
+      __m128i lc = _mm_set1_epi8((char)lenCode);
+
+      for(r=0; r<QF_BLOCKSIZE; r+=16)
+      {
+         __m128i match;
+         int     mask, b;
+
+         match = _mm_cmpeq_epi8(
+                    _mm_loadu_si128((__m128i *)(block + r)), lc);
+
+         /* A code is in range if clamping it to the range leaves it
+            unchanged
+         */
+         for(k=0; k<nDist && _mm_movemask_epi8(match); k++)
+         {
+            __m128i x  = _mm_loadu_si128((__m128i *)
+                                         (block+(k+1)*QF_BLOCKSIZE+r)),
+                    lo = _mm_set1_epi8((char)cMin[k]),
+                    hi = _mm_set1_epi8((char)cMax[k]);
+            match = _mm_and_si128(match,
+                       _mm_and_si128(
+                          _mm_cmpeq_epi8(_mm_max_epu8(x, lo), x),
+                          _mm_cmpeq_epi8(_mm_min_epu8(x, hi), x)));
+         }
+
+         mask = _mm_movemask_epi8(match);
+         for(b=0; b<16; b++)
+         {
+            ok[r+b] = (unsigned char)((mask >> b) & 1);
+         }
+      }
+   }
+#else
+   for(r=0; r<QF_BLOCKSIZE; r++)
+      ok[r] = (unsigned char)(block[r] == lenCode);
+
+   for(k=0; k<nDist; k++)
+   {
+      unsigned char *col  = block + (k+1)*QF_BLOCKSIZE,
+                    lo    = cMin[k],
+                    range = (unsigned char)(cMax[k] - cMin[k]);
+
+      /* Unsigned wrap-around makes this a single range test           */
+      for(r=0; r<QF_BLOCKSIZE; r++)
+         ok[r] &= (unsigned char)((unsigned char)(col[r] - lo) <= range);
+   }
+#endif
+
+   for(r=0; r<QF_BLOCKSIZE; r++)
+   {
+      if(r >= nValid)
+         ok[r] = 0;
+      nOK += ok[r];
+   }
+
+   return(nOK);
+}
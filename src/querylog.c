@@ -0,0 +1,272 @@
+/************************************************************************/
+/**
+
+   \file       querylog.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Writing and reading the scanloopdb query log
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   scanloopdb --log appends the parameters of each query to a log which
+   replayloopdb plays back to generate a realistic load. Each line is
+      time db sidecar query startRes endRes loopLen tolerance nResults
+      nStem d[0][0] d[0][1] ... d[nStem-1][nStem-1]
+   where time is the wall clock time of the query in seconds since the
+   epoch, sidecar and query are '-' if no sidecar was used or the query
+   was read from standard input, loopLen is the length searched for
+   and d[][] is the query's distance matrix. Lines starting with # are
+   comments. Filenames may not contain white space.
+
+   Each line is written with a single write to a file opened for
+   appending so that several scanloopdb processes can share a log.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define QL_MAXLINE (4*QL_MAXFILE + DB_MAXLINE)
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+static void LogField(char *dest, char *field);
+
+
+/************************************************************************/
+/*>double QueryLogTime(void)
+   -------------------------
+*//**
+   \return     Wall clock time in seconds since the epoch
+
+   The time recorded for each query, so that the log can be replayed
+   with the gaps between the queries as they were made
+
+-  18.10.26 Original   By: ACRM
+*/
+double QueryLogTime(void)
+{
+   struct timespec ts;
+
+   if(clock_gettime(CLOCK_REALTIME, &ts))
+      return((double)time(NULL));
+   return((double)ts.tv_sec + (double)ts.tv_nsec / 1.0e9);
+}
+
+
+/************************************************************************/
+/*>BOOL WriteQueryLog(char *filename, QUERYREC *query)
+   ---------------------------------------------------
+*//**
+   \param[in]   *filename   Log file
+   \param[in]   *query      The query
+   \return                  Success
+
+   Appends a line for the query to the log
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL WriteQueryLog(char *filename, QUERYREC *query)
+{
+   char line[QL_MAXLINE],
+        dbFile[QL_MAXFILE],
+        sidecar[QL_MAXFILE],
+        queryFile[QL_MAXFILE];
+   FILE *fp;
+   int  i, j,
+        len;
+   BOOL ok;
+
+   LogField(dbFile,    query->dbFile);
+   LogField(sidecar,   query->sidecar);
+   LogField(queryFile, query->query);
+
+   len = sprintf(line, "%.6f %s %s %s %s %s %d %.3f %d %d",
+                 query->time, dbFile, sidecar, queryFile,
+                 query->startRes, query->endRes, query->loopLen,
+                 query->tolerance, query->numResult, query->nStem);
+   for(i=0; i<query->nStem; i++)
+   {
+      for(j=0; j<query->nStem; j++)
+         len += sprintf(line+len, " %.6f", query->distMat[i][j]);
+   }
+   strcpy(line+len, "\n");
+
+   if((fp = fopen(filename, "a"))==NULL)
+      return(FALSE);
+   ok = (fputs(line, fp) != EOF);
+   if(fclose(fp))
+      ok = FALSE;
+   return(ok);
+}
+
+
+/************************************************************************/
+/*>QUERYREC *ReadQueryLog(char *filename, int *nQueries)
+   -----------------------------------------------------
+*//**
+   \param[in]   *filename   Log file
+   \param[out]  *nQueries   Number of queries read
+   \return                  Array of queries (NULL if the file can't be
+                            read, a line is malformed or no memory).
+                            Free with free()
+
+   Reads all the queries in a log
+
+-  18.10.26 Original   By: ACRM
+*/
+QUERYREC *ReadQueryLog(char *filename, int *nQueries)
+{
+   char     line[QL_MAXLINE],
+            *chp,
+            *end;
+   FILE     *fp;
+   QUERYREC *queries = NULL,
+            *q;
+   int      maxQueries = 0,
+            nChar,
+            i, j;
+   BOOL     ok = TRUE;
+
+   *nQueries = 0;
+   if((fp = fopen(filename, "r"))==NULL)
+      return(NULL);
+
+   while(ok && fgets(line, QL_MAXLINE, fp))
+   {
+      TERMINATE(line);
+      if((line[0] == '#') || (line[0] == '\0'))
+         continue;
+
+      if(*nQueries == maxQueries)
+      {
+         maxQueries += 1024;
+         if((q = (QUERYREC *)realloc(queries,
+                                     maxQueries * sizeof(QUERYREC)))
+            ==NULL)
+         {
+            ok = FALSE;
+            break;
+         }
+         queries = q;
+      }
+      q = queries + *nQueries;
+
+      nChar = 0;
+      if((sscanf(line, "%lf%s%s%s%15s%15s%d%lf%d%d%n", &(q->time),
+                 q->dbFile, q->sidecar, q->query, q->startRes,
+                 q->endRes, &(q->loopLen), &(q->tolerance),
+                 &(q->numResult), &(q->nStem), &nChar) != 10) ||
+         (q->nStem < MINSTEM) || (q->nStem > MAXSTEM))
+      {
+         ok = FALSE;
+         break;
+      }
+      if(!strcmp(q->sidecar, "-"))
+         q->sidecar[0] = '\0';
+      if(!strcmp(q->query, "-"))
+         q->query[0] = '\0';
+
+      chp = line + nChar;
+      for(i=0; ok && i<q->nStem; i++)
+      {
+         for(j=0; j<q->nStem; j++)
+         {
+            q->distMat[i][j] = (REAL)strtod(chp, &end);
+            if(end == chp)
+            {
+               ok = FALSE;
+               break;
+            }
+            chp = end;
+         }
+      }
+      (*nQueries)++;
+   }
+   fclose(fp);
+
+   if(!ok)
+   {
+      free(queries);
+      *nQueries = 0;
+      return(NULL);
+   }
+   return(queries);
+}
+
+
+/************************************************************************/
+/*>static void LogField(char *dest, char *field)
+   ---------------------------------------------
+*//**
+   \param[out]  *dest     Field as written to the log
+   \param[in]   *field    Filename (or blank)
+
+   Copies a filename for the log, using '-' for a blank one
+
+-  18.10.26 Original   By: ACRM
+*/
+static void LogField(char *dest, char *field)
+{
+   if((field == NULL) || (field[0] == '\0'))
+   {
+      strcpy(dest, "-");
+   }
+   else
+   {
+      sprintf(dest, "%.*s", QL_MAXFILE-1, field);
+   }
+}
@@ -0,0 +1,919 @@
+/************************************************************************/
+/**
+
+   \file       replayloopdb.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Replays a scanloopdb query log as a load test
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Plays back the queries recorded by scanloopdb --log (see querylog.c)
+   from a pool of threads and reports the throughput and the latency
+   percentiles as a line of JSON.
+
+   By default each query is run in this process through libloopdb
+   with the recorded distance matrix. Each database is loaded once,
+   before the clock starts, and shared by all the threads, so this
+   measures the scan alone. With -x, scanloopdb itself is run for each
+   query, which also includes starting the program, reading the
+   database and reading the query structure. Queries that were read
+   from standard input can't be rerun like this and are skipped.
+
+   With -r the queries are started at a fixed rate and with -s at the
+   times they were recorded (speeded up by the given factor). The
+   latency of these is measured from the time each query should have
+   started, so a server that falls behind is charged for the queries
+   that were kept waiting. Otherwise the queries are run back to back
+   and the latency is the time each one took.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXBUFF     1024
+
+/************************************************************************/
+/* Structure definitions
+*/
+typedef struct
+{
+   QUERYREC *queries;         /* The log                                */
+   LOOPDB   **dbs;            /* Database for each query in process     */
+   double   *due,             /* Start time of each query relative to
+                                 the start (NULL if run back to back)   */
+            *latency;         /* Latency of each query (ms)             */
+   int      *hits,            /* Hits found by each query               */
+            *status;          /* RP_OK, RP_ERROR or RP_SKIPPED          */
+   char     *scanExe;         /* scanloopdb for -x (NULL in process)    */
+   double   tStart;
+   int      nQueries,         /* Queries in the log                     */
+            nTotal,           /* Queries to run                         */
+            next;             /* Next query to be run                   */
+   pthread_mutex_t lock;
+}  REPLAY;
+
+typedef struct
+{
+   REPLAY    *replay;
+   LOOPDBHIT *hits;           /* Space for this thread's hits           */
+   int       maxHits,
+             thread;
+}  REPLAYJOB;
+
+#define RP_OK      0
+#define RP_ERROR   1
+#define RP_SKIPPED 2
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+int  main(int argc, char **argv);
+BOOL ParseCmdLine(int argc, char **argv, char *logFile, int *nThreads,
+                  REAL *rate, REAL *speed, int *nTotal, char *scanExe,
+                  char *outFile);
+void Usage(void);
+BOOL ScheduleQueries(REPLAY *replay, REAL rate, REAL speed);
+void RunReplay(REPLAY *replay, int nThreads);
+static void *ReplayThread(void *arg);
+BOOL OpenDatabases(REPLAY *replay);
+void CloseDatabases(REPLAY *replay);
+int  RunInProcess(REPLAYJOB *job, LOOPDB *db, QUERYREC *query);
+int  RunScanloopdb(char *scanExe, QUERYREC *query);
+BOOL WriteReplayReport(char *outFile, REPLAY *replay, int nThreads,
+                       REAL rate, REAL speed, double wallTime);
+static int cmpDoubles(const void *p1, const void *p2);
+
+
+/************************************************************************/
+/*>int main(int argc, char **argv)
+   -------------------------------
+*//**
+   Main program
+
+-  18.10.26 Original   By: ACRM
+*/
+int main(int argc, char **argv)
+{
+   char   logFile[MAXBUFF],
+          scanExe[MAXBUFF],
+          outFile[MAXBUFF];
+   REAL   rate     = 0.0,
+          speed    = 0.0;
+   int    nThreads = 0,
+          nTotal   = 0;
+   double wallTime;
+   REPLAY replay;
+
+   if(!ParseCmdLine(argc, argv, logFile, &nThreads, &rate, &speed,
+                    &nTotal, scanExe, outFile))
+   {
+      Usage();
+      return(1);
+   }
+
+   memset(&replay, 0, sizeof(REPLAY));
+   if((replay.queries = ReadQueryLog(logFile, &replay.nQueries))==NULL)
+   {
+      fprintf(stderr,"Error (replayloopdb): No queries read from %s\n",
+              logFile);
+      return(1);
+   }
+
+   replay.nTotal  = (nTotal > 0)?nTotal:replay.nQueries;
+   replay.scanExe = scanExe[0]?scanExe:NULL;
+   replay.latency = (double *)malloc(replay.nTotal * sizeof(double));
+   replay.hits    = (int *)malloc(replay.nTotal * sizeof(int));
+   replay.status  = (int *)malloc(replay.nTotal * sizeof(int));
+   if((replay.latency == NULL) || (replay.hits == NULL) ||
+      (replay.status == NULL) || !ScheduleQueries(&replay, rate, speed))
+   {
+      fprintf(stderr,"Error (replayloopdb): No memory for %d queries\n",
+              replay.nTotal);
+      return(1);
+   }
+
+   if((replay.scanExe == NULL) && !OpenDatabases(&replay))
+   {
+      fprintf(stderr,"Error (replayloopdb): No memory for databases\n");
+      return(1);
+   }
+
+   if(nThreads < 1)
+   {
+      long nCPU = sysconf(_SC_NPROCESSORS_ONLN);
+      nThreads  = (nCPU > 0)?(int)nCPU:1;
+   }
+   if(nThreads > replay.nTotal)
+      nThreads = replay.nTotal;
+
+   replay.tStart = StatsClock();
+   RunReplay(&replay, nThreads);
+   wallTime = StatsClock() - replay.tStart;
+
+   if(!WriteReplayReport(outFile, &replay, nThreads, rate, speed,
+                         wallTime))
+   {
+      fprintf(stderr,"Error (replayloopdb): Unable to write report to \
+%s\n", outFile);
+      return(1);
+   }
+
+   CloseDatabases(&replay);
+   free(replay.queries);
+   free(replay.due);
+   free(replay.latency);
+   free(replay.hits);
+   free(replay.status);
+
+   return(0);
+}
+
+
+/************************************************************************/
+/*>BOOL ParseCmdLine(int argc, char **argv, char *logFile, int *nThreads,
+                     REAL *rate, REAL *speed, int *nTotal, char *scanExe,
+                     char *outFile)
+   ----------------------------------------------------------------------
+*//**
+   \param[in]  argc        Argument count
+   \param[in]  **argv      Argument array
+   \param[out] *logFile    Query log
+   \param[out] *nThreads   Number of threads (0 = one per processor)
+   \param[out] *rate       Queries per second (0 = back to back)
+   \param[out] *speed      Speed up of the recorded times (0 = not used)
+   \param[out] *nTotal     Queries to run (0 = each query in the log)
+   \param[out] *scanExe    scanloopdb to run (blank to run in process)
+   \param[out] *outFile    File for the report (blank for stdout)
+   \return                 Success
+
+   Parse the command line
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL ParseCmdLine(int argc, char **argv, char *logFile, int *nThreads,
+                  REAL *rate, REAL *speed, int *nTotal, char *scanExe,
+                  char *outFile)
+{
+   int arg;
+
+   logFile[0] = scanExe[0] = outFile[0] = '\0';
+   *nThreads  = *nTotal = 0;
+   *rate      = *speed  = 0.0;
+
+   for(arg=1; arg<argc; arg++)
+   {
+      if(argv[arg][0] != '-')
+         break;
+
+      switch(argv[arg][1])
+      {
+      case 'j':
+         if((++arg >= argc) || !sscanf(argv[arg], "%d", nThreads) ||
+            (*nThreads < 0))
+            return(FALSE);
+         break;
+      case 'r':
+         if((++arg >= argc) || !sscanf(argv[arg], "%lf", rate) ||
+            (*rate < 0.0))
+            return(FALSE);
+         break;
+      case 's':
+         if((++arg >= argc) || !sscanf(argv[arg], "%lf", speed) ||
+            (*speed <= 0.0))
+            return(FALSE);
+         break;
+      case 'N':
+         if((++arg >= argc) || !sscanf(argv[arg], "%d", nTotal) ||
+            (*nTotal < 1))
+            return(FALSE);
+         break;
+      case 'x':
+         if(++arg >= argc)
+            return(FALSE);
+         strncpy(scanExe, argv[arg], MAXBUFF-1);
+         scanExe[MAXBUFF-1] = '\0';
+         break;
+      case 'o':
+         if(++arg >= argc)
+            return(FALSE);
+         strncpy(outFile, argv[arg], MAXBUFF-1);
+         outFile[MAXBUFF-1] = '\0';
+         break;
+      default:
+         return(FALSE);
+      }
+   }
+
+   /* -r and -s are different schedules                                 */
+   if((*rate > 0.0) && (*speed > 0.0))
+      return(FALSE);
+
+   if(arg != argc-1)
+      return(FALSE);
+   strncpy(logFile, argv[arg], MAXBUFF-1);
+   logFile[MAXBUFF-1] = '\0';
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void Usage(void)
+   ----------------
+*//**
+   Prints a usage message
+
+-  18.10.26 Original   By: ACRM
+*/
+void Usage(void)
+{
+   fprintf(stderr,"\nreplayloopdb V1.0 (c) 2015-26 UCL, Dr. Andrew C.R. \
+Martin.\n");
+
+   fprintf(stderr,"\nUsage: replayloopdb [-j nthreads][-r rate | -s \
+speed][-N count]\n");
+   fprintf(stderr,"                    [-x scanloopdb][-o report.json] \
+queries.log\n");
+   fprintf(stderr,"\n                    queries.log - log written by \
+scanloopdb --log\n");
+   fprintf(stderr,"                    -j - Number of queries run at \
+once [one per CPU]\n");
+   fprintf(stderr,"                    -r - Start queries at this rate \
+(per second)\n");
+   fprintf(stderr,"                         [Default: back to \
+back]\n");
+   fprintf(stderr,"                    -s - Start queries at the times \
+they were recorded,\n");
+   fprintf(stderr,"                         this many times faster\n");
+   fprintf(stderr,"                    -N - Number of queries to run, \
+going round the log\n");
+   fprintf(stderr,"                         again if needed [each query \
+once]\n");
+   fprintf(stderr,"                    -x - Run this scanloopdb program \
+for each query\n");
+   fprintf(stderr,"                         [Default: scan the database \
+in this process]\n");
+   fprintf(stderr,"                    -o - Append the report to this \
+file [standard output]\n");
+
+   fprintf(stderr,"\nPlays back the queries recorded by scanloopdb --log \
+and reports the\n");
+   fprintf(stderr,"throughput and the latency percentiles as a line of \
+JSON. With -r or -s,\n");
+   fprintf(stderr,"latency is measured from the time each query should \
+have started. With\n");
+   fprintf(stderr,"-x, run from the directory the queries were recorded \
+in so that the\n");
+   fprintf(stderr,"recorded filenames can be found; queries read from \
+standard input are\n");
+   fprintf(stderr,"skipped.\n\n");
+}
+
+
+/************************************************************************/
+/*>BOOL ScheduleQueries(REPLAY *replay, REAL rate, REAL speed)
+   -----------------------------------------------------------
+*//**
+   \param[in,out]  *replay   Replay; the due times are filled in
+   \param[in]      rate      Queries per second (0 = not used)
+   \param[in]      speed     Speed up of the recorded times (0 = not
+                             used)
+   \return                   Success (FALSE if no memory)
+
+   Works out when each query should start. With neither a rate nor a
+   speed, the queries are run back to back and no times are set. When
+   the log is replayed more than once with -s, each pass starts one
+   average gap after the last query of the one before.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL ScheduleQueries(REPLAY *replay, REAL rate, REAL speed)
+{
+   double tFirst,
+          span,
+          offset;
+   int    i;
+
+   replay->due = NULL;
+   if((rate <= 0.0) && (speed <= 0.0))
+      return(TRUE);
+
+   if((replay->due = (double *)malloc(replay->nTotal * sizeof(double)))
+      ==NULL)
+      return(FALSE);
+
+   if(rate > 0.0)
+   {
+      for(i=0; i<replay->nTotal; i++)
+         replay->due[i] = (double)i / rate;
+      return(TRUE);
+   }
+
+   /* Several scanloopdb processes may share a log so the times need
+      not be in order
+   */
+   tFirst = span = replay->queries[0].time;
+   for(i=1; i<replay->nQueries; i++)
+   {
+      tFirst = MIN(tFirst, replay->queries[i].time);
+      span   = MAX(span,   replay->queries[i].time);
+   }
+   span -= tFirst;
+   if(replay->nQueries > 1)
+      span += span / (replay->nQueries - 1);
+
+   for(i=0; i<replay->nTotal; i++)
+   {
+      offset = (double)(i / replay->nQueries) * span +
+               replay->queries[i % replay->nQueries].time - tFirst;
+      replay->due[i] = offset / speed;
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void RunReplay(REPLAY *replay, int nThreads)
+   --------------------------------------------
+*//**
+   \param[in,out]  *replay    Replay; the results are filled in
+   \param[in]      nThreads   Number of threads
+
+   Runs the queries using a pool of threads. Each thread takes the next
+   query that is due.
+
+-  18.10.26 Original   By: ACRM
+*/
+void RunReplay(REPLAY *replay, int nThreads)
+{
+   REPLAYJOB *jobs;
+   pthread_t *threads;
+   int       i;
+
+   jobs    = (REPLAYJOB *)malloc(nThreads * sizeof(REPLAYJOB));
+   threads = (pthread_t *)malloc(nThreads * sizeof(pthread_t));
+   if((jobs == NULL) || (threads == NULL))
+   {
+      free(jobs);
+      free(threads);
+      nThreads = 1;
+      jobs     = (REPLAYJOB *)malloc(sizeof(REPLAYJOB));
+      threads  = NULL;
+      if(jobs == NULL)
+      {
+         for(i=0; i<replay->nTotal; i++)
+         {
+            replay->status[i]  = RP_ERROR;
+            replay->latency[i] = 0.0;
+            replay->hits[i]    = 0;
+         }
+         return;
+      }
+   }
+
+   pthread_mutex_init(&(replay->lock), NULL);
+   replay->next = 0;
+   for(i=0; i<nThreads; i++)
+   {
+      memset(&(jobs[i]), 0, sizeof(REPLAYJOB));
+      jobs[i].replay = replay;
+      jobs[i].thread = i;
+   }
+
+   /* Thread 0 is this one; if a thread can't be started the others
+      take its share of the queries
+   */
+   for(i=1; i<nThreads; i++)
+   {
+      if(pthread_create(&(threads[i]), NULL, ReplayThread, &(jobs[i])))
+         jobs[i].thread = -1;
+   }
+   ReplayThread(&(jobs[0]));
+   for(i=1; i<nThreads; i++)
+   {
+      if(jobs[i].thread >= 0)
+         pthread_join(threads[i], NULL);
+   }
+   pthread_mutex_destroy(&(replay->lock));
+
+   free(jobs);
+   free(threads);
+}
+
+
+/************************************************************************/
+/*>static void *ReplayThread(void *arg)
+   ------------------------------------
+*//**
+   \param[in,out]  *arg   The REPLAYJOB for this thread
+   \return                NULL
+
+   Takes queries until there are none left, waiting until each is due
+
+-  18.10.26 Original   By: ACRM
+*/
+static void *ReplayThread(void *arg)
+{
+   REPLAYJOB       *job    = (REPLAYJOB *)arg;
+   REPLAY          *replay = job->replay;
+   QUERYREC        *query;
+   double          tStart,
+                   wait;
+   struct timespec ts;
+   int             i,
+                   hits;
+
+   while(1)
+   {
+      pthread_mutex_lock(&(replay->lock));
+      i = replay->next++;
+      pthread_mutex_unlock(&(replay->lock));
+      if(i >= replay->nTotal)
+         break;
+      query = replay->queries + (i % replay->nQueries);
+
+      if(replay->due != NULL)
+      {
+         tStart = replay->tStart + replay->due[i];
+         if((wait = tStart - StatsClock()) > 0.0)
+         {
+            ts.tv_sec  = (time_t)wait;
+            ts.tv_nsec = (long)((wait - (double)ts.tv_sec) * 1.0e9);
+            while(nanosleep(&ts, &ts))
+               ;
+         }
+      }
+      else
+      {
+         tStart = StatsClock();
+      }
+
+      if(replay->scanExe != NULL)
+         hits = RunScanloopdb(replay->scanExe, query);
+      else
+         hits = RunInProcess(job, replay->dbs[i % replay->nQueries],
+                             query);
+
+      replay->latency[i] = (StatsClock() - tStart) * 1000.0;
+      replay->hits[i]    = (hits >= 0)?hits:0;
+      replay->status[i]  = (hits >= 0)?RP_OK:
+                           ((hits == -RP_SKIPPED)?RP_SKIPPED:RP_ERROR);
+   }
+
+   free(job->hits);
+
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>BOOL OpenDatabases(REPLAY *replay)
+   ----------------------------------
+*//**
+   \param[in,out]  *replay   Replay; the database for each query is
+                             filled in
+   \return                   FALSE if no memory
+
+   Loads each database named in the log once. Queries whose database
+   can't be loaded are given a NULL database and fail when run.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL OpenDatabases(REPLAY *replay)
+{
+   int i, j;
+
+   if((replay->dbs = (LOOPDB **)calloc(replay->nQueries,
+                                       sizeof(LOOPDB *)))==NULL)
+      return(FALSE);
+
+   for(i=0; i<replay->nQueries; i++)
+   {
+      for(j=0; j<i; j++)
+      {
+         if(!strcmp(replay->queries[i].dbFile,
+                    replay->queries[j].dbFile))
+            break;
+      }
+      if(j < i)
+      {
+         replay->dbs[i] = replay->dbs[j];
+      }
+      else if((replay->dbs[i] = LoopDBOpen(replay->queries[i].dbFile,
+                                           NULL))==NULL)
+      {
+         fprintf(stderr,"Warning (replayloopdb): Unable to load \
+database %s\n", replay->queries[i].dbFile);
+      }
+   }
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>void CloseDatabases(REPLAY *replay)
+   -----------------------------------
+*//**
+   \param[in,out]  *replay   Replay
+
+   Frees the databases loaded by OpenDatabases()
+
+-  18.10.26 Original   By: ACRM
+*/
+void CloseDatabases(REPLAY *replay)
+{
+   int i, j;
+
+   if(replay->dbs == NULL)
+      return;
+
+   for(i=0; i<replay->nQueries; i++)
+   {
+      for(j=0; j<i; j++)
+      {
+         if(replay->dbs[j] == replay->dbs[i])
+            break;
+      }
+      if(j == i)
+         LoopDBClose(replay->dbs[i]);
+   }
+   free(replay->dbs);
+   replay->dbs = NULL;
+}
+
+
+/************************************************************************/
+/*>int RunInProcess(REPLAYJOB *job, LOOPDB *db, QUERYREC *query)
+   -------------------------------------------------------------
+*//**
+   \param[in,out]  *job     This thread's job (space for the hits)
+   \param[in]      *db      The query's database (NULL if it couldn't
+                            be loaded)
+   \param[in]      *query   The query
+   \return                  Number of hits kept (-RP_ERROR on error)
+
+   Scans the database with the recorded distance matrix, keeping the
+   -n best hits (or all of them) as scanloopdb would print. The
+   sidecar is not needed.
+
+-  18.10.26 Original   By: ACRM
+*/
+int RunInProcess(REPLAYJOB *job, LOOPDB *db, QUERYREC *query)
+{
+   LOOPDBQUERY q;
+   LOOPDBHIT   *hits;
+   long        maxHits;
+   int         i, j;
+
+   if((db == NULL) || (LoopDBStemSize(db) != query->nStem))
+      return(-RP_ERROR);
+
+   for(i=0; i<query->nStem; i++)
+   {
+      for(j=0; j<query->nStem; j++)
+         q.distMat[i][j] = query->distMat[i][j];
+   }
+   q.tolerance = query->tolerance;
+   q.loopLen   = query->loopLen;
+   q.nStem     = query->nStem;
+   q.shortList = 0;
+   q.haveStems = FALSE;
+
+   maxHits = LoopDBCandidates(db, query->loopLen);
+   if((query->numResult > 0) && (query->numResult < maxHits))
+      maxHits = query->numResult;
+   if(maxHits > job->maxHits)
+   {
+      if((hits = (LOOPDBHIT *)realloc(job->hits,
+                                      maxHits * sizeof(LOOPDBHIT)))
+         ==NULL)
+         return(-RP_ERROR);
+      job->hits    = hits;
+      job->maxHits = (int)maxHits;
+   }
+
+   if((i = LoopDBScan(db, &q, job->hits, (int)maxHits, NULL)) < 0)
+      return(-RP_ERROR);
+   return(i);
+}
+
+
+/************************************************************************/
+/*>int RunScanloopdb(char *scanExe, QUERYREC *query)
+   -------------------------------------------------
+*//**
+   \param[in]  *scanExe   scanloopdb program
+   \param[in]  *query     The query
+   \return                Number of hits printed (-RP_SKIPPED if the
+                          query was read from standard input,
+                          -RP_ERROR if scanloopdb couldn't be run or
+                          failed)
+
+   Runs scanloopdb for the query, counting the lines it prints
+
+-  18.10.26 Original   By: ACRM
+*/
+int RunScanloopdb(char *scanExe, QUERYREC *query)
+{
+   char    loopLen[16],
+           tolerance[32],
+           numResult[16],
+           buffer[MAXBUFF],
+           *args[16];
+   int     pipeFd[2],
+           nArgs = 0,
+           nLines = 0,
+           status,
+           devNull,
+           nRead,
+           i;
+   pid_t   pid;
+
+   if(query->query[0] == '\0')
+      return(-RP_SKIPPED);
+
+   sprintf(loopLen,   "%d",   query->loopLen);
+   sprintf(tolerance, "%.3f", query->tolerance);
+   sprintf(numResult, "%d",   query->numResult);
+   args[nArgs++] = scanExe;
+   args[nArgs++] = "-l";
+   args[nArgs++] = loopLen;
+   args[nArgs++] = "-t";
+   args[nArgs++] = tolerance;
+   args[nArgs++] = "-n";
+   args[nArgs++] = numResult;
+   args[nArgs++] = "-r";
+   args[nArgs++] = query->startRes;
+   args[nArgs++] = query->endRes;
+   if(query->sidecar[0])
+   {
+      args[nArgs++] = "-q";
+      args[nArgs++] = query->sidecar;
+   }
+   args[nArgs++] = query->dbFile;
+   args[nArgs++] = query->query;
+   args[nArgs]   = NULL;
+
+   if(pipe(pipeFd))
+      return(-RP_ERROR);
+
+   if((pid = fork()) < 0)
+   {
+      close(pipeFd[0]);
+      close(pipeFd[1]);
+      return(-RP_ERROR);
+   }
+
+   if(pid == 0)
+   {
+      /* The hits go to the pipe and any messages are discarded         */
+      close(pipeFd[0]);
+      dup2(pipeFd[1], 1);
+      close(pipeFd[1]);
+      if((devNull = open("/dev/null", O_WRONLY)) >= 0)
+      {
+         dup2(devNull, 2);
+         close(devNull);
+      }
+      execv(scanExe, args);
+      _exit(127);
+   }
+
+   close(pipeFd[1]);
+   while((nRead = read(pipeFd[0], buffer, MAXBUFF)) > 0)
+   {
+      for(i=0; i<nRead; i++)
+      {
+         if(buffer[i] == '\n')
+            nLines++;
+      }
+   }
+   close(pipeFd[0]);
+
+   if((waitpid(pid, &status, 0) != pid) ||
+      !WIFEXITED(status) || WEXITSTATUS(status))
+      return(-RP_ERROR);
+   return(nLines);
+}
+
+
+/************************************************************************/
+/*>BOOL WriteReplayReport(char *outFile, REPLAY *replay, int nThreads,
+                          REAL rate, REAL speed, double wallTime)
+   -------------------------------------------------------------------
+*//**
+   \param[in]  *outFile    File to append to (blank for stdout)
+   \param[in]  *replay     Completed replay
+   \param[in]  nThreads    Number of threads
+   \param[in]  rate        Queries per second (0 = not used)
+   \param[in]  speed       Speed up of the recorded times (0 = not
+                           used)
+   \param[in]  wallTime    Elapsed time of the replay
+   \return                 Success
+
+   Writes a single line JSON object with the throughput and the
+   latencies of the queries that succeeded. Percentiles are by the
+   nearest rank.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL WriteReplayReport(char *outFile, REPLAY *replay, int nThreads,
+                       REAL rate, REAL speed, double wallTime)
+{
+   static double pcts[3] = {50.0, 95.0, 99.0};
+   static char   *pctNames[3] = {"p50", "p95", "p99"};
+   double *latency,
+          sum  = 0.0;
+   long   hits = 0;
+   int    nOK  = 0,
+          nErrors  = 0,
+          nSkipped = 0,
+          rank,
+          i;
+   FILE   *fp = stdout;
+
+   if((latency = (double *)malloc(replay->nTotal * sizeof(double)))
+      ==NULL)
+      return(FALSE);
+   for(i=0; i<replay->nTotal; i++)
+   {
+      switch(replay->status[i])
+      {
+      case RP_OK:
+         latency[nOK++] = replay->latency[i];
+         sum  += replay->latency[i];
+         hits += replay->hits[i];
+         break;
+      case RP_SKIPPED:
+         nSkipped++;
+         break;
+      default:
+         nErrors++;
+         break;
+      }
+   }
+   if(nOK)
+      qsort(latency, nOK, sizeof(double), cmpDoubles);
+
+   if(outFile[0] && ((fp = fopen(outFile, "a"))==NULL))
+   {
+      free(latency);
+      return(FALSE);
+   }
+
+   fprintf(fp, "{\"program\": \"replayloopdb\", \"version\": \"1.1\", ");
+   fprintf(fp, "\"engine\": \"%s\", \"threads\": %d, ",
+           (replay->scanExe != NULL)?"scanloopdb":"in_process",
+           nThreads);
+   fprintf(fp, "\"schedule\": \"%s\", \"rate\": %.3f, \"speed\": %.3f, ",
+           (rate > 0.0)?"rate":((speed > 0.0)?"recorded":"back_to_back"),
+           rate, speed);
+   fprintf(fp, "\"queries\": %d, \"completed\": %d, \"errors\": %d, \
+\"skipped\": %d, ", replay->nTotal, nOK, nErrors, nSkipped);
+   fprintf(fp, "\"wall_seconds\": %.6f, \"throughput_qps\": %.3f, ",
+           wallTime, (wallTime > 0.0)?(double)nOK / wallTime:0.0);
+   fprintf(fp, "\"latency_ms\": {");
+   if(nOK)
+   {
+      fprintf(fp, "\"min\": %.3f, \"mean\": %.3f, ", latency[0],
+              sum / nOK);
+      for(i=0; i<3; i++)
+      {
+         rank = (int)ceil(pcts[i] / 100.0 * nOK);
+         rank = MAX(rank, 1);
+         fprintf(fp, "\"%s\": %.3f, ", pctNames[i], latency[rank-1]);
+      }
+      fprintf(fp, "\"max\": %.3f", latency[nOK-1]);
+   }
+   fprintf(fp, "}, \"hits\": %ld}\n", hits);
+
+   free(latency);
+   if(fp != stdout)
+      return(fclose(fp) == 0);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static int cmpDoubles(const void *p1, const void *p2)
+   -----------------------------------------------------
+*//**
+   \param[in]  *p1    Pointer to first double
+   \param[in]  *p2    Pointer to second double
+   \return            -1, 0 or 1 for ascending order
+
+   Comparison routine used by qsort()
+
+-  18.10.26 Original   By: ACRM
+*/
+static int cmpDoubles(const void *p1, const void *p2)
+{
+   double d1 = *(double *)p1,
+          d2 = *(double *)p2;
+
+   if(d1 < d2)
+      return(-1);
+   if(d1 > d2)
+      return(1);
+   return(0);
+}
@@ -0,0 +1,495 @@
+/************************************************************************/
+/**
+
+   \file       runstats.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Timing and reporting helpers for the --stats options
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Small helpers shared by buildloopdb and scanloopdb for their --stats
+   reports: a monotonic clock for timing phases, the peak memory use of
+   the process and writing strings into the JSON reports.
+
+   For --counters, the phases can also be bracketed by reads of the
+   hardware performance counters (cycles, instructions, cache
+   references and misses, branches and branch misses) using Linux
+   perf_event_open(). The counters are opened as a single group for
+   the calling thread, counting user space only, so one read() gives
+   them all. They are inherited by the threads that it starts later
+   (the analysis threads of buildloopdb and the model writing threads
+   of scanloopdb) whose counts are included in each read. A kernel too
+   old to read an inherited group gets counters for the calling thread
+   only; HWCountersAllThreads() tells the programs so that they can
+   warn. If they can't be opened (another OS, no PMU in a virtual
+   machine, or perf_event_paranoid too high) the phases are just timed
+   and the counters are reported as null.
+
+   The programs only call these when --stats or --counters is given so
+   that the normal paths are unaffected.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#define _POSIX_C_SOURCE 200112L
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "bioplib/SysDefs.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+
+/************************************************************************/
+/* Globals
+*/
+static int sHWFd[HW_NEVENTS]  = {-1, -1, -1, -1, -1, -1};
+static int sHWSlot[HW_NEVENTS];  /* Position of each event in a read   */
+static int sHWNOpen           = 0;
+static BOOL sHWInherit        = FALSE; /* Inherited by new threads     */
+
+/************************************************************************/
+/* Prototypes
+*/
+static int OpenCounterGroup(BOOL inherit);
+
+
+/************************************************************************/
+/*>double StatsClock(void)
+   -----------------------
+*//**
+   \return     Seconds from an arbitrary fixed point
+
+   Monotonic clock for timing phases. Unlike time() it has sub-second
+   resolution and unlike clock() it counts time spent waiting for I/O.
+
+-  18.10.26 Original   By: ACRM
+*/
+double StatsClock(void)
+{
+   struct timespec ts;
+
+   if(clock_gettime(CLOCK_MONOTONIC, &ts))
+      return((double)time(NULL));
+   return((double)ts.tv_sec + (double)ts.tv_nsec / 1.0e9);
+}
+
+
+/************************************************************************/
+/*>long StatsPeakMemory(void)
+   --------------------------
+*//**
+   \return     Peak resident memory of the process in kilobytes (0 if
+               not available)
+
+   Uses the high-water mark kept by the kernel so it needn't be
+   sampled.
+
+-  18.10.26 Original   By: ACRM
+*/
+long StatsPeakMemory(void)
+{
+   struct rusage ru;
+
+   if(getrusage(RUSAGE_SELF, &ru))
+      return(0);
+   return((long)ru.ru_maxrss);
+}
+
+
+/************************************************************************/
+/*>void StatsPrintString(FILE *fp, char *string)
+   ---------------------------------------------
+*//**
+   \param[in]   *fp       Output file
+   \param[in]   *string   String to write
+
+   Writes a string as a quoted JSON string, escaping quotes,
+   backslashes and control characters
+
+-  18.10.26 Original   By: ACRM
+*/
+void StatsPrintString(FILE *fp, char *string)
+{
+   char *chp;
+
+   fputc('"', fp);
+   for(chp=string; *chp; chp++)
+   {
+      if((*chp == '"') || (*chp == '\\'))
+         fprintf(fp, "\\%c", *chp);
+      else if((unsigned char)*chp < ' ')
+         fprintf(fp, "\\u%04x", (unsigned char)*chp);
+      else
+         fputc(*chp, fp);
+   }
+   fputc('"', fp);
+}
+
+
+/************************************************************************/
+/*>int HWCountersOpen(void)
+   ------------------------
+*//**
+   \return     Number of hardware counters that could be opened (0 if
+               none are available)
+
+   Opens the hardware counters as a group led by the cycle counter and
+   starts them. Events that the CPU doesn't support are left out; if
+   the group can't be scheduled at all, none are used. The group is
+   inherited by threads started later if the kernel allows it.
+
+-  18.10.26 Original   By: ACRM
+*/
+int HWCountersOpen(void)
+{
+#ifdef __linux__
+   HWCOUNTS test;
+
+   if(sHWNOpen)
+      return(sHWNOpen);
+
+   /* Older kernels can't read an inherited group                       */
+   if(!OpenCounterGroup(TRUE) && !OpenCounterGroup(FALSE))
+      return(0);
+
+   ioctl(sHWFd[HW_CYCLES], PERF_EVENT_IOC_RESET,  PERF_IOC_FLAG_GROUP);
+   ioctl(sHWFd[HW_CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+
+   /* A group that is never scheduled counts nothing                    */
+   HWCountersRead(&test);
+   if(test.count[HW_CYCLES] < 0.0)
+      HWCountersClose();
+   
+   return(sHWNOpen);
+#else
+   return(0);
+#endif
+}
+
+
+/************************************************************************/
+/*>static int OpenCounterGroup(BOOL inherit)
+   -----------------------------------------
+*//**
+   \param[in]  inherit   Count the threads started after opening
+   \return               Number of counters opened (0 if the group
+                         leader could not be opened)
+
+   Opens the counter group for HWCountersOpen(), disabled
+
+-  18.10.26 Original, from HWCountersOpen()   By: ACRM
+*/
+static int OpenCounterGroup(BOOL inherit)
+{
+#ifdef __linux__
+   static unsigned long config[HW_NEVENTS] =
+   {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_REFERENCES,
+      PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+      PERF_COUNT_HW_BRANCH_MISSES
+   };
+   struct perf_event_attr attr;
+   int      i;
+
+   for(i=0; i<HW_NEVENTS; i++)
+   {
+      memset(&attr, 0, sizeof(attr));
+      attr.type           = PERF_TYPE_HARDWARE;
+      attr.size           = sizeof(attr);
+      attr.config         = config[i];
+      attr.read_format    = PERF_FORMAT_GROUP |
+                            PERF_FORMAT_TOTAL_TIME_RUNNING;
+      attr.disabled       = (i == 0);
+      attr.inherit        = (inherit ? 1 : 0);
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+
+      sHWFd[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1,
+                              (i == 0) ? -1 : sHWFd[HW_CYCLES], 0);
+      if(sHWFd[i] < 0)
+      {
+         /* Without the leader there is no group                        */
+         if(i == 0)
+            return(0);
+         sHWFd[i] = -1;
+      }
+      else
+      {
+         sHWSlot[i] = sHWNOpen++;
+      }
+   }
+   sHWInherit = inherit;
+
+   return(sHWNOpen);
+#else
+   return(0);
+#endif
+}
+
+
+/************************************************************************/
+/*>BOOL HWCountersAllThreads(void)
+   -------------------------------
+*//**
+   \return     Do the open counters include the threads started after
+               HWCountersOpen()?
+
+   Tells a program using several threads whether the counters cover
+   all of them or only the thread that opened them
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL HWCountersAllThreads(void)
+{
+   return(sHWNOpen && sHWInherit);
+}
+
+
+/************************************************************************/
+/*>void HWCountersClose(void)
+   --------------------------
+*//**
+   Closes the hardware counters
+
+-  18.10.26 Original   By: ACRM
+*/
+void HWCountersClose(void)
+{
+   int i;
+
+   for(i=0; i<HW_NEVENTS; i++)
+   {
+      if(sHWFd[i] >= 0)
+         close(sHWFd[i]);
+      sHWFd[i] = -1;
+   }
+   sHWNOpen   = 0;
+   sHWInherit = FALSE;
+}
+
+
+/************************************************************************/
+/*>void HWCountersRead(HWCOUNTS *hw)
+   ---------------------------------
+*//**
+   \param[out]  *hw    Current counts (-1 for events that aren't 
+                       available)
+
+   Reads the totals of all the counters with a single read()
+
+-  18.10.26 Original   By: ACRM
+*/
+void HWCountersRead(HWCOUNTS *hw)
+{
+   int i;
+#ifdef __linux__
+   __u64 buffer[2+HW_NEVENTS];
+
+   if(sHWNOpen &&
+      (read(sHWFd[HW_CYCLES], buffer, sizeof(buffer)) >=
+       (long)((2+sHWNOpen) * sizeof(__u64))) &&
+      (buffer[1] != 0))
+   {
+      /* buffer[0] is the number of events and buffer[1] the time the
+         group has been running
+      */
+      for(i=0; i<HW_NEVENTS; i++)
+         hw->count[i] = (sHWFd[i] < 0) ? -1.0 : 
+                                         (double)buffer[2+sHWSlot[i]];
+      return;
+   }
+#endif
+   for(i=0; i<HW_NEVENTS; i++)
+      hw->count[i] = -1.0;
+}
+
+
+/************************************************************************/
+/*>void StatsMark(PHASESTATS *ps, STATSMARK *mark)
+   -----------------------------------------------
+*//**
+   \param[in]   *ps      Phase statistics
+   \param[out]  *mark    The start of a phase
+
+   Records the time (and counters if they are in use) at the start of
+   a phase
+
+-  18.10.26 Original   By: ACRM
+*/
+void StatsMark(PHASESTATS *ps, STATSMARK *mark)
+{
+   if(ps->counters)
+      HWCountersRead(&(mark->hw));
+   mark->t = StatsClock();
+}
+
+
+/************************************************************************/
+/*>void StatsPhase(PHASESTATS *ps, STATSMARK *mark, int phase)
+   -----------------------------------------------------------
+*//**
+   \param[in,out] *ps      Phase statistics
+   \param[in,out] *mark    Start of the phase; reset to now so that the
+                           next phase can follow on
+   \param[in]     phase    Phase to which the time is added
+
+   Adds the time (and counts) since the mark to a phase, both in the
+   totals and in those for the current file or query.
+
+-  18.10.26 Original   By: ACRM
+*/
+void StatsPhase(PHASESTATS *ps, STATSMARK *mark, int phase)
+{
+   double   now,
+            delta;
+   HWCOUNTS hw;
+   int      i;
+
+   now = StatsClock();
+   ps->time[phase]     += now - mark->t;
+   ps->itemTime[phase] += now - mark->t;
+   mark->t              = now;
+
+   if(ps->counters)
+   {
+      HWCountersRead(&hw);
+      for(i=0; i<HW_NEVENTS; i++)
+      {
+         if((hw.count[i] >= 0.0) && (mark->hw.count[i] >= 0.0))
+         {
+            delta = hw.count[i] - mark->hw.count[i];
+            ps->hw[phase].count[i]     += delta;
+            ps->itemHw[phase].count[i] += delta;
+         }
+      }
+      /* Counting up to here includes the clock and read overheads      */
+      mark->hw = hw;
+   }
+}
+
+
+/************************************************************************/
+/*>void StatsResetItem(PHASESTATS *ps)
+   -----------------------------------
+*//**
+   \param[in,out] *ps      Phase statistics
+
+   Clears the statistics for the current file or query
+
+-  18.10.26 Original   By: ACRM
+*/
+void StatsResetItem(PHASESTATS *ps)
+{
+   memset(ps->itemTime, 0, sizeof(ps->itemTime));
+   memset(ps->itemHw,   0, sizeof(ps->itemHw));
+}
+
+
+/************************************************************************/
+/*>void StatsPrintPhases(FILE *fp, PHASESTATS *ps, char **names, 
+                         int nPhases, BOOL item)
+   --------------------------------------------------------------
+*//**
+   \param[in]   *fp       Output file
+   \param[in]   *ps       Phase statistics
+   \param[in]   **names   Name of each phase
+   \param[in]   nPhases   Number of phases
+   \param[in]   item      Print the current file or query rather than
+                          the totals
+
+   Prints the counters for each phase as a JSON object of objects, e.g.
+   {"read": {"seconds": 0.1, "cycles": 123, ...}, ...}. Counters that
+   aren't available are null and the instructions per cycle are added
+   when they are both known.
+
+-  18.10.26 Original   By: ACRM
+*/
+void StatsPrintPhases(FILE *fp, PHASESTATS *ps, char **names, 
+                      int nPhases, BOOL item)
+{
+   static char *hwNames[HW_NEVENTS] =
+   {
+      "cycles", "instructions", "cache_references", "cache_misses",
+      "branches", "branch_misses"
+   };
+   HWCOUNTS *hw;
+   int      i, j;
+
+   fprintf(fp, "{");
+   for(i=0; i<nPhases; i++)
+   {
+      hw = item ? &(ps->itemHw[i]) : &(ps->hw[i]);
+      fprintf(fp, "%s\"%s\": {\"seconds\": %.6f", i?", ":"", names[i],
+              item ? ps->itemTime[i] : ps->time[i]);
+      for(j=0; j<HW_NEVENTS; j++)
+      {
+         if(sHWFd[j] < 0)
+            fprintf(fp, ", \"%s\": null", hwNames[j]);
+         else
+            fprintf(fp, ", \"%s\": %.0f", hwNames[j], hw->count[j]);
+      }
+      if((sHWFd[HW_CYCLES] >= 0) && (sHWFd[HW_INSTRUCTIONS] >= 0) &&
+         (hw->count[HW_CYCLES] > 0.0))
+         fprintf(fp, ", \"ipc\": %.3f", 
+                 hw->count[HW_INSTRUCTIONS] / hw->count[HW_CYCLES]);
+      else
+         fprintf(fp, ", \"ipc\": null");
+      fprintf(fp, "}");
+   }
+   fprintf(fp, "}");
+}
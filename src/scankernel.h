@@ -0,0 +1,124 @@
+/************************************************************************/
+/**
+
+   \file       scankernel.h
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Record scoring kernel for libloopdb
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+   Description:
+   ============
+   This is a template rather than an ordinary header. libloopdb.c
+   includes it once for each supported stem size with
+   STEM_K defined to that size, giving a ScoreStems2(), ScoreStems3(),
+   ... each with the loop bounds fixed at compile time so that the
+   compiler can unroll them.
+
+**************************************************************************
+
+   Usage:
+   ======
+   #define STEM_K 3
+   #include "scankernel.h"
+   #undef STEM_K
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+#ifndef STEM_K
+#error "Define STEM_K before including scankernel.h"
+#endif
+
+#ifndef STEM_KERNEL
+#define STEM_PASTE2(a, b) a##b
+#define STEM_PASTE(a, b)  STEM_PASTE2(a, b)
+#define STEM_KERNEL(name) STEM_PASTE(name, STEM_K)
+#endif
+
+/************************************************************************/
+/*>static BOOL ScoreStemsK(char *distances, 
+                           REAL distMat[MAXSTEM][MAXSTEM], 
+                           REAL tolerance, REAL *score,
+                           int *failCell)
+   ------------------------------------------------------------------
+*//**
+   \param[in]   *distances  The distance fields of a database record
+   \param[in]   distMat     Distance matrix from our structure
+   \param[in]   tolerance   Allowed tolerance for an individual distance
+   \param[out]  *score      Sum of the differences
+   \param[out]  *failCell   If the record is rejected, the distance
+                            (i*STEM_K+j) that was out of range or -1
+                            if the distances could not be read
+   \return                  All STEM_K*STEM_K distances were read and
+                            are within the tolerance
+
+   Reads the distances of a record one at a time, comparing each with
+   the query, so that the rest of the record needn't be read once one
+   is out of range.
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL STEM_KERNEL(ScoreStems)(char *distances, 
+                                    REAL distMat[MAXSTEM][MAXSTEM],
+                                    REAL tolerance, REAL *score,
+                                    int *failCell)
+{
+   char *end;
+   REAL d,
+        badness;
+   int  i, j;
+
+   *score = 0.0;
+   for(i=0; i<STEM_K; i++)
+   {
+      for(j=0; j<STEM_K; j++)
+      {
+         d = (REAL)strtod(distances, &end);
+         if(end == distances)
+         {
+            *failCell = -1;
+            return(FALSE);
+         }
+         distances = end;
+
+         badness = ABS(distMat[i][j] - d);
+         if(badness > tolerance)
+         {
+            *failCell = i*STEM_K + j;
+            return(FALSE);
+         }
+         *score += badness;
+      }
+   }
+   return(TRUE);
+}
@@ -3,11 +3,11 @@
 
    \file       scanloopdb.c
    
-   \version    V1.1
-   \date       17.07.15
+   \version    V1.14
+   \date       18.10.26
    \brief      Scan a structure against the loop database
    
-   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
    \author     Dr. Andrew C. R. Martin
    \par
                Institute of Structural & Molecular Biology,
@@ -47,10 +47,33 @@
    =================
    V1.0   16.07.15  Original   By: ACRM
    V1.1   17.07.15  Added -l to allow loop length to be specified
+   V1.2   18.10.26  Added -q to use a quantized filter sidecar
+   V1.3   18.10.26  Added -C and -g for a cache of query results
+   V1.4   18.10.26  Added -c and -M to rerank the best hits by the RMSD
+                    of the takeoff residues after superposition
+   V1.5   18.10.26  Added -s and -j to write models with the hits
+                    spliced into the framework
+   V1.6   18.10.26  Handles databases built with 2- to 5-residue stems
+   V1.7   18.10.26  Added --stats to write a line of timings and 
+                    counters for each query
+   V1.8   18.10.26  Added --counters to read the hardware performance
+                    counters for each phase of a query
+   V1.9   18.10.26  Added --reference to scan with the straightforward
+                    reference implementation for differential testing
+   V1.10  18.10.26  Added --log to record the queries for replayloopdb
+   V1.11  18.10.26  The query distances and RMSDs are calculated by
+                    libloopdb
+   V1.12  18.10.26  Added --resolution, --rfactor, --xray and --nonmr
+                    for databases built with the experimental details
+   V1.13  18.10.26  Added --diverse and --diversetop to keep only the
+                    best hit from each cluster of similar hits
+   V1.14  18.10.26  The scan engines and ranking moved into libloopdb.
+                    Options are held in a SCANOPTS
 
 *************************************************************************/
 /* Includes
 */
+#define _POSIX_C_SOURCE 200112L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -58,10 +81,12 @@
 #include <dirent.h>
 #include <time.h>
 #include <math.h>
+#include <unistd.h>
 
 #include "bioplib/pdb.h"
 #include "bioplib/general.h"
 #include "bioplib/macros.h"
+#include "loopdb.h"
 
 /************************************************************************/
 /* Defines and macros
@@ -72,37 +97,107 @@
 #define DEF_TOLERANCE 1.0
 #define DEF_STARTRES  "H95"
 #define DEF_ENDRES    "H102"
-
-typedef struct _loop
+#define DEF_SHORTLIST 100
+#define DEF_DIVERSETOP 200
+#define DIV_ALLOCQUANTUM 64
+
+/* Phases timed for --stats and --counters                             */
+#define SP_QUERY   0
+#define SP_SCAN    1
+#define SP_SORT    2
+#define SP_PRINT   3
+#define SP_MODELS  4
+#define NSCANPHASE 5
+
+/* Time a phase for --stats and --counters                              */
+#define STATS_START(s, m)                                                \
+   do { if((s) != NULL) StatsMark(&((s)->phases), &(m)); }               \
+   while(0)
+#define STATS_STOP(s, m, phase)                                          \
+   do { if((s) != NULL) StatsPhase(&((s)->phases), &(m), phase); }      \
+   while(0)
+
+typedef struct
+{
+   char infile[MAXBUFF],       /* Query PDB file (blank for stdin)      */
+        outfile[MAXBUFF],      /* Output file (blank for stdout)        */
+        dbFile[MAXBUFF],       /* Database to search                    */
+        qfFile[MAXBUFF],       /* Quantized filter sidecar (or blank)   */
+        cacheDir[MAXBUFF],     /* Query cache directory (or blank)      */
+        coordsFile[MAXBUFF],   /* Loop coordinate file (or blank)       */
+        splicePrefix[MAXBUFF], /* Prefix for spliced models (or blank)  */
+        statsFile[MAXBUFF],    /* --stats file (or blank)               */
+        countersFile[MAXBUFF], /* --counters file (or blank)            */
+        logFile[MAXBUFF],      /* --log file (or blank)                 */
+        startRes[SMALLBUFF],   /* The loop in the query                 */
+        endRes[SMALLBUFF];
+   REAL tolerance,             /* Max deviation on an individual distance*/
+        grid,                  /* Grid for rounding cache keys          */
+        diverse;               /* Distance for clustering hits (0 = off)*/
+   int  numResult,             /* Number of results to print (0 = all)  */
+        loopLen,               /* Loop length (0 = as in the query)     */
+        shortList,             /* Number of hits to rerank by RMSD      */
+        nThreads,              /* Threads for writing models (0 = one
+                                  per processor)                        */
+        diverseTop;            /* Number of best hits to cluster        */
+   BOOL reference;             /* Use the reference implementation      */
+   EXPTLFILTER filter;         /* Experimental filters                  */
+}  SCANOPTS;
+
+/* A hit being clustered by DiversifyLoops()                            */
+typedef struct
 {
-   struct _loop *next;
-   char pdbcode[SMALLBUFF],
-        startRes[SMALLBUFF],
-        endRes[SMALLBUFF],
-        buffer[MAXBUFF];
-   REAL score;
-}  LOOP;
+   LOOP  *loop;
+   BBRES *res;                 /* Coordinates (NULL if not available)   */
+   REAL  distMat[MAXSTEM][MAXSTEM];
+   int   loopLen,              /* -1 if the record could not be read    */
+         nRes;
+}  DIVHIT;
+
+typedef struct
+{
+   double tStart;      /* When the query started                        */
+   PHASESTATS phases;  /* Time (and counters) in each phase             */
+   LOOPDBSTATS scan;   /* Records read, rejected and matched by the
+                          scan, time checking distances (part of
+                          SP_SCAN; only the clock is read for each
+                          record), use of the sidecar and cache         */
+   long   nExptl,      /* Hits rejected by the experimental filters     */
+          nSimilar;    /* Hits dropped by --diverse                     */
+   int    nThreads;    /* Threads writing the models                    */
+}  SCANSTATS;
 
 
 /************************************************************************/
 /* Globals
 */
+static char *sScanPhases[NSCANPHASE] = 
+{
+   "read_query", "scan", "sort", "print", "models"
+};
 
 /************************************************************************/
 /* Prototypes
 */
 int  main(int argc, char **argv);
-BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
-                  char *dbFile, REAL *tolerance, char *startRes, 
-                  char *endRes, int *numResult, int *loopLen);
+BOOL ParseCmdLine(int argc, char **argv, SCANOPTS *opts);
 void Usage(void);
-LOOP *FindLoops(PDB *pdb, char *startRes, char *endRes, FILE *dbf, 
-                REAL tolerance, int loopLen);
-BOOL PrintLoops(FILE *out, LOOP *loops, int maxLoops);
-LOOP *ScanMatrix(REAL distMat[3][3], int LoopLen, FILE *dbf, 
-                 REAL tolerance);
-static int cmpResults(const void *p1, const void *p2);
-LOOP **IndexResults(LOOP *loops, int *nLoops);
+LOOP *FindLoops(PDB *pdb, SCANOPTS *opts, LOOPDBFILE *file, int nStem,
+                LOOPDBQUERY *query, SCANSTATS *stats, QUERYREC *log);
+void PrintLoops(FILE *out, LOOP **indx, int nLoops, BOOL withRMSD);
+int  SpliceLoops(PDB *framework, char *startRes, char *endRes,
+                 LOOP **indx, int nLoops, LOOPCOORDS *lc,
+                 SUPATOMS *frameStems, char *prefix, int nThreads);
+LOOP *FilterLoops(LOOP *loops, int nStem, EXPTLFILTER *filter,
+                  SCANSTATS *stats);
+int  DiversifyLoops(LOOP **indx, int nLoops, int nTop, int nWanted,
+                    REAL dist, int nStem, LOOPCOORDS *lc,
+                    SCANSTATS *stats);
+static BOOL SimilarHits(DIVHIT *hit1, DIVHIT *hit2, int nStem, REAL dist,
+                        BOOL withCoords);
+BOOL WriteScanStats(SCANOPTS *opts, int nStem, int nHits, int nPrinted,
+                    SCANSTATS *stats);
+BOOL WriteScanCounters(SCANOPTS *opts, SCANSTATS *stats);
 
 
 /************************************************************************/
@@ -113,49 +208,253 @@ LOOP **IndexResults(LOOP *loops, int *nLoops);
 
 -  14.07.15 Original   By: ACRM
 -  17.07.15 Handles loop length
+-  18.10.26 Added quantized filter sidecar and query cache
+-  18.10.26 Added RMSD reranking using the loop coordinate file
+-  18.10.26 Keeps the full framework to write spliced models
+-  18.10.26 Reads the stem size from the database header
+-  18.10.26 Added --stats
+-  18.10.26 Added --counters
+-  18.10.26 Added --reference
+-  18.10.26 Added --log
+-  18.10.26 Added --diverse
+-  18.10.26 Logs -n as given rather than the number of hits printed
+-  18.10.26 --stats gives the loop length used
+-  18.10.26 Options are held in a SCANOPTS. The scan and ranking are
+            done by libloopdb
+-  18.10.26 Warns if the counters can't follow the model threads
 */
 int main(int argc, char **argv)
 {
-   char infile[MAXBUFF],
-        outfile[MAXBUFF],
-        dbFile[MAXBUFF],
-        startRes[SMALLBUFF],
-        endRes[SMALLBUFF];
    int  natoms,
-        numResult = 0,
-        loopLen = 0;
-   REAL tolerance = DEF_TOLERANCE;
-   LOOP *loops    = NULL;
-   PDB  *pdb      = NULL;
+        nRes      = 0,
+        nLoops    = 0,
+        nHits     = 0,
+        nPrinted  = 0,
+        nStem     = NSTEM;
+   BOOL filtered;
+   SCANOPTS   opts;
+   LOOPDBFILE file;
+   LOOPDBQUERY query;
+   LOOP *loops    = NULL,
+        **indx    = NULL;
+   PDB  *pdb      = NULL,
+        *framework = NULL;
+   QFILTER *qf    = NULL;
+   LOOPCOORDS *lc = NULL;
+   BBRES *backbone = NULL;
+   SCANSTATS stats,
+             *pStats = NULL;
+   STATSMARK mark;
+   QUERYREC  logRec,
+             *pLog = NULL;
    FILE *in       = stdin,
         *out      = stdout,
         *dbf      = NULL;
 
 
-   if(!ParseCmdLine(argc, argv, infile, outfile, dbFile, &tolerance, 
-                    startRes, endRes, &numResult, &loopLen))
+   if(!ParseCmdLine(argc, argv, &opts))
    {
       Usage();
       return(0);
    }
    else
    {
-      if(blOpenStdFiles(infile, outfile, &in, &out))
+      if(opts.reference && (opts.qfFile[0] || opts.cacheDir[0]))
+      {
+         fprintf(stderr,"--reference cannot be used with -q or -C\n");
+         return(1);
+      }
+
+      /* Nothing is logged unless FindLoops() gets as far as the query */
+      memset(&logRec, 0, sizeof(QUERYREC));
+      if(opts.logFile[0])
       {
-         if((dbf = fopen(dbFile, "r"))!=NULL)
+         logRec.time = QueryLogTime();
+         pLog        = &logRec;
+      }
+
+      if(opts.statsFile[0] || opts.countersFile[0])
+      {
+         memset(&stats, 0, sizeof(SCANSTATS));
+         stats.tStart = StatsClock();
+         pStats       = &stats;
+
+         /* As SpliceLoops(), which is the only part using threads     */
+         stats.nThreads = 1;
+         if(opts.splicePrefix[0])
          {
+            if((stats.nThreads = opts.nThreads) < 1)
+            {
+               long nCPU = sysconf(_SC_NPROCESSORS_ONLN);
+               stats.nThreads = (nCPU > 0)?(int)nCPU:1;
+            }
+         }
+      }
+      if(opts.countersFile[0] &&
+         !(stats.phases.counters = (HWCountersOpen() > 0)))
+      {
+         fprintf(stderr,"Warning: Hardware counters are not available; \
+only times will be\n");
+         fprintf(stderr,"         reported\n");
+      }
+      else if(opts.countersFile[0] && (stats.nThreads > 1) &&
+              !HWCountersAllThreads())
+      {
+         fprintf(stderr,"Warning: Hardware counters only count the main \
+thread; use -j 1\n");
+         fprintf(stderr,"         to count all the model writing\n");
+      }
+
+
+      if(blOpenStdFiles(opts.infile, opts.outfile, &in, &out))
+      {
+         if((dbf = fopen(opts.dbFile, "r"))!=NULL)
+         {
+            if((nStem = ReadDBStemSize(dbf))==0)
+            {
+               fprintf(stderr,"Database has an unsupported stem size\n");
+               return(1);
+            }
+
+            filtered = opts.filter.xray || opts.filter.noNMR ||
+                       (opts.filter.maxResolution > 0.0) ||
+                       (opts.filter.maxRFactor > 0.0);
+            if(filtered && !ReadDBExptl(dbf))
+            {
+               fprintf(stderr,"Database has no experimental details. \
+Build it with\n");
+               fprintf(stderr,"buildloopdb --exptl to use --xray, \
+--nonmr, --resolution or --rfactor\n");
+               return(1);
+            }
+
+            if(opts.qfFile[0] &&
+               ((qf = OpenQFilter(opts.qfFile, dbf))!=NULL) &&
+               (qf->header->nStem != nStem))
+            {
+               CloseQFilter(qf);
+               qf = NULL;
+            }
+            if(opts.qfFile[0] && (qf == NULL))
+            {
+               fprintf(stderr,"Warning: Sidecar %s missing or does not \
+match the database.\n", opts.qfFile);
+               fprintf(stderr,"         Scanning the full database.\n");
+            }
+
+            if(opts.coordsFile[0] &&
+               ((lc = OpenLoopCoords(opts.coordsFile, dbf))!=NULL) &&
+               (lc->header->nStem != nStem))
+            {
+               CloseLoopCoords(lc);
+               lc = NULL;
+            }
+            if(opts.coordsFile[0] && (lc == NULL))
+            {
+               fprintf(stderr,"Warning: Coordinate file %s missing or \
+does not match the\n", opts.coordsFile);
+               fprintf(stderr,"         database. Hits will not be \
+reranked by RMSD.\n");
+            }
+
+            if(opts.splicePrefix[0] && (lc == NULL))
+            {
+               fprintf(stderr,"Warning: Models can only be written \
+using a loop coordinate\n");
+               fprintf(stderr,"         file (-c)\n");
+               opts.splicePrefix[0] = '\0';
+            }
+
+            file.dbf       = dbf;
+            file.dbFile    = opts.dbFile;
+            file.cacheDir  = opts.cacheDir;
+            file.qf        = qf;
+            file.grid      = opts.grid;
+            file.reference = opts.reference;
+
+            STATS_START(pStats, mark);
             if((pdb = blReadPDBAtoms(in, &natoms))!=NULL)
             {
-               if((pdb = blSelectCaPDB(pdb))!=NULL)
+               /* Keep the backbone for fitting the stems               */
+               if((lc != NULL) &&
+                  ((backbone = ExtractBackbone(pdb, &nRes))==NULL))
+               {
+                  fprintf(stderr,"No memory for backbone\n");
+                  return(1);
+               }
+
+               /* Keep the full framework for splicing in the hits      */
+               if(opts.splicePrefix[0])
+               {
+                  framework = pdb;
+                  if((pdb = blDupePDB(framework))==NULL)
+                  {
+                     fprintf(stderr,"No memory for framework\n");
+                     return(1);
+                  }
+               }
+
+               pdb = blSelectCaPDB(pdb);
+               STATS_STOP(pStats, mark, SP_QUERY);
+
+               if(pdb != NULL)
                {
-                  if((loops = FindLoops(pdb, startRes, endRes, dbf, 
-                                        tolerance, loopLen))!=NULL)
+                  loops = FindLoops(pdb, &opts, &file, nStem, &query,
+                                    pStats, pLog);
+                  if(filtered)
+                     loops = FilterLoops(loops, nStem, &(opts.filter),
+                                         pStats);
+                  if(loops != NULL)
                   {
-                     if(!PrintLoops(out, loops, numResult))
+                     if((lc != NULL) &&
+                        !LoopDBQueryStems(&query, backbone, nRes))
+                     {
+                        fprintf(stderr,"Warning: Takeoff residues not \
+found. Hits will not\n");
+                        fprintf(stderr,"         be reranked by \
+RMSD.\n");
+                        CloseLoopCoords(lc);
+                        lc = NULL;
+                     }
+
+                     STATS_START(pStats, mark);
+                     if((indx = LoopDBRankMatches(loops, &nLoops, lc,
+                                                  &query))==NULL)
                      {
                         fprintf(stderr,"No memory to sort results\n");
                         return(1);
                      }
+                     if((opts.diverse > 0.0) &&
+                        ((nLoops = DiversifyLoops(indx, nLoops,
+                                                  opts.diverseTop,
+                                                  opts.numResult,
+                                                  opts.diverse, nStem,
+                                                  lc, pStats)) < 0))
+                     {
+                        fprintf(stderr,"No memory to cluster results\n");
+                        return(1);
+                     }
+                     STATS_STOP(pStats, mark, SP_SORT);
+
+                     nPrinted = opts.numResult;
+                     if((nPrinted == 0) || (nPrinted > nLoops))
+                        nPrinted = nLoops;
+                     STATS_START(pStats, mark);
+                     PrintLoops(out, indx, nPrinted, (lc != NULL));
+                     STATS_STOP(pStats, mark, SP_PRINT);
+                     nHits = nLoops;
+
+                     STATS_START(pStats, mark);
+                     if(opts.splicePrefix[0] &&
+                        (SpliceLoops(framework, opts.startRes,
+                                     opts.endRes, indx, nPrinted, lc,
+                                     &(query.stems), opts.splicePrefix,
+                                     opts.nThreads) < 0))
+                     {
+                        fprintf(stderr,"Unable to write models\n");
+                        return(1);
+                     }
+                     STATS_STOP(pStats, mark, SP_MODELS);
 
                   }
                }
@@ -165,6 +464,42 @@ int main(int argc, char **argv)
                fprintf(stderr,"No atoms read from PDB file\n");
                return(1);
             }
+
+            if(opts.statsFile[0] &&
+               !WriteScanStats(&opts, nStem, nHits, nPrinted, pStats))
+            {
+               fprintf(stderr,"Unable to write statistics to %s\n",
+                       opts.statsFile);
+               return(1);
+            }
+            if(opts.countersFile[0])
+            {
+               if(!WriteScanCounters(&opts, pStats))
+               {
+                  fprintf(stderr,"Unable to write counters to %s\n",
+                          opts.countersFile);
+                  return(1);
+               }
+               HWCountersClose();
+            }
+
+            /* FindLoops() fills in the distances if it got that far   */
+            if(opts.logFile[0] && logRec.nStem)
+            {
+               strncpy(logRec.dbFile,  opts.dbFile, QL_MAXFILE-1);
+               strncpy(logRec.sidecar, opts.qfFile, QL_MAXFILE-1);
+               strncpy(logRec.query,   opts.infile, QL_MAXFILE-1);
+               strcpy(logRec.startRes, opts.startRes);
+               strcpy(logRec.endRes,   opts.endRes);
+               logRec.tolerance = opts.tolerance;
+               logRec.numResult = opts.numResult;
+               if(!WriteQueryLog(opts.logFile, &logRec))
+               {
+                  fprintf(stderr,"Unable to write the query to %s\n",
+                          opts.logFile);
+                  return(1);
+               }
+            }
          }
          else
          {
@@ -178,223 +513,136 @@ int main(int argc, char **argv)
          return(1);
       }
    }
-         
+
    return(0);
 }
 
 
 /************************************************************************/
-/*>LOOP *FindLoops(PDB *pdb, char *startRes, char *endRes, FILE *dbf, 
-                   REAL tolerance, int loopLen)
-   ------------------------------------------------------------------
+/*>LOOP *FindLoops(PDB *pdb, SCANOPTS *opts, LOOPDBFILE *file, int nStem,
+                   LOOPDBQUERY *query, SCANSTATS *stats, QUERYREC *log)
+   ----------------------------------------------------------------------
 *//**
-   \param[in]  *pdb       PDB linked list
-   \param[in]  *startRes  Residue identifier for first residue
-   \param[in]  *endRes    Residue identifier for last residue
-   \param[in]  *dbf       File pointer for database file
-   \param[in]  tolerance  Allowed tolerance for an individual distance
-   \param[in]  loopLen    Desired loop length (0 = same as structure)
-   \return                Linked list of loops that match the criteria
+   \param[in]     *pdb     PDB linked list
+   \param[in,out] *opts    Options. The loop length (0 = same as 
+                           structure) is set to the one used for the
+                           scan
+   \param[in]     *file    The database file and how to scan it
+   \param[in]     nStem    Number of takeoff residues each side
+   \param[out]    *query   The query the database was scanned with
+   \param[in,out] *stats   Statistics for --stats (or NULL)
+   \param[out]    *log     Query record for --log (or NULL)
+   \return                 Linked list of loops that match the criteria
 
    Scans the relevant residues against the loop database
 
 -  14.07.15 Original   By: ACRM
 -  17.07.15 Handles loop length as a parameter
+-  18.10.26 Uses the quantized filter if provided and the query cache
+            if a directory is given. Returns the positions of the
+            takeoff residues
+-  18.10.26 Takes the stem size from the database
+-  18.10.26 Times the scan for --stats
+-  18.10.26 Also reads the counters for --counters
+-  18.10.26 Uses ScanReference() with --reference
+-  18.10.26 Records the query for --log
+-  18.10.26 The distance matrix is calculated by LoopDBMakeQuery()
+-  18.10.26 Gives back the loop length used
+-  18.10.26 Uses MakeReferenceQuery() with --reference
+-  18.10.26 The database is scanned by LoopDBScanFile(). Takes the
+            options, statistics and log record rather than using
+            globals and gives back the query
 */
-LOOP *FindLoops(PDB *pdb, char *startRes, char *endRes, FILE *dbf, 
-                REAL tolerance, int loopLen)
+LOOP *FindLoops(PDB *pdb, SCANOPTS *opts, LOOPDBFILE *file, int nStem,
+                LOOPDBQUERY *query, SCANSTATS *stats, QUERYREC *log)
 {
-   PDB  *p,
-        *pStartRes,
-        *pEndRes,
-        *n[3] = {NULL, NULL, NULL},
-        *c[3] = {NULL, NULL, NULL};
    int  i, j;
-   REAL distMat[3][3];
    LOOP *loops = NULL;
+   STATSMARK mark;
 
 
-   if((pStartRes = blFindResidueSpec(pdb, startRes))==NULL)
-      return(NULL);
-   if((pEndRes = blFindResidueSpec(pdb, endRes))==NULL)
-      return(NULL);
-   
-   /* If loop length not specified, see how long the one in the PDB file
-      is and use that length
-   */
-   if(loopLen == 0)
+   /* Build the distance matrix                                         */
+   if(opts->reference)
    {
-      for(p=pStartRes; p!=pEndRes->next; NEXT(p))
-      {
-         loopLen++;
-      }
+      if(!LoopDBMakeReferenceQuery(pdb, opts->startRes, opts->endRes,
+                                   opts->loopLen, nStem, query))
+         return(NULL);
    }
-   
-
-   /* Find the 3 residues before the start of the loop                  */
-   for(p=pdb; p!=pStartRes; NEXT(p))
+   else if(!LoopDBMakeQuery(pdb, opts->startRes, opts->endRes,
+                            opts->loopLen, nStem, query))
    {
-      n[0] = n[1];
-      n[1] = n[2];
-      n[2] = p;
+      return(NULL);
    }
+   query->tolerance = opts->tolerance;
+   query->shortList = opts->shortList;
+   query->haveStems = FALSE;
+   opts->loopLen    = query->loopLen;
 
-   /* Find the 3 residues after the end of the loop                     */
-   c[0] = pEndRes->next;
-   c[1] = (c[0] != NULL)?c[0]->next:NULL;
-   c[2] = (c[1] != NULL)?c[1]->next:NULL;
-
-   /* Build the distance matrix                                         */
-   for(i=0; i<3; i++)
+   if(log != NULL)
    {
-      for(j=0; j<3; j++)
-      {
-         distMat[i][j] = DIST(n[i], c[j]);
-      }
+      for(i=0; i<nStem; i++)
+         for(j=0; j<nStem; j++)
+            log->distMat[i][j] = query->distMat[i][j];
+      log->loopLen = query->loopLen;
+      log->nStem   = nStem;
    }
 
    /* Scan the matrix against the database                              */
-   loops = ScanMatrix(distMat, loopLen, dbf, tolerance);
+   STATS_START(stats, mark);
+   loops = LoopDBScanFile(file, query, (stats?&(stats->scan):NULL));
+   STATS_STOP(stats, mark, SP_SCAN);
 
    return(loops);
 }
 
 
 /************************************************************************/
-/*>LOOP *ScanMatrix(REAL distMat[3][3], int loopLen, FILE *dbf, 
-                    REAL tolerance)
-   ------------------------------------------------------------
-*//**
-   \param[in]  distMat[][] distance matrix from our structure
-   \param[in]  loopLen     Loop length
-   \param[in]  *dbf        File pointer for database file
-   \param[in]  tolerance   Allowed tolerance for an individual distance
-   \return                 Linked list of loops that match the criteria
-
-   Does the actual work of sanning the distance matrix for the residues
-   in question against the database
-
--  14.07.15 Original   By: ACRM
-*/
-LOOP *ScanMatrix(REAL distMat[3][3], int loopLen, FILE *dbf, 
-                 REAL tolerance)
-{
-   char buffer[MAXBUFF],
-        pdbCode[SMALLBUFF],
-        startRes[SMALLBUFF],
-        endRes[SMALLBUFF];
-   REAL thisMat[3][3];
-   int  i, j,
-        thisLoopLen;
-   LOOP *loops = NULL,
-        *l = NULL;
-
-
-   while(fgets(buffer, MAXBUFF, dbf))
-   {
-      char *chp;
-      TERMINATE(buffer);
-      if((chp = strchr(buffer, '#'))!=NULL)
-         *chp = '\0';
-      KILLTRAILSPACES(buffer);
-      if(strlen(buffer))
-      {
-         if(sscanf(buffer,"%s%s%s%d%lf%lf%lf%lf%lf%lf%lf%lf%lf",
-                   pdbCode, startRes, endRes, &thisLoopLen,
-                   &(thisMat[0][0]), &(thisMat[0][1]), &(thisMat[0][2]), 
-                   &(thisMat[1][0]), &(thisMat[1][1]), &(thisMat[1][2]), 
-                   &(thisMat[2][0]), &(thisMat[2][1]), &(thisMat[2][2])))
-         {
-            REAL score = 0.0;
-
-            if(thisLoopLen == loopLen)
-            {
-               BOOL ok = TRUE;
-               for(i=0; i<3; i++)
-               {
-                  for(j=0; j<3; j++)
-                  {
-                     REAL badness = ABS(distMat[i][j] - thisMat[i][j]);
-                     if(badness > tolerance)
-                     {
-                        ok = FALSE;
-                        i = j = 10;
-                        break;
-                     }
-                     score += badness;
-                  }
-               }
-               if(ok)
-               {
-                  if(loops == NULL)
-                  {
-                     INIT(loops, LOOP);
-                     l = loops;
-                  }
-                  else
-                  {
-                     ALLOCNEXT(l, LOOP);
-                  }
-
-                  if(l==NULL)
-                  {
-                     FREELIST(loops, LOOP);
-                     return(NULL);
-                  }
-
-                  /* Save the data                                      */
-                  l->score = score;
-                  strncpy(l->buffer,   buffer,   MAXBUFF);
-                  strncpy(l->pdbcode,  pdbCode,  SMALLBUFF);
-                  strncpy(l->startRes, startRes, SMALLBUFF);
-                  strncpy(l->endRes,   endRes,   SMALLBUFF);
-               }
-            }
-         }
-      }
-   }
-   return(loops);
-}
-
-
-/************************************************************************/
-/*>BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
-                     char *dbFile, REAL *tolerance, char *startRes, 
-                     char *endRes, int *numResult, int *loopLen)
-   ---------------------------------------------------------------------
+/*>BOOL ParseCmdLine(int argc, char **argv, SCANOPTS *opts)
+   ----------------------------------------------------------
 *//**
    \param[in]  argc              Argument count
    \param[in]  **argv            Argument array
-   \param[out] *infile           Input filename (or blank string) 
-   \param[out] *outfile          Output filename (or blank string)
-   \param[out] *dbFile           Database file to search
-   \param[out] *tolerance        Max deviation on an individual distance
-   \param[out] *startRes         Start residue ID
-   \param[out] *endRes           End residue ID
-   \param[out] *numResult        Number of results to print
-   \param[out] *loopLen          Loop length (0 to use the same as in the
-                                 input PDB file)
+   \param[out] *opts             The options
    \return                       Success
 
    Parse the command line
 
 -  14.07.15 Original    By: ACRM
 -  17.07.15 Added loopLen
+-  18.10.26 Added qfFile, cacheDir and grid
+-  18.10.26 Added coordsFile and shortList
+-  18.10.26 Added splicePrefix and nThreads
+-  18.10.26 Added --stats
+-  18.10.26 Added --counters
+-  18.10.26 Added --reference
+-  18.10.26 Added --log
+-  18.10.26 Added --xray, --nonmr, --resolution and --rfactor
+-  18.10.26 Added --diverse and --diversetop
+-  18.10.26 The options are returned in a SCANOPTS
 */
-BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
-                  char *dbFile, REAL *tolerance, char *startRes, 
-                  char *endRes, int *numResult, int *loopLen)
+BOOL ParseCmdLine(int argc, char **argv, SCANOPTS *opts)
 {
    BOOL gotArg = FALSE;
    
    argc--;
    argv++;
    
-   strcpy(startRes, DEF_STARTRES);
-   strcpy(endRes,   DEF_ENDRES);
-   infile[0]  = outfile[0] = dbFile[0] = '\0';
-   *tolerance = DEF_TOLERANCE;
-   *numResult = *loopLen = 0;
+   strcpy(opts->startRes, DEF_STARTRES);
+   strcpy(opts->endRes,   DEF_ENDRES);
+   opts->infile[0] = opts->outfile[0] = opts->dbFile[0] = '\0';
+   opts->qfFile[0] = opts->cacheDir[0] = opts->coordsFile[0] = '\0';
+   opts->splicePrefix[0] = opts->statsFile[0] = '\0';
+   opts->countersFile[0] = opts->logFile[0] = '\0';
+   opts->reference  = FALSE;
+   opts->nThreads   = 0;
+   opts->filter.maxResolution = opts->filter.maxRFactor = (REAL)0.0;
+   opts->filter.xray = opts->filter.noNMR = FALSE;
+   opts->diverse    = (REAL)0.0;
+   opts->diverseTop = DEF_DIVERSETOP;
+   opts->tolerance  = DEF_TOLERANCE;
+   opts->grid       = DEF_CACHEGRID;
+   opts->shortList  = DEF_SHORTLIST;
+   opts->numResult  = opts->loopLen = 0;
    
    while(argc)
    {
@@ -405,31 +653,164 @@ BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
          case 't':
             argv++;
             argc--;
-            if(!argc || !sscanf(argv[0], "%lf", tolerance))
+            if(!argc || !sscanf(argv[0], "%lf", &(opts->tolerance)))
                return(FALSE);
             break;
          case 'n':
             argv++;
             argc--;
-            if(!argc || !sscanf(argv[0], "%d", numResult))
+            if(!argc || !sscanf(argv[0], "%d", &(opts->numResult)))
                return(FALSE);
             break;
          case 'l':
             argv++;
             argc--;
-            if(!argc || !sscanf(argv[0], "%d", loopLen))
+            if(!argc || !sscanf(argv[0], "%d", &(opts->loopLen)))
                return(FALSE);
             break;
          case 'r':
             argv++;
             argc--;
-            if(!argc || !sscanf(argv[0], "%s", startRes))
+            if(!argc || !sscanf(argv[0], "%s", opts->startRes))
                return(FALSE);
             argv++;
             argc--;
-            if(!argc || !sscanf(argv[0], "%s", endRes))
+            if(!argc || !sscanf(argv[0], "%s", opts->endRes))
                return(FALSE);
             break;
+         case 'q':
+            argv++;
+            argc--;
+            if(!argc)
+               return(FALSE);
+            strncpy(opts->qfFile, argv[0], MAXBUFF-1);
+            opts->qfFile[MAXBUFF-1] = '\0';
+            break;
+         case 'C':
+            argv++;
+            argc--;
+            if(!argc)
+               return(FALSE);
+            strncpy(opts->cacheDir, argv[0], MAXBUFF-1);
+            opts->cacheDir[MAXBUFF-1] = '\0';
+            break;
+         case 'g':
+            argv++;
+            argc--;
+            if(!argc || !sscanf(argv[0], "%lf", &(opts->grid)) ||
+               (opts->grid <= 0.0))
+               return(FALSE);
+            break;
+         case 'c':
+            argv++;
+            argc--;
+            if(!argc)
+               return(FALSE);
+            strncpy(opts->coordsFile, argv[0], MAXBUFF-1);
+            opts->coordsFile[MAXBUFF-1] = '\0';
+            break;
+         case 'M':
+            argv++;
+            argc--;
+            if(!argc || !sscanf(argv[0], "%d", &(opts->shortList)) || 
+               (opts->shortList < 1))
+               return(FALSE);
+            break;
+         case 's':
+            argv++;
+            argc--;
+            if(!argc)
+               return(FALSE);
+            strncpy(opts->splicePrefix, argv[0], MAXBUFF-1);
+            opts->splicePrefix[MAXBUFF-1] = '\0';
+            break;
+         case 'j':
+            argv++;
+            argc--;
+            if(!argc || !sscanf(argv[0], "%d", &(opts->nThreads)) || 
+               (opts->nThreads < 0))
+               return(FALSE);
+            break;
+         case '-':
+            if(!strcmp(argv[0], "--stats"))
+            {
+               argv++;
+               argc--;
+               if(!argc)
+                  return(FALSE);
+               strncpy(opts->statsFile, argv[0], MAXBUFF-1);
+               opts->statsFile[MAXBUFF-1] = '\0';
+            }
+            else if(!strcmp(argv[0], "--counters"))
+            {
+               argv++;
+               argc--;
+               if(!argc)
+                  return(FALSE);
+               strncpy(opts->countersFile, argv[0], MAXBUFF-1);
+               opts->countersFile[MAXBUFF-1] = '\0';
+            }
+            else if(!strcmp(argv[0], "--log"))
+            {
+               argv++;
+               argc--;
+               if(!argc)
+                  return(FALSE);
+               strncpy(opts->logFile, argv[0], MAXBUFF-1);
+               opts->logFile[MAXBUFF-1] = '\0';
+            }
+            else if(!strcmp(argv[0], "--reference"))
+            {
+               opts->reference = TRUE;
+            }
+            else if(!strcmp(argv[0], "--xray"))
+            {
+               opts->filter.xray = TRUE;
+            }
+            else if(!strcmp(argv[0], "--nonmr"))
+            {
+               opts->filter.noNMR = TRUE;
+            }
+            else if(!strcmp(argv[0], "--resolution"))
+            {
+               argv++;
+               argc--;
+               if(!argc ||
+                  !sscanf(argv[0], "%lf",
+                          &(opts->filter.maxResolution)) ||
+                  (opts->filter.maxResolution <= 0.0))
+                  return(FALSE);
+            }
+            else if(!strcmp(argv[0], "--rfactor"))
+            {
+               argv++;
+               argc--;
+               if(!argc ||
+                  !sscanf(argv[0], "%lf", &(opts->filter.maxRFactor)) ||
+                  (opts->filter.maxRFactor <= 0.0))
+                  return(FALSE);
+            }
+            else if(!strcmp(argv[0], "--diverse"))
+            {
+               argv++;
+               argc--;
+               if(!argc || !sscanf(argv[0], "%lf", &(opts->diverse)) ||
+                  (opts->diverse <= 0.0))
+                  return(FALSE);
+            }
+            else if(!strcmp(argv[0], "--diversetop"))
+            {
+               argv++;
+               argc--;
+               if(!argc || !sscanf(argv[0], "%d", &(opts->diverseTop)) ||
+                  (opts->diverseTop < 1))
+                  return(FALSE);
+            }
+            else
+            {
+               return(FALSE);
+            }
+            break;
          default:
             return(FALSE);
             break;
@@ -444,19 +825,19 @@ BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
          gotArg = TRUE;
          
          /* Copy the first to dbFile                                    */
-         strcpy(dbFile, argv[0]);
+         strcpy(opts->dbFile, argv[0]);
          
          /* If there's another, copy it to infile                       */
          argc--;
          argv++;
          if(argc)
-            strcpy(infile, argv[0]);
+            strcpy(opts->infile, argv[0]);
             
          /* If there's another, copy it to outfile                      */
          argc--;
          argv++;
          if(argc)
-            strcpy(outfile, argv[0]);
+            strcpy(opts->outfile, argv[0]);
             
          return(TRUE);
       }
@@ -480,14 +861,26 @@ BOOL ParseCmdLine(int argc, char **argv, char *infile, char *outfile,
 
 -  14.07.15 Original   By: ACRM
 -  17.07.15 Handles loop length
+-  18.10.26 Describes the new options
+-  18.10.26 Describes the distances for any stem size
 */
 void Usage(void)
 {
-   fprintf(stderr,"\nscanloopdb V1.1 (c) 2015 UCL, Dr. Andrew C.R. \
+   fprintf(stderr,"\nscanloopdb V1.14 (c) 2015-26 UCL, Dr. Andrew C.R. \
 Martin.\n");
 
    fprintf(stderr,"\nUsage: scanloopdb [-l loopLen][-t tol][-n nresults]\
 [-r startres endres]\n");
+   fprintf(stderr,"                  [-q sidecar][-C cachedir [-g grid]]\
+\n");
+   fprintf(stderr,"                  [-c coords.bb [-M shortlist]\
+[-s prefix [-j nthreads]]]\n");
+   fprintf(stderr,"                  [--stats file][--counters file]\
+[--reference]\n");
+   fprintf(stderr,"                  [--log file][--xray][--nonmr]\
+[--resolution max]\n");
+   fprintf(stderr,"                  [--rfactor max][--diverse dist \
+[--diversetop n]]\n");
    fprintf(stderr,"                  loops.db [in.pdb [out.txt]]\n");
    fprintf(stderr,"\n                  loops.db - loop database from \
 buildloopdb\n");
@@ -500,18 +893,99 @@ individual distance [%.2f]\n", DEF_TOLERANCE);
 [unlimited]\n");
    fprintf(stderr,"                  -r - Set the boundaries of the \
 loop [%s %s]\n", DEF_STARTRES, DEF_ENDRES);
+   fprintf(stderr,"                  -q - Use the quantized filter \
+sidecar written by\n");
+   fprintf(stderr,"                       buildloopdb -q to avoid \
+reading most records\n");
+   fprintf(stderr,"                  -C - Keep a cache of results in \
+this directory\n");
+   fprintf(stderr,"                  -g - Grid spacing for matching \
+cached queries [%.2f]\n", DEF_CACHEGRID);
+   fprintf(stderr,"                  -c - Rerank the best hits by the \
+RMSD of the takeoff\n");
+   fprintf(stderr,"                       residues using the coordinate \
+file written by\n");
+   fprintf(stderr,"                       buildloopdb -c\n");
+   fprintf(stderr,"                  -M - Number of best hits to rerank \
+with -c [%d]\n", DEF_SHORTLIST);
+   fprintf(stderr,"                  -s - Write a model for each hit \
+printed with the loop\n");
+   fprintf(stderr,"                       spliced into the input \
+structure (prefix_N.pdb)\n");
+   fprintf(stderr,"                  -j - Number of threads for writing \
+models [one per CPU]\n");
+   fprintf(stderr,"                  --stats - Append a JSON line of \
+timings and counters\n");
+   fprintf(stderr,"                       for the query to this file \
+('-' for standard error)\n");
+   fprintf(stderr,"                  --counters - Append a JSON line of \
+hardware performance\n");
+   fprintf(stderr,"                       counters (cycles, cache and \
+branch misses) for each\n");
+   fprintf(stderr,"                       phase of the query to this \
+file ('-' for standard\n");
+   fprintf(stderr,"                       error). Only times are given \
+if the counters are\n");
+   fprintf(stderr,"                       not available\n");
+   fprintf(stderr,"                  --reference - Scan with the \
+original, unoptimized code\n");
+   fprintf(stderr,"                       to check faster versions \
+against (cannot be used\n");
+   fprintf(stderr,"                       with -q or -C)\n");
+   fprintf(stderr,"                  --log - Append the parameters of \
+the query to this log\n");
+   fprintf(stderr,"                       to be played back by \
+replayloopdb\n");
+   fprintf(stderr,"                  --xray - Only use hits from X-ray \
+structures\n");
+   fprintf(stderr,"                  --nonmr - Do not use hits from NMR \
+structures\n");
+   fprintf(stderr,"                  --resolution - Only use hits from \
+structures with this\n");
+   fprintf(stderr,"                       resolution or better\n");
+   fprintf(stderr,"                  --rfactor - Only use hits from \
+structures with this\n");
+   fprintf(stderr,"                       R-factor or better\n");
+   fprintf(stderr,"                       (--xray, --nonmr, --resolution \
+and --rfactor need a\n");
+   fprintf(stderr,"                       database built with \
+buildloopdb --exptl)\n");
+   fprintf(stderr,"                  --diverse - Only keep the best hit \
+from each cluster of\n");
+   fprintf(stderr,"                       similar hits. Hits are similar \
+if they are the same\n");
+   fprintf(stderr,"                       length, no takeoff distance \
+differs by more than\n");
+   fprintf(stderr,"                       dist and, with -c, the RMS \
+difference of their\n");
+   fprintf(stderr,"                       CA-CA distances is no more \
+than dist\n");
+   fprintf(stderr,"                  --diversetop - Number of best hits \
+to cluster with\n");
+   fprintf(stderr,"                       --diverse. More are clustered \
+if needed to give -n\n");
+   fprintf(stderr,"                       hits and the rest follow \
+unclustered [%d]\n", DEF_DIVERSETOP);
 
    fprintf(stderr,"\nGenerates a set of loop candidates from the loop \
 database. Scans the\n");
    fprintf(stderr,"specified loop (default CDR-H3) from the PDB file \
 against the database\n");
    fprintf(stderr,"and generates a list of hits ranked by overall \
-deviation of the 9\n");
-   fprintf(stderr,"distances that are calculated around the adjoining 3 \
-residues either\n");
-   fprintf(stderr,"side of the loop. -t specifies the maximum deviation \
-for any individual\n");
-   fprintf(stderr,"distance.\n");
+deviation of the nStem^2\n");
+   fprintf(stderr,"distances that are calculated around the adjoining \
+nStem residues either\n");
+   fprintf(stderr,"side of the loop, where nStem is the stem size the \
+database was built\n");
+   fprintf(stderr,"with (%d-%d, buildloopdb -s; 9 distances for the \
+default of 3). -t\n", MINSTEM, MAXSTEM);
+   fprintf(stderr,"specifies the maximum deviation for any individual \
+distance.\n");
+   fprintf(stderr,"\nWith -c, the best hits are then superimposed on the \
+N, CA, C and O atoms\n");
+   fprintf(stderr,"of the takeoff residues and reranked by RMSD. The \
+RMSD is printed after\n");
+   fprintf(stderr,"the distance score.\n");
    fprintf(stderr,"Input/output is to standard input/output if files are \
 not specified.\n\n");
 
@@ -519,111 +993,426 @@ not specified.\n\n");
 
 
 /************************************************************************/
-/*>BOOL PrintLoops(FILE *out, LOOP *loops, int maxLoops)
-   -----------------------------------------------------
+/*>void PrintLoops(FILE *out, LOOP **indx, int nLoops, BOOL withRMSD)
+   ------------------------------------------------------------------
 *//**
    \param[in]  *out     Output file pointer
-   \param[in]  *loops   Linked list of loops
-   \param[in]  maxloops Maxmimum number of loops to print
-   \return              Success in allocating memory
+   \param[in]  **indx   Index of loops in rank order
+   \param[in]  nLoops   Number of loops to print
+   \param[in]  withRMSD Print the RMSD after the score
 
-   Prints the resulting loops sorted by their fit to the distance matrix
+   Prints the resulting loops
 
 -  14.07.15 Original   By: ACRM
+-  18.10.26 Added RMSD reranking
+-  18.10.26 Takes the ranked index from RankLoops()
 */
-BOOL PrintLoops(FILE *out, LOOP *loops, int maxLoops)
+void PrintLoops(FILE *out, LOOP **indx, int nLoops, BOOL withRMSD)
 {
-   LOOP **indx = NULL;
-   int  nLoops = 0, 
-        i;
-
-   /* Create and sort an array to index the linked list                 */
-   if((indx = IndexResults(loops, &nLoops))==NULL)
-      return(FALSE);
+   int i;
 
-   if(maxLoops == 0)
-      maxLoops = nLoops;
-
-   for(i=0; i<nLoops && i<maxLoops; i++)
+   for(i=0; i<nLoops; i++)
    {
-      fprintf(out, "%s : %f\n", indx[i]->buffer, indx[i]->score);
+      if(withRMSD)
+         fprintf(out, "%s : %f %f\n", indx[i]->buffer, indx[i]->score,
+                 indx[i]->rmsd);
+      else
+         fprintf(out, "%s : %f\n", indx[i]->buffer, indx[i]->score);
    }
-   free(indx);
-   return(TRUE);
 }
 
 
 /************************************************************************/
-/*>static int cmpResults(const void *p1, const void *p2)
-   -----------------------------------------------------
+/*>int SpliceLoops(PDB *framework, char *startRes, char *endRes, 
+                   LOOP **indx, int nLoops, LOOPCOORDS *lc, 
+                   SUPATOMS *frameStems, char *prefix, int nThreads)
+   ---------------------------------------------------------------
 *//**
-   \param[in]  *p1    Pointer to first LOOP pointer
-   \param[in]  *p2    Pointer to second LOOP pointer
-   \return            -1: First is smaller;
-                       0: Values are equal;
-                      +1: First is larger
+   \param[in]  *framework  Full input structure
+   \param[in]  *startRes   First residue of the loop being replaced
+   \param[in]  *endRes     Last residue of the loop being replaced
+   \param[in]  **indx      Index of loops in rank order
+   \param[in]  nLoops      Number of loops to splice in
+   \param[in]  *lc         Loop coordinates
+   \param[in]  *frameStems Takeoff atoms from the input structure
+   \param[in]  *prefix     Prefix for model filenames
+   \param[in]  nThreads    Number of threads (0 = one per processor)
+   \return                 Number of models written (-1 on failure)
+
+   Writes a model for each of the hits. Hits whose coordinates are not
+   available are reported and skipped.
+
+-  18.10.26 Original   By: ACRM
+*/
+int SpliceLoops(PDB *framework, char *startRes, char *endRes, 
+                LOOP **indx, int nLoops, LOOPCOORDS *lc, 
+                SUPATOMS *frameStems, char *prefix, int nThreads)
+{
+   long *records;
+   int  i, 
+        nWritten;
 
-   Comparison routine used by qsort()
+   if((records = (long *)malloc(MAX(nLoops, 1) * sizeof(long)))==NULL)
+      return(-1);
 
--  14.07.15 Original   By: ACRM
+   for(i=0; i<nLoops; i++)
+      records[i] = indx[i]->record;
+
+   nWritten = WriteSplicedModels(framework, startRes, endRes, lc, 
+                                 frameStems, records, nLoops, prefix,
+                                 nThreads);
+   free(records);
+   return(nWritten);
+}
+
+
+/************************************************************************/
+/*>LOOP *FilterLoops(LOOP *loops, int nStem, EXPTLFILTER *filter,
+                     SCANSTATS *stats)
+   ---------------------------------------------------------------
+*//**
+   \param[in]  *loops     Linked list of hits (those removed are freed)
+   \param[in]  nStem      Stem size of the database
+   \param[in]  *filter    Experimental filters
+   \param[in,out] *stats  Statistics for --stats (or NULL)
+   \return                Linked list of the hits that pass
+
+   Removes the hits from entries whose experimental method, resolution
+   or R-factor (at the end of each record in a database built with
+   buildloopdb --exptl) fail the filters.
+
+-  18.10.26 Original   By: ACRM
 */
-static int cmpResults(const void *p1, const void *p2)
+LOOP *FilterLoops(LOOP *loops, int nStem, EXPTLFILTER *filter,
+                  SCANSTATS *stats)
 {
-   REAL s1, s2;
-
-   /* The input values are pointers to the LOOP pointers. We therefore
-      first cast them to the correct type (LOOP **), dereference this
-      to get a LOOP pointer and then extract the score from this.
-   */
-   s1 = (*((LOOP **)p1))->score;
-   s2 = (*((LOOP **)p2))->score;
+   LOOP  *l,
+         *next,
+         *kept = NULL,
+         *last = NULL;
+   EXPTL exptl;
 
-   if(s1 < s2)
-   {
-      return(-1);
-   }
-   if(s2 < s1)
+   for(l=loops; l!=NULL; l=next)
    {
-      return(+1);
+      next = l->next;
+      if(ParseDBExptl(l->buffer, nStem, &exptl) &&
+         ExptlPasses(&exptl, filter))
+      {
+         if(last == NULL)
+            kept = l;
+         else
+            last->next = l;
+         last    = l;
+         l->next = NULL;
+      }
+      else
+      {
+         if(stats != NULL)
+            stats->nExptl++;
+         free(l);
+      }
    }
-   return(0);
+   return(kept);
 }
 
 
 /************************************************************************/
-/*>LOOP **IndexResults(LOOP *loops, int *nLoops)
-   ---------------------------------------------
+/*>int DiversifyLoops(LOOP **indx, int nLoops, int nTop, int nWanted,
+                      REAL dist, int nStem, LOOPCOORDS *lc,
+                      SCANSTATS *stats)
+   -------------------------------------------------------------------
 *//**
-   \param[in]  *loops  Linked list of LOOP structures
-   \param[out] *nLoops Number of loops
-   \return             Array of loop pointers (or NULL if malloc() fails)
+   \param[in,out] **indx   Index of loops in rank order
+   \param[in]     nLoops   Number of loops in the index
+   \param[in]     nTop     Number of best loops to cluster
+   \param[in]     nWanted  Number of clusters wanted (0 = no minimum)
+   \param[in]     dist     Distance within which loops are similar
+   \param[in]     nStem    Stem size of the database
+   \param[in]     *lc      Loop coordinates (or NULL)
+   \param[in,out] *stats   Statistics for --stats (or NULL)
+   \return                 Number of loops left in the index (-1 if
+                           memory allocation failed)
+
+   Clusters the best hits so that near-copies of one loop don't fill
+   the list. The hits are taken in rank order and each one that is not
+   similar (see SimilarHits()) to a hit already kept starts a new
+   cluster. At least the best nTop hits are clustered and clustering
+   carries on past them until there are nWanted clusters. The index is
+   left holding the best hit from each cluster in rank order followed
+   by the hits that were not clustered; the other hits in each cluster
+   are dropped.
+
+-  18.10.26 Original   By: ACRM
+*/
+int DiversifyLoops(LOOP **indx, int nLoops, int nTop, int nWanted,
+                   REAL dist, int nStem, LOOPCOORDS *lc, SCANSTATS *stats)
+{
+   DIVHIT *hits = NULL,
+          *newHits;
+   char   pdbCode[SMALLBUFF],
+          startRes[SMALLBUFF],
+          endRes[SMALLBUFF];
+   int    i, j,
+          maxHits = 0,
+          nKept   = 0;
+
+   for(i=0; (i<nLoops) && ((i<nTop) || (nKept<nWanted)); i++)
+   {
+      /* Kept hits and the one being clustered are held in hits[]      */
+      if(nKept == maxHits)
+      {
+         maxHits += DIV_ALLOCQUANTUM;
+         if((newHits = (DIVHIT *)realloc(hits, 
+                                         maxHits * sizeof(DIVHIT)))
+            ==NULL)
+         {
+            free(hits);
+            return(-1);
+         }
+         hits = newHits;
+      }
 
-   Performs an index sort on an array of pointers to the loop structures.
-   Sorting is on the basis of the score stored in each loop structure.
+      hits[nKept].loop = indx[i];
+      hits[nKept].res  = NULL;
+      hits[nKept].nRes = 0;
+      if(!ParseDBRecord(indx[i]->buffer, nStem, pdbCode, startRes,
+                        endRes, &(hits[nKept].loopLen),
+                        hits[nKept].distMat))
+         hits[nKept].loopLen = -1;
+      if(lc != NULL)
+         hits[nKept].res = GetLoopCoords(lc, indx[i]->record,
+                                         &(hits[nKept].nRes));
+
+      /* Kept hits are compacted to the start of the array so this is
+         compared only with the best hit from each cluster so far
+      */
+      for(j=0; j<nKept; j++)
+      {
+         if(SimilarHits(&(hits[nKept]), &(hits[j]), nStem, dist,
+                        (lc != NULL)))
+            break;
+      }
+      if(j == nKept)
+         nKept++;
+   }
 
--  14.07.15 Original   By: ACRM
+   /* i hits were clustered; the rest follow the kept ones unchanged   */
+   for(j=0; j<nKept; j++)
+      indx[j] = hits[j].loop;
+   for(j=i; j<nLoops; j++)
+      indx[nKept + j - i] = indx[j];
+   free(hits);
+
+   if(stats != NULL)
+      stats->nSimilar += i - nKept;
+   return(nLoops - (i - nKept));
+}
+
+
+/************************************************************************/
+/*>static BOOL SimilarHits(DIVHIT *hit1, DIVHIT *hit2, int nStem,
+                           REAL dist, BOOL withCoords)
+   ---------------------------------------------------------------
+*//**
+   \param[in]  *hit1       First hit
+   \param[in]  *hit2       Second hit
+   \param[in]  nStem       Stem size of the database
+   \param[in]  dist        Distance within which hits are similar
+   \param[in]  withCoords  Compare the loop coordinates
+   \return                 Hits are similar
+
+   Hits are similar if they are the same length and no takeoff distance
+   differs by more than dist. If loop coordinates are being used, the
+   RMS difference of the CA-CA distances over the loop and stems must
+   also be no more than dist; hits whose coordinates are missing are
+   never similar.
+
+-  18.10.26 Original   By: ACRM
 */
-LOOP **IndexResults(LOOP *loops, int *nLoops)
+static BOOL SimilarHits(DIVHIT *hit1, DIVHIT *hit2, int nStem, REAL dist,
+                        BOOL withCoords)
 {
-   LOOP *l, 
-        **indx;
+   int   i, j, k,
+         nPairs = 0;
+   REAL  d1, d2,
+         sumSq  = 0.0;
+   float *a, *b;
 
-   *nLoops = 0;
+   if((hit1->loopLen < 0) || (hit1->loopLen != hit2->loopLen))
+      return(FALSE);
+
+   for(i=0; i<nStem; i++)
+   {
+      for(j=0; j<nStem; j++)
+      {
+         if(ABS(hit1->distMat[i][j] - hit2->distMat[i][j]) > dist)
+            return(FALSE);
+      }
+   }
 
-   /* Count the number of results                                       */
-   for(l=loops; l!=NULL; NEXT(l))
-      (*nLoops)++;
+   if(!withCoords)
+      return(TRUE);
+   if((hit1->res == NULL) || (hit2->res == NULL) ||
+      (hit1->nRes != hit2->nRes))
+      return(FALSE);
 
-   if((indx = (LOOP **)malloc((*nLoops) * sizeof(LOOP *)))!=NULL)
+   for(i=0; i<hit1->nRes; i++)
    {
-      *nLoops = 0;
-      for(l=loops; l!=NULL; NEXT(l))
+      for(j=i+1; j<hit1->nRes; j++)
       {
-         indx[(*nLoops)++] = l;
+         d1 = d2 = 0.0;
+         for(k=0; k<3; k++)
+         {
+            a   = hit1->res[i].xyz[BB_CA];
+            b   = hit1->res[j].xyz[BB_CA];
+            d1 += (a[k] - b[k]) * (a[k] - b[k]);
+            a   = hit2->res[i].xyz[BB_CA];
+            b   = hit2->res[j].xyz[BB_CA];
+            d2 += (a[k] - b[k]) * (a[k] - b[k]);
+         }
+         d1     = sqrt(d1);
+         d2     = sqrt(d2);
+         sumSq += (d1 - d2) * (d1 - d2);
+         nPairs++;
       }
+   }
+
+   return((nPairs == 0) || (sqrt(sumSq / nPairs) <= dist));
+}
+
+
+/************************************************************************/
+/*>BOOL WriteScanStats(SCANOPTS *opts, int nStem, int nHits, 
+                       int nPrinted, SCANSTATS *stats)
+   ---------------------------------------------------------------------
+*//**
+   \param[in]   *opts       Options, giving the --stats file ("-" for
+                            stderr), query, database, loop, loop length
+                            searched for and tolerance
+   \param[in]   nStem       Stem size of the database
+   \param[in]   nHits       Hits kept after ranking
+   \param[in]   nPrinted    Hits printed
+   \param[in]   *stats      Statistics for the query
+   \return                  Success
+
+   Appends a single line JSON object for the query to the --stats file
+   so that the lines from many queries can be collected in one file.
+   The phases are reading the query, scanning the database (of which
+   "match" is the time spent checking distances), sorting, RMSD
+   reranking and clustering, printing and writing models. On a cache
+   miss the
+   records are checked twice, once against the widened tolerance to
+   fill the cache and once against the query, and both are counted.
+   With --counters the hardware counters for each phase are added.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL WriteScanStats(SCANOPTS *opts, int nStem, int nHits, int nPrinted,
+                    SCANSTATS *stats)
+{
+   static char *cacheNames[] = {"off", "hit", "miss"};
+   FILE *fp;
+   int  i;
+   
+   if(!strcmp(opts->statsFile, "-"))
+      fp = stderr;
+   else if((fp = fopen(opts->statsFile, "a"))==NULL)
+      return(FALSE);
 
-      qsort(indx, *nLoops, sizeof(LOOP *), cmpResults);
+   fprintf(fp, "{\"program\": \"scanloopdb\", \"version\": \"1.14\", \
+\"query\": ");
+   StatsPrintString(fp, opts->infile[0]?opts->infile:"stdin");
+   fprintf(fp, ", \"db\": ");
+   StatsPrintString(fp, opts->dbFile);
+   fprintf(fp, ", \"loop\": [");
+   StatsPrintString(fp, opts->startRes);
+   fprintf(fp, ", ");
+   StatsPrintString(fp, opts->endRes);
+   fprintf(fp, "], \"length\": %d, \"tolerance\": %.3f, \"stem\": %d, \
+\"cache\": \"%s\", ", opts->loopLen, opts->tolerance, nStem, 
+           cacheNames[stats->scan.cache]);
+   fprintf(fp, "\"wall_seconds\": %.6f, ", StatsClock() - stats->tStart);
+   fprintf(fp, "\"phases\": {\"read_query\": %.6f, \"scan\": %.6f, \
+\"match\": %.6f, \"sort\": %.6f, \"print\": %.6f, \"models\": %.6f}, ",
+           stats->phases.time[SP_QUERY], stats->phases.time[SP_SCAN],
+           stats->scan.tMatch, stats->phases.time[SP_SORT],
+           stats->phases.time[SP_PRINT], stats->phases.time[SP_MODELS]);
+   if(stats->phases.counters)
+   {
+      fprintf(fp, "\"counters\": ");
+      StatsPrintPhases(fp, &(stats->phases), sScanPhases, NSCANPHASE,
+                       FALSE);
+      fprintf(fp, ", ");
    }
+   fprintf(fp, "\"records\": %ld, \"rejected_length\": %ld, \
+\"rejected_malformed\": %ld, \"rejected_tolerance\": [",
+           stats->scan.nRecords, stats->scan.nLength,
+           stats->scan.nMalformed);
+   for(i=0; i<nStem*nStem; i++)
+      fprintf(fp, "%s%ld", i?", ":"", stats->scan.cellReject[i]);
+   fprintf(fp, "], \"matched\": %ld, \"rejected_exptl\": %ld, \
+\"rejected_similar\": %ld, \"sidecar_records\": %ld, \
+\"sidecar_passed\": %ld, ", stats->scan.nMatched, stats->nExptl,
+           stats->nSimilar, stats->scan.nSidecar, stats->scan.nPassed);
+   fprintf(fp, "\"hits\": %d, \"printed\": %d, \"bytes_read\": %ld, \
+\"peak_memory_kb\": %ld}\n", nHits, nPrinted, stats->scan.bytesRead, 
+           StatsPeakMemory());
+
+   if(fp != stderr)
+   {
+      if(fclose(fp))
+         return(FALSE);
+   }
+   return(TRUE);
+}
+
 
-   return(indx);
+/************************************************************************/
+/*>BOOL WriteScanCounters(SCANOPTS *opts, SCANSTATS *stats)
+   ---------------------------------------------------------
+*//**
+   \param[in]   *opts          Options, giving the --counters file ("-"
+                               for stderr), query, database and loop
+   \param[in]   *stats         Statistics for the query
+   \return                     Success
+
+   Appends a single line JSON object for the query to the --counters
+   file with the threads used and the time, cycles, instructions, cache
+   and branch misses and instructions per cycle for each phase. The
+   distance checks are part of the scan phase since reading the
+   counters for every record would cost more than the check itself.
+
+-  18.10.26 Original   By: ACRM
+*/
+BOOL WriteScanCounters(SCANOPTS *opts, SCANSTATS *stats)
+{
+   FILE *fp;
+   
+   if(!strcmp(opts->countersFile, "-"))
+      fp = stderr;
+   else if((fp = fopen(opts->countersFile, "a"))==NULL)
+      return(FALSE);
+
+   fprintf(fp, "{\"program\": \"scanloopdb\", \"version\": \"1.14\", \
+\"threads\": %d, \"query\": ", stats->nThreads);
+   StatsPrintString(fp, opts->infile[0]?opts->infile:"stdin");
+   fprintf(fp, ", \"db\": ");
+   StatsPrintString(fp, opts->dbFile);
+   fprintf(fp, ", \"loop\": [");
+   StatsPrintString(fp, opts->startRes);
+   fprintf(fp, ", ");
+   StatsPrintString(fp, opts->endRes);
+   fprintf(fp, "], \"wall_seconds\": %.6f, \"counters_available\": %s, \
+\"phases\": ", StatsClock() - stats->tStart, 
+           stats->phases.counters?"true":"false");
+   StatsPrintPhases(fp, &(stats->phases), sScanPhases, NSCANPHASE,
+                    TRUE);
+   fprintf(fp, "}\n");
+
+   if(fp != stderr)
+   {
+      if(fclose(fp))
+         return(FALSE);
+   }
+   return(TRUE);
 }
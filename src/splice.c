@@ -0,0 +1,504 @@
+/************************************************************************/
+/**
+
+   \file       splice.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Splice database loops into a framework and write models
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Builds a model for each of a set of hits by superimposing the stems
+   of the loop (taken from the loop coordinate file) on the takeoff
+   residues of the framework and replacing the framework loop with the
+   backbone of the new loop. This does the job of util/spliceall.pl
+   (splicepdb followed by renumabloop) without starting any processes
+   or re-reading any PDB files.
+
+   The framework stems are kept. The new loop residues are numbered in
+   the same way as renumabloop numbers CDR-H3: the first residues take
+   the numbers of the framework loop, extra residues are given
+   insertion codes on the third from last number and the last two
+   residues always take the last two numbers. A shorter loop loses
+   numbers from before the last two.
+
+   Models are written in parallel. The framework is only read so each
+   thread writes its own file from copies of the atoms.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "bioplib/macros.h"
+#include "bioplib/pdb.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define MAXFILENAME 1024
+#define NTAIL       2         /* Loop residues that always take the last
+                                 framework numbers                      */
+
+/************************************************************************/
+/* Structure definitions
+*/
+typedef struct
+{
+   int  resnum;
+   char insert[8];
+}  RESNUM;
+
+typedef struct
+{
+   PDB        *framework,     /* Full framework structure               */
+              *loopStart,     /* First atom of the framework loop       */
+              *loopAfter;     /* First atom after the framework loop    */
+   RESNUM     *frameNum;      /* Numbering of the framework loop        */
+   int        nFrame;         /* Residues in the framework loop         */
+   LOOPCOORDS *lc;
+   SUPATOMS   *frameStems;
+   long       *records;
+   char       *prefix;
+   BOOL       *written;
+   int        nModels,
+              nThreads,
+              thread;
+}  SPLICEJOB;
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+static void *SpliceThread(void *arg);
+static BOOL SpliceModel(SPLICEJOB *job, int model);
+static void NumberLoopResidue(int i, int loopLen, RESNUM *frameNum,
+                              int nFrame, int *resnum, char *insert);
+static void WriteAtom(FILE *fp, PDB *atom, int *atnum, char *lastChain);
+
+
+/************************************************************************/
+/*>int WriteSplicedModels(PDB *framework, char *startRes, char *endRes,
+                          LOOPCOORDS *lc, SUPATOMS *frameStems,
+                          long *records, int nModels, char *prefix,
+                          int nThreads)
+   ---------------------------------------------------------------------
+*//**
+   \param[in]  *framework   Full framework structure
+   \param[in]  *startRes    First residue of the framework loop
+   \param[in]  *endRes      Last residue of the framework loop
+   \param[in]  *lc          Loop coordinates
+   \param[in]  *frameStems  N, CA, C and O of the framework takeoff
+                            residues (see GetStemAtoms())
+   \param[in]  *records     Database records of the loops to splice in
+   \param[in]  nModels      Number of records
+   \param[in]  *prefix      Model filenames are prefix_rank.pdb
+   \param[in]  nThreads     Number of threads to use (0 for one per
+                            processor)
+   \return                  Number of models written (-1 if the
+                            framework loop can't be found)
+
+   Writes a model for each record with that loop spliced into the
+   framework
+
+-  18.10.26 Original   By: ACRM
+*/
+int WriteSplicedModels(PDB *framework, char *startRes, char *endRes,
+                       LOOPCOORDS *lc, SUPATOMS *frameStems,
+                       long *records, int nModels, char *prefix,
+                       int nThreads)
+{
+   SPLICEJOB *jobs;
+   pthread_t *threads;
+   BOOL      *written;
+   RESNUM    *frameNum;
+   PDB       *p,
+             *pLast;
+   int       i,
+             nFrame  = 0,
+             nWritten = 0;
+
+   if(nModels < 1)
+      return(0);
+
+   if(((p     = blFindResidueSpec(framework, startRes))==NULL) ||
+      ((pLast = blFindResidueSpec(framework, endRes))==NULL))
+      return(-1);
+
+   /* Record the numbering of the framework loop                        */
+   for(p=blFindResidueSpec(framework, startRes);
+       p!=NULL;
+       p=blFindNextResidue(p))
+   {
+      nFrame++;
+      if(p==pLast)
+         break;
+   }
+   if(p==NULL)
+      return(-1);
+
+   if((frameNum = (RESNUM *)malloc(nFrame * sizeof(RESNUM)))==NULL)
+      return(-1);
+   for(i=0, p=blFindResidueSpec(framework, startRes);
+       i<nFrame;
+       i++, p=blFindNextResidue(p))
+   {
+      frameNum[i].resnum = p->resnum;
+      strcpy(frameNum[i].insert, p->insert);
+   }
+
+   if(nThreads < 1)
+   {
+      long nCPU = sysconf(_SC_NPROCESSORS_ONLN);
+      nThreads  = (nCPU > 0)?(int)nCPU:1;
+   }
+   if(nThreads > nModels)
+      nThreads = nModels;
+
+   jobs    = (SPLICEJOB *)malloc(nThreads * sizeof(SPLICEJOB));
+   threads = (pthread_t *)malloc(nThreads * sizeof(pthread_t));
+   written = (BOOL *)malloc(nModels * sizeof(BOOL));
+   if((jobs == NULL) || (threads == NULL) || (written == NULL))
+   {
+      free(jobs);
+      free(threads);
+      free(written);
+      free(frameNum);
+      return(0);
+   }
+
+   for(i=0; i<nModels; i++)
+      written[i] = FALSE;
+
+   for(i=0; i<nThreads; i++)
+   {
+      jobs[i].framework  = framework;
+      jobs[i].loopStart  = blFindResidueSpec(framework, startRes);
+      jobs[i].loopAfter  = blFindNextResidue(pLast);
+      jobs[i].frameNum   = frameNum;
+      jobs[i].nFrame     = nFrame;
+      jobs[i].lc         = lc;
+      jobs[i].frameStems = frameStems;
+      jobs[i].records    = records;
+      jobs[i].prefix     = prefix;
+      jobs[i].written    = written;
+      jobs[i].nModels    = nModels;
+      jobs[i].nThreads   = nThreads;
+      jobs[i].thread     = i;
+   }
+
+   /* Thread 0 is this one; if a thread can't be started its share of
+      the work is done here instead
+   */
+   for(i=1; i<nThreads; i++)
+   {
+      if(pthread_create(&(threads[i]), NULL, SpliceThread, &(jobs[i])))
+      {
+         SpliceThread(&(jobs[i]));
+         jobs[i].thread = -1;
+      }
+   }
+   SpliceThread(&(jobs[0]));
+   for(i=1; i<nThreads; i++)
+   {
+      if(jobs[i].thread >= 0)
+         pthread_join(threads[i], NULL);
+   }
+
+   for(i=0; i<nModels; i++)
+   {
+      if(written[i])
+         nWritten++;
+   }
+
+   free(jobs);
+   free(threads);
+   free(written);
+   free(frameNum);
+
+   return(nWritten);
+}
+
+
+/************************************************************************/
+/*>static void *SpliceThread(void *arg)
+   ------------------------------------
+*//**
+   \param[in]  *arg    The SPLICEJOB for this thread
+   \return             NULL
+
+   Builds every nThreads'th model starting from the thread number
+
+-  18.10.26 Original   By: ACRM
+*/
+static void *SpliceThread(void *arg)
+{
+   SPLICEJOB *job = (SPLICEJOB *)arg;
+   int       model;
+
+   for(model=job->thread; model<job->nModels; model+=job->nThreads)
+   {
+      job->written[model] = SpliceModel(job, model);
+      if(!job->written[model])
+         fprintf(stderr,"Warning: Unable to write model %d (record \
+%ld)\n", model+1, job->records[model]);
+   }
+   return(NULL);
+}
+
+
+/************************************************************************/
+/*>static BOOL SpliceModel(SPLICEJOB *job, int model)
+   --------------------------------------------------
+*//**
+   \param[in]  *job    Details of the splicing
+   \param[in]  model   Index of the model to build
+   \return             Success
+
+   Fits the loop onto the framework stems and writes the model
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL SpliceModel(SPLICEJOB *job, int model)
+{
+   char     filename[MAXFILENAME],
+            lastChain[blMAXCHAINLABEL];
+   static char *atnam[NBBATOM]     = {"N   ", "CA  ", "C   ", "O   "},
+               *atnamRaw[NBBATOM]  = {" N  ", " CA ", " C  ", " O  "},
+               *element[NBBATOM]   = {"N",    "C",    "C",    "O"};
+   BBRES    *residues;
+   SUPATOMS loopStems;
+   REAL     rotMat[3][3],
+            mobCentre[3],
+            fixCentre[3];
+   PDB      *p,
+            atom;
+   FILE     *fp;
+   int      nRes,
+            loopLen,
+            atnum = 1,
+            nStem = job->lc->header->nStem,
+            i, j, k;
+
+   if((residues = GetLoopCoords(job->lc, job->records[model],
+                                &nRes))==NULL)
+      return(FALSE);
+   if(nRes < 2*nStem)
+      return(FALSE);
+   loopLen = nRes - 2*nStem;
+
+   /* Fit the loop stems onto the framework stems                       */
+   loopStems.nAtoms = 0;
+   for(i=0; i<nRes; i++)
+   {
+      if((i >= nStem) && (i < nRes - nStem))
+         continue;
+      for(j=0; j<NBBATOM; j++)
+      {
+         loopStems.x[loopStems.nAtoms] = residues[i].xyz[j][0];
+         loopStems.y[loopStems.nAtoms] = residues[i].xyz[j][1];
+         loopStems.z[loopStems.nAtoms] = residues[i].xyz[j][2];
+         loopStems.nAtoms++;
+      }
+   }
+   if(SuperposeRMSD(&loopStems, job->frameStems, rotMat, mobCentre,
+                    fixCentre) < 0.0)
+      return(FALSE);
+
+   sprintf(filename, "%s_%d.pdb", job->prefix, model+1);
+   if((fp = fopen(filename, "w"))==NULL)
+      return(FALSE);
+
+   lastChain[0] = '\0';
+
+   /* Framework before the loop                                         */
+   for(p=job->framework; p!=job->loopStart; NEXT(p))
+   {
+      atom = *p;
+      WriteAtom(fp, &atom, &atnum, lastChain);
+   }
+
+   /* The new loop, built on the first atom of the framework loop       */
+   for(i=0; i<loopLen; i++)
+   {
+      BBRES *r = residues + nStem + i;
+
+      for(j=0; j<NBBATOM; j++)
+      {
+         REAL x = r->xyz[j][0] - mobCentre[0],
+              y = r->xyz[j][1] - mobCentre[1],
+              z = r->xyz[j][2] - mobCentre[2];
+
+         atom      = *(job->loopStart);
+         atom.next = NULL;
+         strcpy(atom.record_type, "ATOM  ");
+         strcpy(atom.atnam,       atnam[j]);
+         strcpy(atom.atnam_raw,   atnamRaw[j]);
+         strcpy(atom.element,     element[j]);
+         for(k=0; k<4; k++)
+            atom.resnam[k] = r->resnam[k];
+         atom.resnam[4] = '\0';
+         NumberLoopResidue(i, loopLen, job->frameNum, job->nFrame,
+                           &(atom.resnum), atom.insert);
+         atom.altpos = ' ';
+         atom.occ    = (REAL)1.0;
+         atom.bval   = (REAL)0.0;
+         atom.x = rotMat[0][0]*x + rotMat[0][1]*y + rotMat[0][2]*z +
+                  fixCentre[0];
+         atom.y = rotMat[1][0]*x + rotMat[1][1]*y + rotMat[1][2]*z +
+                  fixCentre[1];
+         atom.z = rotMat[2][0]*x + rotMat[2][1]*y + rotMat[2][2]*z +
+                  fixCentre[2];
+         WriteAtom(fp, &atom, &atnum, lastChain);
+      }
+   }
+
+   /* Framework after the loop                                          */
+   for(p=job->loopAfter; p!=NULL; NEXT(p))
+   {
+      atom = *p;
+      WriteAtom(fp, &atom, &atnum, lastChain);
+   }
+
+   fprintf(fp, "TER   \n");
+   fprintf(fp, "END   \n");
+
+   if(fclose(fp))
+      return(FALSE);
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static void NumberLoopResidue(int i, int loopLen, RESNUM *frameNum,
+                                 int nFrame, int *resnum, char *insert)
+   ----------------------------------------------------------------------
+*//**
+   \param[in]  i         Position in the new loop
+   \param[in]  loopLen   Length of the new loop
+   \param[in]  *frameNum Numbering of the framework loop
+   \param[in]  nFrame    Length of the framework loop
+   \param[out] *resnum   Residue number
+   \param[out] *insert   Insertion code
+
+   Numbers a residue of the new loop. The last NTAIL residues take the
+   last NTAIL framework numbers. Residues before them take the
+   framework numbers in order and any that are left over become
+   insertions on the last of those.
+
+-  18.10.26 Original   By: ACRM
+*/
+static void NumberLoopResidue(int i, int loopLen, RESNUM *frameNum,
+                              int nFrame, int *resnum, char *insert)
+{
+   int nTail = MIN(NTAIL, MIN(loopLen, nFrame)),
+       nHead = nFrame - nTail,
+       base,
+       extra;
+
+   /* The tail                                                          */
+   if(i >= loopLen - nTail)
+   {
+      i = nFrame - (loopLen - i);
+      *resnum = frameNum[i].resnum;
+      strcpy(insert, frameNum[i].insert);
+      return;
+   }
+
+   /* The head                                                          */
+   if(i < nHead)
+   {
+      *resnum = frameNum[i].resnum;
+      strcpy(insert, frameNum[i].insert);
+      return;
+   }
+
+   /* Insertions on the last head residue (or the first residue if the
+      framework loop is too short to have a head)
+   */
+   base  = (nHead > 0)?(nHead - 1):0;
+   extra = i - nHead;
+   *resnum = frameNum[base].resnum;
+   if((frameNum[base].insert[0] == ' ') ||
+      (frameNum[base].insert[0] == '\0'))
+      insert[0] = (char)('A' + extra);
+   else
+      insert[0] = (char)(frameNum[base].insert[0] + 1 + extra);
+   if(insert[0] > 'Z')
+      insert[0] = 'Z';
+   insert[1] = '\0';
+}
+
+
+/************************************************************************/
+/*>static void WriteAtom(FILE *fp, PDB *atom, int *atnum,
+                         char *lastChain)
+   -------------------------------------------------------
+*//**
+   \param[in]     *fp         Output file
+   \param[in,out] *atom       Atom to write (a copy; atom number is
+                              changed)
+   \param[in,out] *atnum      Next atom number
+   \param[in,out] *lastChain  Chain of the previous atom
+
+   Writes an atom, renumbering it and adding a TER card at a chain
+   break
+
+-  18.10.26 Original   By: ACRM
+*/
+static void WriteAtom(FILE *fp, PDB *atom, int *atnum, char *lastChain)
+{
+   if(lastChain[0] && !CHAINMATCH(atom->chain, lastChain))
+      fprintf(fp, "TER   \n");
+   strcpy(lastChain, atom->chain);
+
+   atom->atnum = (*atnum)++;
+   blWritePDBRecord(fp, atom);
+}
@@ -0,0 +1,370 @@
+/************************************************************************/
+/**
+
+   \file       superpose.c
+
+   \version    V1.0
+   \date       18.10.26
+   \brief      Closed-form quaternion superposition of small atom sets
+
+   \copyright  (c) Dr. Andrew C. R. Martin, UCL, 2015-2026
+   \author     Dr. Andrew C. R. Martin
+   \par
+               Institute of Structural & Molecular Biology,
+               University College London,
+               Gower Street,
+               London.
+               WC1E 6BT.
+   \par
+               andrew@bioinf.org.uk
+               andrew.martin@ucl.ac.uk
+
+**************************************************************************
+
+   This code is NOT IN THE PUBLIC DOMAIN, but it may be copied
+   according to the conditions laid out in the accompanying file
+   COPYING.DOC.
+
+   The code may be modified as required, but any modifications must be
+   documented so that the person responsible can be identified.
+
+   The code may not be sold commercially or included as part of a
+   commercial product except as described in the file COPYING.DOC.
+
+**************************************************************************
+
+   Description:
+   ============
+   Least-squares superposition using the quaternion characteristic
+   polynomial (QCP) method of Theobald (Acta Cryst A61:478-480, 2005).
+
+   After centring, the 3x3 inner product matrix M of the two coordinate
+   sets defines a traceless symmetric 4x4 key matrix K whose largest
+   eigenvalue L gives the RMSD as sqrt(2(E0-L)/N) where E0 is half the
+   sum of the squared coordinates. The characteristic polynomial of K
+   is x^4 + c2 x^2 + c1 x + c0 with c2 = -2|M|^2, c1 = -8det(M) and
+   c0 = det(K), so L is found with a few Newton steps from E0. If the
+   rotation is needed, the quaternion is taken from the adjugate of
+   (K - LI).
+
+   The coordinates are held as separate x, y and z arrays so that the
+   accumulation loops vectorize.
+
+**************************************************************************
+
+   Usage:
+   ======
+
+**************************************************************************
+
+   Revision History:
+   =================
+   V1.0   18.10.26  Original   By: ACRM
+
+*************************************************************************/
+/* Includes
+*/
+#include <stdio.h>
+#include <math.h>
+
+#include "bioplib/macros.h"
+#include "loopdb.h"
+
+/************************************************************************/
+/* Defines and macros
+*/
+#define QCP_MAXITER   50
+#define QCP_EPSILON   1.0e-11
+
+/************************************************************************/
+/* Globals
+*/
+
+/************************************************************************/
+/* Prototypes
+*/
+static REAL Det3(REAL m[3][3]);
+static REAL Det4(REAL m[4][4]);
+static void Minor4(REAL m[4][4], int row, int col, REAL minor[3][3]);
+static BOOL QuaternionFromKey(REAL k[4][4], REAL lambda, REAL q[4]);
+
+
+/************************************************************************/
+/*>REAL SuperposeRMSD(SUPATOMS *mobile, SUPATOMS *fixed,
+                      REAL rotMat[3][3], REAL mobCentre[3],
+                      REAL fixCentre[3])
+   ---------------------------------------------------------
+*//**
+   \param[in]   *mobile     Coordinates to be fitted
+   \param[in]   *fixed      Reference coordinates (same number of atoms)
+   \param[out]  rotMat      Rotation matrix (or NULL if not needed)
+   \param[out]  mobCentre   Centroid of mobile (or NULL)
+   \param[out]  fixCentre   Centroid of fixed (or NULL)
+   \return                  The RMSD after optimal superposition
+
+   Finds the minimum RMSD between two sets of coordinates. If rotMat is
+   given, a mobile coordinate p is superposed on fixed by
+      p' = rotMat . (p - mobCentre) + fixCentre
+
+-  18.10.26 Original   By: ACRM
+*/
+REAL SuperposeRMSD(SUPATOMS *mobile, SUPATOMS *fixed, REAL rotMat[3][3],
+                   REAL mobCentre[3], REAL fixCentre[3])
+{
+   REAL cm[3] = {0.0, 0.0, 0.0},
+        cf[3] = {0.0, 0.0, 0.0},
+        m[3][3],
+        k[4][4],
+        e0    = 0.0,
+        c0, c1, c2,
+        lambda,
+        rmsd;
+   int  i, j,
+        n     = mobile->nAtoms;
+
+   if((n == 0) || (n != fixed->nAtoms))
+      return(-1.0);
+
+   /* Centroids                                                         */
+   for(i=0; i<n; i++)
+   {
+      cm[0] += mobile->x[i];  cf[0] += fixed->x[i];
+      cm[1] += mobile->y[i];  cf[1] += fixed->y[i];
+      cm[2] += mobile->z[i];  cf[2] += fixed->z[i];
+   }
+   for(j=0; j<3; j++)
+   {
+      cm[j] /= n;
+      cf[j] /= n;
+   }
+
+   /* Inner product matrix M[a][b] = sum(mobile_a * fixed_b) and E0     */
+   for(i=0; i<3; i++)
+      for(j=0; j<3; j++)
+         m[i][j] = 0.0;
+
+   for(i=0; i<n; i++)
+   {
+      REAL mx = mobile->x[i] - cm[0],
+           my = mobile->y[i] - cm[1],
+           mz = mobile->z[i] - cm[2],
+           fx = fixed->x[i]  - cf[0],
+           fy = fixed->y[i]  - cf[1],
+           fz = fixed->z[i]  - cf[2];
+
+      e0      += mx*mx + my*my + mz*mz + fx*fx + fy*fy + fz*fz;
+      m[0][0] += mx*fx;  m[0][1] += mx*fy;  m[0][2] += mx*fz;
+      m[1][0] += my*fx;  m[1][1] += my*fy;  m[1][2] += my*fz;
+      m[2][0] += mz*fx;  m[2][1] += mz*fy;  m[2][2] += mz*fz;
+   }
+   e0 /= 2.0;
+
+   /* Key matrix                                                        */
+   k[0][0] =  m[0][0] + m[1][1] + m[2][2];
+   k[1][1] =  m[0][0] - m[1][1] - m[2][2];
+   k[2][2] = -m[0][0] + m[1][1] - m[2][2];
+   k[3][3] = -m[0][0] - m[1][1] + m[2][2];
+   k[0][1] = k[1][0] = m[1][2] - m[2][1];
+   k[0][2] = k[2][0] = m[2][0] - m[0][2];
+   k[0][3] = k[3][0] = m[0][1] - m[1][0];
+   k[1][2] = k[2][1] = m[0][1] + m[1][0];
+   k[1][3] = k[3][1] = m[2][0] + m[0][2];
+   k[2][3] = k[3][2] = m[1][2] + m[2][1];
+
+   /* Characteristic polynomial coefficients                            */
+   c2 = 0.0;
+   for(i=0; i<3; i++)
+      for(j=0; j<3; j++)
+         c2 += m[i][j] * m[i][j];
+   c2 = -2.0 * c2;
+   c1 = -8.0 * Det3(m);
+   c0 = Det4(k);
+
+   /* Newton-Raphson for the largest root starting from E0, which is an
+      upper bound
+   */
+   lambda = e0;
+   for(i=0; i<QCP_MAXITER; i++)
+   {
+      REAL lambda2 = lambda * lambda,
+           p       = lambda2*lambda2 + c2*lambda2 + c1*lambda + c0,
+           dp      = 4.0*lambda2*lambda + 2.0*c2*lambda + c1,
+           old     = lambda;
+
+      if(dp == 0.0)
+         break;
+      lambda -= p / dp;
+      if(ABS(lambda - old) < ABS(QCP_EPSILON * lambda))
+         break;
+   }
+
+   rmsd = 2.0 * (e0 - lambda) / n;
+   rmsd = (rmsd > 0.0) ? sqrt(rmsd) : 0.0;
+
+   if(rotMat != NULL)
+   {
+      REAL q[4];
+
+      if(!QuaternionFromKey(k, lambda, q))
+      {
+         /* Degenerate (e.g. identical structures): no rotation         */
+         q[0] = 1.0;
+         q[1] = q[2] = q[3] = 0.0;
+      }
+
+      rotMat[0][0] = q[0]*q[0] + q[1]*q[1] - q[2]*q[2] - q[3]*q[3];
+      rotMat[1][1] = q[0]*q[0] - q[1]*q[1] + q[2]*q[2] - q[3]*q[3];
+      rotMat[2][2] = q[0]*q[0] - q[1]*q[1] - q[2]*q[2] + q[3]*q[3];
+      rotMat[0][1] = 2.0 * (q[1]*q[2] - q[0]*q[3]);
+      rotMat[1][0] = 2.0 * (q[1]*q[2] + q[0]*q[3]);
+      rotMat[0][2] = 2.0 * (q[1]*q[3] + q[0]*q[2]);
+      rotMat[2][0] = 2.0 * (q[1]*q[3] - q[0]*q[2]);
+      rotMat[1][2] = 2.0 * (q[2]*q[3] - q[0]*q[1]);
+      rotMat[2][1] = 2.0 * (q[2]*q[3] + q[0]*q[1]);
+   }
+
+   if(mobCentre != NULL)
+      for(j=0; j<3; j++)
+         mobCentre[j] = cm[j];
+   if(fixCentre != NULL)
+      for(j=0; j<3; j++)
+         fixCentre[j] = cf[j];
+
+   return(rmsd);
+}
+
+
+/************************************************************************/
+/*>static BOOL QuaternionFromKey(REAL k[4][4], REAL lambda, REAL q[4])
+   -------------------------------------------------------------------
+*//**
+   \param[in]   k          Key matrix
+   \param[in]   lambda     Its largest eigenvalue
+   \param[out]  q          Normalized quaternion (eigenvector)
+   \return                 FALSE if no eigenvector could be found
+
+   Since (K - lambda I) has rank 3, every non-zero column of its
+   adjugate is the eigenvector. The column with the largest norm is
+   used for numerical stability.
+
+-  18.10.26 Original   By: ACRM
+*/
+static BOOL QuaternionFromKey(REAL k[4][4], REAL lambda, REAL q[4])
+{
+   REAL a[4][4],
+        minor[3][3],
+        adj[4][4],
+        best    = 0.0,
+        norm;
+   int  i, j,
+        bestCol = -1;
+
+   for(i=0; i<4; i++)
+   {
+      for(j=0; j<4; j++)
+         a[i][j] = k[i][j];
+      a[i][i] -= lambda;
+   }
+
+   /* adj[i][j] is the (j,i) cofactor                                   */
+   for(i=0; i<4; i++)
+   {
+      for(j=0; j<4; j++)
+      {
+         Minor4(a, j, i, minor);
+         adj[i][j] = (((i+j)%2) ? -1.0 : 1.0) * Det3(minor);
+      }
+   }
+
+   for(j=0; j<4; j++)
+   {
+      norm = 0.0;
+      for(i=0; i<4; i++)
+         norm += adj[i][j] * adj[i][j];
+      if(norm > best)
+      {
+         best    = norm;
+         bestCol = j;
+      }
+   }
+
+   if((bestCol < 0) || (best < QCP_EPSILON * QCP_EPSILON))
+      return(FALSE);
+
+   norm = sqrt(best);
+   for(i=0; i<4; i++)
+      q[i] = adj[i][bestCol] / norm;
+
+   return(TRUE);
+}
+
+
+/************************************************************************/
+/*>static REAL Det3(REAL m[3][3])
+   ------------------------------
+*//**
+   \param[in]   m          3x3 matrix
+   \return                 Its determinant
+
+-  18.10.26 Original   By: ACRM
+*/
+static REAL Det3(REAL m[3][3])
+{
+   return(m[0][0] * (m[1][1]*m[2][2] - m[1][2]*m[2][1]) -
+          m[0][1] * (m[1][0]*m[2][2] - m[1][2]*m[2][0]) +
+          m[0][2] * (m[1][0]*m[2][1] - m[1][1]*m[2][0]));
+}
+
+
+/************************************************************************/
+/*>static void Minor4(REAL m[4][4], int row, int col, REAL minor[3][3])
+   --------------------------------------------------------------------
+*//**
+   \param[in]   m          4x4 matrix
+   \param[in]   row        Row to remove
+   \param[in]   col        Column to remove
+   \param[out]  minor      The remaining 3x3 matrix
+
+-  18.10.26 Original   By: ACRM
+*/
+static void Minor4(REAL m[4][4], int row, int col, REAL minor[3][3])
+{
+   int i, j, mi, mj;
+
+   for(i=0, mi=0; i<4; i++)
+   {
+      if(i == row)
+         continue;
+      for(j=0, mj=0; j<4; j++)
+      {
+         if(j == col)
+            continue;
+         minor[mi][mj++] = m[i][j];
+      }
+      mi++;
+   }
+}
+
+
+/************************************************************************/
+/*>static REAL Det4(REAL m[4][4])
+   ------------------------------
+*//**
+   \param[in]   m          4x4 matrix
+   \return                 Its determinant (cofactor expansion)
+
+-  18.10.26 Original   By: ACRM
+*/
+static REAL Det4(REAL m[4][4])
+{
+   REAL minor[3][3],
+        det = 0.0;
+   int  j;
+
+   for(j=0; j<4; j++)
+   {
+      Minor4(m, 0, j, minor);
+      det += ((j%2) ? -1.0 : 1.0) * m[0][j] * Det3(minor);
+   }
+   return(det);
+}
@@ -0,0 +1,117 @@
+#!/bin/sh
+# Benchmarks buildloopdb and scanloopdb on synthetic data (see
+# src/benchgen.c) and appends one JSON line per run to $OUT. Run from
+# the test directory (or with 'make bench' in src).
+#
+# Each line has the form
+#    {"format": 1, "bench": "...", <parameters>, "stats": {...}}
+# where "stats" is the --stats report from the program. RunAnalysis()
+# is stats.phases.analysis of the "build" runs and ScanMatrix() is
+# stats.phases.scan of the "scan" runs. Both reports include the peak
+# memory.
+#
+# Settings may be overridden from the environment, e.g.
+#    SIZES="100 1000" RECORDS=100000 REPEATS=1 ./bench.sh
+
+BIN=${BIN:-../src}
+OUT=${OUT:-bench.jsonl}
+WORK=${WORK:-bench.tmp}
+SEED=${SEED:-12345}
+SIZES=${SIZES:-"100 1000 10000 50000"}      # Residues per chain
+CHAINS=${CHAINS:-1}
+RECORDS=${RECORDS:-"1000000"}               # Up to 100000000
+TOLERANCES=${TOLERANCES:-"0.5 1.0 2.0"}
+NHITS=${NHITS:-"0 10 100"}                  # -n (0 = all)
+REPEATS=${REPEATS:-3}
+QUERY=${QUERY:-pdb1yqv.ent}
+
+set -e
+mkdir -p $WORK/pdb
+: > $OUT
+
+# record bench "parameters" statsfile
+record()
+{
+   printf '{"format": 1, "bench": "%s", %s, "stats": %s}\n' \
+          "$1" "$2" "`tr -d '\n' < $3`" >> $OUT
+}
+
+# nonempty db what - stops if a build wrote no records, as the timings
+# would not be of the analysis
+nonempty()
+{
+   if ! grep -q '^[^#]' $1; then
+      echo "FAIL: buildloopdb found no loops in $2" 1>&2
+      exit 1
+   fi
+}
+
+# Building from single structures and from a directory of them
+for size in $SIZES
+do
+   pdb=$WORK/pdb/syn$size.pdb
+   $BIN/benchgen -S $SEED -p $size -c $CHAINS $pdb
+   r=1
+   while [ $r -le $REPEATS ]
+   do
+      echo "build: $size residues, run $r" 1>&2
+      $BIN/buildloopdb -p --stats $WORK/build.json $pdb $WORK/syn.db
+      nonempty $WORK/syn.db $pdb
+      record build "\"residues\": $size, \"chains\": $CHAINS, \
+\"repeat\": $r" $WORK/build.json
+      r=`expr $r + 1`
+   done
+done
+
+r=1
+while [ $r -le $REPEATS ]
+do
+   echo "build: directory, run $r" 1>&2
+   $BIN/buildloopdb --stats $WORK/build.json $WORK/pdb $WORK/syn.db \
+      2>/dev/null
+   nonempty $WORK/syn.db $WORK/pdb
+   record build_dir "\"sizes\": \"$SIZES\", \"chains\": $CHAINS, \
+\"repeat\": $r" $WORK/build.json
+   r=`expr $r + 1`
+done
+
+# Scanning databases of each size with and without the sidecar
+for records in $RECORDS
+do
+   db=$WORK/loops$records.db
+   $BIN/benchgen -S $SEED -d $records $WORK/gen.db
+   $BIN/mergeloopdb -q $WORK/loops$records.q8 $db $WORK/gen.db
+   rm -f $WORK/gen.db
+
+   for mode in full sidecar
+   do
+      qf=""
+      if [ $mode = sidecar ]; then
+         qf="-q $WORK/loops$records.q8"
+      fi
+      for tol in $TOLERANCES
+      do
+         for n in $NHITS
+         do
+            r=1
+            while [ $r -le $REPEATS ]
+            do
+               echo "scan: $records records, $mode, -t $tol -n $n, \
+run $r" 1>&2
+               rm -f $WORK/scan.json
+               $BIN/scanloopdb --stats $WORK/scan.json $qf -t $tol \
+                  -n $n $db $QUERY > /dev/null
+               record scan "\"records\": $records, \"mode\": \"$mode\", \
+\"tolerance\": $tol, \"n\": $n, \"repeat\": $r" $WORK/scan.json
+               r=`expr $r + 1`
+            done
+         done
+      done
+   done
+   rm -f $db $WORK/loops$records.q8
+done
+
+if [ -z "$KEEP" ]; then
+   rm -rf $WORK
+fi
+echo "Results written to $OUT" 1>&2
@@ -0,0 +1,531 @@
+#!/bin/sh
+# Differential test of buildloopdb and scanloopdb. Runs the optimized
+# code (the default, with random choices of the sidecar, coordinates,
+# CA pack, extra loop types, query cache and so on) side by side with
+# the --reference implementations on the structures in this directory
+# and on synthetic ones (see src/benchgen.c), over random stem sizes,
+# distance tables, loop lengths, residue ranges and tolerances, checks
+# that merged shards, updates (-u), resumed builds (-k) and --exptl give
+# the database of a single build, and checks that libloopdb's
+# LoopDBScan() gives the hits printed by scanloopdb (see
+# src/libscantest.c). Stops at the first difference, printing the
+# commands and the first record that differs, and leaves the files in
+# $WORK. Run from the test directory (or with 'make difftest' in src).
+#
+# Settings may be overridden from the environment, e.g.
+#    SEED=42 ROUNDS=50 QUERIES=20 ./difftest.sh
+
+BIN=${BIN:-../src}
+WORK=${WORK:-difftest.tmp}
+SEED=${SEED:-1}
+ROUNDS=${ROUNDS:-10}                        # Random builds
+QUERIES=${QUERIES:-10}                      # Random queries per build
+SYNTHETIC=${SYNTHETIC:-3}                   # Synthetic structures
+REAL=${REAL:-"pdb1yqv.ent pdb1yqv.ent_3dwn ../src/test/pdb104l.ent"}
+
+rm -rf $WORK
+mkdir -p $WORK/pdb $WORK/stream $WORK/large $WORK/cache
+
+# random lo hi - sets RAND to a random integer from lo to hi
+NRAND=0
+random()
+{
+   NRAND=`expr $NRAND + 1`
+   RAND=`awk -v s=$SEED -v n=$NRAND -v lo=$1 -v hi=$2 'BEGIN {
+      srand(s * 100003 + n); rand();
+      printf "%d", lo + int(rand() * (hi - lo + 1)) }'`
+}
+
+# randomf lo hi - sets RAND to a random real from lo to hi
+randomf()
+{
+   NRAND=`expr $NRAND + 1`
+   RAND=`awk -v s=$SEED -v n=$NRAND -v lo=$1 -v hi=$2 'BEGIN {
+      srand(s * 100003 + n); rand();
+      printf "%.2f", lo + rand() * (hi - lo) }'`
+}
+
+# fail message - reports a failure and stops
+fail()
+{
+   echo "FAIL: $1" 1>&2
+   echo "Files left in $WORK (SEED=$SEED)" 1>&2
+   exit 1
+}
+
+# compare what reference optimized - checks the outputs are the same,
+# ignoring the build date, and reports the first record that is not
+compare()
+{
+   grep -v '^#DATE' $2 > $WORK/ref.cmp
+   grep -v '^#DATE' $3 > $WORK/opt.cmp
+   if ! cmp -s $WORK/ref.cmp $WORK/opt.cmp; then
+      awk -v opt=$WORK/opt.cmp '
+         {  if((getline line < opt) <= 0) line = "(end of output)";
+            if($0 != line) {
+               printf "First difference at record %d:\n", NR;
+               printf "   reference: %s\n   optimized: %s\n", $0, line;
+               exit;
+            }
+         }
+         END { if((getline line < opt) > 0) {
+                  printf "First difference at record %d:\n", NR + 1;
+                  printf "   reference: (end of output)\n";
+                  printf "   optimized: %s\n", line;
+               }
+             }' $WORK/ref.cmp 1>&2
+      fail "$1"
+   fi
+}
+
+# nocross in out - copies a database or hits without the loops that
+# run from one chain into the next
+nocross()
+{
+   awk '/^#/ { print; next }
+        {  a = $2; b = $3;
+           sub(/[-0-9].*/, "", a); sub(/[-0-9].*/, "", b);
+           if(a == b) print }' $1 > $2
+}
+
+# run command... - runs a command, stopping if it fails
+run()
+{
+   echo "$@" >> $WORK/commands
+   "$@" 2>>$WORK/stderr || fail "$*"
+}
+
+# single dir name - builds a database of dir in a single run, with the
+# sidecar, coordinates and manifest, as $WORK/name.db, .q8, .bb and .mft
+single()
+{
+   run $BIN/buildloopdb $opts -q $WORK/$2.q8 -c $WORK/$2.bb \
+       -M $WORK/$2.mft $1 $WORK/$2.db
+}
+
+# same what ref opt - checks that $WORK/opt.db, its sidecar, its
+# coordinates and (if it has one) its manifest are those of $WORK/ref.db
+same()
+{
+   compare "$1" $WORK/$2.db $WORK/$3.db
+   cmp -s $WORK/$2.q8 $WORK/$3.q8 || fail "$1 (sidecar)"
+   cmp -s $WORK/$2.bb $WORK/$3.bb || fail "$1 (coordinates)"
+   if [ -f $WORK/$3.mft ]; then
+      compare "$1 (manifest)" $WORK/$2.mft $WORK/$3.mft
+   fi
+}
+
+# Structures: the real ones and some synthetic ones with several chains
+for pdb in $REAL
+do
+   cp $pdb $WORK/pdb/`basename $pdb`.pdb
+done
+
+# A copy of 1yqv with the heavy chain relabelled from H60, so that two
+# chains lie within bonding distance and loops can run from one into
+# the next
+awk '/^(ATOM|HETATM)/ && substr($0, 22, 1) == "H" &&
+     substr($0, 23, 4) + 0 >= 60 {
+        $0 = substr($0, 1, 21) "I" substr($0, 23) }
+     { print }' pdb1yqv.ent > $WORK/pdb/nicked.pdb
+i=1
+while [ $i -le $SYNTHETIC ]
+do
+   random 30 400; size=$RAND
+   random 1 3;    chains=$RAND
+   run $BIN/benchgen -S `expr $SEED + $i` -p $size -c $chains \
+       $WORK/pdb/syn$i.pdb
+   i=`expr $i + 1`
+done
+set -- $WORK/pdb/*.pdb
+nPdb=$#
+
+# A structure large enough to be split into tasks run by several
+# threads (loopdb.h, BL_MINPARALLEL), with chains that are not a
+# multiple of the task size. It is kept apart as it makes the builds
+# slower
+random 700 1000; size=$RAND
+run $BIN/benchgen -S $SEED -p $size -c 3 $WORK/large/large.pdb
+
+# --stream is checked on the structures whose chains each come in one
+# piece, so that a loop that runs into the next chain starts and ends
+# in different chains
+for pdb in "$@"
+do
+   if awk '/^ATOM/ {
+              ch = substr($0, 22, 1);
+              if(ch != last) { if(ch in seen) broken = 1; seen[ch] = 1 }
+              last = ch;
+           }
+           END { exit broken }' $pdb; then
+      cp $pdb $WORK/stream
+   fi
+done
+
+# --diverse on the hits in 1yqv_15.hits, read as a database. The
+# copies of the 3mlt/3mlu loop collapse to one hit, clustering carries
+# on past --diversetop until there are -n hits and every hit is either
+# kept or counted as rejected_similar
+sed 's/ *:.*//' 1yqv_15.hits > $WORK/h15.db
+dsopts="-l 15 -t 10 -r H95 H102"
+run $BIN/scanloopdb --diverse 0.2 --diversetop 300 $dsopts $WORK/h15.db \
+    pdb1yqv.ent $WORK/ref.hits
+n=`grep -c '^3ml[tu] ' $WORK/ref.hits`
+if [ $n -ne 1 ]; then
+   fail "scanloopdb --diverse 0.2 $dsopts leaves $n 3mlt/3mlu hits"
+fi
+head -20 $WORK/ref.hits > $WORK/ref.top
+rm -f $WORK/diverse.json
+run $BIN/scanloopdb --diverse 0.2 --diversetop 5 -n 20 \
+    --stats $WORK/diverse.json $dsopts $WORK/h15.db pdb1yqv.ent \
+    $WORK/opt.hits
+compare "scanloopdb --diverse 0.2 --diversetop 5 -n 20 $dsopts" \
+    $WORK/ref.top $WORK/opt.hits
+n=`awk '{ match($0, /"hits": [0-9]+/);
+          hits = substr($0, RSTART + 8, RLENGTH - 8);
+          match($0, /"rejected_similar": [0-9]+/);
+          print hits + substr($0, RSTART + 20, RLENGTH - 20) }' \
+       $WORK/diverse.json`
+if [ "$n" -ne `wc -l < 1yqv_15.hits` ]; then
+   fail "scanloopdb --diverse --stats accounts for $n of the hits"
+fi
+
+# --dedup on a homodimer of the nicked 1yqv (the second copy moved
+# along x and relabelled) where loops run from H into I and from N into
+# O. With the alias chains given the records of their canonical chains,
+# the records must be those found without --dedup
+awk '/^(ATOM|HETATM)/ {
+        print > "'$WORK/dimer.tmp'";
+        n = index("LHIY", substr($0, 22, 1));
+        printf "%s%s%s%8.3f%s\n", substr($0, 1, 21),
+               substr("MNOZ", n, 1), substr($0, 23, 8),
+               substr($0, 31, 8) + 60.0, substr($0, 39) > "'$WORK/copy.tmp'"
+     }' $WORK/pdb/nicked.pdb
+cat $WORK/dimer.tmp $WORK/copy.tmp > $WORK/dimer.pdb
+echo END >> $WORK/dimer.pdb
+run $BIN/buildloopdb -p $WORK/dimer.pdb $WORK/ref.db
+awk '!/^#/ && NF { print $1, $2, $3, $4 }' $WORK/ref.db | sort \
+    > $WORK/ref.keys
+run $BIN/buildloopdb -p --dedup $WORK/dimer.aliases $WORK/dimer.pdb \
+    $WORK/opt.db
+if [ -z "`awk -F'\t' '$2 == "M" && $4 == "L"' $WORK/dimer.aliases`" ]
+then
+   fail "buildloopdb --dedup does not find chain M repeats chain L"
+fi
+awk -v aliases=$WORK/dimer.aliases '
+   BEGIN { while((getline line < aliases) > 0) {
+              if(line ~ /^#/) continue;
+              split(line, f, "\t");
+              n++; alias[n] = f[2]; canon[n] = f[4];
+           }
+         }
+   /^#/ || NF == 0 { next }
+   {  print $1, $2, $3, $4;
+      a = $2; b = $3;
+      sub(/[-0-9].*/, "", a); sub(/[-0-9].*/, "", b);
+      for(i=1; i<=n; i++) {
+         if((a == canon[i]) && (b == canon[i])) {
+            a = $2; b = $3;
+            sub(/^[^-0-9]*/, "", a); sub(/^[^-0-9]*/, "", b);
+            print $1, alias[i] a, alias[i] b, $4;
+         }
+      }
+   }' $WORK/opt.db | sort > $WORK/opt.keys
+compare "buildloopdb -p --dedup (homodimer)" $WORK/ref.keys $WORK/opt.keys
+
+# LoopDBScan() ranks hits as scanloopdb does. The two copies in the
+# homodimer give every loop a twin with exactly the same score, so
+# this checks that ties are ranked the same way
+for n in 0 3
+do
+   lsopts="-t 3.0 -n $n -r H95 H102"
+   run $BIN/scanloopdb $lsopts $WORK/ref.db pdb1yqv.ent $WORK/ref.hits
+   run $BIN/libscantest $lsopts $WORK/ref.db pdb1yqv.ent $WORK/opt.hits
+   compare "libscantest $lsopts (homodimer)" $WORK/ref.hits $WORK/opt.hits
+done
+
+nQueries=0
+nHits=0
+round=1
+while [ $round -le $ROUNDS ]
+do
+   : > $WORK/commands
+
+   # Random stem size, loop lengths and distance table. With the
+   # default table, the records are CDR-H3 like; otherwise the table
+   # allows any distance up to a random maximum
+   random 2 5;  stem=$RAND
+   random 1 10; minLen=$RAND
+   random 0 25; maxLen=`expr $minLen + $RAND`
+   random 0 1
+   table=""
+   if [ $stem -ne 3 ] || [ $RAND -eq 1 ]; then
+      randomf 10 40; maxDist=$RAND
+      awk -v n=$stem -v d=$maxDist 'BEGIN {
+         for(i=0; i<n*n; i++) printf "0.0 %s\n", d }' > $WORK/dist.tab
+      table="-t $WORK/dist.tab"
+   fi
+   opts="-s $stem -m $minLen -x $maxLen $table"
+
+   # An extra loop type for the multiple output path
+   random 0 1
+   extra=""
+   if [ $RAND -eq 1 ]; then
+      random 1 5;  tMin=$RAND
+      random 0 15; tMax=`expr $tMin + $RAND`
+      tTable=-
+      [ -z "$table" ] || tTable=$WORK/dist.tab
+      extra="-T $tTable $tMin $tMax $WORK/type.db"
+   fi
+
+   echo "Round $round: -s $stem -m $minLen -x $maxLen \
+${table:+(wide table)} ${extra:+(two loop types)}" 1>&2
+
+   # Building from single files
+   for pdb in "$@"
+   do
+      run $BIN/buildloopdb -p --reference $opts $pdb $WORK/ref.db
+      run $BIN/buildloopdb -p $opts $pdb $WORK/opt.db
+      compare "buildloopdb -p $opts $pdb" $WORK/ref.db $WORK/opt.db
+      [ "`awk '/^#STEM:/ {print $2}' $WORK/opt.db`" = "$stem" ] || \
+         fail "buildloopdb -p $opts $pdb does not give the stem size"
+   done
+
+   # Splitting the large structure between threads gives the same
+   # records in the same order
+   run $BIN/buildloopdb --reference $opts $extra $WORK/large \
+       $WORK/largeref.db
+   [ -z "$extra" ] || mv $WORK/type.db $WORK/largereftype.db
+   run $BIN/buildloopdb -j 4 $opts $extra -c $WORK/large.bb $WORK/large \
+       $WORK/largeopt.db
+   compare "buildloopdb -j 4 $opts $extra (large)" $WORK/largeref.db \
+       $WORK/largeopt.db
+   if [ -n "$extra" ]; then
+      compare "buildloopdb -j 4 $opts $extra (large, second type)" \
+          $WORK/largereftype.db $WORK/type.db
+   fi
+
+   # Building from the directory with the reference and then the
+   # optimized code with random extras: the sidecar and coordinates
+   # and either a CA pack or a shard
+   run $BIN/buildloopdb --reference $opts $extra $WORK/pdb $WORK/ref.db
+   [ -z "$extra" ] || mv $WORK/type.db $WORK/reftype.db
+   random 0 2
+   case $RAND in
+   0) run $BIN/buildloopdb $opts $extra -q $WORK/opt.q8 -c $WORK/opt.bb \
+          $WORK/pdb $WORK/opt.db
+      ;;
+   1) run $BIN/buildloopdb $opts -P $WORK/opt.pack -c $WORK/pack.bb \
+          $WORK/pdb $WORK/pack.db
+      run $BIN/buildloopdb $opts $extra -q $WORK/opt.q8 -c $WORK/opt.bb \
+          -R $WORK/opt.pack $WORK/opt.db
+      ;;
+   2) random 1 2; shard=$RAND
+      run $BIN/buildloopdb --reference $opts --shard $shard/2 $WORK/pdb \
+          $WORK/refshard.db
+      run $BIN/buildloopdb $opts --shard $shard/2 $WORK/pdb \
+          $WORK/optshard.db
+      compare "buildloopdb $opts --shard $shard/2" $WORK/refshard.db \
+          $WORK/optshard.db
+      run $BIN/buildloopdb $opts $extra -q $WORK/opt.q8 -c $WORK/opt.bb \
+          $WORK/pdb $WORK/opt.db
+      ;;
+   esac
+   compare "buildloopdb $opts $extra" $WORK/ref.db $WORK/opt.db
+   if [ -n "$extra" ]; then
+      compare "buildloopdb $opts $extra (second type)" $WORK/reftype.db \
+          $WORK/type.db
+   fi
+
+   # Merging shards, given in reverse order, gives the database of a
+   # single build
+   single $WORK/pdb single
+   random 2 3; nShards=$RAND
+   shards=""
+   i=1
+   while [ $i -le $nShards ]
+   do
+      run $BIN/buildloopdb $opts --shard $i/$nShards -c $WORK/shard$i.bb \
+          $WORK/pdb $WORK/shard$i.db
+      shards="$WORK/shard$i.db $shards"
+      i=`expr $i + 1`
+   done
+   rm -f $WORK/merged.mft
+   run $BIN/mergeloopdb $table -q $WORK/merged.q8 -c $WORK/merged.bb \
+       $WORK/merged.db $shards
+   same "mergeloopdb of buildloopdb $opts --shard i/$nShards" single \
+       merged
+
+   # So does --exptl, less the experimental details at the end of each
+   # record
+   run $BIN/buildloopdb $opts --exptl $WORK/pdb $WORK/exptl.db
+   grep -q '^#EXPTL:' $WORK/exptl.db || \
+      fail "buildloopdb --exptl $opts does not write the #EXPTL: header"
+   awk '/^#EXPTL:/ { next }
+        /^#/ || NF == 0 { print; next }
+        { sub(/[^ ]+ [^ ]+ [^ ]+$/, ""); print }' $WORK/exptl.db \
+       > $WORK/noexptl.db
+   compare "buildloopdb --exptl $opts" $WORK/single.db $WORK/noexptl.db
+
+   # Updating a database built with -M after one file has changed, one
+   # has been added and one removed reuses the records of the others and
+   # gives the database of a single build
+   eval added=\${$nPdb}
+   changed=$1
+   rm -rf $WORK/update
+   mkdir $WORK/update
+   cp "$@" $WORK/update
+   rm $WORK/update/`basename $added`
+   cp $added $WORK/update/removed.pdb
+   echo "REMARK 999 CHANGED" | cat - $changed \
+       > $WORK/update/`basename $changed`
+   single $WORK/update old
+   rm $WORK/update/removed.pdb
+   cp $changed $added $WORK/update
+   run $BIN/buildloopdb $opts -q $WORK/update.q8 -c $WORK/update.bb \
+       -M $WORK/update.mft -u $WORK/old.db $WORK/old.mft \
+       --stats $WORK/update.json $WORK/update $WORK/update.db
+   n=`sed -n 's/.*"reused": \([0-9]*\).*/\1/p' $WORK/update.json`
+   if [ "$n" != "`expr $nPdb - 2`" ]; then
+      fail "buildloopdb -u $opts reuses $n of `expr $nPdb - 2` files"
+   fi
+   single $WORK/update fresh
+   same "buildloopdb -u $opts" fresh update
+
+   # Resuming an interrupted build gives the database of a single build.
+   # A FIFO stands in for one of the files so that the build stops
+   # there; it is killed once it has checkpointed the file before and
+   # resumed with the file in place
+   rm -rf $WORK/resume $WORK/resume.ck
+   mkdir $WORK/resume
+   cp "$@" $WORK/resume
+   random 2 $nPdb
+   prev=`ls $WORK/resume | LC_ALL=C sort | sed -n "\`expr $RAND - 1\`p"`
+   held=`ls $WORK/resume | LC_ALL=C sort | sed -n "${RAND}p"`
+   mv $WORK/resume/$held $WORK/held.pdb
+   mkfifo $WORK/resume/$held
+   ropts="$opts -q $WORK/resume.q8 -c $WORK/resume.bb -M $WORK/resume.mft \
+-k $WORK/resume.ck"
+   echo "$BIN/buildloopdb $ropts -K 0 $WORK/resume $WORK/resume.db &" \
+       >> $WORK/commands
+   $BIN/buildloopdb $ropts -K 0 $WORK/resume $WORK/resume.db \
+       2>>$WORK/stderr &
+   pid=$!
+   until grep -q "^LASTFILE *$WORK/resume/$prev\$" $WORK/resume.ck \
+         2>/dev/null
+   do
+      kill -0 $pid 2>/dev/null || \
+         fail "buildloopdb -k $opts -K 0 stops before $held"
+      sleep 1
+   done
+   kill $pid
+   wait $pid
+   rm $WORK/resume/$held
+   mv $WORK/held.pdb $WORK/resume/$held
+   run $BIN/buildloopdb $ropts --resume $WORK/resume $WORK/resume.db
+   [ ! -f $WORK/resume.ck ] || \
+      fail "buildloopdb -k $opts --resume leaves the checkpoint"
+   single $WORK/resume fresh
+   same "buildloopdb -k $opts --resume (after $prev)" fresh resume
+
+   # Reading one chain at a time gives the same records except those
+   # running into the next chain
+   run $BIN/buildloopdb $opts -c $WORK/whole.bb $WORK/stream \
+       $WORK/whole.db
+   run $BIN/buildloopdb --stream $opts -c $WORK/stream.bb $WORK/stream \
+       $WORK/stream.db
+   nocross $WORK/whole.db $WORK/nocross.db
+   compare "buildloopdb --stream $opts" $WORK/nocross.db $WORK/stream.db
+
+   # Random queries against the database: a random loop in a random
+   # structure, a random tolerance and sometimes a different length
+   q=1
+   while [ $q -le $QUERIES ]
+   do
+      random 1 $nPdb; eval query=\${$RAND}
+      random $minLen $maxLen; len=$RAND
+      random 1 1000000
+      range=`awk -v k=$stem -v len=$len -v r=$RAND '
+         /^ATOM/ && substr($0, 13, 4) == " CA " {
+            id = substr($0, 22, 1) substr($0, 23, 4) substr($0, 27, 1);
+            gsub(/ /, "", id);
+            if(id != last) { n++; res[n] = id; ch[n] = substr($0, 22, 1) }
+            last = id;
+         }
+         END {
+            if(n < len + 2*k) exit;
+            for(t=0; t<n; t++) {
+               s = k + 1 + (r + t) % (n - len - 2*k + 1);
+               e = s + len - 1;
+               if(ch[s-k] == ch[e+k]) { print res[s], res[e]; exit }
+            }
+         }' $query`
+      if [ -z "$range" ]; then
+         q=`expr $q + 1`
+         continue
+      fi
+      randomf 0.1 3.0; tol=$RAND
+      random 0 20;     nhits="-n $RAND"
+      random 0 3;      loopLen=""
+      [ $RAND -ne 0 ] || loopLen="-l `expr $len + 1`"
+      sopts="$loopLen -t $tol $nhits -r $range"
+
+      run $BIN/scanloopdb --reference $sopts $WORK/ref.db $query \
+          $WORK/ref.hits
+      run $BIN/scanloopdb $sopts $WORK/opt.db $query $WORK/opt.hits
+      compare "scanloopdb $sopts $query" $WORK/ref.hits $WORK/opt.hits
+      nQueries=`expr $nQueries + 1`
+      nHits=`expr $nHits + \`wc -l < $WORK/ref.hits\``
+      run $BIN/scanloopdb -q $WORK/opt.q8 $sopts $WORK/opt.db $query \
+          $WORK/opt.hits
+      compare "scanloopdb -q $sopts $query" $WORK/ref.hits $WORK/opt.hits
+      run $BIN/libscantest $sopts $WORK/opt.db $query $WORK/opt.hits
+      compare "libscantest $sopts $query" $WORK/ref.hits $WORK/opt.hits
+
+      # The cache is filled by the first query and used by the second
+      rm -rf $WORK/cache/*
+      for pass in miss hit
+      do
+         run $BIN/scanloopdb -C $WORK/cache $sopts $WORK/opt.db $query \
+             $WORK/opt.hits
+         compare "scanloopdb -C ($pass) $sopts $query" $WORK/ref.hits \
+             $WORK/opt.hits
+      done
+
+      # Reranking by RMSD gives the same results from the same hits
+      run $BIN/scanloopdb --reference -c $WORK/opt.bb $sopts \
+          $WORK/opt.db $query $WORK/ref.hits
+      run $BIN/scanloopdb -c $WORK/opt.bb -q $WORK/opt.q8 $sopts \
+          $WORK/opt.db $query $WORK/opt.hits
+      compare "scanloopdb -c -q $sopts $query" $WORK/ref.hits \
+          $WORK/opt.hits
+      run $BIN/libscantest -c $WORK/opt.bb $sopts $WORK/opt.db $query \
+          $WORK/opt.hits
+      compare "libscantest -c $sopts $query" $WORK/ref.hits \
+          $WORK/opt.hits
+
+      # So do the coordinates read one chain at a time. All the hits
+      # are reranked and sorted since those running into the next
+      # chain are left out
+      rsopts="$loopLen -t $tol -r $range -M 1000000"
+      run $BIN/scanloopdb -c $WORK/whole.bb $rsopts $WORK/whole.db \
+          $query $WORK/opt.hits
+      run $BIN/scanloopdb -c $WORK/stream.bb $rsopts $WORK/stream.db \
+          $query $WORK/stream.hits
+      nocross $WORK/opt.hits $WORK/ref.hits
+      sort $WORK/ref.hits > $WORK/ref.sorted
+      sort $WORK/stream.hits > $WORK/stream.sorted
+      compare "scanloopdb -c $rsopts (--stream) $query" $WORK/ref.sorted \
+          $WORK/stream.sorted
+      q=`expr $q + 1`
+   done
+
+   round=`expr $round + 1`
+done
+
+if [ -z "$KEEP" ]; then
+   rm -rf $WORK
+fi
+echo "All $ROUNDS builds and $nQueries queries ($nHits hits) gave the \
+same results as the" 1>&2
+echo "reference" 1>&2